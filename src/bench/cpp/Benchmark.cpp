@@ -0,0 +1,74 @@
+#include "Benchmark.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+using namespace pistis::bench;
+
+namespace {
+  typedef std::chrono::steady_clock Clock;
+
+  // Runs shorter than this are too noisy to report
+  const double MIN_RUN_TIME = 0.5;
+
+  std::vector< std::pair<std::string, BenchmarkFunction> >& registry() {
+    static std::vector< std::pair<std::string, BenchmarkFunction> > r;
+    return r;
+  }
+
+  double timeRun(BenchmarkFunction f, size_t iterations, size_t& bytes) {
+    const Clock::time_point start = Clock::now();
+    bytes = f(iterations);
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+}
+
+BenchmarkRegistration::BenchmarkRegistration(const char* name,
+					     BenchmarkFunction f) {
+  registry().emplace_back(name, f);
+}
+
+size_t pistis::bench::runBenchmarks(const std::string& filter) {
+  auto& benchmarks = registry();
+  size_t count = 0;
+
+  std::sort(benchmarks.begin(), benchmarks.end());
+  std::cout << std::left << std::setw(48) << "Benchmark" << std::right
+	    << std::setw(14) << "Iterations" << std::setw(14) << "ns/iter"
+	    << std::setw(12) << "MB/s" << std::endl;
+  for (const auto& b : benchmarks) {
+    if (b.first.find(filter) == std::string::npos) {
+      continue;
+    }
+
+    size_t iterations = 1;
+    size_t bytes = 0;
+    double t = timeRun(b.second, iterations, bytes);
+    while (t < MIN_RUN_TIME) {
+      // Aim for 1.5 * MIN_RUN_TIME, but grow by at most 100x per step
+      const double scale = (t > 0.0) ? (1.5 * MIN_RUN_TIME / t) : 100.0;
+      iterations = (size_t)(iterations * std::min(std::max(scale, 2.0),
+						   100.0));
+      t = timeRun(b.second, iterations, bytes);
+    }
+
+    std::cout << std::left << std::setw(48) << b.first << std::right
+	      << std::setw(14) << iterations << std::setw(14)
+	      << std::fixed << std::setprecision(2)
+	      << (t * 1e9 / iterations);
+    if (bytes) {
+      std::cout << std::setw(12) << std::setprecision(1) << (bytes / t / 1e6);
+    }
+    std::cout << std::endl;
+    ++count;
+  }
+  return count;
+}
+
+int main(int argc, char** argv) {
+  const std::string filter = (argc > 1) ? argv[1] : "";
+  return pistis::bench::runBenchmarks(filter) ? 0 : 1;
+}
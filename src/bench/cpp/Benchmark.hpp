@@ -0,0 +1,62 @@
+#ifndef __PISTIS__BENCH__BENCHMARK_HPP__
+#define __PISTIS__BENCH__BENCHMARK_HPP__
+
+/** @file Benchmark.hpp
+ *
+ *  A minimal benchmark harness.  Define a benchmark with
+ *
+ *    PISTIS_BENCHMARK(IStringHash_Wy_32) {
+ *      for (size_t i = 0; i < iterations; ++i) {
+ *        pistis::bench::doNotOptimize(...);
+ *      }
+ *      return iterations * 32;  // Bytes processed, or zero
+ *    }
+ *
+ *  The harness runs each benchmark with increasing iteration counts
+ *  until one run takes long enough to time reliably, then reports the
+ *  time per iteration and, if the benchmark returns the number of bytes
+ *  it processed, the throughput.  Benchmark names follow
+ *  <Subject>_<Variant>_<Parameter> so related results sort together.
+ */
+
+#include <string>
+#include <stddef.h>
+
+namespace pistis {
+  namespace bench {
+
+    /** @brief Runs a benchmark for the given number of iterations and
+     *         returns the number of bytes it processed (zero if that is
+     *         not meaningful).
+     */
+    typedef size_t (*BenchmarkFunction)(size_t iterations);
+
+    /** @brief Adds a benchmark to the registry when constructed */
+    class BenchmarkRegistration {
+    public:
+      BenchmarkRegistration(const char* name, BenchmarkFunction f);
+    };
+
+    /** @brief Keep the compiler from optimizing away the computation of v
+     */
+    template <typename T>
+    inline void doNotOptimize(const T& v) {
+      asm volatile("" : : "r"(&v) : "memory");
+    }
+
+    /** @brief Run every registered benchmark whose name contains filter
+     *
+     *  Returns the number of benchmarks run.
+     */
+    size_t runBenchmarks(const std::string& filter);
+
+  }
+}
+
+#define PISTIS_BENCHMARK(NAME)						\
+  static size_t NAME(size_t iterations);				\
+  static const ::pistis::bench::BenchmarkRegistration			\
+      NAME##_registration_(#NAME, NAME);				\
+  static size_t NAME(size_t iterations)
+
+#endif
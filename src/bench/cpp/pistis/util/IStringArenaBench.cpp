@@ -0,0 +1,83 @@
+#include <Benchmark.hpp>
+#include <pistis/util/IStringArena.hpp>
+#include <string>
+#include <vector>
+
+using namespace pistis::util;
+using pistis::bench::doNotOptimize;
+
+namespace {
+  // Header values from one request, each too long to store inline
+  const std::vector<std::string>& fields() {
+    static const std::vector<std::string> FIELDS = [] {
+      std::vector<std::string> f;
+      for (size_t i = 0; i < 64; ++i) {
+	f.push_back("x-request-header-" + std::to_string(i) +
+		    ": some/value;q=0." + std::to_string(i % 10));
+      }
+      return f;
+    }();
+    return FIELDS;
+  }
+
+  size_t fieldBytes() {
+    size_t n = 0;
+    for (const std::string& f : fields()) {
+      n += f.size();
+    }
+    return n;
+  }
+
+  // Copy every field of a request into a string and drop them all
+  template <typename String, typename Allocator>
+  void copyFields(const Allocator& allocator) {
+    std::vector<String> strings;
+    strings.reserve(fields().size());
+    for (const std::string& f : fields()) {
+      strings.emplace_back(f, allocator);
+    }
+    doNotOptimize(strings.data());
+  }
+
+  // Format every field of a request with a builder
+  template <typename Builder, typename Allocator>
+  void buildFields(const Allocator& allocator) {
+    for (size_t i = 0; i < fields().size(); ++i) {
+      Builder builder(allocator);
+      builder << "x-request-header-" << i << ": " << fields()[i];
+      doNotOptimize(builder.done());
+    }
+  }
+}
+
+PISTIS_BENCHMARK(IStringArena_Heap_CopyFields) {
+  for (size_t i = 0; i < iterations; ++i) {
+    copyFields<IString>(std::allocator<uint8_t>());
+  }
+  return iterations * fieldBytes();
+}
+
+PISTIS_BENCHMARK(IStringArena_Arena_CopyFields) {
+  IStringArena arena;
+  for (size_t i = 0; i < iterations; ++i) {
+    copyFields<ArenaIString>(IStringArenaAllocator(arena));
+    arena.release();
+  }
+  return iterations * fieldBytes();
+}
+
+PISTIS_BENCHMARK(IStringArena_Heap_BuildFields) {
+  for (size_t i = 0; i < iterations; ++i) {
+    buildFields<IStringBuilder>(std::allocator<uint8_t>());
+  }
+  return iterations * fieldBytes();
+}
+
+PISTIS_BENCHMARK(IStringArena_Arena_BuildFields) {
+  IStringArena arena;
+  for (size_t i = 0; i < iterations; ++i) {
+    buildFields<ArenaIStringBuilder>(IStringArenaAllocator(arena));
+    arena.release();
+  }
+  return iterations * fieldBytes();
+}
@@ -0,0 +1,135 @@
+#include <Benchmark.hpp>
+#include <pistis/util/IStringCaseInsensitive.hpp>
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <strings.h>
+
+using namespace pistis::util;
+using pistis::bench::doNotOptimize;
+
+// Converting a 64KiB document to lower case, comparing it with an upper
+// case copy of itself, and looking up mixed-case HTTP header names in a
+// table, each with the new ASCII case operations and with the usual
+// per-character alternatives.
+
+namespace {
+  const IString& document() {
+    static const IString TEXT = [] {
+      std::string t;
+      for (size_t i = 0; t.size() < 65536; ++i) {
+	t += "The Cow " + std::to_string(i) + " Jumped Over The Moon. ";
+      }
+      return IString(t);
+    }();
+    return TEXT;
+  }
+
+  const IString& shouting() {
+    static const IString TEXT = document().toUpper();
+    return TEXT;
+  }
+
+  const std::vector<IString>& headerNames() {
+    static const std::vector<IString> NAMES{
+      IString("Content-Type"), IString("Content-Length"), IString("Host"),
+      IString("Accept"), IString("Accept-Encoding"), IString("User-Agent"),
+      IString("Cache-Control"), IString("Connection"), IString("Cookie"),
+      IString("X-Forwarded-For"), IString("Authorization"),
+      IString("If-None-Match")
+    };
+    return NAMES;
+  }
+
+  const std::vector<IString>& requestHeaders() {
+    static const std::vector<IString> HEADERS = [] {
+      std::vector<IString> headers;
+      for (const IString& name : headerNames()) {
+	headers.push_back(name.toLower());
+	headers.push_back(name.toUpper());
+	headers.push_back(name);
+      }
+      return headers;
+    }();
+    return HEADERS;
+  }
+
+  size_t headerBytes() {
+    size_t n = 0;
+    for (const IString& h : requestHeaders()) {
+      n += h.size();
+    }
+    return n;
+  }
+}
+
+PISTIS_BENCHMARK(IStringCase_ToLowerStdTransform) {
+  const std::string text(document().begin(), document().end());
+  for (size_t i = 0; i < iterations; ++i) {
+    std::string lower(text.size(), ' ');
+    std::transform(text.begin(), text.end(), lower.begin(),
+		   [](char c) { return (char)std::tolower(c); });
+    doNotOptimize(lower.data());
+  }
+  return iterations * text.size();
+}
+
+PISTIS_BENCHMARK(IStringCase_ToLower) {
+  for (size_t i = 0; i < iterations; ++i) {
+    const IString lower = document().toLower();
+    doNotOptimize(lower.data());
+  }
+  return iterations * document().size();
+}
+
+PISTIS_BENCHMARK(IStringCase_StrNCaseCmp) {
+  int total = 0;
+  for (size_t i = 0; i < iterations; ++i) {
+    total += ::strncasecmp(document().data(), shouting().data(),
+			   document().size());
+  }
+  doNotOptimize(total);
+  return iterations * document().size();
+}
+
+PISTIS_BENCHMARK(IStringCase_CmpIgnoreCase) {
+  int total = 0;
+  for (size_t i = 0; i < iterations; ++i) {
+    total += document().cmpIgnoreCase(shouting());
+  }
+  doNotOptimize(total);
+  return iterations * document().size();
+}
+
+PISTIS_BENCHMARK(IStringCase_LookupAfterToLower) {
+  std::unordered_map<IString, size_t> table;
+  for (const IString& name : headerNames()) {
+    table[name.toLower()] = name.size();
+  }
+  size_t total = 0;
+  for (size_t i = 0; i < iterations; ++i) {
+    for (const IString& h : requestHeaders()) {
+      total += table.find(h.toLower())->second;
+    }
+  }
+  doNotOptimize(total);
+  return iterations * headerBytes();
+}
+
+PISTIS_BENCHMARK(IStringCase_CaseInsensitiveLookup) {
+  std::unordered_map<IString, size_t, CaseInsensitiveIStringHash,
+		     CaseInsensitiveIStringEqual> table;
+  for (const IString& name : headerNames()) {
+    table[name] = name.size();
+  }
+  size_t total = 0;
+  for (size_t i = 0; i < iterations; ++i) {
+    for (const IString& h : requestHeaders()) {
+      total += table.find(h)->second;
+    }
+  }
+  doNotOptimize(total);
+  return iterations * headerBytes();
+}
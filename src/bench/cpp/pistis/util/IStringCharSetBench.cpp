@@ -0,0 +1,80 @@
+#include <Benchmark.hpp>
+#include <pistis/util/IString.hpp>
+#include <string>
+
+using namespace pistis::util;
+using pistis::bench::doNotOptimize;
+
+namespace {
+  const char DELIMITERS[] = " \t\r\n,;:|=&?#[]{}";
+
+  // Words separated by delimiters every 40 or so characters
+  const std::string& tokenText() {
+    static const std::string TEXT = []() {
+      std::string t;
+      for (size_t i = 0; t.size() < 4 * 1024 * 1024; ++i) {
+	t += "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLM";
+	t += DELIMITERS[i % (sizeof(DELIMITERS) - 1)];
+      }
+      return t;
+    }();
+    return TEXT;
+  }
+
+  // One delimiter at the very end
+  const std::string& sparseText() {
+    static const std::string TEXT =
+        std::string(4 * 1024 * 1024, 'x') + "|";
+    return TEXT;
+  }
+}
+
+PISTIS_BENCHMARK(IStringFindFirstOf_IString_Sparse) {
+  const IString s(sparseText());
+  for (size_t i = 0; i < iterations; ++i) {
+    doNotOptimize(s.findFirstOf(DELIMITERS));
+  }
+  return iterations * s.size();
+}
+
+PISTIS_BENCHMARK(IStringFindFirstOf_StdString_Sparse) {
+  const std::string& s = sparseText();
+  for (size_t i = 0; i < iterations; ++i) {
+    doNotOptimize(s.find_first_of(DELIMITERS));
+  }
+  return iterations * s.size();
+}
+
+PISTIS_BENCHMARK(IStringFindLastOf_IString_Sparse) {
+  const IString s(std::string("|") + sparseText());
+  for (size_t i = 0; i < iterations; ++i) {
+    doNotOptimize(s.findLastOf(DELIMITERS, 0, s.size() - 1));
+  }
+  return iterations * s.size();
+}
+
+PISTIS_BENCHMARK(IStringFindFirstOf_IString_Tokenize) {
+  const IString s(tokenText());
+  for (size_t i = 0; i < iterations; ++i) {
+    size_t count = 0;
+    for (size_t p = s.findFirstOf(DELIMITERS); p != IString::NPOS;
+	 p = s.findFirstOf(DELIMITERS, p + 1)) {
+      ++count;
+    }
+    doNotOptimize(count);
+  }
+  return iterations * s.size();
+}
+
+PISTIS_BENCHMARK(IStringFindFirstOf_StdString_Tokenize) {
+  const std::string& s = tokenText();
+  for (size_t i = 0; i < iterations; ++i) {
+    size_t count = 0;
+    for (size_t p = s.find_first_of(DELIMITERS); p != std::string::npos;
+	 p = s.find_first_of(DELIMITERS, p + 1)) {
+      ++count;
+    }
+    doNotOptimize(count);
+  }
+  return iterations * s.size();
+}
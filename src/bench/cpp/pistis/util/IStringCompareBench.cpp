@@ -0,0 +1,74 @@
+#include <Benchmark.hpp>
+#include <pistis/util/IString.hpp>
+#include <string>
+
+using namespace pistis::util;
+using pistis::bench::doNotOptimize;
+
+namespace {
+  // A long ASCII document, as text decoded into UTF-16 or UTF-32 often is
+  const std::string& asciiText() {
+    static const std::string TEXT = []() {
+      std::string t;
+      for (size_t i = 0; i < 4096; ++i) {
+	t.push_back((char)('a' + (i * 7) % 26));
+      }
+      return t;
+    }();
+    return TEXT;
+  }
+
+  template <typename Char>
+  std::basic_string<Char> widen(const std::string& s) {
+    return std::basic_string<Char>(s.begin(), s.end());
+  }
+}
+
+PISTIS_BENCHMARK(IStringCompare_U16_Equal) {
+  const IString s(asciiText());
+  const U16_IString w(widen<char16_t>(asciiText()));
+  for (size_t i = 0; i < iterations; ++i) {
+    doNotOptimize(w);
+    doNotOptimize(s == w);
+  }
+  return iterations * s.size();
+}
+
+PISTIS_BENCHMARK(IStringCompare_U32_Cmp) {
+  const IString s(asciiText());
+  const U32_IString w(widen<char32_t>(asciiText()));
+  for (size_t i = 0; i < iterations; ++i) {
+    doNotOptimize(w);
+    doNotOptimize(s.cmp(w));
+  }
+  return iterations * s.size();
+}
+
+PISTIS_BENCHMARK(IStringCompare_U16_U32_Cmp) {
+  const U16_IString s(widen<char16_t>(asciiText()));
+  const U32_IString w(widen<char32_t>(asciiText()));
+  for (size_t i = 0; i < iterations; ++i) {
+    doNotOptimize(w);
+    doNotOptimize(s.cmp(w));
+  }
+  return iterations * s.size();
+}
+
+PISTIS_BENCHMARK(IStringCompare_U16_EndsWith) {
+  const U16_IString w(widen<char16_t>(asciiText()));
+  const IString suffix(asciiText().substr(asciiText().size() - 64));
+  for (size_t i = 0; i < iterations; ++i) {
+    doNotOptimize(w);
+    doNotOptimize(w.endsWith(suffix));
+  }
+  return iterations * suffix.size();
+}
+
+PISTIS_BENCHMARK(IStringCompare_U16_FindAscii) {
+  const U16_IString w(widen<char16_t>(asciiText() + "needle"));
+  for (size_t i = 0; i < iterations; ++i) {
+    doNotOptimize(w);
+    doNotOptimize(w.find("needle"));
+  }
+  return iterations * w.size();
+}
@@ -0,0 +1,76 @@
+#include <Benchmark.hpp>
+#include <pistis/util/IString.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace pistis::util;
+using pistis::bench::doNotOptimize;
+
+// Each benchmark splits its iterations among N threads that all copy the
+// same string, created on the main thread.  With atomic counts every copy
+// writes the text's reference count, so the count's cache line moves
+// between cores on nearly every copy.  Borrowing the string gives each
+// thread a count of its own.
+
+namespace {
+  const IString& sharedString() {
+    static const IString S(
+	std::string("a read-mostly string shared by many worker threads")
+    );
+    return S;
+  }
+
+  template <typename Worker>
+  size_t runOnThreads(size_t iterations, size_t numThreads, Worker worker) {
+    std::vector<std::thread> threads;
+    const size_t perThread = (iterations + numThreads - 1) / numThreads;
+    for (size_t i = 0; i < numThreads; ++i) {
+      threads.emplace_back(worker, perThread);
+    }
+    for (std::thread& t : threads) {
+      t.join();
+    }
+    return 0;
+  }
+
+  void copyShared(size_t n) {
+    const IString& s = sharedString();
+    for (size_t i = 0; i < n; ++i) {
+      IString copy(s);
+      doNotOptimize(copy);
+    }
+  }
+
+  void copyBorrowed(size_t n) {
+    const LocalIString s(sharedString());
+    for (size_t i = 0; i < n; ++i) {
+      LocalIString copy(s);
+      doNotOptimize(copy);
+    }
+  }
+}
+
+PISTIS_BENCHMARK(IStringContention_Atomic_1Thread) {
+  return runOnThreads(iterations, 1, copyShared);
+}
+
+PISTIS_BENCHMARK(IStringContention_Atomic_8Threads) {
+  return runOnThreads(iterations, 8, copyShared);
+}
+
+PISTIS_BENCHMARK(IStringContention_Atomic_64Threads) {
+  return runOnThreads(iterations, 64, copyShared);
+}
+
+PISTIS_BENCHMARK(IStringContention_Borrowed_1Thread) {
+  return runOnThreads(iterations, 1, copyBorrowed);
+}
+
+PISTIS_BENCHMARK(IStringContention_Borrowed_8Threads) {
+  return runOnThreads(iterations, 8, copyBorrowed);
+}
+
+PISTIS_BENCHMARK(IStringContention_Borrowed_64Threads) {
+  return runOnThreads(iterations, 64, copyBorrowed);
+}
@@ -0,0 +1,125 @@
+#include <Benchmark.hpp>
+#include <pistis/util/IString.hpp>
+#include <pistis/util/IStringHash.hpp>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace pistis::util;
+using pistis::bench::doNotOptimize;
+
+namespace {
+  const std::string& text() {
+    static const std::string TEXT = []() {
+      std::string t;
+      for (size_t i = 0; i < 4096; ++i) {
+	t.push_back((char)('a' + (i * 7) % 26));
+      }
+      return t;
+    }();
+    return TEXT;
+  }
+
+  template <typename Hasher>
+  size_t hashText(size_t iterations, size_t n) {
+    const Hasher hasher;
+    const char* p = text().data();
+    for (size_t i = 0; i < iterations; ++i) {
+      doNotOptimize(p);
+      doNotOptimize(hasher(p, n));
+    }
+    return iterations * n;
+  }
+
+  // Keys that differ only in their last few characters, like
+  // identifiers and URLs
+  std::vector<IString> makeKeys() {
+    std::vector<IString> keys;
+    for (size_t i = 0; i < 10000; ++i) {
+      keys.push_back(IString("/api/v1/resource/" + std::to_string(i)));
+    }
+    return keys;
+  }
+
+  template <typename Hasher>
+  struct IStringHasher {
+    size_t operator()(const IString& s) const { return s.hash(Hasher()); }
+  };
+
+  template <typename Hasher>
+  size_t lookupKeys(size_t iterations) {
+    static const std::vector<IString> KEYS = makeKeys();
+    static const std::unordered_set<IString, IStringHasher<Hasher> > SET(
+	KEYS.begin(), KEYS.end()
+    );
+    size_t found = 0;
+    for (size_t i = 0; i < iterations; ++i) {
+      found += SET.count(KEYS[i % KEYS.size()]);
+    }
+    doNotOptimize(found);
+    return 0;
+  }
+}
+
+PISTIS_BENCHMARK(IStringHash_Djb2_8) { return hashText<Djb2Hasher>(iterations, 8); }
+PISTIS_BENCHMARK(IStringHash_Djb2_32) { return hashText<Djb2Hasher>(iterations, 32); }
+PISTIS_BENCHMARK(IStringHash_Djb2_256) { return hashText<Djb2Hasher>(iterations, 256); }
+PISTIS_BENCHMARK(IStringHash_Djb2_4096) { return hashText<Djb2Hasher>(iterations, 4096); }
+PISTIS_BENCHMARK(IStringHash_Wy_8) { return hashText<WyHasher>(iterations, 8); }
+PISTIS_BENCHMARK(IStringHash_Wy_32) { return hashText<WyHasher>(iterations, 32); }
+PISTIS_BENCHMARK(IStringHash_Wy_256) { return hashText<WyHasher>(iterations, 256); }
+PISTIS_BENCHMARK(IStringHash_Wy_4096) { return hashText<WyHasher>(iterations, 4096); }
+
+PISTIS_BENCHMARK(IStringHash_Djb2_SetLookup) {
+  return lookupKeys<Djb2Hasher>(iterations);
+}
+
+PISTIS_BENCHMARK(IStringHash_Wy_SetLookup) {
+  return lookupKeys<WyHasher>(iterations);
+}
+
+PISTIS_BENCHMARK(IStringHash_Cached_SetLookup) {
+  static const std::vector<IString> KEYS = makeKeys();
+  static const std::unordered_set<IString> SET(KEYS.begin(), KEYS.end());
+  size_t found = 0;
+  for (size_t i = 0; i < iterations; ++i) {
+    found += SET.count(KEYS[i % KEYS.size()]);
+  }
+  doNotOptimize(found);
+  return 0;
+}
+
+// Looks up a header name in a dispatch table, first with a plain literal
+// that has to be hashed on every lookup, then with an _is literal that
+// carries its hash.
+namespace {
+  const std::unordered_set<IString>& headers() {
+    static const std::unordered_set<IString> HEADERS{
+      IString(std::string("accept")), IString(std::string("content-length")),
+      IString(std::string("content-type")), IString(std::string("host")),
+      IString(std::string("transfer-encoding")),
+      IString(std::string("x-forwarded-for-original-client"))
+    };
+    return HEADERS;
+  }
+}
+
+PISTIS_BENCHMARK(IStringHash_PlainLiteral_SetLookup) {
+  size_t found = 0;
+  for (size_t i = 0; i < iterations; ++i) {
+    found += headers().count(
+        IString::literal("x-forwarded-for-original-client", 31)
+    );
+  }
+  doNotOptimize(found);
+  return 0;
+}
+
+PISTIS_BENCHMARK(IStringHash_HashedLiteral_SetLookup) {
+  size_t found = 0;
+  for (size_t i = 0; i < iterations; ++i) {
+    found += headers().count("x-forwarded-for-original-client"_is);
+  }
+  doNotOptimize(found);
+  return 0;
+}
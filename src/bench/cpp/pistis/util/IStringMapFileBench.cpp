@@ -0,0 +1,99 @@
+#include <Benchmark.hpp>
+#include <pistis/util/IString.hpp>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace pistis::util;
+using pistis::bench::doNotOptimize;
+
+namespace {
+  // A 16 MiB log file, written once and removed at exit
+  class LogFile {
+  public:
+    LogFile(): name_("/tmp/IStringMapFileBench.XXXXXX") {
+      const int fd = ::mkstemp(&name_[0]);
+      ::close(fd);
+      std::ofstream out(name_);
+      for (size_t i = 0; i < 262144; ++i) {
+	out << "2017-03-01T12:00:00 INFO request " << (i * 7919)
+	    << " served from cache in 12 ms\n";
+      }
+      size_ = (size_t)out.tellp();
+    }
+    ~LogFile() { ::unlink(name_.c_str()); }
+
+    const std::string& name() const { return name_; }
+    size_t size() const { return size_; }
+
+  private:
+    std::string name_;
+    size_t size_;
+  };
+
+  const LogFile& logFile() {
+    static const LogFile FILE;
+    return FILE;
+  }
+
+  IString readFile(const std::string& name) {
+    std::ifstream in(name);
+    std::ostringstream content;
+    content << in.rdbuf();
+    return IString(content.str());
+  }
+
+  template <typename Load>
+  size_t countLines(size_t iterations, Load load) {
+    const LogFile& f = logFile();
+    const IString newline("\n");
+    size_t n = 0;
+    for (size_t i = 0; i < iterations; ++i) {
+      IString text = load(f.name());
+      auto lines = text.split(newline);
+      while (lines) {
+	n += lines.next().size();
+      }
+    }
+    doNotOptimize(n);
+    return iterations * f.size();
+  }
+
+  template <typename Load>
+  size_t firstLine(size_t iterations, Load load) {
+    const LogFile& f = logFile();
+    const IString newline("\n");
+    for (size_t i = 0; i < iterations; ++i) {
+      IString text = load(f.name());
+      IString line = text.split(newline).next();
+      doNotOptimize(line);
+    }
+    return 0;
+  }
+
+  IString mapSequential(const std::string& name) {
+    return IString::mapFile(name, FileAccessPattern::SEQUENTIAL);
+  }
+
+  IString mapRandom(const std::string& name) {
+    return IString::mapFile(name, FileAccessPattern::RANDOM);
+  }
+}
+
+PISTIS_BENCHMARK(IStringMapFile_Read_CountLines) {
+  return countLines(iterations, readFile);
+}
+
+PISTIS_BENCHMARK(IStringMapFile_Map_CountLines) {
+  return countLines(iterations, mapSequential);
+}
+
+PISTIS_BENCHMARK(IStringMapFile_Read_FirstLine) {
+  return firstLine(iterations, readFile);
+}
+
+PISTIS_BENCHMARK(IStringMapFile_Map_FirstLine) {
+  return firstLine(iterations, mapRandom);
+}
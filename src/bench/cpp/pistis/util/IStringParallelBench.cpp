@@ -0,0 +1,52 @@
+#include <Benchmark.hpp>
+#include <pistis/util/IString.hpp>
+#include <string>
+
+using namespace pistis::util;
+using pistis::bench::doNotOptimize;
+
+// Compares counting and replacing the matches of a word in a 64MiB log
+// on one thread and on four.
+
+namespace {
+  const IString& log() {
+    static const IString LOG = [] {
+      std::string text;
+      for (size_t i = 0; text.size() < (64 << 20); ++i) {
+	text += "2017-03-01T12:00:" + std::to_string(10 + i % 50) +
+	        " INFO request " + std::to_string(i * 7919) +
+	        " served from cache node " + std::to_string(i % 7) + "\n";
+      }
+      return IString(text);
+    }();
+    return LOG;
+  }
+
+  size_t count(size_t numThreads, size_t iterations) {
+    const IStringParallelism parallelism(numThreads);
+    size_t n = 0;
+    for (size_t i = 0; i < iterations; ++i) {
+      n += log().count("cache", parallelism);
+    }
+    doNotOptimize(n);
+    return iterations * log().size();
+  }
+
+  size_t replace(size_t numThreads, size_t iterations) {
+    const IStringParallelism parallelism(numThreads);
+    for (size_t i = 0; i < iterations; ++i) {
+      const IString s = log().replace("cache", "memo", parallelism);
+      doNotOptimize(s.data());
+    }
+    return iterations * log().size();
+  }
+}
+
+PISTIS_BENCHMARK(IStringParallel_Count_1) { return count(1, iterations); }
+PISTIS_BENCHMARK(IStringParallel_Count_4) { return count(4, iterations); }
+PISTIS_BENCHMARK(IStringParallel_Replace_1) {
+  return replace(1, iterations);
+}
+PISTIS_BENCHMARK(IStringParallel_Replace_4) {
+  return replace(4, iterations);
+}
@@ -0,0 +1,130 @@
+#include <Benchmark.hpp>
+#include <pistis/util/IString.hpp>
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace pistis::util;
+using pistis::bench::doNotOptimize;
+
+// Compares sanitizing a 64KiB JSON payload (escaping the HTML special
+// characters and masking the values of 32 sensitive fields) with one
+// replace() call per pattern and with a single replaceAll(), and looking
+// for the first of eight patterns in text that contains none of them with
+// one find() per pattern and with findAny().
+
+namespace {
+  typedef std::vector< std::pair<std::string, std::string> > Mapping;
+
+  const std::vector<std::string>& sensitiveFields() {
+    static const std::vector<std::string> FIELDS{
+      "password", "passwd", "secret", "token", "api_key", "apikey",
+      "access_key", "private_key", "session_id", "cookie", "ssn",
+      "credit_card", "card_number", "cvv", "pin", "auth", "bearer",
+      "client_secret", "refresh_token", "id_token", "otp", "passphrase",
+      "signature", "salt", "hash", "email", "phone", "address", "dob",
+      "account_number", "routing_number", "iban"
+    };
+    return FIELDS;
+  }
+
+  const Mapping& mapping() {
+    static const Mapping MAPPING = [] {
+      Mapping m{ { "&", "&amp;" }, { "<", "&lt;" }, { ">", "&gt;" },
+		 { "'", "&#39;" } };
+      for (const std::string& f : sensitiveFields()) {
+	m.emplace_back("\"" + f + "\": \"", "\"" + f + "\": \"***");
+      }
+      return m;
+    }();
+    return MAPPING;
+  }
+
+  const IString& payload() {
+    static const IString PAYLOAD = [] {
+      const std::vector<std::string>& fields = sensitiveFields();
+      std::string text;
+      for (size_t i = 0; text.size() < 65536; ++i) {
+	text += "{\"id\": " + std::to_string(i) + ", \"name\": \"user " +
+	        std::to_string(i * 7919) + "\", \"note\": \"likes cows " +
+	        "& penguins\", \"" + fields[i % fields.size()] +
+	        "\": \"<hidden>\", \"status\": \"active\"}\n";
+      }
+      return IString(text);
+    }();
+    return PAYLOAD;
+  }
+
+  const IStringPatternSet& sanitizer() {
+    static const IStringPatternSet PATTERNS(mapping());
+    return PATTERNS;
+  }
+
+  const std::vector<std::string>& keywords() {
+    static const std::vector<std::string> KEYWORDS{
+      "ERROR", "FATAL", "panic", "segfault", "Traceback", "exception",
+      "OutOfMemory", "deadlock"
+    };
+    return KEYWORDS;
+  }
+
+  const IString& cleanLog() {
+    static const IString LOG = [] {
+      std::string text;
+      for (size_t i = 0; text.size() < 65536; ++i) {
+	text += "2017-03-01T12:00:" + std::to_string(10 + i % 50) +
+	        " INFO request " + std::to_string(i * 7919) +
+	        " served from cache node " + std::to_string(i % 7) + "\n";
+      }
+      return IString(text);
+    }();
+    return LOG;
+  }
+
+  const IStringPatternSet& alarms() {
+    static const IStringPatternSet PATTERNS(keywords());
+    return PATTERNS;
+  }
+}
+
+PISTIS_BENCHMARK(IStringPatternSet_ReplaceOneAtATime) {
+  for (size_t i = 0; i < iterations; ++i) {
+    IString s = payload();
+    for (const auto& m : mapping()) {
+      s = s.replace(m.first, m.second);
+    }
+    doNotOptimize(s.data());
+  }
+  return iterations * payload().size();
+}
+
+PISTIS_BENCHMARK(IStringPatternSet_ReplaceAll) {
+  for (size_t i = 0; i < iterations; ++i) {
+    const IString s = payload().replaceAll(sanitizer());
+    doNotOptimize(s.data());
+  }
+  return iterations * payload().size();
+}
+
+PISTIS_BENCHMARK(IStringPatternSet_FindOneAtATime) {
+  size_t found = 0;
+  for (size_t i = 0; i < iterations; ++i) {
+    size_t first = IString::NPOS;
+    for (const std::string& k : keywords()) {
+      first = std::min(first, cleanLog().find(k));
+    }
+    found += first;
+  }
+  doNotOptimize(found);
+  return iterations * cleanLog().size();
+}
+
+PISTIS_BENCHMARK(IStringPatternSet_FindAny) {
+  size_t found = 0;
+  for (size_t i = 0; i < iterations; ++i) {
+    found += cleanLog().findAny(alarms());
+  }
+  doNotOptimize(found);
+  return iterations * cleanLog().size();
+}
@@ -0,0 +1,95 @@
+#include <Benchmark.hpp>
+#include <pistis/util/IStringPool.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace pistis::util;
+using pistis::bench::doNotOptimize;
+
+// Compares texts allocated from glibc malloc (IString) and the
+// IStringPool (PooledIString) when lines are read, split into fields
+// that are copied into strings of their own, and thrown away.
+
+namespace {
+  const std::vector<std::string>& lines() {
+    static const std::vector<std::string> LINES = [] {
+      std::vector<std::string> l;
+      for (size_t i = 0; i < 64; ++i) {
+	l.push_back("2017-03-01T12:00:" + std::to_string(10 + i % 50) +
+		    ",request-" + std::to_string(i * 7919) +
+		    ",/api/v1/resources/" + std::to_string(i) +
+		    "/children,application/json;charset=utf-8,200,"
+		    "served-from-cache-node-" + std::to_string(i % 7));
+      }
+      return l;
+    }();
+    return LINES;
+  }
+
+  size_t lineBytes() {
+    size_t n = 0;
+    for (const std::string& l : lines()) {
+      n += l.size();
+    }
+    return n;
+  }
+
+  template <typename String>
+  void splitLine(const std::string& line, std::vector<String>& fields) {
+    const String s(line);
+    auto pieces = s.split(String(","));
+    while (pieces) {
+      const String piece = pieces.next();
+      // Copy each field out of the line, as a parser that keeps only
+      // some fields would
+      fields.emplace_back(piece.data(), piece.data() + piece.size());
+    }
+  }
+
+  template <typename String>
+  size_t splitAndDiscard(size_t iterations) {
+    std::vector<String> fields;
+    fields.reserve(16);
+    for (size_t i = 0; i < iterations; ++i) {
+      for (const std::string& line : lines()) {
+	splitLine(line, fields);
+	doNotOptimize(fields.data());
+	fields.clear();
+      }
+    }
+    return iterations * lineBytes();
+  }
+
+  // Split on one thread and discard on another, so every free is a
+  // cross-thread free
+  template <typename String>
+  size_t splitAndHandOff(size_t iterations) {
+    std::vector<String> fields;
+    fields.reserve(16 * lines().size());
+    for (size_t i = 0; i < iterations; ++i) {
+      for (const std::string& line : lines()) {
+	splitLine(line, fields);
+      }
+      std::thread consumer([&fields]() { fields.clear(); });
+      consumer.join();
+    }
+    return iterations * lineBytes();
+  }
+}
+
+PISTIS_BENCHMARK(IStringPool_Malloc_SplitAndDiscard) {
+  return splitAndDiscard<IString>(iterations);
+}
+
+PISTIS_BENCHMARK(IStringPool_Pool_SplitAndDiscard) {
+  return splitAndDiscard<PooledIString>(iterations);
+}
+
+PISTIS_BENCHMARK(IStringPool_Malloc_SplitAndHandOff) {
+  return splitAndHandOff<IString>(iterations);
+}
+
+PISTIS_BENCHMARK(IStringPool_Pool_SplitAndHandOff) {
+  return splitAndHandOff<PooledIString>(iterations);
+}
@@ -0,0 +1,98 @@
+#include <Benchmark.hpp>
+#include <pistis/util/IString.hpp>
+#include <string>
+#include <vector>
+
+using namespace pistis::util;
+using pistis::bench::doNotOptimize;
+
+namespace {
+  const std::string& text() {
+    static const std::string TEXT =
+	"GET /api/v1/resource/12345 HTTP/1.1 host=example.com "
+	"user-agent=bench accept=application/json";
+    return TEXT;
+  }
+
+  template <typename String>
+  size_t copyAndDestroy(size_t iterations) {
+    const String s(text());
+    for (size_t i = 0; i < iterations; ++i) {
+      String copy(s);
+      doNotOptimize(copy);
+    }
+    return 0;
+  }
+
+  template <typename String>
+  size_t copyIntoVector(size_t iterations) {
+    const String s(text());
+    std::vector<String> copies;
+    copies.reserve(64);
+    for (size_t i = 0; i < iterations; i += 64) {
+      for (size_t j = 0; j < 64; ++j) {
+	copies.push_back(s);
+      }
+      doNotOptimize(copies.data());
+      copies.clear();
+    }
+    return 0;
+  }
+
+  template <typename String>
+  size_t takeSubstrings(size_t iterations) {
+    const String s(text());
+    for (size_t i = 0; i < iterations; ++i) {
+      String sub = s.substr(0, s.size() - (i & 7));
+      doNotOptimize(sub);
+    }
+    return 0;
+  }
+
+  template <typename String>
+  size_t splitTokens(size_t iterations) {
+    const String s(text());
+    const String separator(" ");
+    size_t n = 0;
+    for (size_t i = 0; i < iterations; ++i) {
+      auto tokens = s.split(separator);
+      while (tokens) {
+	n += tokens.next().size();
+      }
+    }
+    doNotOptimize(n);
+    return iterations * s.size();
+  }
+}
+
+PISTIS_BENCHMARK(IStringRefCount_Atomic_CopyAndDestroy) {
+  return copyAndDestroy<IString>(iterations);
+}
+
+PISTIS_BENCHMARK(IStringRefCount_Local_CopyAndDestroy) {
+  return copyAndDestroy<LocalIString>(iterations);
+}
+
+PISTIS_BENCHMARK(IStringRefCount_Atomic_CopyIntoVector) {
+  return copyIntoVector<IString>(iterations);
+}
+
+PISTIS_BENCHMARK(IStringRefCount_Local_CopyIntoVector) {
+  return copyIntoVector<LocalIString>(iterations);
+}
+
+PISTIS_BENCHMARK(IStringRefCount_Atomic_Substr) {
+  return takeSubstrings<IString>(iterations);
+}
+
+PISTIS_BENCHMARK(IStringRefCount_Local_Substr) {
+  return takeSubstrings<LocalIString>(iterations);
+}
+
+PISTIS_BENCHMARK(IStringRefCount_Atomic_Split) {
+  return splitTokens<IString>(iterations);
+}
+
+PISTIS_BENCHMARK(IStringRefCount_Local_Split) {
+  return splitTokens<LocalIString>(iterations);
+}
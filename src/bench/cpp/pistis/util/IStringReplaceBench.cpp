@@ -0,0 +1,59 @@
+#include <Benchmark.hpp>
+#include <pistis/util/IString.hpp>
+#include <string>
+
+using namespace pistis::util;
+using pistis::bench::doNotOptimize;
+
+// Replacing and removing words in a 64KiB text, where the replacement
+// is longer than the target, shorter than it, or not needed at all.
+
+namespace {
+  const IString& text() {
+    static const IString TEXT = [] {
+      std::string t;
+      for (size_t i = 0; t.size() < 65536; ++i) {
+	t += "the cow " + std::to_string(i) + " jumped over the moon, ";
+      }
+      return IString(t);
+    }();
+    return TEXT;
+  }
+
+  template <typename Function>
+  size_t run(size_t iterations, Function f) {
+    for (size_t i = 0; i < iterations; ++i) {
+      const IString s = f(text());
+      doNotOptimize(s.data());
+    }
+    return iterations * text().size();
+  }
+}
+
+PISTIS_BENCHMARK(IStringReplace_Longer) {
+  return run(iterations, [](const IString& s) {
+    return s.replace("cow", "penguin");
+  });
+}
+
+PISTIS_BENCHMARK(IStringReplace_Shorter) {
+  return run(iterations, [](const IString& s) {
+    return s.replace("jumped", "hop");
+  });
+}
+
+PISTIS_BENCHMARK(IStringReplace_Remove) {
+  return run(iterations, [](const IString& s) {
+    return s.remove("the ");
+  });
+}
+
+PISTIS_BENCHMARK(IStringReplace_RemoveChar) {
+  return run(iterations, [](const IString& s) { return s.remove(','); });
+}
+
+PISTIS_BENCHMARK(IStringReplace_NoMatch) {
+  return run(iterations, [](const IString& s) {
+    return s.replace("sheep", "goats");
+  });
+}
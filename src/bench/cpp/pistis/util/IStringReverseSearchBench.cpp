@@ -0,0 +1,81 @@
+#include <Benchmark.hpp>
+#include <pistis/util/IString.hpp>
+#include <string>
+
+using namespace pistis::util;
+using pistis::bench::doNotOptimize;
+
+namespace {
+  // Log records with a path, whose last segment and extension are
+  // found from the right
+  const std::string& logRecord() {
+    static const std::string TEXT = []() {
+      std::string t = "2026-01-01T00:00:00Z INFO request=";
+      while (t.size() < 4096) {
+	t += "abcdefghijklmnopqrstuvwxyz0123456789";
+      }
+      return t + " path=/var/log/app/server.log";
+    }();
+    return TEXT;
+  }
+
+  const std::string& longText() {
+    static const std::string TEXT =
+        "needle" + std::string(1024 * 1024, 'x');
+    return TEXT;
+  }
+}
+
+PISTIS_BENCHMARK(IStringFindLast_IString_Char) {
+  const IString s(longText());
+  for (size_t i = 0; i < iterations; ++i) {
+    doNotOptimize(s.findLast('n'));
+  }
+  return iterations * s.size();
+}
+
+PISTIS_BENCHMARK(IStringFindLast_StdString_Char) {
+  const std::string& s = longText();
+  for (size_t i = 0; i < iterations; ++i) {
+    doNotOptimize(s.rfind('n'));
+  }
+  return iterations * s.size();
+}
+
+PISTIS_BENCHMARK(IStringFindLast_IString_String) {
+  const IString s(longText());
+  for (size_t i = 0; i < iterations; ++i) {
+    doNotOptimize(s.findLast("needle"));
+  }
+  return iterations * s.size();
+}
+
+PISTIS_BENCHMARK(IStringFindLast_StdString_String) {
+  const std::string& s = longText();
+  for (size_t i = 0; i < iterations; ++i) {
+    doNotOptimize(s.rfind("needle"));
+  }
+  return iterations * s.size();
+}
+
+PISTIS_BENCHMARK(IStringFindLast_IString_LogRecord) {
+  const IString s(logRecord());
+  for (size_t i = 0; i < iterations; ++i) {
+    const size_t slash = s.findLast('/');
+    const size_t dot = s.findLast('.', slash);
+    const size_t field = s.findLast(" path=");
+    doNotOptimize(slash);
+    doNotOptimize(dot);
+    doNotOptimize(field);
+  }
+  return iterations * s.size();
+}
+
+PISTIS_BENCHMARK(IStringFindLast_IString_RSplit) {
+  const IString s(logRecord());
+  const IString separator("/");
+  for (size_t i = 0; i < iterations; ++i) {
+    doNotOptimize(s.rsplit(separator, 1).next());
+  }
+  return 0;
+}
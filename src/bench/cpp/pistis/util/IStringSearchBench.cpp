@@ -0,0 +1,98 @@
+#include <Benchmark.hpp>
+#include <pistis/util/IString.hpp>
+#include <algorithm>
+#include <string>
+
+using namespace pistis::util;
+using pistis::bench::doNotOptimize;
+
+namespace {
+  // HTTP-style headers: "\r" is everywhere, so searches for "\r\n\r\n"
+  // find many candidates for the first character
+  const std::string& crlfText() {
+    static const std::string TEXT = []() {
+      std::string t;
+      for (size_t i = 0; t.size() < 64 * 1024; ++i) {
+	t += "X-Header-" + std::to_string(i) + ": v\r\n";
+      }
+      return t + "\r\nbody";
+    }();
+    return TEXT;
+  }
+
+  const std::string& proseText() {
+    static const std::string TEXT = []() {
+      std::string t;
+      while (t.size() < 64 * 1024) {
+	t += "the quick brown fox jumps over the lazy dog and then ";
+      }
+      return t + "the quick brown fox finally rests";
+    }();
+    return TEXT;
+  }
+
+  // Every window matches the pattern's first and last characters
+  const std::string& adversarialText() {
+    static const std::string TEXT(64 * 1024, 'a');
+    return TEXT;
+  }
+
+  size_t findIString(size_t iterations, const std::string& text,
+		     const std::string& pattern) {
+    const IString s(text);
+    const IString p(pattern);
+    for (size_t i = 0; i < iterations; ++i) {
+      doNotOptimize(s.find(p));
+    }
+    return iterations * text.size();
+  }
+
+  size_t findStdString(size_t iterations, const std::string& text,
+		       const std::string& pattern) {
+    for (size_t i = 0; i < iterations; ++i) {
+      doNotOptimize(text.find(pattern));
+    }
+    return iterations * text.size();
+  }
+
+  const std::string ADVERSARIAL_PATTERN =
+      std::string(32, 'a') + "b" + std::string(32, 'a');
+}
+
+PISTIS_BENCHMARK(IStringFind_IString_Crlf) {
+  return findIString(iterations, crlfText(), "\r\n\r\n");
+}
+
+PISTIS_BENCHMARK(IStringFind_StdString_Crlf) {
+  return findStdString(iterations, crlfText(), "\r\n\r\n");
+}
+
+PISTIS_BENCHMARK(IStringFind_IString_Prose) {
+  return findIString(iterations, proseText(), "fox finally");
+}
+
+PISTIS_BENCHMARK(IStringFind_StdString_Prose) {
+  return findStdString(iterations, proseText(), "fox finally");
+}
+
+PISTIS_BENCHMARK(IStringFind_IString_Adversarial) {
+  return findIString(iterations, adversarialText(), ADVERSARIAL_PATTERN);
+}
+
+PISTIS_BENCHMARK(IStringFind_StdString_Adversarial) {
+  return findStdString(iterations, adversarialText(), ADVERSARIAL_PATTERN);
+}
+
+PISTIS_BENCHMARK(IStringFind_IString_Split) {
+  const IString s(crlfText());
+  for (size_t i = 0; i < iterations; ++i) {
+    size_t n = 0;
+    auto stream = s.split(IString("\r\n"));
+    while (stream) {
+      doNotOptimize(stream.next());
+      ++n;
+    }
+    doNotOptimize(n);
+  }
+  return iterations * s.size();
+}
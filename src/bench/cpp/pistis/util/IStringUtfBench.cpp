@@ -0,0 +1,111 @@
+#include <Benchmark.hpp>
+#include <pistis/util/IString.hpp>
+#include <codecvt>
+#include <locale>
+#include <string>
+
+using namespace pistis::util;
+using pistis::bench::doNotOptimize;
+
+// Transcoding 64KiB of mostly-ASCII text (an English log with the odd
+// accented name) and of mostly-CJK text between UTF-8 and UTF-16, with
+// std::wstring_convert and with ImmutableString::toUtf16()/toUtf8().
+
+namespace {
+  typedef std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t>
+          Converter;
+
+  IString makeText(const std::string& unit) {
+    std::string text;
+    for (size_t i = 0; text.size() < 65536; ++i) {
+      text += unit + std::to_string(i) + "\n";
+    }
+    return IString(text);
+  }
+
+  const IString& english() {
+    static const IString TEXT = makeText(
+	"2017-03-01 INFO user Ren\xC3\xA9""e logged in from cache node "
+    );
+    return TEXT;
+  }
+
+  const IString& chinese() {
+    static const IString TEXT = makeText(
+	"\xE7\x94\xA8\xE6\x88\xB7\xE7\x99\xBB\xE5\xBD\x95\xE6\x88\x90"
+	"\xE5\x8A\x9F\xEF\xBC\x8C\xE7\xBC\x93\xE5\xAD\x98\xE8\x8A\x82"
+	"\xE7\x82\xB9 "
+    );
+    return TEXT;
+  }
+
+  size_t convertWithCodecvt(const IString& text, size_t iterations) {
+    Converter converter;
+    for (size_t i = 0; i < iterations; ++i) {
+      const std::u16string s =
+	  converter.from_bytes(text.data(), text.data() + text.size());
+      doNotOptimize(s.data());
+    }
+    return iterations * text.size();
+  }
+
+  size_t convertWithIString(const IString& text, size_t iterations) {
+    for (size_t i = 0; i < iterations; ++i) {
+      const U16_IString s = text.toUtf16();
+      doNotOptimize(s.data());
+    }
+    return iterations * text.size();
+  }
+
+  size_t encodeWithCodecvt(const IString& text, size_t iterations) {
+    Converter converter;
+    const std::u16string utf16 =
+	converter.from_bytes(text.data(), text.data() + text.size());
+    for (size_t i = 0; i < iterations; ++i) {
+      const std::string s = converter.to_bytes(utf16);
+      doNotOptimize(s.data());
+    }
+    return iterations * text.size();
+  }
+
+  size_t encodeWithIString(const IString& text, size_t iterations) {
+    const U16_IString utf16 = text.toUtf16();
+    for (size_t i = 0; i < iterations; ++i) {
+      const IString s = utf16.toUtf8();
+      doNotOptimize(s.data());
+    }
+    return iterations * text.size();
+  }
+}
+
+PISTIS_BENCHMARK(IStringUtf_EnglishToUtf16Codecvt) {
+  return convertWithCodecvt(english(), iterations);
+}
+
+PISTIS_BENCHMARK(IStringUtf_EnglishToUtf16) {
+  return convertWithIString(english(), iterations);
+}
+
+PISTIS_BENCHMARK(IStringUtf_ChineseToUtf16Codecvt) {
+  return convertWithCodecvt(chinese(), iterations);
+}
+
+PISTIS_BENCHMARK(IStringUtf_ChineseToUtf16) {
+  return convertWithIString(chinese(), iterations);
+}
+
+PISTIS_BENCHMARK(IStringUtf_EnglishToUtf8Codecvt) {
+  return encodeWithCodecvt(english(), iterations);
+}
+
+PISTIS_BENCHMARK(IStringUtf_EnglishToUtf8) {
+  return encodeWithIString(english(), iterations);
+}
+
+PISTIS_BENCHMARK(IStringUtf_ChineseToUtf8Codecvt) {
+  return encodeWithCodecvt(chinese(), iterations);
+}
+
+PISTIS_BENCHMARK(IStringUtf_ChineseToUtf8) {
+  return encodeWithIString(chinese(), iterations);
+}
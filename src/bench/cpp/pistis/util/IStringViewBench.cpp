@@ -0,0 +1,72 @@
+#include <Benchmark.hpp>
+#include <pistis/util/IStringView.hpp>
+#include <string>
+
+using namespace pistis::util;
+using pistis::bench::doNotOptimize;
+
+namespace {
+  const IString& text() {
+    static const IString TEXT(
+	"  GET /api/v1/resource/12345 HTTP/1.1 host=example.com "
+	"user-agent=bench accept=application/json  "
+    );
+    return TEXT;
+  }
+}
+
+PISTIS_BENCHMARK(IStringView_IString_SubstrAndStrip) {
+  const IString& s = text();
+  size_t n = 0;
+  for (size_t i = 0; i < iterations; ++i) {
+    IString piece = s.substr(i & 7, s.size() - (i & 7)).strip();
+    n += piece.size();
+  }
+  doNotOptimize(n);
+  return 0;
+}
+
+PISTIS_BENCHMARK(IStringView_View_SubstrAndStrip) {
+  const IStringView s(text());
+  size_t n = 0;
+  for (size_t i = 0; i < iterations; ++i) {
+    IStringView piece = s.substr(i & 7, s.size() - (i & 7)).strip();
+    n += piece.size();
+  }
+  doNotOptimize(n);
+  return 0;
+}
+
+PISTIS_BENCHMARK(IStringView_IString_Tokenize) {
+  const IString& s = text();
+  const IString separator(" ");
+  size_t n = 0;
+  for (size_t i = 0; i < iterations; ++i) {
+    IString rest = s.strip();
+    for (size_t p = rest.find(separator); p != IString::NPOS;
+	 p = rest.find(separator)) {
+      n += rest.substr(0, p).size();
+      rest = rest.substr(p + 1);
+    }
+    n += rest.size();
+  }
+  doNotOptimize(n);
+  return iterations * s.size();
+}
+
+PISTIS_BENCHMARK(IStringView_View_Tokenize) {
+  const IStringView s(text());
+  const IString separator(" ");
+  size_t n = 0;
+  for (size_t i = 0; i < iterations; ++i) {
+    IStringView rest = s.strip();
+    for (size_t p = rest.find(separator); p != IString::NPOS;
+	 p = rest.find(separator)) {
+      n += rest.substr(0, p).size();
+      rest = rest.substr(p + 1);
+    }
+    n += rest.size();
+  }
+  doNotOptimize(n);
+  return iterations * s.size();
+}
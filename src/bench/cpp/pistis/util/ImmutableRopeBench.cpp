@@ -0,0 +1,87 @@
+#include <Benchmark.hpp>
+#include <pistis/util/ImmutableRope.hpp>
+#include <string>
+#include <vector>
+
+using namespace pistis::util;
+using pistis::bench::doNotOptimize;
+
+namespace {
+  // Lines of a generated document, about 60 characters each
+  const std::vector<IString>& lines() {
+    static const std::vector<IString> LINES = []() {
+      std::vector<IString> l;
+      for (size_t i = 0; i < 4096; ++i) {
+	l.push_back(IString("<tr><td>" + std::to_string(i) +
+			    "</td><td>some generated table content</td></tr>\n"));
+      }
+      return l;
+    }();
+    return LINES;
+  }
+
+  size_t documentSize(size_t n) {
+    size_t total = 0;
+    for (size_t i = 0; i < n; ++i) {
+      total += lines()[i].size();
+    }
+    return total;
+  }
+}
+
+PISTIS_BENCHMARK(ImmutableRope_BuildDocument_IString) {
+  for (size_t i = 0; i < iterations; ++i) {
+    IString doc;
+    for (const IString& line : lines()) {
+      doc = doc.append(line);
+    }
+    doNotOptimize(doc);
+  }
+  return iterations * documentSize(lines().size());
+}
+
+PISTIS_BENCHMARK(ImmutableRope_BuildDocument_IRope) {
+  for (size_t i = 0; i < iterations; ++i) {
+    IRope doc;
+    for (const IString& line : lines()) {
+      doc = doc.append(line);
+    }
+    doNotOptimize(doc.str());
+  }
+  return iterations * documentSize(lines().size());
+}
+
+PISTIS_BENCHMARK(ImmutableRope_InsertInMiddle_IString) {
+  for (size_t i = 0; i < iterations; ++i) {
+    IString doc;
+    for (const IString& line : lines()) {
+      doc = doc.insert(doc.size() / 2, line);
+    }
+    doNotOptimize(doc);
+  }
+  return iterations * documentSize(lines().size());
+}
+
+PISTIS_BENCHMARK(ImmutableRope_InsertInMiddle_IRope) {
+  for (size_t i = 0; i < iterations; ++i) {
+    IRope doc;
+    for (const IString& line : lines()) {
+      doc = doc.insert(doc.size() / 2, line);
+    }
+    doNotOptimize(doc.str());
+  }
+  return iterations * documentSize(lines().size());
+}
+
+PISTIS_BENCHMARK(ImmutableRope_Index) {
+  IRope doc;
+  for (const IString& line : lines()) {
+    doc = doc.append(line);
+  }
+  size_t sum = 0;
+  for (size_t i = 0; i < iterations; ++i) {
+    sum += doc[(i * 7919) % doc.size()];
+  }
+  doNotOptimize(sum);
+  return 0;
+}
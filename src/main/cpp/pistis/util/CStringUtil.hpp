@@ -6,6 +6,7 @@
  *  Utilities for working with null-terminated "C" strings.
  */
 
+#include <pistis/util/IStringHash.hpp>
 #include <string>
 #include <string.h>
 #include <stdint.h>
@@ -13,27 +14,40 @@
 namespace pistis {
   namespace util {
       
-    /** @brief Functor that computes a hash code for a C string */
-    struct CStringHasher {
-      /** @brief Compute a hash code for s
-       *
-       *  The current implementation uses djb2.
-       */
+    /** @brief Functor that computes a hash code for a C string using
+     *         the given hash policy (see IStringHash.hpp)
+     */
+    template <typename Hasher>
+    class BasicCStringHasher {
+    public:
+      BasicCStringHasher(const Hasher& hasher = Hasher()): hasher_(hasher) { }
+
+      /** @brief Compute a hash code for s */
       uint64_t operator()(const char* s) const {
-	uint64_t v= 5381;
-	for (const char*p= s; *p; ++p) {
-	  v= ((v << 5) + v) + (int)*p;
-	}
-	return v;	
+	return hasher_(s, ::strlen(s));
       }
+
+    private:
+      Hasher hasher_;
     };
 
+    /** @brief Functor that computes a hash code for a C string
+     *
+     *  Uses djb2, so hash codes are the same as they have always been.
+     */
+    typedef BasicCStringHasher<Djb2Hasher> CStringHasher;
+
+    /** @brief Functor that computes a hash code for a C string using
+     *         the same hash as ImmutableString.
+     */
+    typedef BasicCStringHasher<DefaultIStringHasher> FastCStringHasher;
+
     /** @brief Less-than predicate for C strings */
     struct CStringsLess {
       /** @brief Returns true if left comes before right in a character-by-
        *         character comparison.
        */
-      bool operator(const char* left, const char* right) const {
+      bool operator()(const char* left, const char* right) const {
 	return strcmp(left, right) < 0;
       }
     };
@@ -41,7 +55,7 @@ namespace pistis {
     /** @brief Equality predicate for C strings */
     struct CStringsEqual {
       /** @brief Returns true if its arguments are equal */
-      bool operator(const char* left, const char* right) const {
+      bool operator()(const char* left, const char* right) const {
 	return !strcmp(left, right);
       }
     };
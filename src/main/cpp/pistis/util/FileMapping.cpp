@@ -0,0 +1,97 @@
+#include "FileMapping.hpp"
+#include <pistis/util/FileMappingError.hpp>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace pistis::util;
+
+namespace {
+  int adviceFor(FileAccessPattern access) {
+    switch (access) {
+      case FileAccessPattern::SEQUENTIAL: return MADV_SEQUENTIAL;
+      case FileAccessPattern::RANDOM: return MADV_RANDOM;
+      case FileAccessPattern::WILL_NEED: return MADV_WILLNEED;
+      default: return MADV_NORMAL;
+    }
+  }
+
+  class FileDescriptor {
+  public:
+    explicit FileDescriptor(int fd): fd_(fd) { }
+    FileDescriptor(const FileDescriptor&) = delete;
+    ~FileDescriptor() {
+      if (fd_ >= 0) {
+	::close(fd_);
+      }
+    }
+
+    int get() const { return fd_; }
+
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+  private:
+    int fd_;
+  };
+}
+
+namespace pistis {
+  namespace util {
+    namespace detail {
+
+      FileMapping mapFile(const std::string& path, FileAccessPattern access) {
+	FileDescriptor fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+	if (fd.get() < 0) {
+	  throw FileMappingError::systemError("open", path, errno,
+					      PISTIS_EX_HERE);
+	}
+
+	struct stat info;
+	if (::fstat(fd.get(), &info) < 0) {
+	  throw FileMappingError::systemError("stat", path, errno,
+					      PISTIS_EX_HERE);
+	}
+
+	const size_t length = (size_t)info.st_size;
+	if (!length) {
+	  return FileMapping{ nullptr, 0 };
+	}
+
+	void* const address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE,
+				     fd.get(), 0);
+	if (address == MAP_FAILED) {
+	  throw FileMappingError::systemError("map", path, errno,
+					      PISTIS_EX_HERE);
+	}
+
+	const FileMapping mapping{ address, length };
+	if (access != FileAccessPattern::NORMAL) {
+	  adviseFileAccess(address, length, access);
+	}
+	return mapping;
+      }
+
+      void unmapFile(const FileMapping& mapping) noexcept {
+	if (mapping.address) {
+	  ::munmap(mapping.address, mapping.length);
+	}
+      }
+
+      void adviseFileAccess(const void* p, size_t n,
+			    FileAccessPattern access) noexcept {
+	// madvise() wants a page-aligned start address
+	static const uintptr_t pageSize = (uintptr_t)::sysconf(_SC_PAGESIZE);
+	const uintptr_t start = (uintptr_t)p & ~(pageSize - 1);
+	const uintptr_t end = (uintptr_t)p + n;
+	if (end > start) {
+	  // Advice is only a hint, so failures are ignored
+	  ::madvise((void*)start, end - start, adviceFor(access));
+	}
+      }
+
+    }
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef __PISTIS__UTIL__FILEMAPPING_HPP__
+#define __PISTIS__UTIL__FILEMAPPING_HPP__
+
+/** @file FileMapping.hpp
+ *
+ *  Maps files into memory for ImmutableString::mapFile().  Files are
+ *  mapped read-only and private, so strings made from them share the
+ *  kernel's page cache with every other reader of the file.
+ */
+
+#include <string>
+#include <stddef.h>
+
+namespace pistis {
+  namespace util {
+
+    /** @brief How a program expects to read a mapped file
+     *
+     *  Passed to madvise() so the kernel can tune its readahead.
+     */
+    enum class FileAccessPattern {
+      /** @brief No particular pattern */
+      NORMAL,
+
+      /** @brief From start to end.  The kernel reads ahead aggressively
+       *         and may drop pages soon after they are read.
+       */
+      SEQUENTIAL,
+
+      /** @brief In no particular order.  The kernel reads as little
+       *         ahead as possible.
+       */
+      RANDOM,
+
+      /** @brief Soon.  The kernel starts reading the pages in now. */
+      WILL_NEED
+    };
+
+    namespace detail {
+
+      struct FileMapping {
+	/** @brief Start of the mapping, or nullptr for an empty file */
+	void* address;
+
+	/** @brief Size of the file */
+	size_t length;
+      };
+
+      /** @brief Map the file at path into memory
+       *
+       *  Throws FileMappingError if the file cannot be opened or mapped.
+       *  Empty files are not mapped and return a mapping with a null
+       *  address.
+       */
+      FileMapping mapFile(const std::string& path, FileAccessPattern access);
+
+      /** @brief Unmap a mapping returned by mapFile() */
+      void unmapFile(const FileMapping& mapping) noexcept;
+
+      /** @brief Apply access to the pages holding the n bytes starting
+       *         at p, which must lie inside a mapping
+       */
+      void adviseFileAccess(const void* p, size_t n,
+			    FileAccessPattern access) noexcept;
+
+    }
+  }
+}
+#endif
@@ -0,0 +1,27 @@
+#include <pistis/util/FileMappingError.hpp>
+#include <sstream>
+#include <string.h>
+
+using namespace pistis::exceptions;
+using namespace pistis::util;
+
+FileMappingError::FileMappingError(
+    const std::string& details,
+    const pistis::exceptions::ExceptionOrigin& origin
+): PistisException(details, origin) {
+}
+
+FileMappingError::~FileMappingError() noexcept {
+}
+
+FileMappingError FileMappingError::systemError(
+    const std::string& operation, const std::string& path, int errorCode,
+    const pistis::exceptions::ExceptionOrigin& origin
+) {
+  char buffer[256];
+  std::ostringstream msg;
+  // GNU strerror_r returns its message, which need not be in buffer
+  msg << "Cannot " << operation << " \"" << path << "\": "
+      << ::strerror_r(errorCode, buffer, sizeof(buffer));
+  return FileMappingError(msg.str(), origin);
+}
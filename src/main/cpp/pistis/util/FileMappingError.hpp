@@ -0,0 +1,32 @@
+#ifndef __PISTIS__UTIL__FILEMAPPINGERROR_HPP__
+#define __PISTIS__UTIL__FILEMAPPINGERROR_HPP__
+
+#include <pistis/exceptions/PistisException.hpp>
+#include <string>
+
+namespace pistis {
+  namespace util {
+
+    /** @brief Thrown when a file cannot be mapped into memory */
+    class FileMappingError : public pistis::exceptions::PistisException {
+    public:
+      FileMappingError(const std::string& details,
+		       const pistis::exceptions::ExceptionOrigin& origin);
+      virtual ~FileMappingError() noexcept;
+
+      /** @brief Create an error for a failed system call
+       *
+       *  @param operation  What was being done when the call failed
+       *  @param path       The file being mapped
+       *  @param errorCode  The value of errno after the call failed
+       *  @param origin     Where the error was detected
+       */
+      static FileMappingError systemError(
+	  const std::string& operation, const std::string& path,
+	  int errorCode, const pistis::exceptions::ExceptionOrigin& origin
+      );
+    };
+
+  }
+}
+#endif
@@ -3,22 +3,48 @@
 
 #include <pistis/util/detail/IStringText.hpp>
 #include <pistis/util/detail/IStringFormatter.hpp>
+#include <pistis/util/detail/IStringCase.hpp>
+#include <pistis/util/detail/IStringCompare.hpp>
+#include <pistis/util/detail/IStringHash.hpp>
+#include <pistis/util/detail/IStringParallel.hpp>
+#include <pistis/util/detail/IStringSearch.hpp>
+#include <pistis/util/detail/IStringUtf.hpp>
 #include <pistis/util/IStringBuilder_.hpp>
+#include <pistis/util/InternPool.hpp>
+#include <pistis/util/InvalidUtfError.hpp>
+#include <pistis/util/ImmutableList.hpp>
+#include <pistis/util/IStringCompactionPolicy.hpp>
+#include <pistis/util/IStringParallelism.hpp>
+#include <pistis/util/IStringPatternSet.hpp>
 #include <pistis/util/IStringSplitStream.hpp>
 #include <algorithm>
 #include <cctype>
 #include <functional>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <memory>
 #include <string>
+#include <vector>
 #include <stdint.h>
 #include <string.h>
 
 namespace pistis {
   namespace util {
 
+    class IStringRetentionAudit;
+
     /** @brief An immutable string class
+     *
+     *  Strings of up to MAX_INLINE_SIZE characters are stored inside the
+     *  ImmutableString object itself, in the space a longer string uses
+     *  for its text and size, so they need neither an allocation nor a
+     *  reference count and the object stays three pointers wide.  Longer
+     *  strings share a reference-counted IStringText block.  Because
+     *  inline text moves with the string,
+     *  pointers and iterators into an inline string are invalidated when
+     *  that string is moved or destroyed, just as they are for the short
+     *  string optimization in std::basic_string.
      *
      *  @todo  Add variations of split() for std::string, const Char[],
      *         etc.
@@ -36,6 +62,14 @@ namespace pistis {
       
       static constexpr const size_t NPOS = std::numeric_limits<size_t>::max();
 
+      /** @brief Longest string stored inline instead of in an IStringText
+       *
+       *  Inline characters share two pointers' worth of space with one
+       *  byte that holds their count.
+       */
+      static constexpr const size_t MAX_INLINE_SIZE =
+	  (2 * sizeof(void*) - 1) / sizeof(Char);
+
       // TODO: Get this from IStringSplitStream somehow...
       static constexpr const size_t MAX_SPLITS =
 	  std::numeric_limits<size_t>::max();
@@ -130,7 +164,7 @@ namespace pistis {
       
     public:
       ImmutableString(const Allocator& allocator = Allocator()):
-	  text_(allocator), begin_(nullptr), end_(nullptr) {
+	  begin_(nullptr), storage_(allocator) {
       }
 
       template <typename Iterator>
@@ -142,15 +176,15 @@ namespace pistis {
       template <typename Iterator>
       ImmutableString(size_t size, const Iterator& begin,
 		      const Allocator& allocator = Allocator()):
-	  text_(makeText_(size, begin, allocator)),
-	  begin_(size ? text_->text : nullptr),
-	  end_(begin_ + size) {
+	  begin_(nullptr), storage_(allocator) {
+	setChars_(size, begin);
       }
 
       template <size_t N>
       explicit ImmutableString(const Char (&text)[N],
 			       const Allocator& allocator = Allocator()):
-	  text_(allocator), begin_(text), end_(text + N - 1) {
+	  begin_(nullptr), storage_(allocator) {
+	setLiteral_(text, N - 1, 0, false);
       }
       
       template <typename C, size_t N,
@@ -161,9 +195,8 @@ namespace pistis {
       explicit ImmutableString(C (&text)[N],
 			       const Allocator& allocator = Allocator(),
 			       Enabled = 0):
-	  text_(makeText_(N - 1, text, allocator)),
-	  begin_((N > 1) ? text_->text : nullptr),
-	  end_(begin_ + N - 1) {
+	  begin_(nullptr), storage_(allocator) {
+	setChars_(N - 1, text);
       }
 
       template <typename C, typename T, typename A>
@@ -173,7 +206,8 @@ namespace pistis {
       }
       
       ImmutableString(const ImmutableString& other):
-	  text_(other.text_), begin_(other.begin_), end_(other.end_) {
+	  begin_(nullptr), storage_(other.allocator()) {
+	copyFrom_(other);
       }
 
       template <typename OtherChar, typename OtherTraits,
@@ -181,37 +215,121 @@ namespace pistis {
       explicit ImmutableString(
 	  const ImmutableString<OtherChar, OtherTraits, OtherAllocator>& other
       ):
-	  text_(makeText_(other.size(), other.data(), other.allocator())),
-	  begin_(other.size() ? text_->text : nullptr),
-	  end_(begin_ + other.size()) {
+	  begin_(nullptr), storage_(other.allocator()) {
+	setChars_(other.size(), other.data());
       }
 	
       ImmutableString(ImmutableString&& other):
-	  text_(std::move(other.text_)), begin_(other.begin_),
-	  end_(other.end_) {
-	other.begin_ = nullptr;
-	other.end_ = nullptr;
+	  begin_(nullptr), storage_(std::move(other.allocator())) {
+	moveFrom_(other);
+      }
+
+      /** @brief Convert between a thread-local string and a shared one
+       *
+       *  A thread-local string made from a shared one borrows the shared
+       *  string's text: it holds one atomic reference to that text, and
+       *  copies of the thread-local string on its thread share the
+       *  borrowed reference without touching the text's count.  Threads
+       *  that copy the same shared string many times should convert it
+       *  to a thread-local string once and copy that instead.
+       *
+       *  A shared string made from a thread-local one takes over the
+       *  thread-local string's text if the thread-local string is an
+       *  rvalue holding the only reference to it, refers directly to the
+       *  text a thread-local string borrowed, and copies the characters
+       *  otherwise.  In no case does a text end up counted by strings
+       *  with different reference counting policies.
+       */
+      template <typename OtherAllocator,
+		typename Enabled =
+		    typename std::enable_if<
+		        detail::CanTransferIStringText<Allocator,
+						       OtherAllocator>::value,
+			int
+		    >::type>
+      explicit ImmutableString(
+	  const ImmutableString<Char, CharTraits, OtherAllocator>& other,
+	  Enabled = 0
+      ):
+	  begin_(nullptr), storage_(Allocator(other.allocator())) {
+	convertFrom_<OtherAllocator>(other, nullptr);
+      }
+
+      /** @brief Convert between a thread-local string and a shared one,
+       *         leaving other empty.
+       *
+       *  Moves other's text into this string when other holds the only
+       *  reference to it.  Otherwise behaves like the constructor that
+       *  copies other.
+       */
+      template <typename OtherAllocator,
+		typename Enabled =
+		    typename std::enable_if<
+		        detail::CanTransferIStringText<Allocator,
+						       OtherAllocator>::value,
+			int
+		    >::type>
+      explicit ImmutableString(
+	  ImmutableString<Char, CharTraits, OtherAllocator>&& other,
+	  Enabled = 0
+      ):
+	  begin_(nullptr), storage_(Allocator(other.allocator())) {
+	convertFrom_<OtherAllocator>(other, &other);
+	other.reset_();
       }
       
-      ~ImmutableString() { }
+      ~ImmutableString() { release_(); }
 
-      const Allocator& allocator() const { return text_.allocator(); }
-      Allocator& allocator() { return text_.allocator(); }
+      const Allocator& allocator() const { return storage_; }
+      Allocator& allocator() { return storage_; }
       
-      size_t size() const { return end_ - begin_; }
+      size_t size() const {
+	return isInline_() ? storage_.local.size
+	                   : (storage_.remote.sizeAndFlags & SIZE_MASK_);
+      }
       const Char* data() const { return begin_; }
 
+      /** @brief Compute this string's hash code
+       *
+       *  A string that spans its entire IStringText returns the hash
+       *  code cached in the text, computing it on the first call.
+       *  Strings made by the _is and _wis literals or by hashedLiteral()
+       *  return the hash code they were made with.  Substrings and
+       *  inline strings hash their characters each time.  The hash code
+       *  comes from DefaultIStringHasher.
+       */
       size_t hash() const {
-	size_t h = 5381;
-	
-	for (const Char* p = begin_; p != end_; ++p) {
-	  h = (h << 5) + h + (size_t)*p;
+	const detail::IStringText<Char>* const t = ownerText_();
+	if (t && t->spans(begin_, size())) {
+	  return t->hash();
+	} else if (!isInline_() &&
+		   (storage_.remote.sizeAndFlags & HASH_KNOWN_)) {
+	  return storage_.remote.hashCode;
+	} else {
+	  return detail::hashIStringChars(begin_, size());
 	}
-	return h;
       }
+
+      /** @brief Compute this string's hash code using another hash policy
+       *
+       *  Hash codes from policies other than DefaultIStringHasher are
+       *  not cached.
+       */
+      template <typename Hasher>
+      size_t hash(const Hasher& hasher) const {
+	return hasher(begin_, size());
+      }
+
+      /** @brief Compute a hash code that ignores the case of ASCII letters
+       *
+       *  Strings for which equalsIgnoreCase() is true have the same
+       *  hash code.  The code comes from CaseInsensitiveWyHasher and is
+       *  not cached.
+       */
+      size_t hashIgnoreCase() const { return hash(CaseInsensitiveWyHasher()); }
       
       ConstIterator begin() const { return ConstIterator(begin_); }
-      ConstIterator end() const { return ConstIterator(end_); }
+      ConstIterator end() const { return ConstIterator(end_()); }
       ConstIterator cbegin() const { return begin(); }
       ConstIterator cend() const { return end(); }
       ConstIterator position(size_t p) const {
@@ -241,12 +359,56 @@ namespace pistis {
 
       template <typename C>
       int cmp(C* other, C* end) const { return cmp_(other, end - other); }
+
+      /** @brief Compare this string to another, treating the ASCII
+       *         letters A-Z as if they were a-z.
+       *
+       *  Other characters compare by their code units, so the order
+       *  agrees with cmp() on strings that have been converted with
+       *  toLower().  Returns a negative number, zero or a positive
+       *  number, just as cmp() does.
+       */
+      template <typename T, typename A>
+      int cmpIgnoreCase(const ImmutableString<Char, T, A>& other) const {
+	return cmpIgnoreCase_(other.data(), other.size());
+      }
+
+      template <typename T, typename A>
+      int cmpIgnoreCase(const std::basic_string<Char, T, A>& other) const {
+	return cmpIgnoreCase_(other.data(), other.size());
+      }
+
+      int cmpIgnoreCase(const Char* other) const {
+	return cmpIgnoreCase_(other, findFirstNull_(other) - other);
+      }
+
+      template <typename T, typename A>
+      bool equalsIgnoreCase(const ImmutableString<Char, T, A>& other) const {
+	return equalsIgnoreCase_(other.data(), other.size());
+      }
+
+      template <typename T, typename A>
+      bool equalsIgnoreCase(const std::basic_string<Char, T, A>& other) const {
+	return equalsIgnoreCase_(other.data(), other.size());
+      }
+
+      bool equalsIgnoreCase(const Char* other) const {
+	return equalsIgnoreCase_(other, findFirstNull_(other) - other);
+      }
       
       ImmutableString substr(const size_t start,
 			     const size_t end = NPOS) const {
 	const Char* const e = begin_ + std::min(end, size());
 	const Char* const s = std::min(begin_ + start, e);
-	return ImmutableString(text_, s, e);
+	return slice_(s, e);
+      }
+
+      /** @brief Return substr(start, end), compacted under policy */
+      ImmutableString substr(const size_t start, const size_t end,
+			     const IStringCompactionPolicy& policy) const {
+	ImmutableString s = substr(start, end);
+	s.shrink(policy);
+	return s;
       }
 
       template <typename C,
@@ -388,10 +550,94 @@ namespace pistis {
 	return findLastOf_(chars, charsEnd - chars, start, end);
       }
 
+      /** @brief Return the position of the first match of any of the
+       *         patterns in [start, end), or NPOS if there is none
+       */
+      size_t findAny(const ImmutableStringPatternSet<Char>& patterns,
+		     size_t start = 0, size_t end = NPOS) const {
+	const size_t e = std::min(end, size());
+	const size_t s = std::min(start, e);
+	typename ImmutableStringPatternSet<Char>::Match match;
+	return patterns.find(begin_ + s, e - s, match) ? s + match.position
+	                                               : NPOS;
+      }
+
+      /** @brief Return the positions of every match of target, searching
+       *         chunks of the string in parallel
+       *
+       *  Matches do not overlap: each one starts after the end of the
+       *  one before it, just as with repeated calls to find().
+       */
+      template <typename C, typename T, typename A>
+      ImmutableList<size_t> findAll(
+	  const ImmutableString<C, T, A>& target,
+	  const IStringParallelism& parallelism = IStringParallelism()
+      ) const {
+	return findAll_(target.data(), target.size(), parallelism, (T*)0);
+      }
+
+      template <typename C, typename T, typename A>
+      ImmutableList<size_t> findAll(
+	  const std::basic_string<C, T, A>& target,
+	  const IStringParallelism& parallelism = IStringParallelism()
+      ) const {
+	return findAll_(target.data(), target.size(), parallelism, (T*)0);
+      }
+
+      template <typename C, size_t N>
+      ImmutableList<size_t> findAll(
+	  C (&target)[N],
+	  const IStringParallelism& parallelism = IStringParallelism()
+      ) const {
+	return findAll_(target, N - 1, parallelism);
+      }
+
+      template <typename C>
+      ImmutableList<size_t> findAll(
+	  C* const& target,
+	  const IStringParallelism& parallelism = IStringParallelism()
+      ) const {
+	return findAll_(target, findFirstNull_(target) - target,
+			parallelism);
+      }
+
+      /** @brief Return the number of matches findAll() would find */
+      template <typename C, typename T, typename A>
+      size_t count(
+	  const ImmutableString<C, T, A>& target,
+	  const IStringParallelism& parallelism = IStringParallelism()
+      ) const {
+	return count_(target.data(), target.size(), parallelism, (T*)0);
+      }
+
+      template <typename C, typename T, typename A>
+      size_t count(
+	  const std::basic_string<C, T, A>& target,
+	  const IStringParallelism& parallelism = IStringParallelism()
+      ) const {
+	return count_(target.data(), target.size(), parallelism, (T*)0);
+      }
+
+      template <typename C, size_t N>
+      size_t count(
+	  C (&target)[N],
+	  const IStringParallelism& parallelism = IStringParallelism()
+      ) const {
+	return count_(target, N - 1, parallelism);
+      }
+
+      template <typename C>
+      size_t count(
+	  C* const& target,
+	  const IStringParallelism& parallelism = IStringParallelism()
+      ) const {
+	return count_(target, findFirstNull_(target) - target, parallelism);
+      }
+
       template <typename... Args>
       auto fmt(Args&&... args) const {
 	ImmutableStringBuilder<Char, CharTraits, Allocator> builder;
-	return detail::formatIString(builder, begin_, end_, begin_,
+	return detail::formatIString(builder, begin_, end_(), begin_,
 				     std::forward<Args>(args)...);
       }
 
@@ -406,7 +652,7 @@ namespace pistis {
 	        Builder;
 	Builder builder(size() + 1, allocator());
 	const Char* const p = begin_ + pos;
-	return builder.append(begin_, p).append(c).append(p, end_).done();
+	return builder.append(begin_, p).append(c).append(p, end_()).done();
       }
 
       template <typename C, typename T, typename A>
@@ -678,13 +924,104 @@ namespace pistis {
 			replacementEnd - replacement, start, end);
       }
 
+      /** @brief Replace every match of target with replacement, searching
+       *         and copying chunks of the string in parallel
+       *
+       *  Replaces the same matches as replace(target, replacement).
+       *  First each chunk finds its matches.  Then the offset in the
+       *  result of each chunk follows from the number of matches before
+       *  it, so the chunks copy themselves into the result at once.
+       *  The replacement's characters must fit in this string's
+       *  characters.  Returns this string if nothing matches.
+       */
+      template <typename C1, typename T1, typename A1,
+		typename C2, typename T2, typename A2>
+      ImmutableString replace(const ImmutableString<C1, T1, A1>& target,
+			      const ImmutableString<C2, T2, A2>& replacement,
+			      const IStringParallelism& parallelism) const {
+	return replaceInChunks_(target.data(), target.size(),
+				replacement.data(), replacement.size(),
+				parallelism, (T1*)0);
+      }
+
+      template <typename C1, typename T1, typename A1,
+		typename C2, typename T2, typename A2>
+      ImmutableString replace(const std::basic_string<C1, T1, A1>& target,
+			      const std::basic_string<C2, T2, A2>& replacement,
+			      const IStringParallelism& parallelism) const {
+	return replaceInChunks_(target.data(), target.size(),
+				replacement.data(), replacement.size(),
+				parallelism, (T1*)0);
+      }
+
+      template <typename C1, size_t N1, typename C2, size_t N2>
+      ImmutableString replace(C1 (&target)[N1], C2 (&replacement)[N2],
+			      const IStringParallelism& parallelism) const {
+	typedef std::char_traits<typename std::remove_cv<C1>::type> C1T;
+	return replaceInChunks_(target, N1 - 1, replacement, N2 - 1,
+				parallelism, (C1T*)0);
+      }
+
+      /** @brief Replace every match of the patterns in [start, end) with
+       *         its pattern's replacement
+       *
+       *  Scans the string once and allocates the result once, at its
+       *  final size.  Returns this string if nothing matches.
+       */
+      ImmutableString replaceAll(
+	  const ImmutableStringPatternSet<Char>& patterns, size_t start = 0,
+	  size_t end = NPOS) const {
+	typedef typename ImmutableStringPatternSet<Char>::Match Match;
+	const size_t e = std::min(end, size());
+	const size_t s = std::min(start, e);
+	std::vector<Match> matches;
+	size_t n = size();
+	patterns.forEachMatch(begin_ + s, e - s,
+			      [&patterns, &matches, &n](const Match& m) {
+	  matches.push_back(m);
+	  n = n - m.length + patterns.replacement(m.pattern).size();
+	});
+	if (matches.empty()) {
+	  return *this;
+	}
+
+	ImmutableStringBuilder<Char, CharTraits, Allocator> builder(
+	    n, allocator());
+	const Char* last = begin_;
+	for (const Match& m : matches) {
+	  const auto& replacement = patterns.replacement(m.pattern);
+	  const Char* const p = begin_ + s + m.position;
+	  builder.append(last, p)
+	         .append(replacement.data(),
+			 replacement.data() + replacement.size());
+	  last = p + m.length;
+	}
+	return builder.append(last, end_()).done();
+      }
+
       template <typename C,
 		typename Enabled =
 		    typename std::enable_if<
 		        std::is_integral<C>::value, int
 		    >::type>
       ImmutableString remove(C c, size_t start = 0, size_t end = NPOS) const {
-	return filter([c](Char x) { return c != x; }, start, end);
+	const Char* const e = begin_ + std::min(size(), end);
+	const Char* const s = std::min(begin_ + start, e);
+	auto isC = [c](Char x) { return x == c; };
+	const size_t numMatches = std::count_if(s, e, isC);
+	if (!numMatches) {
+	  return *this;
+	}
+
+	ImmutableStringBuilder<Char, CharTraits, Allocator>
+	    builder(size() - numMatches, allocator());
+	const Char* last = begin_;
+	for (const Char* p = std::find_if(s, e, isC); p != e;
+	     p = std::find_if(p + 1, e, isC)) {
+	  builder.append(last, p);
+	  last = p + 1;
+	}
+	return builder.append(last, end_()).done();
       }
 
       template <typename C, typename T, typename A>
@@ -717,25 +1054,108 @@ namespace pistis {
 	return remove_(text, textEnd - text, start, end);
       }
 
+      /** @brief Remove every match of text, searching and copying chunks
+       *         of the string in parallel.  See replace().
+       */
+      template <typename C, typename T, typename A>
+      ImmutableString remove(const ImmutableString<C, T, A>& text,
+			     const IStringParallelism& parallelism) const {
+	return replaceInChunks_(text.data(), text.size(), (Char*)0, 0,
+				parallelism, (T*)0);
+      }
+
+      template <typename C, typename T, typename A>
+      ImmutableString remove(const std::basic_string<C, T, A>& text,
+			     const IStringParallelism& parallelism) const {
+	return replaceInChunks_(text.data(), text.size(), (Char*)0, 0,
+				parallelism, (T*)0);
+      }
+
+      template <typename C, size_t N>
+      ImmutableString remove(C (&text)[N],
+			     const IStringParallelism& parallelism) const {
+	typedef std::char_traits<typename std::remove_cv<C>::type> CT;
+	return replaceInChunks_(text, N - 1, (Char*)0, 0, parallelism,
+				(CT*)0);
+      }
+
       ImmutableString strip() const {
+	const Char* const end = end_();
 	const Char* s, *e;
-	for (s = begin_; (s < end_) && std::isspace(*s); ++s) {
+	for (s = begin_; (s < end) && std::isspace(*s); ++s) {
 	}
-	for (e = end_; (e > s) && std::isspace(e[-1]); --e) {
+	for (e = end; (e > s) && std::isspace(e[-1]); --e) {
 	}
-	return ImmutableString(text_, s, e);
+	return slice_(s, e);
       }
       
       ImmutableString& shrink() {
 	const size_t n = size();
-	if ((begin_ > (const Char*)text_.get()) || (n < text_->size)) {
-	  text_ = StringTextPtr::create(n, begin_, allocator());
-	  begin_ = n ? text_->text : nullptr;
-	  end_ = begin_ + n;
+	const detail::IStringText<Char>* const t = ownerText_();
+	if (t ? !t->spans(begin_, n) : (begin_ && !isInline_())) {
+	  *this = ImmutableString(n, begin_, allocator());
 	}
 	return *this;
       }
 
+      /** @brief Copy this string into a text of its own if policy says
+       *         it keeps too much of its current text alive
+       */
+      ImmutableString& shrink(const IStringCompactionPolicy& policy) {
+	const size_t n = size();
+	const detail::IStringText<Char>* const t = ownerText_();
+	if (t && !t->spans(begin_, n) &&
+	    policy.shouldCompact(n * sizeof(Char), t->footprint())) {
+	  *this = ImmutableString(n, begin_, allocator());
+	}
+	return *this;
+      }
+
+      /** @brief Bytes of text this string keeps alive
+       *
+       *  Zero for strings stored inline or made by literal(); otherwise
+       *  the size of the whole text it shares, which for a substring can
+       *  be far more than the substring itself.
+       */
+      size_t bytesPinned() const {
+	const detail::IStringText<Char>* const t = ownerText_();
+	return t ? t->footprint() : 0;
+      }
+
+      /** @brief Return a string with the same content whose text is
+       *         shared with every other interned string equal to it.
+       *
+       *  Equal interned strings share one text, so comparing two
+       *  interned strings for equality short-circuits on the identity of
+       *  their texts and takes constant time.  hash() takes constant
+       *  time after the first call, since the text caches the code.
+       *  Containers that want to hash interned strings by address can
+       *  opt in with InternedIStringHash.  The text stays in the global
+       *  InternPool until the last string referring to it is destroyed.
+       */
+      ImmutableString intern() const {
+	static_assert(StringTextPtr::RefCount::THREAD_SAFE,
+		      "Thread-local strings cannot be interned; convert them "
+		      "to shared strings first");
+	static_assert(!detail::IStringAllocationTraits<Allocator>::SCOPED,
+		      "Strings whose allocator frees its memory all at once "
+		      "cannot be interned");
+	if (!size() || isInterned()) {
+	  return *this;
+	}
+	StringTextPtr text =
+	    InternPool<Char, Allocator>::global().intern(begin_, size(),
+							 allocator());
+	const Char* const p = text->chars();
+	return ImmutableString(std::move(text), p, p + size());
+      }
+
+      /** @brief True if this string's text came from intern() */
+      bool isInterned() const {
+	const detail::IStringText<Char>* const t = ownerText_();
+	return t && t->interned() && t->spans(begin_, size());
+      }
+
       template <typename C, typename T, typename A>
       bool startsWith(const ImmutableString<C, T, A>& prefix) const {
 	return startsWith_(prefix.data(), prefix.size(), (T*)0);
@@ -784,12 +1204,66 @@ namespace pistis {
 	return endsWith_(suffix, end - suffix);
       }			
 
-      bool isLowerCase() const {
-	return all([](Char c) { return std::islower(c); });
-      }
-      
-      bool isUpperCase() const {
-	return all([](Char c) { return std::isupper(c); });
+      /** @brief True if every character is one of the ASCII letters a-z
+       *
+       *  Like the other case operations, isLowerCase(), isUpperCase(),
+       *  toLower() and toUpper() only know about the ASCII letters.  They
+       *  do not depend on the locale and never alter a non-ASCII
+       *  character, so they are safe to use on UTF-8 text.
+       */
+      bool isLowerCase() const { return allInRange_('a', 'z'); }
+
+      /** @brief True if every character is one of the ASCII letters A-Z */
+      bool isUpperCase() const { return allInRange_('A', 'Z'); }
+
+      /** @brief Convert the ASCII letters A-Z to a-z
+       *
+       *  Returns this string, without copying it, if it has no capital
+       *  letters.
+       */
+      ImmutableString toLower() const { return switchCase_('A'); }
+
+      /** @brief Convert the ASCII letters a-z to A-Z
+       *
+       *  Returns this string, without copying it, if it has no lower
+       *  case letters.
+       */
+      ImmutableString toUpper() const { return switchCase_('a'); }
+
+      typedef ImmutableString<char, std::char_traits<char>, Allocator>
+              Utf8String;
+      typedef ImmutableString<char16_t, std::char_traits<char16_t>,
+			      Allocator> Utf16String;
+      typedef ImmutableString<char32_t, std::char_traits<char32_t>,
+			      Allocator> Utf32String;
+
+      /** @brief Transcode this string to UTF-8
+       *
+       *  A string's encoding follows from the width of its characters:
+       *  UTF-8 for one-byte characters, UTF-16 for two-byte characters
+       *  and UTF-32 for four-byte characters, which include wchar_t on
+       *  Linux.  The string is validated and the length of the result
+       *  computed before anything is allocated, so the result takes a
+       *  single allocation, or none if it fits inline.  A string that
+       *  is already of the result type is returned as it is once it has
+       *  been validated.
+       *
+       *  Throws InvalidUtfError if this string is not valid in its
+       *  encoding.
+       */
+      Utf8String toUtf8() const { return transcode_((Utf8String*)0); }
+
+      /** @brief Transcode this string to UTF-16.  See toUtf8(). */
+      Utf16String toUtf16() const { return transcode_((Utf16String*)0); }
+
+      /** @brief Transcode this string to UTF-32.  See toUtf8(). */
+      Utf32String toUtf32() const { return transcode_((Utf32String*)0); }
+
+      /** @brief True if this string is valid UTF-8, UTF-16 or UTF-32,
+       *         depending on the width of its characters
+       */
+      bool isValidUtf() const {
+	return scanUtf_(sizeof(Char)).invalidAt == size();
       }
 
       template <typename Predicate>
@@ -820,7 +1294,7 @@ namespace pistis {
 	    builder << *p;
 	  }
 	}
-	return builder.append(p, end_).done();
+	return builder.append(p, end_()).done();
       }
       
       template <typename Function>
@@ -844,7 +1318,7 @@ namespace pistis {
 	for (; p < e; ++p) {
 	  builder << f(*p);
 	}
-	return builder.append(e, end_).done();
+	return builder.append(e, end_()).done();
       }
 
       template <typename Iterator>
@@ -864,32 +1338,65 @@ namespace pistis {
 	return join(c.begin(), c.end());
       }
 
+      /** @brief Split this string at each occurrence of separator
+       *
+       *  The pieces share this string's text unless compaction says to
+       *  copy them.
+       */
       template <typename C, typename T, typename A>
       auto split(const ImmutableString<C, T, A>& separator,
-		 const size_t maxSplits = MAX_SPLITS) const {
+		 const size_t maxSplits = MAX_SPLITS,
+		 const IStringCompactionPolicy& compaction =
+		     IStringCompactionPolicy()) const {
 	return IStringSplitStream<CharType, CharTraits, Allocator, C, T, A>(
-	    *this, separator, maxSplits
+	    *this, separator, maxSplits, compaction
+	);
+      }
+
+      /** @brief Split this string at each occurrence of separator,
+       *         working from the end of the string to the beginning.
+       *
+       *  The stream returns the pieces last to first.  If maxSplits is
+       *  reached, the last piece is everything that has not been
+       *  returned yet, from the start of the string on.
+       */
+      template <typename C, typename T, typename A>
+      auto rsplit(const ImmutableString<C, T, A>& separator,
+		  const size_t maxSplits = MAX_SPLITS,
+		  const IStringCompactionPolicy& compaction =
+		      IStringCompactionPolicy()) const {
+	return ReverseIStringSplitStream<CharType, CharTraits, Allocator,
+					 C, T, A>(
+	    *this, separator, maxSplits, compaction
 	);
       }
 
       template <typename RegexTraits>
       auto split(
 	  const std::basic_regex<CharType, RegexTraits>& separator,
-	  const size_t maxSplits = MAX_SPLITS
+	  const size_t maxSplits = MAX_SPLITS,
+	  const IStringCompactionPolicy& compaction = IStringCompactionPolicy()
       ) const {
 	return RegexIStringSplitStream<CharType, CharTraits, Allocator,
 				       RegexTraits>(
-	    *this, separator, maxSplits
+	    *this, separator, maxSplits, compaction
 	);
       }
       
-      ImmutableString& operator=(const ImmutableString&) = default;
+      ImmutableString& operator=(const ImmutableString& other) {
+	if (&other != this) {
+	  reset_();
+	  allocator() = other.allocator();
+	  copyFrom_(other);
+	}
+	return *this;
+      }
       
       ImmutableString& operator=(ImmutableString&& other) {
 	if (&other != this) {
-	  text_ = std::move(other.text_);
-	  begin_ = other.begin_; other.begin_ = nullptr;
-	  end_ = other.end_; other.end_ = nullptr;
+	  reset_();
+	  allocator() = std::move(other.allocator());
+	  moveFrom_(other);
 	}
 	return *this;
       }
@@ -913,14 +1420,18 @@ namespace pistis {
 	return *this;
       }
 
+      bool operator==(const ImmutableString& other) const {
+	return equals_(other);
+      }
+
       template <typename C, typename T, typename A>
       bool operator==(const ImmutableString<C, T, A>& other) const {
-	return !cmp(other);
+	return (size() == other.size()) && !cmp(other);
       }
       
       template <typename C, typename T, typename A>
       bool operator==(const std::basic_string<C, T, A>& other) const {
-	return !cmp(other);
+	return (size() == other.size()) && !cmp(other);
       }
 
       template <typename C, size_t N>
@@ -928,14 +1439,18 @@ namespace pistis {
 	return !cmp(other);
       }
 
+      bool operator!=(const ImmutableString& other) const {
+	return !equals_(other);
+      }
+
       template <typename C, typename T, typename A>
       bool operator!=(const ImmutableString<C, T, A>& other) const {
-	return (bool)cmp(other);
+	return (size() != other.size()) || (bool)cmp(other);
       }
       
       template <typename C, typename T, typename A>
       bool operator!=(const std::basic_string<C, T, A>& other) const {
-	return (bool)cmp(other);
+	return (size() != other.size()) || (bool)cmp(other);
       }
       
       template <typename C, size_t N>
@@ -1007,7 +1522,65 @@ namespace pistis {
 
       static ImmutableString literal(const Char* text, size_t n,
 				     const Allocator& allocator = Allocator()) {
-	return ImmutableString(text, n, allocator, LiteralTag());
+	return ImmutableString(text, n, allocator, LiteralTag(), 0, false);
+      }
+
+      /** @brief Like literal(), but hash() returns hashCode without
+       *         looking at the characters
+       *
+       *  hashCode must be DefaultIStringHasher()(text, n).  The _is and
+       *  _wis literals compute it at compile time.
+       */
+      static ImmutableString hashedLiteral(
+	  const Char* text, size_t n, size_t hashCode,
+	  const Allocator& allocator = Allocator()
+      ) {
+	return ImmutableString(text, n, allocator, LiteralTag(), hashCode,
+			       true);
+      }
+
+      /** @brief Return a string whose characters are the contents of
+       *         the file at path, mapped into memory
+       *
+       *  The file is mapped read-only instead of being copied, so mapping
+       *  a large file is fast and shares the kernel's page cache.  The
+       *  string and every substring or split token taken from it share
+       *  the mapping, which is unmapped when the last of them is
+       *  destroyed.  shrink() copies a substring out of the mapping.
+       *
+       *  Any bytes past the last whole Char are ignored.  Files no longer
+       *  than MAX_INLINE_SIZE characters are copied.  Truncating the file
+       *  while it is mapped makes reading the missing characters raise
+       *  SIGBUS, so only map files that will not change.
+       *
+       *  Throws FileMappingError if the file cannot be opened or mapped.
+       */
+      static ImmutableString mapFile(
+	  const std::string& path,
+	  FileAccessPattern access = FileAccessPattern::NORMAL,
+	  const Allocator& allocator = Allocator()
+      ) {
+	const detail::FileMapping mapping = detail::mapFile(path, access);
+	const Char* const p = (const Char*)mapping.address;
+	const size_t n = mapping.length / sizeof(Char);
+	if (n <= MAX_INLINE_SIZE) {
+	  ImmutableString s(n, p, allocator);
+	  detail::unmapFile(mapping);
+	  return s;
+	}
+	return ImmutableString(StringTextPtr::map(mapping, allocator), p,
+			       p + n);
+      }
+
+      /** @brief Tell the kernel how this string's characters will be read
+       *
+       *  Only affects strings made by mapFile() and their substrings.
+       */
+      void advise(FileAccessPattern access) const {
+	const detail::IStringText<Char>* const t = ownerText_();
+	if (t && t->mapped()) {
+	  detail::adviseFileAccess(begin_, size() * sizeof(Char), access);
+	}
       }
       
     private:
@@ -1048,40 +1621,180 @@ namespace pistis {
       };
       
     private:
-      StringTextPtr text_;
-      const Char* begin_;
-      const Char* end_;
+      // Flags in the top bits of Remote_::sizeAndFlags
+      static constexpr const size_t OWNS_TEXT_ =
+	  (size_t)1 << (std::numeric_limits<size_t>::digits - 1);
+      static constexpr const size_t HASH_KNOWN_ = OWNS_TEXT_ >> 1;
+      static constexpr const size_t SIZE_MASK_ = HASH_KNOWN_ - 1;
+
+      /** @brief How strings that are not inline keep their size, and
+       *         either a reference to their text or, for literals made
+       *         by hashedLiteral(), their hash code
+       */
+      struct Remote_ {
+	union {
+	  detail::IStringText<Char>* text;
+	  size_t hashCode;
+	};
+	size_t sizeAndFlags;
+      };
 
-      ImmutableString(const StringTextPtr& text, const Char* begin,
-		      const Char* end):
-	  text_(text), begin_(begin), end_(end) {
-      }
+      struct Local_ {
+	Char chars[MAX_INLINE_SIZE];
+	uint8_t size;
+      };
+
+      /** @brief The allocator, which takes no space when it is empty,
+       *         and either an inline string's characters or the text
+       *         and size of any other string.  A string is inline when
+       *         begin_ points at local.chars.
+       */
+      struct Storage_ : Allocator {
+	union {
+	  Remote_ remote;
+	  Local_ local;
+	};
+
+	Storage_(const Allocator& allocator): Allocator(allocator), remote() {
+	}
+
+	Storage_(Allocator&& allocator):
+	    Allocator(std::move(allocator)), remote() {
+	}
+      };
+
+      const Char* begin_;
+      Storage_ storage_;
 
       ImmutableString(StringTextPtr&& text, const Char* begin,
 		      const Char* end):
-	  text_(std::move(text)), begin_(begin), end_(end) {
+	  begin_(nullptr), storage_(text.allocator()) {
+	setText_(std::move(text), begin, end - begin);
       }
 
       ImmutableString(const Char* text, size_t n, const Allocator& allocator,
-		      LiteralTag):
-	  text_(allocator), begin_(text), end_(text + n) {
+		      LiteralTag, size_t hashCode, bool hashKnown):
+	  begin_(nullptr), storage_(allocator) {
+	setLiteral_(text, n, hashCode, hashKnown);
       }
 
       template <typename C, typename T>
       void assign_(const C* other, size_t size, T* = 0) {
 	static_assert(sizeof(C) <= sizeof(Char), "Char type is too big");
-	
-	if (!size) {
-	  text_.reset();
-	  begin_ = nullptr;
-	  end_ = nullptr;
+	ImmutableString tmp(size, other, allocator());
+	reset_();
+	moveFrom_(tmp);
+      }
+      
+      bool equals_(const ImmutableString& other) const {
+	// Equal interned strings always share the same text, so two
+	// interned strings at different addresses cannot be equal.
+	return (size() == other.size()) &&
+	       ((begin_ == other.begin_) ||
+		(!(isInterned() && other.isInterned()) &&
+		 !CharTraits::compare(begin_, other.begin_, size())));
+      }
+
+      detail::UtfScan scanUtf_(size_t outUnitSize) const {
+	typedef typename detail::SearchUnitType<sizeof(Char)>::type Unit;
+	return detail::scanUtf((const Unit*)begin_, size(), outUnitSize);
+      }
+
+      const ImmutableString& transcode_(ImmutableString*) const {
+	const detail::UtfScan scan = scanUtf_(sizeof(Char));
+	if (scan.invalidAt < size()) {
+	  detail::throwInvalidUtf(sizeof(Char), scan.invalidAt);
+	}
+	return *this;
+      }
+
+      template <typename ResultString>
+      ResultString transcode_(ResultString*) const {
+	typedef typename ResultString::CharType OutChar;
+	typedef typename detail::SearchUnitType<sizeof(Char)>::type InUnit;
+	typedef typename detail::SearchUnitType<sizeof(OutChar)>::type OutUnit;
+	const detail::UtfScan scan = scanUtf_(sizeof(OutChar));
+	if (scan.invalidAt < size()) {
+	  detail::throwInvalidUtf(sizeof(Char), scan.invalidAt);
+	} else if (sizeof(OutChar) == sizeof(Char)) {
+	  // Same encoding under another character type, such as wchar_t
+	  // to char32_t, so the characters copy across unchanged
+	  return ResultString(size(), (const OutChar*)begin_, allocator());
+	}
+	return ResultString::generate_(
+	    scan.length,
+	    [this](OutChar* out) {
+	      detail::transcodeUtf((const InUnit*)begin_, size(),
+				   (OutUnit*)out);
+	    },
+	    allocator()
+	);
+      }
+
+      /** @brief Make a string of n characters and have fill write them */
+      template <typename Fill>
+      static ImmutableString generate_(size_t n, const Fill& fill,
+				       const Allocator& allocator) {
+	if (n <= MAX_INLINE_SIZE) {
+	  Char local[MAX_INLINE_SIZE];
+	  fill(local);
+	  return ImmutableString(n, (const Char*)local, allocator);
+	}
+	Char* chars;
+	StringTextPtr text = StringTextPtr::create(n, allocator, chars);
+	fill(chars);
+	return ImmutableString(std::move(text), chars, chars + n);
+      }
+
+      typedef typename detail::SearchUnitType<sizeof(Char)>::type CaseUnit_;
+
+      const CaseUnit_* units_() const { return (const CaseUnit_*)begin_; }
+
+      bool allInRange_(char low, char high) const {
+	return detail::findFirstNotInRange(units_(), size(), (CaseUnit_)low,
+					   (CaseUnit_)high) == size();
+      }
+
+      ImmutableString switchCase_(char first) const {
+	const size_t n = size();
+	const CaseUnit_* const text = units_();
+	const size_t p = detail::findFirstInRange(text, n, (CaseUnit_)first,
+						  (CaseUnit_)(first + 25));
+	if (p == n) {
+	  return *this;
+	} else if (n <= MAX_INLINE_SIZE) {
+	  CaseUnit_ converted[MAX_INLINE_SIZE];
+	  detail::switchAsciiCase(text, n, converted, (CaseUnit_)first);
+	  return ImmutableString(n, (const Char*)converted, allocator());
 	} else {
-	  text_ = StringTextPtr::create(size, other, allocator());
-	  begin_ = text_->text;
-	  end_ = begin_ + size;
+	  Char* chars;
+	  StringTextPtr t = StringTextPtr::create(n, allocator(), chars);
+	  std::copy_n(begin_, p, chars);
+	  detail::switchAsciiCase(text + p, n - p, (CaseUnit_*)chars + p,
+				  (CaseUnit_)first);
+	  return ImmutableString(std::move(t), chars, chars + n);
 	}
       }
-      
+
+      int cmpIgnoreCase_(const Char* other, size_t n) const {
+	const size_t common = std::min(size(), n);
+	const CaseUnit_* const right = (const CaseUnit_*)other;
+	const size_t p = detail::findMismatchIgnoringCase(units_(), right,
+							  common);
+	if (p < common) {
+	  return (detail::foldAsciiCase(units_()[p]) <
+		  detail::foldAsciiCase(right[p])) ? -1 : 1;
+	}
+	return (size() < n) ? -1 : int(size() > n);
+      }
+
+      bool equalsIgnoreCase_(const Char* other, size_t n) const {
+	return (size() == n) &&
+	       (detail::findMismatchIgnoringCase(
+		    units_(), (const CaseUnit_*)other, n
+		) == n);
+      }
+
       template <typename OtherChar>
       int cmp_(const OtherChar* other, size_t size) const {
 	return cmp_(other, size, (std::char_traits<OtherChar>*)0);
@@ -1108,7 +1821,10 @@ namespace pistis {
       static int compareChars_(const Char* left, const OtherChar* right,
 			       size_t n, OtherTraits*) {
 	static const IntTypeConverter<OtherTraits> toInt;
-	for (size_t i = 0; i < n; ++i) {
+	const size_t start =
+	    skipEqualChars_(left, right, n,
+			    IsWideningComparable_<OtherChar, OtherTraits>());
+	for (size_t i = start; i < n; ++i) {
 	  const auto l = toInt(left[i], (CharTraits*)0);
 	  const auto r = toInt(right[i], (OtherTraits*)0);
 	  const auto delta = l - r;
@@ -1119,6 +1835,22 @@ namespace pistis {
 	return 0;
       }
 
+      /** @brief Return the number of characters at the start of left
+       *         and right that are equal, if that can be computed faster
+       *         than comparing them one at a time, or zero otherwise.
+       */
+      template <typename OtherChar>
+      static size_t skipEqualChars_(const Char* left, const OtherChar* right,
+				    size_t n, std::true_type) {
+	return detail::findMismatch(left, right, n);
+      }
+
+      template <typename OtherChar>
+      static size_t skipEqualChars_(const Char*, const OtherChar*, size_t,
+				    std::false_type) {
+	return 0;
+      }
+
       static size_t findFirstChar_(const Char* text, Char c, size_t start,
 				   size_t end, CharTraits*) {
 	const Char* const p = CharTraits::find(text + start, end - start, c);
@@ -1145,25 +1877,119 @@ namespace pistis {
       template <typename C, typename T>
       size_t find_(const C* other, size_t n, size_t start, size_t end,
 		   T*) const {
-	if (!n || (end < start) || ((end - start) < n)) {
+	const size_t e = std::min(end, size());
+	if (!n || (start > e) || ((e - start) < n)) {
 	  return NPOS;
 	} else if (n == 1) {
-	  const size_t e = std::min(end, size());
 	  return setNpos_(findFirstChar_(begin_, *other, start, e, (T*)0), e);
 	} else {
-	  const size_t e = std::min(end, size()) - n + 1;
-	  size_t p = findFirstChar_(begin_, *other, start, e, (T*)0);
-	  while ((p < e) &&
-		 compareChars_(begin_ + p + 1, other + 1, n - 1, (T*)0)) {
-	    p = findFirstChar_(begin_, *other, p + 1, e, (T*)0);
+	  return findString_(other, n, start, e, (T*)0,
+			     IsBitwiseComparable_<C, T>());
+	}
+      }
+
+      /** @brief True if characters of type C with traits T are equal to
+       *         this string's characters exactly when their code units
+       *         are equal, so the search kernels can compare them.
+       */
+      template <typename C, typename T>
+      struct IsBitwiseComparable_ :
+	  std::integral_constant<
+	      bool,
+	      (sizeof(C) == sizeof(Char)) &&
+	      detail::IsSearchableChar<Char>::value &&
+	      std::is_same<T, std::char_traits<C> >::value &&
+	      std::is_same<CharTraits, std::char_traits<Char> >::value
+	  > {
+      };
+
+      /** @brief True if characters of type C with traits T are equal to
+       *         this string's characters exactly when their code units,
+       *         zero-extended to the wider of the two, are equal.  The
+       *         widening comparison kernels apply to these characters.
+       */
+      template <typename C, typename T>
+      struct IsWideningComparable_ :
+	  std::integral_constant<
+	      bool,
+	      (sizeof(C) != sizeof(Char)) &&
+	      detail::IsSearchableChar<C>::value &&
+	      detail::IsSearchableChar<Char>::value &&
+	      std::is_same<T, std::char_traits<C> >::value &&
+	      std::is_same<CharTraits, std::char_traits<Char> >::value
+	  > {
+      };
+
+      template <typename C, typename T>
+      size_t findString_(const C* other, size_t n, size_t start, size_t end,
+			 T*, std::false_type) const {
+	return findConvertedString_(other, n, start, end, (T*)0,
+				    IsWideningComparable_<C, T>());
+      }
+
+      template <typename C, typename T>
+      size_t findString_(const C* other, size_t n, size_t start, size_t end,
+			 T*, std::true_type) const {
+	const size_t p = detail::searchChars(begin_ + start, end - start,
+					     other, n);
+	return setNpos_(start + p, end);
+      }
+
+      /** @brief Convert other to this string's character type, then
+       *         search for it with the search kernels.
+       */
+      template <typename C, typename T>
+      size_t findConvertedString_(const C* other, size_t n, size_t start,
+				  size_t end, T*, std::true_type) const {
+	typedef typename detail::SearchUnitType<sizeof(Char)>::type Unit;
+	static constexpr const size_t MAX_LOCAL_SIZE = 64;
+	Unit local[MAX_LOCAL_SIZE];
+	std::unique_ptr<Unit[]> allocated(
+	    (n > MAX_LOCAL_SIZE) ? new Unit[n] : nullptr
+	);
+	Unit* const converted = allocated ? allocated.get() : local;
+
+	for (size_t i = 0; i < n; ++i) {
+	  const auto c = T::to_int_type(other[i]);
+	  if ((uint64_t)c > (uint64_t)std::numeric_limits<Unit>::max()) {
+	    // Too wide to equal any character in this string
+	    return NPOS;
 	  }
-	  return setNpos_(p, e);
+	  converted[i] = (Unit)c;
+	}
+	return findString_(converted, n, start, end,
+			   (std::char_traits<Char>*)0, std::true_type());
+      }
+
+      template <typename C, typename T>
+      size_t findConvertedString_(const C* other, size_t n, size_t start,
+				  size_t end, T*, std::false_type) const {
+	const size_t e = end - n + 1;
+	size_t p = findFirstChar_(begin_, *other, start, e, (T*)0);
+	while ((p < e) &&
+	       compareChars_(begin_ + p + 1, other + 1, n - 1, (T*)0)) {
+	  p = findFirstChar_(begin_, *other, p + 1, e, (T*)0);
 	}
+	return setNpos_(p, e);
       }
 
       template <typename C, typename T>
       static size_t findLastChar_(const Char* text, C c, size_t start,
 				  size_t end, T*) {
+	return findLastChar_(text, c, start, end, (T*)0,
+			     IsBitwiseComparable_<C, T>());
+      }
+
+      template <typename C, typename T>
+      static size_t findLastChar_(const Char* text, C c, size_t start,
+				  size_t end, T*, std::true_type) {
+	const size_t p = detail::findLastChar(text + start, end - start, c);
+	return (p < end - start) ? start + p : end;
+      }
+
+      template <typename C, typename T>
+      static size_t findLastChar_(const Char* text, C c, size_t start,
+				  size_t end, T*, std::false_type) {
 	static const IntTypeConverter<T> toInt;
 	const auto target = toInt(c, (T*)0);
 	size_t i = end;
@@ -1182,20 +2008,40 @@ namespace pistis {
       template <typename C, typename T>
       size_t findLast_(const C* other, size_t n, size_t start, size_t end,
 		       T*) const {
-	if (!n || (end < start) || ((end - start) < n)) {
+	const size_t e = std::min(end, size());
+	if (!n || (start > e) || ((e - start) < n)) {
 	  return NPOS;
 	} else if (n == 1) {
-	  const size_t e = std::min(end, size());
 	  return setNpos_(findLastChar_(begin_, *other, start, e, (T*)0), e);
 	} else {
-	  const size_t e = std::min(end, size()) - n + 1;
-	  size_t p = findLastChar_(begin_, *other, start, e, (T*)0);
-	  while ((p < e) &&
-		 compareChars_(begin_ + p + 1, other + 1, n - 1, (T*)0)) {
-	    p = findLastChar_(begin_, *other, start, p, (T*)0);
+	  return findLastString_(other, n, start, e, (T*)0,
+				 IsBitwiseComparable_<C, T>());
+	}
+      }
+
+      template <typename C, typename T>
+      size_t findLastString_(const C* other, size_t n, size_t start,
+			     size_t end, T*, std::true_type) const {
+	const size_t p = detail::reverseSearchChars(begin_ + start,
+						    end - start, other, n);
+	return setNpos_(start + p, end);
+      }
+
+      template <typename C, typename T>
+      size_t findLastString_(const C* other, size_t n, size_t start,
+			     size_t end, T*, std::false_type) const {
+	const size_t e = end - n + 1;
+	size_t p = findLastChar_(begin_, *other, start, e, (T*)0);
+	while ((p < e) &&
+	       compareChars_(begin_ + p + 1, other + 1, n - 1, (T*)0)) {
+	  // findLastChar_() returns its end, p, when it finds nothing
+	  const size_t q = findLastChar_(begin_, *other, start, p, (T*)0);
+	  if (q >= p) {
+	    return NPOS;
 	  }
-	  return setNpos_(p, e);
+	  p = q;
 	}
+	return setNpos_(p, e);
       }
 
       template <typename C, typename T>
@@ -1215,21 +2061,35 @@ namespace pistis {
       template <typename C, typename T>
       size_t findFirstOf_(const C* chars, size_t n, size_t start, size_t end,
 			  T*) const {
-	if (!n || (end < start)) {
+	const size_t e = std::min(end, size());
+	if (!n || (start >= e)) {
 	  return NPOS;
 	} else if (n == 1) {
-	  const size_t e = std::min(end, size());
 	  return setNpos_(findFirstChar_(begin_, *chars, start, e, (T*)0), e);
 	} else {
-	  const size_t e = std::min(end, size());
-	  const C* const endOfChars = chars + n;
-	  for (size_t i = start; i < e; ++i) {
-	    if (isInSet_(chars, endOfChars, begin_[i], (T*)0)) {
-	      return i;
-	    }
+	  return findFirstOf_(chars, n, start, e, (T*)0,
+			      IsBitwiseComparable_<C, T>());
+	}
+      }
+
+      template <typename C, typename T>
+      size_t findFirstOf_(const C* chars, size_t n, size_t start, size_t end,
+			  T*, std::true_type) const {
+	const size_t p = detail::findFirstOfChars(begin_ + start, end - start,
+						  chars, n);
+	return setNpos_(start + p, end);
+      }
+
+      template <typename C, typename T>
+      size_t findFirstOf_(const C* chars, size_t n, size_t start, size_t end,
+			  T*, std::false_type) const {
+	const C* const endOfChars = chars + n;
+	for (size_t i = start; i < end; ++i) {
+	  if (isInSet_(chars, endOfChars, begin_[i], (T*)0)) {
+	    return i;
 	  }
-	  return NPOS;
 	}
+	return NPOS;
       }
 
       template <typename C>
@@ -1241,21 +2101,35 @@ namespace pistis {
       template <typename C, typename T>
       size_t findLastOf_(const C* chars, size_t n, size_t start, size_t end,
 			 T*) const {
-	if (!n || (end < start)) {
+	const size_t e = std::min(end, size());
+	if (!n || (start >= e)) {
 	  return NPOS;
 	} else if (n == 1) {
-	  const size_t e = std::min(end, size());
-	  return setNpos_(findLastChar_(begin_, *chars, start, end, (T*)0), e);
+	  return setNpos_(findLastChar_(begin_, *chars, start, e, (T*)0), e);
 	} else {
-	  const size_t e = std::min(end, size());
-	  const C* const endOfChars = chars + n;
-	  for (size_t i = e; i > start; --i) {
-	    if (isInSet_(chars, endOfChars, begin_[i - 1], (T*)0)) {
-	      return i - 1;
-	    }
+	  return findLastOf_(chars, n, start, e, (T*)0,
+			     IsBitwiseComparable_<C, T>());
+	}
+      }
+
+      template <typename C, typename T>
+      size_t findLastOf_(const C* chars, size_t n, size_t start, size_t end,
+			 T*, std::true_type) const {
+	const size_t p = detail::findLastOfChars(begin_ + start, end - start,
+						 chars, n);
+	return setNpos_(start + p, end);
+      }
+
+      template <typename C, typename T>
+      size_t findLastOf_(const C* chars, size_t n, size_t start, size_t end,
+			 T*, std::false_type) const {
+	const C* const endOfChars = chars + n;
+	for (size_t i = end; i > start; --i) {
+	  if (isInSet_(chars, endOfChars, begin_[i - 1], (T*)0)) {
+	    return i - 1;
 	  }
-	  return NPOS;
 	}
+	return NPOS;
       }
 
       template <typename C>
@@ -1270,7 +2144,7 @@ namespace pistis {
 	ResultBuilder builder(size() + n, allocator());
 	const Char* const p = begin_ + pos;
 	return builder.append(begin_, p).append(text, text + n)
-	              .append(p, end_).done();
+	              .append(p, end_()).done();
       }
 
       template <typename C>
@@ -1283,7 +2157,7 @@ namespace pistis {
 	typedef typename StringBuilder<Char, CharTraits, C, T>::type
 	        ResultBuilder;
 	ResultBuilder builder(size() + n, allocator());
-	return builder.append(begin_, end_).append(text, text + n).done();
+	return builder.append(begin_, end_()).append(text, text + n).done();
       }
 
       template <typename C1, typename C2>
@@ -1300,20 +2174,171 @@ namespace pistis {
 		    T1*, T2*) const {
 	typedef typename StringBuilder<Char, CharTraits, C2, T2>::type
 	        ResultBuilder;
-	const C2* const replacementEnd = replacement + replacementSize;
-	ResultBuilder builder(size(), allocator());
+	typedef typename ResultBuilder::StringType ResultString;
+
+	// Find the matches first so the result can be allocated at its
+	// exact size.  The first few positions go on the stack.
+	static constexpr const size_t MAX_LOCAL_MATCHES = 32;
+	size_t local[MAX_LOCAL_MATCHES];
+	std::vector<size_t> more;
+	size_t numMatches = 0;
 	const size_t e = std::min(size(), end);
-	size_t last = std::min(start, e);
-	size_t p = find_(target, targetSize, last, e, (T1*)0);
+	for (size_t p = find_(target, targetSize, std::min(start, e), e,
+			      (T1*)0);
+	     p != NPOS;
+	     p = find_(target, targetSize, p + targetSize, e, (T1*)0)) {
+	  if (numMatches < MAX_LOCAL_MATCHES) {
+	    local[numMatches] = p;
+	  } else {
+	    more.push_back(p);
+	  }
+	  ++numMatches;
+	}
+	if (!numMatches) {
+	  return unchanged_((ResultString*)0);
+	}
 
-	builder.append(begin_, begin_ + last);
-	while (p != NPOS) {
+	const C2* const replacementEnd = replacement + replacementSize;
+	ResultBuilder builder(size() - numMatches * targetSize +
+			        numMatches * replacementSize,
+			      allocator());
+	size_t last = 0;
+	for (size_t i = 0; i < numMatches; ++i) {
+	  const size_t p = (i < MAX_LOCAL_MATCHES)
+	                       ? local[i] : more[i - MAX_LOCAL_MATCHES];
 	  builder.append(begin_ + last, begin_ + p)
 	         .append(replacement, replacementEnd);
 	  last = p + targetSize;
-	  p = find_(target, targetSize, last, e, (T1*)0);
 	}
-	return builder.append(begin_ + last, end_).done();
+	return builder.append(begin_ + last, end_()).done();
+      }
+
+      /** @brief Find the matches of target in each chunk of this string
+       *         in parallel.  See detail::findInChunks().
+       */
+      template <typename C, typename T>
+      std::vector< std::vector<size_t> > findInChunks_(
+	  const C* target, size_t n, const std::vector<size_t>& boundaries,
+	  T*
+      ) const {
+	return detail::findInChunks(
+	    boundaries, size(), n,
+	    [this, target, n](size_t start, size_t end) {
+	      return find_(target, n, start, end, (T*)0);
+	    }
+	);
+      }
+
+      std::vector<size_t> chunkBoundaries_(
+	  size_t patternSize, const IStringParallelism& parallelism
+      ) const {
+	return detail::chunkBoundaries(
+	    size(), parallelism.numChunks(size(), patternSize)
+	);
+      }
+
+      template <typename C>
+      ImmutableList<size_t> findAll_(
+	  const C* target, size_t n, const IStringParallelism& parallelism
+      ) const {
+	return findAll_(target, n, parallelism, (std::char_traits<C>*)0);
+      }
+
+      template <typename C, typename T>
+      ImmutableList<size_t> findAll_(
+	  const C* target, size_t n, const IStringParallelism& parallelism,
+	  T*
+      ) const {
+	const std::vector< std::vector<size_t> > matches =
+	    findInChunks_(target, n, chunkBoundaries_(n, parallelism),
+			  (T*)0);
+	std::vector<size_t> positions;
+	for (const auto& found : matches) {
+	  positions.insert(positions.end(), found.begin(), found.end());
+	}
+	return ImmutableList<size_t>(positions.begin(), positions.end());
+      }
+
+      template <typename C>
+      size_t count_(const C* target, size_t n,
+		    const IStringParallelism& parallelism) const {
+	return count_(target, n, parallelism, (std::char_traits<C>*)0);
+      }
+
+      template <typename C, typename T>
+      size_t count_(const C* target, size_t n,
+		    const IStringParallelism& parallelism, T*) const {
+	size_t numMatches = 0;
+	for (const auto& found :
+	         findInChunks_(target, n, chunkBoundaries_(n, parallelism),
+			       (T*)0)) {
+	  numMatches += found.size();
+	}
+	return numMatches;
+      }
+
+      template <typename C1, typename C2, typename T1>
+      ImmutableString replaceInChunks_(
+	  const C1* target, size_t targetSize, const C2* replacement,
+	  size_t replacementSize, const IStringParallelism& parallelism,
+	  T1*
+      ) const {
+	static_assert(sizeof(C2) <= sizeof(Char), "Char type too large");
+	const std::vector<size_t> boundaries =
+	    chunkBoundaries_(targetSize, parallelism);
+	const std::vector< std::vector<size_t> > matches =
+	    findInChunks_(target, targetSize, boundaries, (T1*)0);
+	const size_t numChunks = matches.size();
+
+	// Chunk i copies the characters in [from[i], from[i + 1]) to the
+	// result, starting at to[i].  A chunk starts copying after the
+	// end of any match that straddles its first character.
+	std::vector<size_t> from(numChunks + 1);
+	std::vector<size_t> to(numChunks + 1);
+	size_t numMatches = 0;
+	size_t lastEnd = 0;
+	for (size_t i = 0; i <= numChunks; ++i) {
+	  from[i] = (i < numChunks) ? std::max(boundaries[i], lastEnd)
+	                            : size();
+	  to[i] = from[i] - numMatches * targetSize +
+	          numMatches * replacementSize;
+	  if ((i < numChunks) && !matches[i].empty()) {
+	    numMatches += matches[i].size();
+	    lastEnd = matches[i].back() + targetSize;
+	  }
+	}
+	if (!numMatches) {
+	  return *this;
+	}
+
+	auto fill = [&](Char* chars) {
+	  detail::forEachChunk(numChunks, [&](size_t i) {
+	    Char* out = chars + to[i];
+	    size_t last = from[i];
+	    for (size_t p : matches[i]) {
+	      out = std::copy(begin_ + last, begin_ + p, out);
+	      out = std::copy(replacement, replacement + replacementSize,
+			      out);
+	      last = p + targetSize;
+	    }
+	    std::copy(begin_ + last, begin_ + from[i + 1], out);
+	  });
+	};
+	return generate_(to[numChunks], fill, allocator());
+      }
+
+      /** @brief Returns this string as a result of type ResultString
+       *         from an operation that changed nothing
+       */
+      const ImmutableString& unchanged_(ImmutableString*) const {
+	return *this;
+      }
+
+      template <typename ResultString>
+      ResultString unchanged_(ResultString*) const {
+	typedef typename ResultString::Builder ResultBuilder;
+	ResultBuilder builder(size(), allocator());
+	return builder.append(begin_, end_()).done();
       }
       
       template <typename C>
@@ -1349,7 +2374,7 @@ namespace pistis {
       template <typename C, typename T>
       bool endsWith_(const C* suffix, size_t suffixSize, T*) const {
 	return (suffixSize <= size()) &&
-	       !compareChars_(end_ - suffixSize, suffix, suffixSize, (T*)0);
+	       !compareChars_(end_() - suffixSize, suffix, suffixSize, (T*)0);
       }
 
       static size_t setNpos_(size_t x, size_t e) {
@@ -1361,20 +2386,205 @@ namespace pistis {
 	return p + std::char_traits<C>::length(p);
       }
 
+      bool isInline_() const { return begin_ == storage_.local.chars; }
+
+      const Char* end_() const { return begin_ + size(); }
+
+      /** @brief The text this string holds a reference to, if any */
+      detail::IStringText<Char>* text_() const {
+	return (!isInline_() && (storage_.remote.sizeAndFlags & OWNS_TEXT_))
+	           ? storage_.remote.text : nullptr;
+      }
+
+      /** @brief The text holding this string's characters, if any */
+      const detail::IStringText<Char>* ownerText_() const {
+	const detail::IStringText<Char>* const t = text_();
+	return t ? t->owner() : nullptr;
+      }
+
+      /** @brief Drop this string's reference to its text, if it has one.
+       *         Leaves the string's fields as they were.
+       */
+      void release_() {
+	if (detail::IStringText<Char>* const t = text_()) {
+	  // The temporary releases the reference when it is destroyed
+	  StringTextPtr::adopt(t, allocator());
+	}
+      }
+
+      /** @brief Make this string empty without releasing its text */
+      void clear_() {
+	begin_ = nullptr;
+	storage_.remote.text = nullptr;
+	storage_.remote.sizeAndFlags = 0;
+      }
+
+      void reset_() {
+	release_();
+	clear_();
+      }
+
+      /** @brief The set*_() functions below fill in an empty string */
+      template <typename Iterator>
+      void setInline_(size_t n, const Iterator& text) {
+	std::copy_n(text, n, storage_.local.chars);
+	storage_.local.size = (uint8_t)n;
+	begin_ = storage_.local.chars;
+      }
+
+      /** @brief Copy other's inline characters
+       *
+       *  Copies the whole buffer rather than other.size() characters, so
+       *  the length of the copy is a constant the compiler can see stays
+       *  within it.
+       */
+      template <typename OtherString>
+      void copyInline_(const OtherString& other) {
+	std::copy_n(other.storage_.local.chars, MAX_INLINE_SIZE,
+		    storage_.local.chars);
+	storage_.local.size = other.storage_.local.size;
+	begin_ = storage_.local.chars;
+      }
+
+      /** @brief Refer to n characters at begin, which text holds, and
+       *         take over text's reference
+       */
+      void setText_(StringTextPtr&& text, const Char* begin, size_t n) {
+	begin_ = begin;
+	storage_.remote.text = text.release();
+	storage_.remote.sizeAndFlags =
+	    n | (storage_.remote.text ? OWNS_TEXT_ : 0);
+      }
+
+      void setLiteral_(const Char* text, size_t n, size_t hashCode,
+		       bool hashKnown) {
+	begin_ = text;
+	storage_.remote.hashCode = hashCode;
+	storage_.remote.sizeAndFlags = n | (hashKnown ? HASH_KNOWN_ : 0);
+      }
+
+      /** @brief Copy n characters inline, or into a new text if there
+       *         are too many
+       */
       template <typename Iterator>
-      static StringTextPtr makeText_(size_t n, const Iterator& text,
-				     const Allocator& allocator) {
+      void setChars_(size_t n, const Iterator& text) {
 	static_assert(sizeof(decltype(*text)) <= sizeof(Char),
 		      "Char type is too big");
-	Allocator newAllocator(allocator);
-	return StringTextPtr::create(n, text, newAllocator);
+	if (n > MAX_INLINE_SIZE) {
+	  Char* chars;
+	  StringTextPtr t = StringTextPtr::create(n, allocator(), chars);
+	  std::copy_n(text, n, chars);
+	  setText_(std::move(t), chars, n);
+	} else if (n) {
+	  setInline_(n, text);
+	}
+      }
+
+      void copyFrom_(const ImmutableString& other) {
+	if (other.isInline_()) {
+	  copyInline_(other);
+	} else {
+	  begin_ = other.begin_;
+	  storage_.remote = other.storage_.remote;
+	  detail::IStringText<Char>::template addRef<
+	      typename StringTextPtr::RefCount
+	  >(text_());
+	}
+      }
+
+      /** @brief Take over other's characters and leave other empty */
+      void moveFrom_(ImmutableString& other) {
+	if (other.isInline_()) {
+	  copyInline_(other);
+	} else {
+	  begin_ = other.begin_;
+	  storage_.remote = other.storage_.remote;
+	}
+	other.clear_();
+      }
+
+      /** @brief Fill in this empty string from a string with another
+       *         reference counting policy
+       *
+       *  If movable is not null, it is other, and this string may take
+       *  over its reference to its text.
+       */
+      template <typename OtherAllocator>
+      void convertFrom_(
+	  const ImmutableString<Char, CharTraits, OtherAllocator>& other,
+	  ImmutableString<Char, CharTraits, OtherAllocator>* movable
+      ) {
+	typedef detail::IStringText<Char> Text;
+	Text* const t = other.text_();
+	const size_t n = other.size();
+
+	if (other.isInline_()) {
+	  copyInline_(other);
+	} else if (!t) {
+	  // Empty, or a literal
+	  begin_ = other.begin_;
+	  storage_.remote.hashCode = other.storage_.remote.hashCode;
+	  storage_.remote.sizeAndFlags = other.storage_.remote.sizeAndFlags;
+	} else if (t->borrowed()) {
+	  if (StringTextPtr::RefCount::THREAD_SAFE) {
+	    setText_(StringTextPtr(t->lender(), allocator()), other.begin_, n);
+	  } else {
+	    setText_(StringTextPtr::borrow(t->lender(), allocator()),
+		     other.begin_, n);
+	  }
+	} else if (movable && !t->interned() && Text::isUnique(t)) {
+	  setText_(StringTextPtr::adopt(t, allocator()), other.begin_, n);
+	  movable->clear_();
+	} else if (!StringTextPtr::RefCount::THREAD_SAFE) {
+	  setText_(StringTextPtr::borrow(t, allocator()), other.begin_, n);
+	} else {
+	  setChars_(n, other.data());
+	}
+      }
+
+      ImmutableString slice_(const Char* s, const Char* e) const {
+	// Short slices of inline or shared text are copied inline, which
+	// avoids touching the reference count and lets the slice outlive
+	// its (possibly much larger) parent without pinning it.
+	detail::IStringText<Char>* const t = text_();
+	const size_t n = e - s;
+	if (isInline_() || (t && (n <= MAX_INLINE_SIZE))) {
+	  // A slice of an inline string is never longer than the string,
+	  // but the compiler can only see that if the bound is explicit.
+	  ImmutableString slice(allocator());
+	  if (n) {
+	    slice.setInline_(std::min(n, MAX_INLINE_SIZE), s);
+	  }
+	  return slice;
+	} else if (!t) {
+	  return literal(s, n, allocator());
+	} else {
+	  return ImmutableString(StringTextPtr(t, allocator()), s, e);
+	}
       }
       
       friend class ImmutableStringBuilder<Char, CharTraits, Allocator>;
+
+      template <typename C, typename T, typename A>
+      friend class ImmutableString;
+
+      friend class IStringRetentionAudit;
     };
 
     template <typename C, typename T, typename A>
     const size_t ImmutableString<C, T, A>::NPOS;
+
+    template <typename C, typename T, typename A>
+    const size_t ImmutableString<C, T, A>::MAX_INLINE_SIZE;
+
+    template <typename C, typename T, typename A>
+    const size_t ImmutableString<C, T, A>::OWNS_TEXT_;
+
+    template <typename C, typename T, typename A>
+    const size_t ImmutableString<C, T, A>::HASH_KNOWN_;
+
+    template <typename C, typename T, typename A>
+    const size_t ImmutableString<C, T, A>::SIZE_MASK_;
     
     // Add missing + and relation ops
     template <typename C1, typename T1, typename A1,
@@ -1561,6 +2771,94 @@ namespace pistis {
     typedef ImmutableString<char16_t> U16_IString;
     typedef ImmutableString<char32_t> U32_IString;
 
+    /** @brief Strings that count references without atomic operations
+     *
+     *  Copying and destroying a LocalIString is cheaper than copying and
+     *  destroying an IString, but every LocalIString that shares a text
+     *  must stay on the thread that created it.  To pass one to another
+     *  thread, convert it to an IString with
+     *  IString(std::move(localString)).  LocalIString(sharedString)
+     *  gives a thread its own cheaply copied handle on an IString
+     *  without copying its characters.
+     */
+    typedef ImmutableString<char, std::char_traits<char>,
+			    LocalIStringAllocator<> > LocalIString;
+    typedef ImmutableString<wchar_t, std::char_traits<wchar_t>,
+			    LocalIStringAllocator<> > LocalWIString;
+    typedef ImmutableString<char16_t, std::char_traits<char16_t>,
+			    LocalIStringAllocator<> > LocalU16_IString;
+    typedef ImmutableString<char32_t, std::char_traits<char32_t>,
+			    LocalIStringAllocator<> > LocalU32_IString;
+
+    namespace detail {
+
+      /** @brief The characters of a string literal, and their hash code
+       *         computed at compile time
+       */
+      template <typename Char, Char... CHARS>
+      struct HashedIStringLiteral {
+	static constexpr Char TEXT[] = { CHARS..., Char(0) };
+	static constexpr size_t SIZE = sizeof...(CHARS);
+	static constexpr size_t HASH =
+	    DefaultIStringHasher().compute(TEXT, SIZE);
+      };
+
+      template <typename Char, Char... CHARS>
+      constexpr Char HashedIStringLiteral<Char, CHARS...>::TEXT[];
+
+      template <typename String, typename Char, Char... CHARS>
+      String hashedIStringLiteral() {
+	typedef HashedIStringLiteral<Char, CHARS...> Literal;
+	return String::hashedLiteral(Literal::TEXT, Literal::SIZE,
+				     Literal::HASH);
+      }
+    }
+
+    /** @def PISTIS_HASHED_ISTRING_LITERALS
+     *
+     *  Defined when _is and _wis are string literal operator templates
+     *  that compute the literal's hash code at compile time.  That form
+     *  is a GNU extension, which Clang deprecates, so it is only used
+     *  with GCC.  Elsewhere, or if PISTIS_NO_HASHED_ISTRING_LITERALS is
+     *  defined, _is and _wis are the standard (const Char*, size_t)
+     *  literal operators, which can also be called by name.  The two
+     *  forms cannot be declared together, since GCC prefers the standard
+     *  one.
+     */
+#if defined(__GNUC__) && !defined(__clang__) && \
+    !defined(PISTIS_NO_HASHED_ISTRING_LITERALS)
+#define PISTIS_HASHED_ISTRING_LITERALS 1
+#endif
+
+#ifdef PISTIS_HASHED_ISTRING_LITERALS
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+    /** @brief A literal IString whose hash code is computed at compile
+     *         time
+     *
+     *  The string refers to the literal's characters directly, and
+     *  hash() and std::hash return the precomputed code, so a literal
+     *  used as a key costs neither an allocation nor a hash.
+     */
+    template <typename Char, Char... CHARS>
+    inline IString operator ""_is() {
+      static_assert(std::is_same<Char, char>::value,
+		    "_is only applies to narrow string literals");
+      return detail::hashedIStringLiteral<IString, Char, CHARS...>();
+    }
+
+    /** @brief The wide counterpart of _is */
+    template <typename Char, Char... CHARS>
+    inline WIString operator ""_wis() {
+      static_assert(std::is_same<Char, wchar_t>::value,
+		    "_wis only applies to wide string literals");
+      return detail::hashedIStringLiteral<WIString, Char, CHARS...>();
+    }
+
+#pragma GCC diagnostic pop
+#else
+
     inline IString operator ""_is(const char* s, std::size_t n) {
       return IString::literal(s, n);
     }
@@ -1568,6 +2866,8 @@ namespace pistis {
     inline WIString operator ""_wis(const wchar_t* s, std::size_t n) {
       return WIString::literal(s, n);
     }
+
+#endif
   }
 }
 
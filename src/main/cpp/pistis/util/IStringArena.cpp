@@ -0,0 +1,82 @@
+#include "IStringArena.hpp"
+#include <algorithm>
+#include <new>
+
+using namespace pistis::util;
+
+constexpr const size_t IStringArena::ALIGNMENT;
+constexpr const size_t IStringArena::DEFAULT_BLOCK_SIZE;
+
+IStringArena::IStringArena(size_t blockSize):
+    blocks_(nullptr), top_(nullptr), end_(nullptr),
+    blockSize_(std::max(align_(blockSize), (size_t)4 * ALIGNMENT)),
+    allocated_(0), reserved_(0), numBlocks_(0) {
+}
+
+IStringArena::IStringArena(IStringArena&& other):
+    blocks_(other.blocks_), top_(other.top_), end_(other.end_),
+    blockSize_(other.blockSize_), allocated_(other.allocated_),
+    reserved_(other.reserved_), numBlocks_(other.numBlocks_) {
+  other.blocks_ = nullptr;
+  other.top_ = other.end_ = nullptr;
+  other.allocated_ = other.reserved_ = other.numBlocks_ = 0;
+}
+
+void IStringArena::release() {
+  while (blocks_) {
+    Block* const next = blocks_->next;
+    ::operator delete(blocks_);
+    blocks_ = next;
+  }
+  top_ = end_ = nullptr;
+  allocated_ = reserved_ = numBlocks_ = 0;
+}
+
+IStringArena& IStringArena::operator=(IStringArena&& other) {
+  if (this != &other) {
+    release();
+    blocks_ = other.blocks_;
+    top_ = other.top_;
+    end_ = other.end_;
+    blockSize_ = other.blockSize_;
+    allocated_ = other.allocated_;
+    reserved_ = other.reserved_;
+    numBlocks_ = other.numBlocks_;
+    other.blocks_ = nullptr;
+    other.top_ = other.end_ = nullptr;
+    other.allocated_ = other.reserved_ = other.numBlocks_ = 0;
+  }
+  return *this;
+}
+
+uint8_t* IStringArena::allocateSlow_(size_t n) {
+  if (n > blockSize_ / 4) {
+    // Give large requests a block of their own behind the current one,
+    // so the space left in the current block is not wasted.
+    Block* const block = newBlock_(n);
+    if (blocks_) {
+      block->next = blocks_->next;
+      blocks_->next = block;
+    } else {
+      block->next = nullptr;
+      blocks_ = block;
+    }
+    allocated_ += n;
+    return (uint8_t*)block + BLOCK_HEADER_SIZE;
+  }
+
+  Block* const block = newBlock_(blockSize_);
+  block->next = blocks_;
+  blocks_ = block;
+  top_ = (uint8_t*)block + BLOCK_HEADER_SIZE + n;
+  end_ = (uint8_t*)block + BLOCK_HEADER_SIZE + blockSize_;
+  allocated_ += n;
+  return (uint8_t*)block + BLOCK_HEADER_SIZE;
+}
+
+IStringArena::Block* IStringArena::newBlock_(size_t n) {
+  Block* const block = (Block*)::operator new(BLOCK_HEADER_SIZE + n);
+  reserved_ += n;
+  ++numBlocks_;
+  return block;
+}
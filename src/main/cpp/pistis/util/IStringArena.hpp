@@ -0,0 +1,219 @@
+#ifndef __PISTIS__UTIL__ISTRINGARENA_HPP__
+#define __PISTIS__UTIL__ISTRINGARENA_HPP__
+
+/** @file IStringArena.hpp
+ *
+ *  A bump-pointer arena for ImmutableStrings that all die together, such
+ *  as the strings made while parsing one request.  Allocating from the
+ *  arena is a pointer increment, deallocating is a no-op, and the arena
+ *  frees all of its memory at once when it is released or destroyed.
+ *  An ImmutableStringBuilder that uses the arena grows its buffer in
+ *  place and hands it to the string it builds without copying it.
+ *
+ *  An arena is not thread-safe.  It and every string allocated from it
+ *  belong to one thread, so the arena string types count references
+ *  without atomic operations, like LocalIString.
+ */
+
+#include <pistis/util/IString.hpp>
+#include <pistis/util/IStringBuilder.hpp>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace pistis {
+  namespace util {
+
+    /** @brief Bump-pointer memory for ImmutableStrings that die together
+     *
+     *  allocate() and resize() do no locking, so an arena must only be
+     *  used from one thread, along with every string and builder that
+     *  allocates from it.
+     */
+    class IStringArena {
+    public:
+      /** @brief Alignment of every allocation from the arena */
+      static constexpr const size_t ALIGNMENT = alignof(uint64_t);
+
+      /** @brief Size of the blocks the arena allocates by default */
+      static constexpr const size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+    public:
+      /** @brief Create an arena that allocates memory from the heap in
+       *         blocks of blockSize bytes.
+       *
+       *  The first block is allocated on first use.  Requests larger
+       *  than a quarter of blockSize get a block of their own.
+       */
+      explicit IStringArena(size_t blockSize = DEFAULT_BLOCK_SIZE);
+      IStringArena(const IStringArena&) = delete;
+      IStringArena(IStringArena&& other);
+      ~IStringArena() { release(); }
+
+      size_t blockSize() const { return blockSize_; }
+
+      /** @brief Bytes handed out since the arena was created or last
+       *         released
+       */
+      size_t bytesAllocated() const { return allocated_; }
+
+      /** @brief Bytes the arena holds in its blocks */
+      size_t bytesReserved() const { return reserved_; }
+
+      /** @brief Number of blocks the arena holds */
+      size_t numBlocks() const { return numBlocks_; }
+
+      uint8_t* allocate(size_t n) {
+	const size_t size = align_(n);
+	if (size <= (size_t)(end_ - top_)) {
+	  uint8_t* const p = top_;
+	  top_ += size;
+	  allocated_ += size;
+	  return p;
+	}
+	return allocateSlow_(size);
+      }
+
+      /** @brief Resize the most recent allocation, at p, from oldSize to
+       *         newSize bytes without moving it.
+       *
+       *  Returns false if p is not the most recent allocation or there is
+       *  not enough room left in its block.  Any allocation can shrink,
+       *  but only the most recent one gives its space back.
+       */
+      bool resize(uint8_t* p, size_t oldSize, size_t newSize) {
+	const size_t oldAligned = align_(oldSize);
+	const size_t newAligned = align_(newSize);
+	if ((p + oldAligned) != top_) {
+	  return newAligned <= oldAligned;
+	} else if (newAligned > oldAligned + (size_t)(end_ - top_)) {
+	  return false;
+	}
+	top_ = p + newAligned;
+	allocated_ = allocated_ + newAligned - oldAligned;
+	return true;
+      }
+
+      /** @brief Free every block the arena holds
+       *
+       *  Every string allocated from the arena must be destroyed first.
+       */
+      void release();
+
+      IStringArena& operator=(const IStringArena&) = delete;
+      IStringArena& operator=(IStringArena&& other);
+
+    private:
+      struct Block {
+	Block* next;
+      };
+
+      static constexpr const size_t BLOCK_HEADER_SIZE =
+	  (sizeof(Block) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+      Block* blocks_;
+      uint8_t* top_;
+      uint8_t* end_;
+      size_t blockSize_;
+      size_t allocated_;
+      size_t reserved_;
+      size_t numBlocks_;
+
+      static size_t align_(size_t n) {
+	return (n + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+      }
+
+      uint8_t* allocateSlow_(size_t n);
+      Block* newBlock_(size_t n);
+    };
+
+    /** @brief Allocator that draws from an IStringArena
+     *
+     *  An allocator that is not bound to an arena, such as the
+     *  default-constructed allocator strings use when none is given,
+     *  allocates from and frees to the heap like std::allocator.  Strings
+     *  that use an arena must be destroyed before the arena is released,
+     *  on the arena's thread.  The arena string types below wrap it in a
+     *  LocalIStringAllocator for that reason.
+     */
+    class IStringArenaAllocator {
+    public:
+      typedef uint8_t value_type;
+
+    public:
+      IStringArenaAllocator(): arena_(nullptr) { }
+      IStringArenaAllocator(IStringArena& arena): arena_(&arena) { }
+
+      IStringArena* arena() const { return arena_; }
+
+      uint8_t* allocate(size_t n) {
+	return arena_ ? arena_->allocate(n) : (uint8_t*)::operator new(n);
+      }
+
+      void deallocate(uint8_t* p, size_t) {
+	if (!arena_) {
+	  ::operator delete(p);
+	}
+      }
+
+      bool operator==(const IStringArenaAllocator& other) const {
+	return arena_ == other.arena_;
+      }
+
+      bool operator!=(const IStringArenaAllocator& other) const {
+	return arena_ != other.arena_;
+      }
+
+    private:
+      IStringArena* arena_;
+    };
+
+    namespace detail {
+      template <>
+      struct IStringAllocationTraits<IStringArenaAllocator> {
+	static constexpr const bool SCOPED = true;
+
+	static bool resize(IStringArenaAllocator& allocator, uint8_t* p,
+			   size_t oldSize, size_t newSize) {
+	  return allocator.arena() &&
+	         allocator.arena()->resize(p, oldSize, newSize);
+	}
+      };
+    }
+
+    /** @brief The allocator the arena string types use */
+    typedef LocalIStringAllocator<IStringArenaAllocator>
+            LocalIStringArenaAllocator;
+
+    /** @brief Strings allocated from an IStringArena
+     *
+     *  Construct them with an IStringArenaAllocator for the arena, e.g.
+     *  ArenaIString(text, IStringArenaAllocator(arena)).  Substrings and
+     *  strings from split() share their parent's text as usual.  Like
+     *  the arena itself, they must stay on the arena's thread, so they
+     *  count references without atomic operations.
+     */
+    typedef ImmutableString<char, std::char_traits<char>,
+			    LocalIStringArenaAllocator> ArenaIString;
+    typedef ImmutableString<wchar_t, std::char_traits<wchar_t>,
+			    LocalIStringArenaAllocator> ArenaWIString;
+    typedef ImmutableString<char16_t, std::char_traits<char16_t>,
+			    LocalIStringArenaAllocator> ArenaU16_IString;
+    typedef ImmutableString<char32_t, std::char_traits<char32_t>,
+			    LocalIStringArenaAllocator> ArenaU32_IString;
+
+    typedef ImmutableStringBuilder<char, std::char_traits<char>,
+				   LocalIStringArenaAllocator>
+            ArenaIStringBuilder;
+    typedef ImmutableStringBuilder<wchar_t, std::char_traits<wchar_t>,
+				   LocalIStringArenaAllocator>
+            ArenaWIStringBuilder;
+    typedef ImmutableStringBuilder<char16_t, std::char_traits<char16_t>,
+				   LocalIStringArenaAllocator>
+            ArenaU16_IStringBuilder;
+    typedef ImmutableStringBuilder<char32_t, std::char_traits<char32_t>,
+				   LocalIStringArenaAllocator>
+            ArenaU32_IStringBuilder;
+
+  }
+}
+#endif
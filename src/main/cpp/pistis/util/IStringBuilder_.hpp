@@ -40,11 +40,11 @@ namespace pistis {
 	  fieldPadding_(' ') {
       }
 
-      explicit ImmutableStringBuilder(uint32_t initialBufferSize,
+      explicit ImmutableStringBuilder(size_t initialBufferSize,
 				      const Allocator& allocator = Allocator()):
 	  text_(StringTextPtr::create(initialBufferSize, allocator)),
-	  end_(initialBufferSize ? text_->text : nullptr),
-	  eos_(initialBufferSize ? text_->text + text_->size : nullptr),
+	  end_(initialBufferSize ? text_->chars() : nullptr),
+	  eos_(initialBufferSize ? end_ + text_->numChars() : nullptr),
 	  flags_(DEFAULT_FORMAT_FLAGS_), fieldWidth_(0), fieldPrecision_(0),
 	  fieldPadding_(' ') {
       }
@@ -53,8 +53,8 @@ namespace pistis {
 
       const Allocator& allocator() const { return text_.allocator(); }
       Allocator& allocator() { return text_.allocator(); }
-      size_t allocated() const { return text_ ? eos_ - text_->text : 0; }
-      size_t size() const { return text_ ? end_ - text_->text : 0; }
+      size_t allocated() const { return text_ ? eos_ - text_->chars() : 0; }
+      size_t size() const { return text_ ? end_ - text_->chars() : 0; }
       
       template <typename C,
 		typename Enabled =
@@ -239,7 +239,7 @@ namespace pistis {
       
       void reset() {
 	resetFormat();
-	end_ = text_ ? text_->text : nullptr;
+	end_ = text_ ? text_->chars() : nullptr;
       }
 
       StringType done() {
@@ -292,7 +292,7 @@ namespace pistis {
       void increaseSize_(size_t minSize) {
 	static const size_t MIN_ALLOC_SIZE = 8;
 	static const size_t MAX_ALLOC_SIZE =
-	    std::numeric_limits<uint32_t>::max();
+	    std::numeric_limits<size_t>::max() / sizeof(Char) / 2;
 	if (minSize > MAX_ALLOC_SIZE) {
 	  throw std::bad_alloc();
 	} else if (allocated() < MAX_ALLOC_SIZE) {
@@ -302,12 +302,17 @@ namespace pistis {
 	    newSize = std::min(newSize << 1, MAX_ALLOC_SIZE);
 	  }
 
+	  if (text_.resize(newSize)) {
+	    eos_ = text_->chars() + newSize;
+	    return;
+	  }
+
 	  StringTextPtr newText = StringTextPtr::create(newSize, allocator());
 	  if (text_) {
-	    std::copy(text_->text, end_, newText->text);
+	    std::copy(text_->chars(), end_, newText->chars());
 	  }
-	  end_ = newText->text + size();
-	  eos_ = newText->text + newSize;
+	  end_ = newText->chars() + size();
+	  eos_ = newText->chars() + newSize;
 	  text_ = newText;
 	}
       }
@@ -315,10 +320,11 @@ namespace pistis {
       StringType makeString_() {
 	if (!text_) {
 	  return StringType(allocator());
-	} else if (end_ < eos_) {
-	  return StringType((Char*)(text_->text), end_, allocator());
+	} else if ((size() <= StringType::MAX_INLINE_SIZE) ||
+		   ((end_ < eos_) && !text_.resize(size()))) {
+	  return StringType((Char*)(text_->chars()), end_, allocator());
 	} else {
-	  return StringType(std::move(text_), text_->text, end_);
+	  return StringType(std::move(text_), text_->chars(), end_);
 	}
       }
 
@@ -0,0 +1,56 @@
+#ifndef __PISTIS__UTIL__ISTRINGCASEINSENSITIVE_HPP__
+#define __PISTIS__UTIL__ISTRINGCASEINSENSITIVE_HPP__
+
+/** @file IStringCaseInsensitive.hpp
+ *
+ *  Function objects for keying hash tables with ImmutableStrings whose
+ *  case does not matter, such as HTTP header names:
+ *
+ *  @code
+ *  std::unordered_map<IString, IString, CaseInsensitiveIStringHash,
+ *                     CaseInsensitiveIStringEqual> headers;
+ *  @endcode
+ *
+ *  Only the ASCII letters have case; see ImmutableString::toLower().
+ */
+
+#include <pistis/util/IString.hpp>
+#include <pistis/util/IStringHash.hpp>
+#include <stdint.h>
+
+namespace pistis {
+  namespace util {
+
+    /** @brief Hashes an ImmutableString ignoring the case of ASCII letters */
+    class CaseInsensitiveIStringHash {
+    public:
+      constexpr CaseInsensitiveIStringHash(uint64_t seed = 0):
+	  hasher_(seed) {
+      }
+
+      template <typename Char, typename CharTraits, typename Allocator>
+      size_t operator()(
+	  const ImmutableString<Char, CharTraits, Allocator>& s
+      ) const {
+	return s.hash(hasher_);
+      }
+
+    private:
+      CaseInsensitiveWyHasher hasher_;
+    };
+
+    /** @brief True if two ImmutableStrings differ at most in the case of
+     *         their ASCII letters
+     */
+    struct CaseInsensitiveIStringEqual {
+      template <typename Char, typename T1, typename A1, typename T2,
+		typename A2>
+      bool operator()(const ImmutableString<Char, T1, A1>& left,
+		      const ImmutableString<Char, T2, A2>& right) const {
+	return left.equalsIgnoreCase(right);
+      }
+    };
+
+  }
+}
+#endif
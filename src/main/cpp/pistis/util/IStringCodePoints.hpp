@@ -0,0 +1,167 @@
+#ifndef __PISTIS__UTIL__ISTRINGCODEPOINTS_HPP__
+#define __PISTIS__UTIL__ISTRINGCODEPOINTS_HPP__
+
+#include <pistis/exceptions/IllegalValueError.hpp>
+#include <pistis/util/IString.hpp>
+#include <pistis/util/detail/IStringUtf.hpp>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace pistis {
+  namespace util {
+
+    /** @brief A view of a UTF-8 ImmutableString as a sequence of code
+     *         points
+     *
+     *  ImmutableString's operator[], position() and substr() count code
+     *  units, so finding the nth code point of a UTF-8 string means
+     *  decoding everything before it.  This view records the byte offset
+     *  of every stride-th code point the first time it needs one, which
+     *  takes a single pass over the string.  After that, length() costs
+     *  O(1) and finding any code point costs at most stride steps, so
+     *  operator[], offsetOf() and substr() are O(1) amortized.  The index
+     *  takes one size_t per stride code points.
+     *
+     *  The view shares the string's text, and copies of a view share its
+     *  index.  Building the index is thread-safe.  The string should be
+     *  valid UTF-8 (see ImmutableString::isValidUtf()).  If it is not,
+     *  every byte that is not a continuation byte counts as the start of
+     *  a code point, and continuation bytes at the start of the string
+     *  count as code point 0, so offsetOf(0) is always 0.
+     */
+    template <typename Char, typename CharTraits = std::char_traits<Char>,
+	      typename Allocator = std::allocator<uint8_t> >
+    class ImmutableStringCodePoints {
+    public:
+      static_assert(sizeof(Char) == 1, "Only UTF-8 strings are supported");
+
+      typedef ImmutableString<Char, CharTraits, Allocator> StringType;
+
+      static constexpr const size_t NPOS = StringType::NPOS;
+      static constexpr const size_t DEFAULT_STRIDE = 64;
+
+      /** @brief View the code points of s
+       *
+       *  Throws IllegalValueError if stride is zero.
+       */
+      explicit ImmutableStringCodePoints(const StringType& s,
+					 size_t stride = DEFAULT_STRIDE):
+	  str_(s), stride_(stride), index_(std::make_shared<Index_>()) {
+	if (!stride) {
+	  throw exceptions::IllegalValueError("stride cannot be zero",
+					      PISTIS_EX_HERE);
+	}
+      }
+
+      const StringType& str() const { return str_; }
+      size_t stride() const { return stride_; }
+
+      /** @brief Number of code points in the string */
+      size_t length() const { return builtIndex_().length; }
+
+      /** @brief Byte offset of code point i, or the string's size if i
+       *         is not less than length()
+       */
+      size_t offsetOf(size_t i) const {
+	const Index_& index = builtIndex_();
+	if (i >= index.length) {
+	  return str_.size();
+	}
+	const uint8_t* const text = bytes_();
+	size_t p = index.offsets[i / stride_];
+	for (size_t k = i % stride_; k; --k) {
+	  p = nextCodePoint_(text, p);
+	}
+	return p;
+      }
+
+      /** @brief Index of the code point that contains the byte at
+       *         offset, or length() if offset is past the end of the
+       *         string
+       */
+      size_t indexOf(size_t offset) const {
+	const Index_& index = builtIndex_();
+	if (offset >= str_.size()) {
+	  return index.length;
+	}
+	// offsets[0] is 0, so some entry is at or before offset
+	const auto next = std::upper_bound(index.offsets.begin(),
+					   index.offsets.end(), offset);
+	const size_t k = next - index.offsets.begin() - 1;
+	const uint8_t* const text = bytes_();
+	size_t i = k * stride_;
+	for (size_t p = nextCodePoint_(text, index.offsets[k]); p <= offset;
+	     p = nextCodePoint_(text, p)) {
+	  ++i;
+	}
+	return i;
+      }
+
+      /** @brief Decode code point i, which must be less than length() */
+      char32_t operator[](size_t i) const {
+	const uint8_t* const text = bytes_();
+	const size_t p = offsetOf(i);
+	const size_t n = nextCodePoint_(text, p) - p;
+	uint32_t c = (n == 1) ? text[p] : (text[p] & (0x7F >> n));
+	for (size_t k = 1; k < n; ++k) {
+	  c = (c << 6) | (text[p + k] & 0x3F);
+	}
+	return (char32_t)c;
+      }
+
+      /** @brief The code points from start up to, but not including,
+       *         end.  Shares the string's text, just as
+       *         ImmutableString::substr() does.
+       */
+      StringType substr(size_t start, size_t end = NPOS) const {
+	const size_t e = offsetOf(end);
+	return str_.substr(std::min(offsetOf(start), e), e);
+      }
+
+    private:
+      struct Index_ {
+	std::once_flag built;
+	std::vector<size_t> offsets;
+	size_t length = 0;
+      };
+
+      StringType str_;
+      size_t stride_;
+      std::shared_ptr<Index_> index_;
+
+      const uint8_t* bytes_() const { return (const uint8_t*)str_.data(); }
+
+      const Index_& builtIndex_() const {
+	Index_& index = *index_;
+	std::call_once(index.built, [this, &index]() {
+	  index.length = detail::indexUtf8(bytes_(), str_.size(), stride_,
+					   index.offsets);
+	});
+	return index;
+      }
+
+      // Offset of the code point after the one at p
+      size_t nextCodePoint_(const uint8_t* text, size_t p) const {
+	const size_t n = str_.size();
+	do {
+	  ++p;
+	} while ((p < n) && ((text[p] & 0xC0) == 0x80));
+	return p;
+      }
+    };
+
+    template <typename C, typename T, typename A>
+    const size_t ImmutableStringCodePoints<C, T, A>::NPOS;
+
+    template <typename C, typename T, typename A>
+    const size_t ImmutableStringCodePoints<C, T, A>::DEFAULT_STRIDE;
+
+    typedef ImmutableStringCodePoints<char> IStringCodePoints;
+
+  }
+}
+#endif
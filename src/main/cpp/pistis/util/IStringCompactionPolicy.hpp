@@ -0,0 +1,45 @@
+#ifndef __PISTIS__UTIL__ISTRINGCOMPACTIONPOLICY_HPP__
+#define __PISTIS__UTIL__ISTRINGCOMPACTIONPOLICY_HPP__
+
+#include <stddef.h>
+
+namespace pistis {
+  namespace util {
+
+    /** @brief Decides when a substring should copy its characters
+     *         instead of keeping its parent's text alive
+     *
+     *  A substring shares its parent's text, so a ten-byte token cut
+     *  from a fifty-megabyte document pins the whole document.  A string
+     *  compacted under this policy copies itself into a text of its own
+     *  when it refers to no more than maxBytes bytes and to less than
+     *  maxFraction of the bytes its text pins.  Pass a policy to
+     *  ImmutableString::shrink(), substr(), split() or rsplit() to apply
+     *  it.  The default policy never compacts anything.
+     */
+    class IStringCompactionPolicy {
+    public:
+      IStringCompactionPolicy(): maxBytes_(0), maxFraction_(0.0) { }
+      IStringCompactionPolicy(size_t maxBytes, double maxFraction):
+	  maxBytes_(maxBytes), maxFraction_(maxFraction) {
+      }
+
+      size_t maxBytes() const { return maxBytes_; }
+      double maxFraction() const { return maxFraction_; }
+
+      /** @brief True if a string that refers to referenced bytes of a
+       *         text that pins pinned bytes should be copied
+       */
+      bool shouldCompact(size_t referenced, size_t pinned) const {
+	return (referenced <= maxBytes_) &&
+	       ((double)referenced < maxFraction_ * (double)pinned);
+      }
+
+    private:
+      size_t maxBytes_;
+      double maxFraction_;
+    };
+
+  }
+}
+#endif
@@ -0,0 +1,20 @@
+#include "IStringHash.hpp"
+#include <chrono>
+#include <random>
+
+namespace pistis {
+  namespace util {
+
+    uint64_t processHashSeed() {
+      static const uint64_t SEED = []() {
+	std::random_device rd;
+	uint64_t seed = ((uint64_t)rd() << 32) ^ rd();
+	// random_device may be deterministic on some platforms
+	return seed ^ (uint64_t)std::chrono::high_resolution_clock::now()
+	                            .time_since_epoch().count();
+      }();
+      return SEED;
+    }
+
+  }
+}
@@ -0,0 +1,339 @@
+#ifndef __PISTIS__UTIL__ISTRINGHASH_HPP__
+#define __PISTIS__UTIL__ISTRINGHASH_HPP__
+
+/** @file IStringHash.hpp
+ *
+ *  Hash policies for ImmutableString and C strings.  A hash policy is a
+ *  function object whose operator()(const Char* p, size_t n) returns the
+ *  hash code for the n characters starting at p.  The characters are
+ *  hashed as a sequence of code units, so strings with different
+ *  character types but the same content do not, in general, have the
+ *  same hash code.
+ */
+
+#include <pistis/util/detail/IStringCase.hpp>
+#include <type_traits>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace pistis {
+  namespace util {
+    namespace detail {
+
+      constexpr uint64_t WYHASH_SECRET_[4] = {
+	  0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+	  0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+      };
+
+      struct WyMultiply {
+	uint64_t low;
+	uint64_t high;
+
+	constexpr WyMultiply(uint64_t a, uint64_t b):
+	    low(multiplyLow_(a, b)), high(multiplyHigh_(a, b)) {
+	}
+
+      private:
+#ifdef __SIZEOF_INT128__
+	static constexpr uint64_t multiplyLow_(uint64_t a, uint64_t b) {
+	  return (uint64_t)((__uint128_t)a * b);
+	}
+
+	static constexpr uint64_t multiplyHigh_(uint64_t a, uint64_t b) {
+	  return (uint64_t)(((__uint128_t)a * b) >> 64);
+	}
+#else
+	static constexpr uint64_t multiplyLow_(uint64_t a, uint64_t b) {
+	  return a * b;
+	}
+
+	static constexpr uint64_t multiplyHigh_(uint64_t a, uint64_t b) {
+	  const uint64_t aLow = (uint32_t)a, aHigh = a >> 32;
+	  const uint64_t bLow = (uint32_t)b, bHigh = b >> 32;
+	  const uint64_t cross = (aLow * bLow >> 32) + (uint32_t)(aHigh * bLow)
+	                         + aLow * bHigh;
+	  return aHigh * bHigh + (aHigh * bLow >> 32) + (cross >> 32);
+	}
+#endif
+      };
+
+      constexpr uint64_t wyMix(uint64_t a, uint64_t b) {
+	return WyMultiply(a, b).low ^ WyMultiply(a, b).high;
+      }
+
+      /** @brief Reads the code units of a string as little-endian bytes
+       *         one at a time.  Usable in constant expressions.
+       */
+      template <typename Char>
+      struct WyCharReader {
+	typedef typename std::make_unsigned<Char>::type UChar;
+	const Char* p;
+
+	constexpr uint64_t byte(size_t i) const {
+	  return ((uint64_t)(UChar)p[i / sizeof(Char)] >>
+		  (8 * (i % sizeof(Char)))) & 0xFF;
+	}
+
+	constexpr uint64_t r4(size_t i) const {
+	  return byte(i) | (byte(i + 1) << 8) | (byte(i + 2) << 16) |
+	         (byte(i + 3) << 24);
+	}
+
+	constexpr uint64_t r8(size_t i) const { return r4(i) | (r4(i + 4) << 32); }
+      };
+
+      /** @brief Reads a string's bytes a word at a time.  Only agrees with
+       *         WyCharReader on little-endian machines.
+       */
+      struct WyMemoryReader {
+	const uint8_t* p;
+
+	uint64_t byte(size_t i) const { return p[i]; }
+
+	uint64_t r4(size_t i) const {
+	  uint32_t v;
+	  ::memcpy(&v, p + i, sizeof(v));
+	  return v;
+	}
+
+	uint64_t r8(size_t i) const {
+	  uint64_t v;
+	  ::memcpy(&v, p + i, sizeof(v));
+	  return v;
+	}
+      };
+
+      /** @brief Like WyCharReader, but reads each code unit as if it had
+       *         been folded to lower case with foldAsciiCase()
+       */
+      template <typename Char>
+      struct WyFoldingCharReader {
+	typedef typename std::make_unsigned<Char>::type UChar;
+	const Char* p;
+
+	constexpr uint64_t byte(size_t i) const {
+	  return ((uint64_t)foldAsciiCase((UChar)p[i / sizeof(Char)]) >>
+		  (8 * (i % sizeof(Char)))) & 0xFF;
+	}
+
+	constexpr uint64_t r4(size_t i) const {
+	  return byte(i) | (byte(i + 1) << 8) | (byte(i + 2) << 16) |
+	         (byte(i + 3) << 24);
+	}
+
+	constexpr uint64_t r8(size_t i) const { return r4(i) | (r4(i + 4) << 32); }
+      };
+
+      /** @brief Fold the ASCII capitals in each UNIT_SIZE-byte lane of x
+       *         to lower case, without branches.
+       *
+       *  The top bit of a lane's low bits plus HIGH - 'A' is set when the
+       *  lane is at least 'A', and that of its low bits plus HIGH - 'Z' - 1
+       *  is set when it is past 'Z'.  Lanes with their own top bit set are
+       *  not ASCII.  The sums never carry into the next lane.
+       */
+      template <size_t UNIT_SIZE>
+      inline uint64_t foldAsciiCaseInWord(uint64_t x) {
+	constexpr size_t BITS = 8 * UNIT_SIZE;
+	constexpr uint64_t ONES = ~0ull / ((BITS < 64) ? ((1ull << BITS) - 1)
+					                 : ~0ull);
+	constexpr uint64_t HIGH = ONES << (BITS - 1);
+	constexpr uint64_t LANE_HIGH = 1ull << (BITS - 1);
+	const uint64_t low = x & ~HIGH;
+	const uint64_t upper = (low + ONES * (LANE_HIGH - 'A')) &
+	                       ~(low + ONES * (LANE_HIGH - 'Z' - 1)) & ~x & HIGH;
+	return x | (upper >> (BITS - 6));
+      }
+
+      /** @brief Like WyMemoryReader, but folds the ASCII capitals among
+       *         its UNIT_SIZE-byte code units to lower case.
+       *
+       *  wyHash() only reads words at multiples of the unit size when the
+       *  length is a multiple of it, so lanes always line up with units.
+       */
+      template <size_t UNIT_SIZE>
+      struct WyFoldingMemoryReader {
+	const uint8_t* p;
+
+	uint64_t byte(size_t i) const {
+	  const size_t offset = i % UNIT_SIZE;
+	  return (unit_(i - offset) >> (8 * offset)) & 0xFF;
+	}
+
+	uint64_t r4(size_t i) const {
+	  uint32_t v;
+	  ::memcpy(&v, p + i, sizeof(v));
+	  return foldAsciiCaseInWord<UNIT_SIZE>(v);
+	}
+
+	uint64_t r8(size_t i) const {
+	  uint64_t v;
+	  ::memcpy(&v, p + i, sizeof(v));
+	  return foldAsciiCaseInWord<UNIT_SIZE>(v);
+	}
+
+      private:
+	uint64_t unit_(size_t i) const {
+	  uint64_t v = 0;
+	  ::memcpy(&v, p + i, UNIT_SIZE);
+	  return foldAsciiCaseInWord<UNIT_SIZE>(v);
+	}
+      };
+
+      /** @brief wyhash (version 4) of the len bytes read by reader */
+      template <typename Reader>
+      constexpr uint64_t wyHash(const Reader& reader, size_t len,
+				uint64_t seed) {
+	const uint64_t* const secret = WYHASH_SECRET_;
+	uint64_t a = 0, b = 0;
+	size_t p = 0;
+
+	seed ^= wyMix(seed ^ secret[0], secret[1]);
+	if (len <= 16) {
+	  if (len >= 4) {
+	    a = (reader.r4(0) << 32) | reader.r4((len >> 3) << 2);
+	    b = (reader.r4(len - 4) << 32) |
+	        reader.r4(len - 4 - ((len >> 3) << 2));
+	  } else if (len > 0) {
+	    a = (reader.byte(0) << 16) | (reader.byte(len >> 1) << 8) |
+	        reader.byte(len - 1);
+	  }
+	} else {
+	  size_t i = len;
+	  if (i >= 48) {
+	    uint64_t see1 = seed, see2 = seed;
+	    do {
+	      seed = wyMix(reader.r8(p) ^ secret[1], reader.r8(p + 8) ^ seed);
+	      see1 = wyMix(reader.r8(p + 16) ^ secret[2],
+			   reader.r8(p + 24) ^ see1);
+	      see2 = wyMix(reader.r8(p + 32) ^ secret[3],
+			   reader.r8(p + 40) ^ see2);
+	      p += 48;
+	      i -= 48;
+	    } while (i >= 48);
+	    seed ^= see1 ^ see2;
+	  }
+	  while (i > 16) {
+	    seed = wyMix(reader.r8(p) ^ secret[1], reader.r8(p + 8) ^ seed);
+	    i -= 16;
+	    p += 16;
+	  }
+	  a = reader.r8(p + i - 16);
+	  b = reader.r8(p + i - 8);
+	}
+
+	const WyMultiply ab(a ^ secret[1], b ^ seed);
+	return wyMix(ab.low ^ secret[0] ^ len, ab.high ^ secret[1]);
+      }
+    }
+
+    /** @brief The djb2 hash, one character at a time.
+     *
+     *  This was the only hash ImmutableString and CStringHasher used
+     *  before hash policies were introduced, and it remains available
+     *  for hash codes that have to stay stable.
+     */
+    struct Djb2Hasher {
+      template <typename Char>
+      constexpr size_t operator()(const Char* p, size_t n) const {
+	size_t h = 5381;
+	for (size_t i = 0; i < n; ++i) {
+	  h = (h << 5) + h + (size_t)p[i];
+	}
+	return h;
+      }
+    };
+
+    /** @brief A 64-bit wyhash, computed eight bytes at a time.
+     *
+     *  Much faster than djb2 on long strings and much better distributed
+     *  over the low bits that power-of-two tables use.  The seed selects
+     *  one of a family of hash functions; see SeededWyHasher for hashing
+     *  untrusted keys.  compute() can be evaluated at compile time and
+     *  always returns the same value as operator().
+     */
+    class WyHasher {
+    public:
+      constexpr WyHasher(uint64_t seed = 0): seed_(seed) { }
+
+      constexpr uint64_t seed() const { return seed_; }
+
+      template <typename Char>
+      size_t operator()(const Char* p, size_t n) const {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+	return detail::wyHash(detail::WyMemoryReader{ (const uint8_t*)p },
+			      n * sizeof(Char), seed_);
+#else
+	return compute(p, n);
+#endif
+      }
+
+      template <typename Char>
+      constexpr size_t compute(const Char* p, size_t n) const {
+	return detail::wyHash(detail::WyCharReader<Char>{ p },
+			      n * sizeof(Char), seed_);
+      }
+
+    private:
+      uint64_t seed_;
+    };
+
+    /** @brief A WyHasher that ignores the case of ASCII letters
+     *
+     *  Strings that differ only in the case of the letters A-Z hash to
+     *  the same value, which is WyHasher(seed) applied to the string
+     *  folded to lower case.  The folding happens a word at a time as
+     *  the hash reads the string, so nothing is copied.  Use it with
+     *  CaseInsensitiveIStringEqual.
+     */
+    class CaseInsensitiveWyHasher {
+    public:
+      constexpr CaseInsensitiveWyHasher(uint64_t seed = 0): seed_(seed) { }
+
+      constexpr uint64_t seed() const { return seed_; }
+
+      template <typename Char>
+      size_t operator()(const Char* p, size_t n) const {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+	return detail::wyHash(
+	    detail::WyFoldingMemoryReader<sizeof(Char)>{ (const uint8_t*)p },
+	    n * sizeof(Char), seed_
+	);
+#else
+	return compute(p, n);
+#endif
+      }
+
+      template <typename Char>
+      constexpr size_t compute(const Char* p, size_t n) const {
+	return detail::wyHash(detail::WyFoldingCharReader<Char>{ p },
+			      n * sizeof(Char), seed_);
+      }
+
+    private:
+      uint64_t seed_;
+    };
+
+    /** @brief Seed chosen at random once per process */
+    uint64_t processHashSeed();
+
+    /** @brief A WyHasher seeded with processHashSeed()
+     *
+     *  Keys crafted to collide under one process's hash will not collide
+     *  in another, which protects tables keyed by untrusted input from
+     *  hash flooding.  Hash codes are not stable between processes.
+     */
+    class SeededWyHasher : public WyHasher {
+    public:
+      SeededWyHasher(): WyHasher(processHashSeed()) { }
+    };
+
+    /** @brief The hash policy behind ImmutableString::hash() and
+     *         std::hash<ImmutableString>
+     */
+    typedef WyHasher DefaultIStringHasher;
+
+  }
+}
+#endif
@@ -0,0 +1,56 @@
+#ifndef __PISTIS__UTIL__ISTRINGPARALLELISM_HPP__
+#define __PISTIS__UTIL__ISTRINGPARALLELISM_HPP__
+
+#include <algorithm>
+#include <thread>
+#include <stddef.h>
+
+namespace pistis {
+  namespace util {
+
+    /** @brief Decides how many threads a parallel search or replace uses
+     *
+     *  Pass a parallelism to ImmutableString::findAll(), count(),
+     *  replace() or remove() to split the string into chunks and search
+     *  them at once.  The string is split into at most numThreads()
+     *  chunks of at least minChunkSize() characters, so short strings
+     *  are still searched on the calling thread alone.  A numThreads of
+     *  zero means one thread per hardware thread.
+     */
+    class IStringParallelism {
+    public:
+      static constexpr const size_t DEFAULT_MIN_CHUNK_SIZE = 1 << 20;
+
+    public:
+      explicit IStringParallelism(
+	  size_t numThreads = 0,
+	  size_t minChunkSize = DEFAULT_MIN_CHUNK_SIZE
+      ):
+	  numThreads_(numThreads ? numThreads
+		                 : std::max(std::thread::hardware_concurrency(),
+					    1u)),
+	  minChunkSize_(std::max(minChunkSize, (size_t)1)) {
+      }
+
+      size_t numThreads() const { return numThreads_; }
+      size_t minChunkSize() const { return minChunkSize_; }
+
+      /** @brief Number of chunks to split n characters into when
+       *         looking for a pattern of patternSize characters
+       *
+       *  Every chunk is at least as long as the pattern, so a match can
+       *  only straddle the boundary between two neighboring chunks.
+       */
+      size_t numChunks(size_t n, size_t patternSize) const {
+	const size_t chunkSize = std::max(minChunkSize_, patternSize);
+	return std::max(std::min(numThreads_, n / chunkSize), (size_t)1);
+      }
+
+    private:
+      size_t numThreads_;
+      size_t minChunkSize_;
+    };
+
+  }
+}
+#endif
@@ -0,0 +1,505 @@
+#ifndef __PISTIS__UTIL__ISTRINGPATTERNSET_HPP__
+#define __PISTIS__UTIL__ISTRINGPATTERNSET_HPP__
+
+#include <pistis/exceptions/IllegalValueError.hpp>
+#include <pistis/util/detail/IStringSearch.hpp>
+#include <algorithm>
+#include <initializer_list>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace pistis {
+  namespace util {
+
+    /** @brief A set of patterns compiled into an Aho-Corasick automaton,
+     *         with an optional replacement for each one
+     *
+     *  Pass a pattern set to ImmutableString::findAny() or replaceAll()
+     *  to look for, or replace, all of its patterns in one pass over the
+     *  string.  Compiling the set is much more expensive than using it,
+     *  so build it once and reuse it.  A pattern set is immutable, so
+     *  any number of threads can use it at once.
+     *
+     *  Matches are leftmost-longest and do not overlap: of the matches
+     *  that start earliest, the longest one wins, and scanning resumes
+     *  after its last character.  If the same pattern appears more than
+     *  once, the first occurrence and its replacement are used.
+     *  Patterns match code units exactly; character traits play no part.
+     *
+     *  The automaton is a dense transition table with one row per prefix
+     *  of a pattern and one column per distinct character that appears
+     *  in the patterns, so its size grows with the product of the two.
+     *
+     *  Each pattern also contributes the rarest of its first few
+     *  characters, judged by how often they appear in English text and
+     *  machine-generated logs.  When there are only a few of these, the
+     *  scan skips ahead to the next one with the same vectorized kernels
+     *  as ImmutableString::findFirstOf(), and only runs the automaton
+     *  near it.  If the skips turn out to be short, the scan stops
+     *  making them.
+     */
+    template <typename Char>
+    class ImmutableStringPatternSet {
+    public:
+      typedef Char CharType;
+      typedef std::basic_string<Char> PatternType;
+
+      /** @brief A match found by find() or forEachMatch() */
+      struct Match {
+	/** @brief Offset of the first character of the match */
+	size_t position;
+
+	/** @brief Length of the match */
+	size_t length;
+
+	/** @brief Index of the pattern that matched */
+	size_t pattern;
+      };
+
+      /** @brief Most distinct rare characters the scan will skip to */
+      static constexpr const size_t MAX_PREFILTER_UNITS = 16;
+
+      /** @brief How far into a pattern to look for its rarest character
+       */
+      static constexpr const size_t MAX_RARE_UNIT_OFFSET = 4;
+
+    public:
+      /** @brief Compile patterns that have no replacement
+       *
+       *  Each element of patterns is a pattern, given as a
+       *  null-terminated string or anything with data() and size().
+       *  replaceAll() removes the patterns of a set created this way.
+       *
+       *  @throws IllegalValueError if any pattern is empty
+       */
+      ImmutableStringPatternSet(std::initializer_list<const Char*> patterns):
+	  ImmutableStringPatternSet(patterns.begin(), patterns.end()) {
+      }
+
+      /** @brief Compile patterns with replacements
+       *
+       *  Each element of mapping pairs a pattern with its replacement.
+       *
+       *  @throws IllegalValueError if any pattern is empty
+       */
+      ImmutableStringPatternSet(
+	  std::initializer_list< std::pair<const Char*, const Char*> >
+	      mapping):
+	  ImmutableStringPatternSet(mapping.begin(), mapping.end()) {
+      }
+
+      /** @brief Compile the patterns in a container
+       *
+       *  The elements of c may be patterns, as for the initializer list
+       *  constructor, or pairs of a pattern and its replacement, such as
+       *  the elements of a std::map.
+       *
+       *  @throws IllegalValueError if any pattern is empty
+       */
+      template <typename Container>
+      explicit ImmutableStringPatternSet(const Container& c):
+	  ImmutableStringPatternSet(c.begin(), c.end()) {
+      }
+
+      template <typename Iterator>
+      ImmutableStringPatternSet(Iterator begin, Iterator end):
+	  patterns_(), replacements_(), lowClasses_(), highUnits_(),
+	  numClasses_(1), rowSize_(0), table_(),
+	  rareUnits_(nullptr, 0), maxRareUnitOffset_(0), prefilter_(false) {
+	for (Iterator i = begin; i != end; ++i) {
+	  add_(*i);
+	}
+	compile_();
+      }
+
+      /** @brief Number of patterns in the set */
+      size_t size() const { return patterns_.size(); }
+
+      /** @brief Number of states in the automaton */
+      size_t numStates() const { return table_.size() / rowSize_; }
+
+      const PatternType& pattern(size_t i) const { return patterns_[i]; }
+
+      /** @brief The replacement for pattern i, which is empty if the set
+       *         was created without replacements
+       */
+      const PatternType& replacement(size_t i) const {
+	return replacements_[i];
+      }
+
+      /** @brief True if the scan skips ahead to the rare characters in
+       *         the patterns
+       */
+      bool prefiltered() const { return prefilter_; }
+
+      /** @brief Find the first match in the n characters that start at
+       *         text
+       *
+       *  @returns  True if there was a match, in which case it is stored
+       *            in match
+       */
+      bool find(const Char* text, size_t n, Match& match) const {
+	bool found = false;
+	scan_((const Unit*)text, n, [&match, &found](const Match& m) {
+	  match = m;
+	  found = true;
+	  return false;
+	});
+	return found;
+      }
+
+      /** @brief Call f(match) for every match in the n characters that
+       *         start at text, from left to right
+       */
+      template <typename Function>
+      void forEachMatch(const Char* text, size_t n, Function f) const {
+	scan_((const Unit*)text, n, [&f](const Match& m) {
+	  f(m);
+	  return true;
+	});
+      }
+
+    private:
+      typedef typename detail::SearchUnitType<sizeof(Char)>::type Unit;
+      typedef typename detail::SearchUnitSet<Unit>::type RareUnitSet;
+
+      static constexpr const size_t NO_MATCH_ =
+	  std::numeric_limits<size_t>::max();
+      static constexpr const uint32_t NO_PATTERN_ =
+	  std::numeric_limits<uint32_t>::max();
+
+      // Each row of the table starts with a header that describes its
+      // state, followed by its transitions
+      static constexpr const uint32_t DEPTH_ = 0;
+      static constexpr const uint32_t MATCH_LENGTH_ = 1;
+      static constexpr const uint32_t PATTERN_ = 2;
+      static constexpr const uint32_t ROW_HEADER_SIZE_ = 3;
+
+      static constexpr const size_t PREFILTER_TRIAL_SKIPS_ = 32;
+      static constexpr const size_t PREFILTER_MIN_SKIP_ = 16;
+
+      std::vector<PatternType> patterns_;
+      std::vector<PatternType> replacements_;
+
+      // Characters in the patterns are numbered from 1 to
+      // numClasses_ - 1.  Every other character is class 0.  Units below
+      // 256 are looked up in lowClasses_, and the rest are found in
+      // highUnits_, which is sorted, with their classes in highClasses_.
+      uint32_t lowClasses_[256];
+      std::vector<Unit> highUnits_;
+      std::vector<uint32_t> highClasses_;
+      uint32_t numClasses_;
+
+      // One row of rowSize_ entries per state.  A transition is the
+      // offset of the next state's transitions in table_, so the scan
+      // needs no multiplication to follow it.
+      uint32_t rowSize_;
+      std::vector<uint32_t> table_;
+      // Every match contains one of rareUnits_ no more than
+      // maxRareUnitOffset_ characters after it starts
+      RareUnitSet rareUnits_;
+      size_t maxRareUnitOffset_;
+      bool prefilter_;
+
+      static PatternType toPattern_(const Char* s) { return PatternType(s); }
+
+      template <typename S>
+      static PatternType toPattern_(const S& s) {
+	return PatternType(s.data(), s.data() + s.size());
+      }
+
+      void add_(const Char* pattern) {
+	add_(toPattern_(pattern), PatternType());
+      }
+
+      template <typename S>
+      void add_(const S& pattern) {
+	add_(toPattern_(pattern), PatternType());
+      }
+
+      template <typename K, typename V>
+      void add_(const std::pair<K, V>& entry) {
+	add_(toPattern_(entry.first), toPattern_(entry.second));
+      }
+
+      void add_(PatternType&& pattern, PatternType&& replacement) {
+	if (pattern.empty()) {
+	  throw exceptions::IllegalValueError("Pattern is empty",
+					      PISTIS_EX_HERE);
+	}
+	patterns_.push_back(std::move(pattern));
+	replacements_.push_back(std::move(replacement));
+      }
+
+      uint32_t classOf_(Unit c) const {
+	if (c < 256) {
+	  return lowClasses_[c];
+	}
+	auto i = std::lower_bound(highUnits_.begin(), highUnits_.end(), c);
+	return ((i != highUnits_.end()) && (*i == c))
+	           ? highClasses_[i - highUnits_.begin()] : 0;
+      }
+
+      void compile_() {
+	// Number the characters that appear in the patterns
+	std::fill(lowClasses_, lowClasses_ + 256, 0);
+	for (const PatternType& p : patterns_) {
+	  for (Char c : p) {
+	    const Unit u = (Unit)c;
+	    if (u < 256) {
+	      lowClasses_[u] = 1;
+	    } else {
+	      highUnits_.push_back(u);
+	    }
+	  }
+	}
+	for (uint32_t u = 0; u < 256; ++u) {
+	  if (lowClasses_[u]) {
+	    lowClasses_[u] = numClasses_++;
+	  }
+	}
+	std::sort(highUnits_.begin(), highUnits_.end());
+	highUnits_.erase(std::unique(highUnits_.begin(), highUnits_.end()),
+			 highUnits_.end());
+	for (size_t i = 0; i < highUnits_.size(); ++i) {
+	  highClasses_.push_back(numClasses_++);
+	}
+
+	// Build the trie.  goTo[s * numClasses_ + c] is the state that
+	// follows state s on a character of class c, or zero if there is
+	// none.
+	std::vector<uint32_t> goTo(numClasses_, 0);
+	std::vector<uint32_t> depth(1, 0);
+	std::vector<uint32_t> matched(1, NO_PATTERN_);
+	for (uint32_t i = 0; i < patterns_.size(); ++i) {
+	  uint32_t s = 0;
+	  for (Char c : patterns_[i]) {
+	    const size_t t = (size_t)s * numClasses_ + classOf_((Unit)c);
+	    if (!goTo[t]) {
+	      goTo[t] = (uint32_t)depth.size();
+	      depth.push_back(depth[s] + 1);
+	      matched.push_back(NO_PATTERN_);
+	      goTo.resize(goTo.size() + numClasses_, 0);
+	    }
+	    s = goTo[t];
+	  }
+	  if (matched[s] == NO_PATTERN_) {
+	    matched[s] = i;
+	  }
+	}
+
+	// Fill in the missing transitions breadth-first from the failure
+	// links, so the scan takes exactly one step per character.  A
+	// state that matches no pattern inherits the match of its failure
+	// state, which is the longest match that ends at the same
+	// character.
+	const size_t numStates = depth.size();
+	std::vector<uint32_t> fail(numStates, 0);
+	std::vector<uint32_t> queue;
+	queue.reserve(numStates);
+	for (uint32_t c = 0; c < numClasses_; ++c) {
+	  if (goTo[c]) {
+	    queue.push_back(goTo[c]);
+	  }
+	}
+	for (size_t q = 0; q < queue.size(); ++q) {
+	  const uint32_t s = queue[q];
+	  if (matched[s] == NO_PATTERN_) {
+	    matched[s] = matched[fail[s]];
+	  }
+	  uint32_t* const row = &goTo[(size_t)s * numClasses_];
+	  const uint32_t* const failRow = &goTo[(size_t)fail[s] * numClasses_];
+	  for (uint32_t c = 0; c < numClasses_; ++c) {
+	    if (row[c]) {
+	      fail[row[c]] = failRow[c];
+	      queue.push_back(row[c]);
+	    } else {
+	      row[c] = failRow[c];
+	    }
+	  }
+	}
+
+	// Lay out the table the scan uses
+	rowSize_ = ROW_HEADER_SIZE_ + numClasses_;
+	if (numStates * rowSize_ > std::numeric_limits<uint32_t>::max()) {
+	  throw exceptions::IllegalValueError("Too many patterns",
+					      PISTIS_EX_HERE);
+	}
+	table_.resize(numStates * rowSize_);
+	for (size_t s = 0; s < numStates; ++s) {
+	  uint32_t* const row = &table_[s * rowSize_];
+	  row[DEPTH_] = depth[s];
+	  if (matched[s] == NO_PATTERN_) {
+	    row[MATCH_LENGTH_] = 0;
+	    row[PATTERN_] = 0;
+	  } else {
+	    row[MATCH_LENGTH_] = (uint32_t)patterns_[matched[s]].size();
+	    row[PATTERN_] = matched[s];
+	  }
+	  for (uint32_t c = 0; c < numClasses_; ++c) {
+	    row[ROW_HEADER_SIZE_ + c] =
+	        goTo[s * numClasses_ + c] * rowSize_ + ROW_HEADER_SIZE_;
+	  }
+	}
+
+	// Choose the rare characters
+	std::vector<Unit> rareUnits;
+	for (const PatternType& p : patterns_) {
+	  const size_t n = std::min(p.size(), MAX_RARE_UNIT_OFFSET + 1);
+	  size_t offset = 0;
+	  for (size_t i = 1; i < n; ++i) {
+	    if (rarity_((Unit)p[i]) > rarity_((Unit)p[offset])) {
+	      offset = i;
+	    }
+	  }
+	  rareUnits.push_back((Unit)p[offset]);
+	  maxRareUnitOffset_ = std::max(maxRareUnitOffset_, offset);
+	}
+	std::sort(rareUnits.begin(), rareUnits.end());
+	rareUnits.erase(std::unique(rareUnits.begin(), rareUnits.end()),
+			rareUnits.end());
+	rareUnits_ = RareUnitSet(rareUnits.data(), rareUnits.size());
+	prefilter_ = rareUnits.size() <= MAX_PREFILTER_UNITS;
+      }
+
+      /** @brief How rarely c appears in text, from 0 for the space
+       *         character up
+       */
+      static size_t rarity_(Unit c) {
+	// ASCII characters from most to least common.  The rest are
+	// rarer than any of these.
+	static const char BY_FREQUENCY[] =
+	    " etaoinsrhldcumfpgwybv0123456789\n\".,:-_/=kxjqz"
+	    "ETAOINSRHLDCUMFPGWYBVKXJQZ'();{}[]<>&*+?!@#$%^|\\~`\t";
+	static const size_t NUM_CHARS = sizeof(BY_FREQUENCY) - 1;
+	if (c < 128) {
+	  const char* const p =
+	      std::find(BY_FREQUENCY, BY_FREQUENCY + NUM_CHARS, (char)c);
+	  return p - BY_FREQUENCY;
+	}
+	return NUM_CHARS + 1;
+      }
+
+      /** @brief Call f(match) for each match until it returns false */
+      template <typename Function>
+      void scan_(const Unit* text, size_t n, Function f) const {
+	const uint32_t* const table = table_.data();
+	bool prefilter = prefilter_;
+	size_t numSkips = 0;
+	size_t numSkipped = 0;
+	size_t nextRareUnit = 0;
+	size_t i = 0;
+
+	while (true) {
+	  // s points at the transitions in the current state's row, so
+	  // the row's header is just before it
+	  uint32_t s = ROW_HEADER_SIZE_;
+	  size_t bestStart = NO_MATCH_;
+	  size_t bestLength = 0;
+	  uint32_t bestPattern = 0;
+
+	  for (; i < n; ++i) {
+	    // Skip to the first place a match could start, unless the
+	    // last skip already found a rare character ahead
+	    if (prefilter && (s == ROW_HEADER_SIZE_) && (i >= nextRareUnit)) {
+	      const size_t p = i + detail::findFirstInSet(text + i, n - i,
+							  rareUnits_);
+	      if (p == n) {
+		i = n;
+		break;
+	      }
+	      nextRareUnit = p + 1;
+
+	      const size_t next = (p > i + maxRareUnitOffset_)
+		                      ? p - maxRareUnitOffset_ : i;
+	      numSkipped += next - i;
+	      i = next;
+
+	      // Stop skipping ahead if it rarely skips far enough to pay
+	      // for itself
+	      if ((++numSkips >= PREFILTER_TRIAL_SKIPS_) &&
+		  (numSkipped < numSkips * PREFILTER_MIN_SKIP_)) {
+		prefilter = false;
+	      }
+	    }
+	    s = table[s + classOf_(text[i])];
+
+	    const uint32_t* const header = table + s - ROW_HEADER_SIZE_;
+	    const uint32_t matchLength = header[MATCH_LENGTH_];
+	    if (matchLength) {
+	      const size_t start = i + 1 - matchLength;
+	      if ((start < bestStart) ||
+		  ((start == bestStart) && (matchLength > bestLength))) {
+		bestStart = start;
+		bestLength = matchLength;
+		bestPattern = header[PATTERN_];
+	      }
+	    }
+
+	    // A pending match is final once no match still in progress
+	    // can start at or before it
+	    if ((bestStart != NO_MATCH_) &&
+		(bestStart + header[DEPTH_] <= i)) {
+	      break;
+	    }
+	  }
+
+	  if (bestStart == NO_MATCH_) {
+	    return;
+	  }
+	  const Match m{ bestStart, bestLength, bestPattern };
+	  if (!f(m)) {
+	    return;
+	  }
+	  i = bestStart + bestLength;
+	}
+      }
+    };
+
+    template <typename Char>
+    constexpr const size_t
+        ImmutableStringPatternSet<Char>::MAX_PREFILTER_UNITS;
+
+    template <typename Char>
+    constexpr const size_t
+        ImmutableStringPatternSet<Char>::MAX_RARE_UNIT_OFFSET;
+
+    template <typename Char>
+    constexpr const size_t ImmutableStringPatternSet<Char>::NO_MATCH_;
+
+    template <typename Char>
+    constexpr const uint32_t ImmutableStringPatternSet<Char>::NO_PATTERN_;
+
+    template <typename Char>
+    constexpr const uint32_t ImmutableStringPatternSet<Char>::DEPTH_;
+
+    template <typename Char>
+    constexpr const uint32_t ImmutableStringPatternSet<Char>::MATCH_LENGTH_;
+
+    template <typename Char>
+    constexpr const uint32_t ImmutableStringPatternSet<Char>::PATTERN_;
+
+    template <typename Char>
+    constexpr const uint32_t
+        ImmutableStringPatternSet<Char>::ROW_HEADER_SIZE_;
+
+    template <typename Char>
+    constexpr const size_t
+        ImmutableStringPatternSet<Char>::PREFILTER_TRIAL_SKIPS_;
+
+    template <typename Char>
+    constexpr const size_t
+        ImmutableStringPatternSet<Char>::PREFILTER_MIN_SKIP_;
+
+    typedef ImmutableStringPatternSet<char> IStringPatternSet;
+    typedef ImmutableStringPatternSet<wchar_t> WIStringPatternSet;
+    typedef ImmutableStringPatternSet<char16_t> U16_IStringPatternSet;
+    typedef ImmutableStringPatternSet<char32_t> U32_IStringPatternSet;
+
+  }
+}
+#endif
@@ -0,0 +1,230 @@
+#include "IStringPool.hpp"
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <stdlib.h>
+
+using namespace pistis::util;
+
+constexpr const size_t IStringPool::MAX_POOLED_SIZE;
+constexpr const size_t IStringPool::NUM_SIZE_CLASSES;
+constexpr const size_t IStringPool::SLAB_SIZE;
+constexpr const size_t IStringPool::REMOTE_BATCH_SIZE;
+
+namespace {
+  struct FreeBlock {
+    FreeBlock* next;
+    size_t sizeClass;
+  };
+
+  struct alignas(64) ThreadCache {
+    FreeBlock* freeLists[IStringPool::NUM_SIZE_CLASSES];
+    uint8_t* top;
+    uint8_t* end;
+    ThreadCache* nextAbandoned;
+
+    // Blocks other threads have freed, pushed in batches.  Kept on its
+    // own cache line so those threads do not slow down the owner.
+    alignas(64) std::atomic<FreeBlock*> remoteFrees;
+
+    ThreadCache(): top(nullptr), end(nullptr), nextAbandoned(nullptr),
+		   remoteFrees(nullptr) {
+      for (size_t i = 0; i < IStringPool::NUM_SIZE_CLASSES; ++i) {
+	freeLists[i] = nullptr;
+      }
+    }
+  };
+
+  // Every slab starts with a header naming the cache that carves it
+  struct Slab {
+    ThreadCache* owner;
+  };
+
+  constexpr size_t SLAB_HEADER_SIZE = 64;
+
+  Slab* slabOf(const void* p) {
+    return (Slab*)((uintptr_t)p & ~(uintptr_t)(IStringPool::SLAB_SIZE - 1));
+  }
+
+  // Caches of threads that have exited, waiting for a new owner.  Never
+  // destroyed, so strings freed during static destruction still work.
+  std::mutex& abandonedLock() {
+    static std::mutex* lock = new std::mutex();
+    return *lock;
+  }
+
+  ThreadCache* abandoned = nullptr;
+
+  ThreadCache* acquireCache() {
+    {
+      std::lock_guard<std::mutex> lock(abandonedLock());
+      if (abandoned) {
+	ThreadCache* const cache = abandoned;
+	abandoned = cache->nextAbandoned;
+	cache->nextAbandoned = nullptr;
+	return cache;
+      }
+    }
+    // Before C++17, operator new ignores alignas, so get the cache line
+    // alignment remoteFrees relies on from aligned_alloc.  Caches are
+    // never freed.
+    void* const p = ::aligned_alloc(alignof(ThreadCache), sizeof(ThreadCache));
+    if (!p) {
+      throw std::bad_alloc();
+    }
+    return new(p) ThreadCache();
+  }
+
+  void abandonCache(ThreadCache* cache) {
+    std::lock_guard<std::mutex> lock(abandonedLock());
+    cache->nextAbandoned = abandoned;
+    abandoned = cache;
+  }
+
+  void pushRemote(ThreadCache* owner, FreeBlock* head, FreeBlock* tail) {
+    FreeBlock* top = owner->remoteFrees.load(std::memory_order_relaxed);
+    do {
+      tail->next = top;
+    } while (!owner->remoteFrees.compare_exchange_weak(
+		 top, head, std::memory_order_release,
+		 std::memory_order_relaxed));
+  }
+
+  // Blocks this thread has freed for another thread, all for the same one
+  struct RemoteBatch {
+    ThreadCache* owner;
+    FreeBlock* head;
+    FreeBlock* tail;
+    size_t size;
+
+    void flush() {
+      if (head) {
+	pushRemote(owner, head, tail);
+	owner = nullptr;
+	head = tail = nullptr;
+	size = 0;
+      }
+    }
+  };
+
+  enum class ThreadState { NEW, ACTIVE, EXITED };
+
+  // Plain data, so it stays usable after the thread's destructors run
+  thread_local ThreadState threadState = ThreadState::NEW;
+  thread_local ThreadCache* threadCache = nullptr;
+  thread_local RemoteBatch remoteBatch = { nullptr, nullptr, nullptr, 0 };
+
+  // Flushes the remote batch and gives up the cache when the thread exits
+  struct ThreadExit {
+    ~ThreadExit() {
+      remoteBatch.flush();
+      if (threadCache) {
+	abandonCache(threadCache);
+	threadCache = nullptr;
+      }
+      threadState = ThreadState::EXITED;
+    }
+  };
+
+  thread_local ThreadExit threadExit;
+
+  void activateThread() {
+    if (threadState == ThreadState::NEW) {
+      // Touching threadExit registers its destructor
+      (void)&threadExit;
+      threadState = ThreadState::ACTIVE;
+    }
+  }
+
+  ThreadCache* localCache() {
+    if (!threadCache) {
+      activateThread();
+      threadCache = acquireCache();
+    }
+    return threadCache;
+  }
+
+  void drainRemoteFrees(ThreadCache* cache) {
+    FreeBlock* block =
+        cache->remoteFrees.exchange(nullptr, std::memory_order_acquire);
+    while (block) {
+      FreeBlock* const next = block->next;
+      block->next = cache->freeLists[block->sizeClass];
+      cache->freeLists[block->sizeClass] = block;
+      block = next;
+    }
+  }
+
+  uint8_t* carve(ThreadCache* cache, size_t size) {
+    if ((size_t)(cache->end - cache->top) < size) {
+      void* const p = ::aligned_alloc(IStringPool::SLAB_SIZE,
+				      IStringPool::SLAB_SIZE);
+      if (!p) {
+	throw std::bad_alloc();
+      }
+      ((Slab*)p)->owner = cache;
+      cache->top = (uint8_t*)p + SLAB_HEADER_SIZE;
+      cache->end = (uint8_t*)p + IStringPool::SLAB_SIZE;
+    }
+    uint8_t* const block = cache->top;
+    cache->top += size;
+    return block;
+  }
+}
+
+uint8_t* IStringPool::allocate(size_t n) {
+  if (n > MAX_POOLED_SIZE) {
+    return (uint8_t*)::operator new(n);
+  }
+
+  ThreadCache* const cache = localCache();
+  const size_t c = sizeClass(n);
+  FreeBlock* block = cache->freeLists[c];
+  if (!block && cache->remoteFrees.load(std::memory_order_relaxed)) {
+    drainRemoteFrees(cache);
+    block = cache->freeLists[c];
+  }
+  if (block) {
+    cache->freeLists[c] = block->next;
+    return (uint8_t*)block;
+  }
+  return carve(cache, sizeOfClass(c));
+}
+
+void IStringPool::deallocate(uint8_t* p, size_t n) {
+  if (n > MAX_POOLED_SIZE) {
+    ::operator delete(p);
+    return;
+  }
+
+  const size_t c = sizeClass(n);
+  FreeBlock* const block = (FreeBlock*)p;
+  ThreadCache* const owner = slabOf(p)->owner;
+  if (owner == threadCache) {
+    block->next = threadCache->freeLists[c];
+    threadCache->freeLists[c] = block;
+    return;
+  }
+
+  block->sizeClass = c;
+  if (threadState == ThreadState::EXITED) {
+    pushRemote(owner, block, block);
+    return;
+  }
+
+  activateThread();
+  if (remoteBatch.owner != owner) {
+    remoteBatch.flush();
+    remoteBatch.owner = owner;
+    remoteBatch.tail = block;
+  }
+  block->next = remoteBatch.head;
+  remoteBatch.head = block;
+  if (++remoteBatch.size == REMOTE_BATCH_SIZE) {
+    remoteBatch.flush();
+  }
+}
+
+void IStringPool::flushRemoteFrees() {
+  remoteBatch.flush();
+}
@@ -0,0 +1,123 @@
+#ifndef __PISTIS__UTIL__ISTRINGPOOL_HPP__
+#define __PISTIS__UTIL__ISTRINGPOOL_HPP__
+
+/** @file IStringPool.hpp
+ *
+ *  A pooling allocator for the small, short-lived texts behind
+ *  ImmutableStrings.  Each thread carves blocks in a few dozen size
+ *  classes out of 64 KiB slabs and keeps freed blocks on per-class free
+ *  lists, so allocating and freeing a text on one thread never takes a
+ *  lock or calls malloc.  A block freed on another thread is returned to
+ *  the thread that allocated it in batches through a lock-free stack,
+ *  which that thread drains when its own free list runs dry.
+ *
+ *  Requests larger than IStringPool::MAX_POOLED_SIZE go to the heap.
+ *  Slabs are never returned to the heap; the blocks in them are reused
+ *  instead.  When a thread exits, its cache, with its free blocks and
+ *  slabs, is handed to the next thread that starts allocating.
+ */
+
+#include <pistis/util/IString.hpp>
+#include <pistis/util/IStringBuilder.hpp>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace pistis {
+  namespace util {
+
+    class IStringPool {
+    public:
+      /** @brief Largest request served from the pool */
+      static constexpr const size_t MAX_POOLED_SIZE = 2048;
+
+      /** @brief Number of size classes */
+      static constexpr const size_t NUM_SIZE_CLASSES = 23;
+
+      /** @brief Size of the slabs blocks are carved from */
+      static constexpr const size_t SLAB_SIZE = 64 * 1024;
+
+      /** @brief Blocks freed on a thread other than the one that
+       *         allocated them are returned in batches of this many
+       */
+      static constexpr const size_t REMOTE_BATCH_SIZE = 32;
+
+    public:
+      static uint8_t* allocate(size_t n);
+      static void deallocate(uint8_t* p, size_t n);
+
+      /** @brief Return the blocks this thread has freed on behalf of
+       *         other threads to them now, instead of waiting for the
+       *         batch to fill.
+       */
+      static void flushRemoteFrees();
+
+      /** @brief The size class for an n-byte request, for n no larger
+       *         than MAX_POOLED_SIZE
+       *
+       *  Classes are 16 bytes apart up to 128 bytes, then four to each
+       *  doubling, so no more than a fifth of a block is wasted once
+       *  the IStringText header is counted.
+       */
+      static size_t sizeClass(size_t n) {
+	if (n <= 128) {
+	  return (n <= 32) ? 0 : ((n + 15) >> 4) - 2;
+	}
+	const size_t m = n - 1;
+	const size_t log = 63 - __builtin_clzll(m);
+	return 7 + (log - 7) * 4 + ((m >> (log - 2)) & 3);
+      }
+
+      /** @brief Size of the blocks in size class c */
+      static size_t sizeOfClass(size_t c) {
+	if (c < 7) {
+	  return 32 + (c << 4);
+	}
+	const size_t log = 7 + (c - 7) / 4;
+	const size_t step = (size_t)1 << (log - 2);
+	return ((size_t)1 << log) + (((c - 7) % 4) + 1) * step;
+      }
+    };
+
+    /** @brief Allocator that draws from the calling thread's IStringPool
+     *         cache
+     *
+     *  Strings using it can be passed between threads like any other
+     *  strings.  Wrap it in a LocalIStringAllocator for strings that
+     *  also never leave their thread.
+     */
+    class IStringPoolAllocator {
+    public:
+      typedef uint8_t value_type;
+
+    public:
+      uint8_t* allocate(size_t n) { return IStringPool::allocate(n); }
+      void deallocate(uint8_t* p, size_t n) { IStringPool::deallocate(p, n); }
+
+      bool operator==(const IStringPoolAllocator&) const { return true; }
+      bool operator!=(const IStringPoolAllocator&) const { return false; }
+    };
+
+    /** @brief Strings whose texts come from the IStringPool */
+    typedef ImmutableString<char, std::char_traits<char>,
+			    IStringPoolAllocator> PooledIString;
+    typedef ImmutableString<wchar_t, std::char_traits<wchar_t>,
+			    IStringPoolAllocator> PooledWIString;
+    typedef ImmutableString<char16_t, std::char_traits<char16_t>,
+			    IStringPoolAllocator> PooledU16_IString;
+    typedef ImmutableString<char32_t, std::char_traits<char32_t>,
+			    IStringPoolAllocator> PooledU32_IString;
+
+    typedef ImmutableStringBuilder<char, std::char_traits<char>,
+				   IStringPoolAllocator> PooledIStringBuilder;
+    typedef ImmutableStringBuilder<wchar_t, std::char_traits<wchar_t>,
+				   IStringPoolAllocator> PooledWIStringBuilder;
+    typedef ImmutableStringBuilder<char16_t, std::char_traits<char16_t>,
+				   IStringPoolAllocator>
+            PooledU16_IStringBuilder;
+    typedef ImmutableStringBuilder<char32_t, std::char_traits<char32_t>,
+				   IStringPoolAllocator>
+            PooledU32_IStringBuilder;
+
+  }
+}
+#endif
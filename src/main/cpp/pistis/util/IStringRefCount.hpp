@@ -0,0 +1,122 @@
+#ifndef __PISTIS__UTIL__ISTRINGREFCOUNT_HPP__
+#define __PISTIS__UTIL__ISTRINGREFCOUNT_HPP__
+
+/** @file IStringRefCount.hpp
+ *
+ *  Reference counting policies for the text shared by ImmutableStrings.
+ *  The policy is chosen by the string's allocator type through
+ *  IStringRefCountPolicy.  Strings with an ordinary allocator count
+ *  references with atomic read-modify-write instructions, so they can be
+ *  copied and destroyed on any thread.  Strings whose allocator is a
+ *  LocalIStringAllocator count references with plain loads and stores,
+ *  which is much cheaper but only correct when all the strings sharing a
+ *  text stay on one thread.
+ */
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <stdint.h>
+
+namespace pistis {
+  namespace util {
+
+    /** @brief Counts references with atomic operations */
+    struct AtomicIStringRefCount {
+      static constexpr const bool THREAD_SAFE = true;
+
+      static void addRef(std::atomic<uint32_t>& n) { ++n; }
+      static uint32_t removeRef(std::atomic<uint32_t>& n) { return --n; }
+    };
+
+    /** @brief Counts references with plain loads and stores
+     *
+     *  The count is still a std::atomic so that the text has the same
+     *  layout under either policy, but relaxed loads and stores compile
+     *  to ordinary instructions with no lock prefix or fence.
+     */
+    struct LocalIStringRefCount {
+      static constexpr const bool THREAD_SAFE = false;
+
+      static void addRef(std::atomic<uint32_t>& n) {
+	n.store(n.load(std::memory_order_relaxed) + 1,
+		std::memory_order_relaxed);
+      }
+
+      static uint32_t removeRef(std::atomic<uint32_t>& n) {
+	const uint32_t count = n.load(std::memory_order_relaxed) - 1;
+	n.store(count, std::memory_order_relaxed);
+	return count;
+      }
+    };
+
+    /** @brief Allocator for ImmutableStrings that never leave the thread
+     *         that created them
+     *
+     *  Allocates exactly as Allocator does, but selects
+     *  LocalIStringRefCount for the strings that use it.  See
+     *  LocalIString.
+     */
+    template <typename Allocator = std::allocator<uint8_t> >
+    class LocalIStringAllocator : public Allocator {
+    public:
+      LocalIStringAllocator() { }
+      LocalIStringAllocator(const Allocator& allocator):
+	  Allocator(allocator) {
+      }
+      LocalIStringAllocator(Allocator&& allocator):
+	  Allocator(std::move(allocator)) {
+      }
+    };
+
+    /** @brief The reference counting policy for strings that use
+     *         Allocator
+     *
+     *  Specialize to give another allocator type a different policy.
+     */
+    template <typename Allocator>
+    struct IStringRefCountPolicy {
+      typedef AtomicIStringRefCount type;
+    };
+
+    template <typename Allocator>
+    struct IStringRefCountPolicy< LocalIStringAllocator<Allocator> > {
+      typedef LocalIStringRefCount type;
+    };
+
+    namespace detail {
+      /** @brief The allocator for shared strings that corresponds to
+       *         Allocator
+       */
+      template <typename Allocator>
+      struct SharedIStringAllocator {
+	typedef Allocator type;
+      };
+
+      template <typename Allocator>
+      struct SharedIStringAllocator< LocalIStringAllocator<Allocator> > {
+	typedef Allocator type;
+      };
+
+      /** @brief True if strings using A1 and A2 can hand texts to each
+       *         other, because one allocator is the LocalIStringAllocator
+       *         for the other.
+       */
+      template <typename A1, typename A2>
+      struct CanTransferIStringText : std::false_type { };
+
+      template <typename A>
+      struct CanTransferIStringText<A, LocalIStringAllocator<A> > :
+	  std::true_type {
+      };
+
+      template <typename A>
+      struct CanTransferIStringText<LocalIStringAllocator<A>, A> :
+	  std::true_type {
+      };
+    }
+
+  }
+}
+#endif
@@ -0,0 +1,76 @@
+#ifndef __PISTIS__UTIL__ISTRINGRETENTIONAUDIT_HPP__
+#define __PISTIS__UTIL__ISTRINGRETENTIONAUDIT_HPP__
+
+#include <pistis/util/IString.hpp>
+#include <unordered_set>
+#include <stddef.h>
+
+namespace pistis {
+  namespace util {
+
+    /** @brief Reports how much memory a set of strings keeps alive
+     *         compared to how much of it they actually refer to
+     *
+     *  Add every string in a cache or other long-lived collection, then
+     *  compare referencedBytes() with pinnedBytes().  A text shared by
+     *  several of the strings is counted once.  A large gap means the
+     *  strings are substrings of much larger texts, and shrinking them,
+     *  or splitting with an IStringCompactionPolicy, would free memory.
+     */
+    class IStringRetentionAudit {
+    public:
+      IStringRetentionAudit():
+	  numStrings_(0), referencedBytes_(0), pinnedBytes_(0) {
+      }
+
+      /** @brief Number of strings added */
+      size_t numStrings() const { return numStrings_; }
+
+      /** @brief Number of distinct texts the strings keep alive */
+      size_t numTexts() const { return texts_.size(); }
+
+      /** @brief Total size of the characters the strings contain */
+      size_t referencedBytes() const { return referencedBytes_; }
+
+      /** @brief Total size of the texts the strings keep alive, counting
+       *         each text once
+       */
+      size_t pinnedBytes() const { return pinnedBytes_; }
+
+      template <typename C, typename T, typename A>
+      IStringRetentionAudit& add(const ImmutableString<C, T, A>& s) {
+	++numStrings_;
+	referencedBytes_ += s.size() * sizeof(C);
+	const detail::IStringText<C>* const t = s.ownerText_();
+	if (t && texts_.insert(t).second) {
+	  pinnedBytes_ += t->footprint();
+	}
+	return *this;
+      }
+
+      template <typename Iterator>
+      IStringRetentionAudit& add(Iterator begin, Iterator end) {
+	for (Iterator i = begin; i != end; ++i) {
+	  add(*i);
+	}
+	return *this;
+      }
+
+      /** @brief Audit every string in c */
+      template <typename Container>
+      static IStringRetentionAudit of(const Container& c) {
+	IStringRetentionAudit audit;
+	audit.add(c.begin(), c.end());
+	return audit;
+      }
+
+    private:
+      std::unordered_set<const void*> texts_;
+      size_t numStrings_;
+      size_t referencedBytes_;
+      size_t pinnedBytes_;
+    };
+
+  }
+}
+#endif
@@ -2,6 +2,7 @@
 #define __PISTIS__UTIL__ISTRINGSPLITSTREAM_HPP__
 
 #include <pistis/exceptions/EndOfStream.hpp>
+#include <pistis/util/IStringCompactionPolicy.hpp>
 #include <algorithm>
 #include <iterator>
 #include <limits>
@@ -98,9 +99,12 @@ namespace pistis {
     public:
       IStringSplitStream(const SourceStringType& source,
 			 const TargetStringType& target,
-			 size_t maxSplits = MAX_SPLITS):
-	  source_(source), target_(target), maxSplits_(maxSplits), current_(0),
-          splitCount_(0), ready_(source.size()) {
+			 size_t maxSplits = MAX_SPLITS,
+			 const IStringCompactionPolicy& compaction =
+			     IStringCompactionPolicy()):
+	  source_(source), target_(target), maxSplits_(maxSplits),
+	  compaction_(compaction), current_(0), splitCount_(0),
+	  ready_(source.size()) {
       }
       IStringSplitStream(const IStringSplitStream&) = default;
       IStringSplitStream(IStringSplitStream&&) = default;
@@ -114,12 +118,12 @@ namespace pistis {
 	  const size_t i = current_;
 	  current_ = source_.size();
 	  ready_ = false;
-	  return source_.substr(i);
+	  return source_.substr(i, SourceStringType::NPOS, compaction_);
 	} else if (!target_.size()) {
 	  ++current_;
 	  ++splitCount_;
 	  ready_ = current_ < source_.size();
-	  return source_.substr(current_ - 1, current_);
+	  return source_.substr(current_ - 1, current_, compaction_);
 	} else {
 	  const size_t last = current_;
 	  const size_t next = source_.find(target_, current_);
@@ -130,7 +134,7 @@ namespace pistis {
 	    ready_ = false;
 	  }
 	  ++splitCount_;
-	  return source_.substr(last, next);
+	  return source_.substr(last, next, compaction_);
 	}
       }
 
@@ -141,6 +145,96 @@ namespace pistis {
       const ImmutableString<Char, CharTraits, Allocator> source_;
       const ImmutableString<Char, CharTraits, Allocator> target_;
       const size_t maxSplits_;
+      const IStringCompactionPolicy compaction_;
+      size_t current_;
+      size_t splitCount_;
+      bool ready_;
+    };
+
+    /** @brief Splits a string at each occurrence of a target string,
+     *         from the end of the string to the beginning.
+     *
+     *  Returns the same pieces as IStringSplitStream, in reverse order,
+     *  except that when maxSplits is reached, the final piece is the
+     *  unsplit start of the source.
+     */
+    template <typename Char, typename CharTraits, typename Allocator,
+	      typename TargetChar, typename TargetCharTraits,
+	      typename TargetAllocator>
+    class ReverseIStringSplitStream :
+        public detail::IStringSplitStreamBase<
+            ReverseIStringSplitStream<Char, CharTraits, Allocator, TargetChar,
+				      TargetCharTraits, TargetAllocator>,
+            ImmutableString<Char, CharTraits, Allocator>
+        > {
+    private:
+      typedef detail::IStringSplitStreamBase<
+          ReverseIStringSplitStream<Char, CharTraits, Allocator, TargetChar,
+				    TargetCharTraits, TargetAllocator>,
+          ImmutableString<Char, CharTraits, Allocator>
+      > ParentType;
+
+    public:
+      using typename ParentType::SourceStringType;
+      using ParentType::MAX_SPLITS;
+      typedef ImmutableString<TargetChar, TargetCharTraits, TargetAllocator>
+              TargetStringType;
+
+    public:
+      ReverseIStringSplitStream(const SourceStringType& source,
+				const TargetStringType& target,
+				size_t maxSplits = MAX_SPLITS,
+				const IStringCompactionPolicy& compaction =
+				    IStringCompactionPolicy()):
+	  source_(source), target_(target), maxSplits_(maxSplits),
+	  compaction_(compaction), current_(source.size()), splitCount_(0),
+	  ready_(source.size()) {
+      }
+      ReverseIStringSplitStream(const ReverseIStringSplitStream&) = default;
+      ReverseIStringSplitStream(ReverseIStringSplitStream&&) = default;
+
+      bool ready() const { return ready_; }
+
+      SourceStringType next() {
+	if (!ready()) {
+	  throw pistis::exceptions::EndOfStream(PISTIS_EX_HERE);
+	} else if (splitCount_ >= maxSplits_) {
+	  const size_t i = current_;
+	  current_ = 0;
+	  ready_ = false;
+	  return source_.substr(0, i, compaction_);
+	} else if (!target_.size()) {
+	  --current_;
+	  ++splitCount_;
+	  ready_ = current_ > 0;
+	  return source_.substr(current_, current_ + 1, compaction_);
+	} else {
+	  const size_t last = current_;
+	  const size_t next = source_.findLast(target_, 0, current_);
+	  ++splitCount_;
+	  if (next < source_.size()) {
+	    current_ = next;
+	    return source_.substr(next + target_.size(), last, compaction_);
+	  } else {
+	    current_ = 0;
+	    ready_ = false;
+	    return source_.substr(0, last, compaction_);
+	  }
+	}
+      }
+
+      ReverseIStringSplitStream& operator=(const ReverseIStringSplitStream&) =
+          default;
+      ReverseIStringSplitStream& operator=(ReverseIStringSplitStream&&) =
+          default;
+
+    private:
+      const ImmutableString<Char, CharTraits, Allocator> source_;
+      const ImmutableString<Char, CharTraits, Allocator> target_;
+      const size_t maxSplits_;
+      const IStringCompactionPolicy compaction_;
+
+      // End of the part of the source that has not been returned yet
       size_t current_;
       size_t splitCount_;
       bool ready_;
@@ -172,9 +266,12 @@ namespace pistis {
     public:
       RegexIStringSplitStream(const SourceStringType& source,
 			      const RegexType& regex,
-			      size_t maxSplits = MAX_SPLITS):
+			      size_t maxSplits = MAX_SPLITS,
+			      const IStringCompactionPolicy& compaction =
+				  IStringCompactionPolicy()):
 	  source_(source), target_(regex), maxSplits_(maxSplits),
-	  current_(source_.begin()), splitCount_(0), ready_(source.size()) {
+	  compaction_(compaction), current_(0), splitCount_(0),
+	  ready_(source.size()) {
       }
       RegexIStringSplitStream(const RegexIStringSplitStream&) = default;
       RegexIStringSplitStream(RegexIStringSplitStream&&) = default;
@@ -185,31 +282,32 @@ namespace pistis {
 	if (!ready()) {
 	  throw pistis::exceptions::EndOfStream(PISTIS_EX_HERE);
 	} else if (splitCount_ >= maxSplits_) {
-	  const size_t p = source_.indexFor(current_);
-	  current_ = source_.end();
+	  const size_t p = current_;
+	  current_ = source_.size();
 	  ready_ = false;
-	  return source_.substr(p);
+	  return source_.substr(p, SourceStringType::NPOS, compaction_);
 	} else {
 	  std::match_results<typename SourceStringType::ConstIterator> match;
-	  if (std::regex_search(current_, source_.end(), match, target_)) {
-	    const size_t i = source_.indexFor(current_);
+	  if (std::regex_search(source_.position(current_), source_.end(),
+				match, target_)) {
+	    const size_t i = current_;
 	    const size_t p = match.position();
 	    if (match.length()) {
 	      current_ += p + match.length();
 	      ++splitCount_;
-	      return source_.substr(i, i + p);
+	      return source_.substr(i, i + p, compaction_);
 	    } else {
 	      ++current_;
 	      ++splitCount_;
-	      ready_ = current_ < source_.end();
-	      return source_.substr(i, i + 1);
+	      ready_ = current_ < source_.size();
+	      return source_.substr(i, i + 1, compaction_);
 	    }
 	  } else {
-	    const size_t i = source_.indexFor(current_);
-	    current_ = source_.end();
+	    const size_t i = current_;
+	    current_ = source_.size();
 	    ++splitCount_;
 	    ready_ = false;
-	    return source_.substr(i);
+	    return source_.substr(i, SourceStringType::NPOS, compaction_);
 	  }
 	}
       }
@@ -222,7 +320,12 @@ namespace pistis {
       const SourceStringType source_;
       const RegexType target_;
       const size_t maxSplits_;
-      typename SourceStringType::ConstIterator current_;
+      const IStringCompactionPolicy compaction_;
+
+      // An index rather than an iterator, because short sources are
+      // stored inline and would leave an iterator dangling when the
+      // stream is copied or moved.
+      size_t current_;
       size_t splitCount_;
       bool ready_;
     };
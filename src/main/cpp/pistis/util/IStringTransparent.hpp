@@ -0,0 +1,101 @@
+#ifndef __PISTIS__UTIL__ISTRINGTRANSPARENT_HPP__
+#define __PISTIS__UTIL__ISTRINGTRANSPARENT_HPP__
+
+/** @file IStringTransparent.hpp
+ *
+ *  Function objects that let containers keyed by ImmutableString look
+ *  up null-terminated strings, std::basic_strings and ImmutableStrings
+ *  with other traits or allocators without making an ImmutableString
+ *  from them first:
+ *
+ *  @code
+ *  std::map<IString, Handler, TransparentIStringLess> handlers;
+ *  auto i = handlers.find(request.path());  // A std::string
+ *  @endcode
+ *
+ *  Each functor views its arguments as ImmutableStrings with
+ *  asIStringKey(), which copies nothing, and then hashes or compares
+ *  them with ImmutableString's own hash(), operator== and operator<, so
+ *  the results always agree with those of the keys themselves.  Keys
+ *  and the values looked up must have the same character type.
+ *
+ *  std::map and std::set use transparent comparators since C++14, but
+ *  std::unordered_map and std::unordered_set only use transparent hash
+ *  and equality functors since C++20.  Before that, look up
+ *  asIStringKey(s) instead of s, which allocates nothing either.
+ */
+
+#include <pistis/util/IString.hpp>
+#include <string>
+#include <stddef.h>
+
+namespace pistis {
+  namespace util {
+
+    /** @brief Return s itself */
+    template <typename Char, typename CharTraits, typename Allocator>
+    inline const ImmutableString<Char, CharTraits, Allocator>& asIStringKey(
+	const ImmutableString<Char, CharTraits, Allocator>& s
+    ) {
+      return s;
+    }
+
+    /** @brief View the characters of s as an ImmutableString, without
+     *         copying them
+     *
+     *  Like ImmutableString::literal(), the result refers to s's
+     *  characters, so it must not outlive s or any change to s.
+     */
+    template <typename Char, typename CharTraits, typename Allocator>
+    inline ImmutableString<Char, CharTraits> asIStringKey(
+	const std::basic_string<Char, CharTraits, Allocator>& s
+    ) {
+      return ImmutableString<Char, CharTraits>::literal(s.data(), s.size());
+    }
+
+    /** @brief View the null-terminated string s as an ImmutableString,
+     *         without copying it.  See asIStringKey(std::basic_string).
+     */
+    template <typename Char>
+    inline ImmutableString<Char> asIStringKey(const Char* s) {
+      return ImmutableString<Char>::literal(s,
+					    std::char_traits<Char>::length(s));
+    }
+
+    /** @brief Hashes anything asIStringKey() accepts to the same value
+     *         ImmutableString::hash() gives for the same characters
+     */
+    struct TransparentIStringHash {
+      typedef void is_transparent;
+
+      template <typename Key>
+      size_t operator()(const Key& key) const {
+	return asIStringKey(key).hash();
+      }
+    };
+
+    /** @brief True if two strings have the same characters */
+    struct TransparentIStringEqual {
+      typedef void is_transparent;
+
+      template <typename Left, typename Right>
+      bool operator()(const Left& left, const Right& right) const {
+	return asIStringKey(left) == asIStringKey(right);
+      }
+    };
+
+    /** @brief True if left comes before right, as ImmutableString's
+     *         operator< orders them
+     */
+    struct TransparentIStringLess {
+      typedef void is_transparent;
+
+      template <typename Left, typename Right>
+      bool operator()(const Left& left, const Right& right) const {
+	return asIStringKey(left) < asIStringKey(right);
+      }
+    };
+
+  }
+}
+#endif
@@ -0,0 +1,408 @@
+#ifndef __PISTIS__UTIL__ISTRINGVIEW_HPP__
+#define __PISTIS__UTIL__ISTRINGVIEW_HPP__
+
+#include <pistis/exceptions/IllegalValueError.hpp>
+#include <pistis/util/IString.hpp>
+#include <pistis/util/IStringTransparent.hpp>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace pistis {
+  namespace util {
+
+    template <typename Char, typename CharTraits>
+    class ImmutableStringView;
+
+    namespace detail {
+      template <typename T>
+      struct IsIStringView : std::false_type {
+      };
+
+      template <typename Char, typename CharTraits>
+      struct IsIStringView< ImmutableStringView<Char, CharTraits> > :
+	  std::true_type {
+      };
+    }
+
+    /** @brief A view of a range of characters that does not own them
+     *
+     *  A view is just a pointer and a length, so making, copying and
+     *  slicing one never touches a reference count.  Its substr(),
+     *  strip() and split() return views as well, which lets a parsing
+     *  loop cut a large ImmutableString into pieces without a single
+     *  atomic operation.  Views have the same search functions as
+     *  ImmutableString, which do the work, so they return the same
+     *  results, counted from the start of the view.
+     *
+     *  The view must not outlive the characters it refers to.  To keep
+     *  a piece, promote it with toIString(source), which shares the text
+     *  of the ImmutableString the view was cut from, or with toIString(),
+     *  which copies it.
+     */
+    template <typename Char, typename CharTraits = std::char_traits<Char> >
+    class ImmutableStringView {
+    public:
+      typedef Char CharType;
+      typedef CharTraits CharTraitsType;
+      typedef ImmutableString<Char, CharTraits> StringType;
+      typedef const Char* ConstIterator;
+
+      static constexpr const size_t NPOS = StringType::NPOS;
+      static constexpr const size_t MAX_SPLITS = StringType::MAX_SPLITS;
+
+    public:
+      constexpr ImmutableStringView(): begin_(nullptr), end_(nullptr) { }
+
+      constexpr ImmutableStringView(const Char* begin, const Char* end):
+	  begin_(begin), end_(end) {
+      }
+
+      constexpr ImmutableStringView(const Char* text, size_t n):
+	  begin_(text), end_(text + n) {
+      }
+
+      /** @brief View a null-terminated string */
+      explicit ImmutableStringView(const Char* text):
+	  begin_(text), end_(text + CharTraits::length(text)) {
+      }
+
+      template <typename Allocator>
+      ImmutableStringView(
+	  const ImmutableString<Char, CharTraits, Allocator>& s
+      ):
+	  begin_(s.data()), end_(s.data() + s.size()) {
+      }
+
+      template <typename Allocator>
+      ImmutableStringView(const std::basic_string<Char, CharTraits,
+			                          Allocator>& s):
+	  begin_(s.data()), end_(s.data() + s.size()) {
+      }
+
+      size_t size() const { return end_ - begin_; }
+      const Char* data() const { return begin_; }
+      ConstIterator begin() const { return begin_; }
+      ConstIterator end() const { return end_; }
+      Char operator[](size_t n) const { return begin_[n]; }
+
+      ImmutableStringView substr(size_t start, size_t end = NPOS) const {
+	const Char* const e = begin_ + std::min(end, size());
+	return ImmutableStringView(std::min(begin_ + start, e), e);
+      }
+
+      ImmutableStringView strip() const {
+	return viewOf_(str_().strip());
+      }
+
+      /** @brief Split this view at each occurrence of separator, which
+       *         may be anything asIStringKey() accepts
+       */
+      template <typename Separator>
+      std::vector<ImmutableStringView> split(
+	  const Separator& separator, size_t maxSplits = MAX_SPLITS
+      ) const {
+	return split_(str_().split(asIStringKey(separator), maxSplits));
+      }
+
+      template <typename RegexTraits>
+      std::vector<ImmutableStringView> split(
+	  const std::basic_regex<Char, RegexTraits>& separator,
+	  size_t maxSplits = MAX_SPLITS
+      ) const {
+	return split_(str_().split(separator, maxSplits));
+      }
+
+      /** @name Searches
+       *
+       *  Each takes the same arguments as the ImmutableString function
+       *  of the same name, as well as views in place of strings.
+       */
+      /** @{ */
+      template <typename... Args>
+      size_t find(Args&&... args) const {
+	return str_().find(arg_(std::forward<Args>(args))...);
+      }
+
+      template <typename... Args>
+      size_t findLast(Args&&... args) const {
+	return str_().findLast(arg_(std::forward<Args>(args))...);
+      }
+
+      template <typename... Args>
+      size_t findFirstOf(Args&&... args) const {
+	return str_().findFirstOf(arg_(std::forward<Args>(args))...);
+      }
+
+      template <typename... Args>
+      size_t findLastOf(Args&&... args) const {
+	return str_().findLastOf(arg_(std::forward<Args>(args))...);
+      }
+
+      size_t findAny(const ImmutableStringPatternSet<Char>& patterns,
+		     size_t start = 0, size_t end = NPOS) const {
+	return str_().findAny(patterns, start, end);
+      }
+
+      template <typename... Args>
+      size_t count(Args&&... args) const {
+	return str_().count(arg_(std::forward<Args>(args))...);
+      }
+
+      template <typename... Args>
+      bool startsWith(Args&&... args) const {
+	return str_().startsWith(arg_(std::forward<Args>(args))...);
+      }
+
+      template <typename... Args>
+      bool endsWith(Args&&... args) const {
+	return str_().endsWith(arg_(std::forward<Args>(args))...);
+      }
+
+      template <typename Predicate>
+      bool all(const Predicate& p, size_t start = 0, size_t end = NPOS) const {
+	return str_().all(p, start, end);
+      }
+
+      template <typename Predicate>
+      bool any(const Predicate& p, size_t start = 0, size_t end = NPOS) const {
+	return str_().any(p, start, end);
+      }
+      /** @} */
+
+      template <typename Other>
+      int cmp(const Other& other) const { return str_().cmp(arg_(other)); }
+
+      template <typename Other>
+      int cmpIgnoreCase(const Other& other) const {
+	return str_().cmpIgnoreCase(arg_(other));
+      }
+
+      template <typename Other>
+      bool equalsIgnoreCase(const Other& other) const {
+	return str_().equalsIgnoreCase(arg_(other));
+      }
+
+      bool isValidUtf() const { return str_().isValidUtf(); }
+
+      /** @brief Same as ImmutableString::hash() for the same characters */
+      size_t hash() const { return str_().hash(); }
+
+      template <typename Hasher>
+      size_t hash(const Hasher& hasher) const { return hasher(begin_, size()); }
+
+      size_t hashIgnoreCase() const { return str_().hashIgnoreCase(); }
+
+      /** @brief Copy the characters of this view into an ImmutableString
+       */
+      template <typename Allocator = std::allocator<uint8_t> >
+      ImmutableString<Char, CharTraits, Allocator> toIString(
+	  const Allocator& allocator = Allocator()
+      ) const {
+	return ImmutableString<Char, CharTraits, Allocator>(size(), begin_,
+							    allocator);
+      }
+
+      /** @brief Return the substring of source this view refers to,
+       *         which shares source's text instead of copying it
+       *
+       *  @throws IllegalValueError if this view is not part of source
+       */
+      template <typename Allocator>
+      ImmutableString<Char, CharTraits, Allocator> toIString(
+	  const ImmutableString<Char, CharTraits, Allocator>& source
+      ) const {
+	const Char* const s = source.data();
+	if (!size()) {
+	  return source.substr(0, 0);
+	} else if ((begin_ < s) || (end_ > (s + source.size()))) {
+	  throw pistis::exceptions::IllegalValueError(
+	      "View is not part of the source string", PISTIS_EX_HERE
+	  );
+	}
+	return source.substr(begin_ - s, end_ - s);
+      }
+
+      std::basic_string<Char, CharTraits> toStdString() const {
+	return std::basic_string<Char, CharTraits>(begin_, end_);
+      }
+
+      template <typename Other>
+      bool operator==(const Other& other) const {
+	return str_() == arg_(other);
+      }
+
+      template <typename Other>
+      bool operator!=(const Other& other) const {
+	return str_() != arg_(other);
+      }
+
+      template <typename Other>
+      bool operator<(const Other& other) const { return cmp(other) < 0; }
+
+      template <typename Other>
+      bool operator<=(const Other& other) const { return cmp(other) <= 0; }
+
+      template <typename Other>
+      bool operator>(const Other& other) const { return cmp(other) > 0; }
+
+      template <typename Other>
+      bool operator>=(const Other& other) const { return cmp(other) >= 0; }
+
+    private:
+      const Char* begin_;
+      const Char* end_;
+
+      template <typename C, typename T>
+      friend class ImmutableStringView;
+
+      /** @brief This view as an ImmutableString that refers to the same
+       *         characters.  Like a literal, it has no text, so making
+       *         and destroying it counts no references.
+       */
+      StringType str_() const { return StringType::literal(begin_, size()); }
+
+      static ImmutableStringView viewOf_(const StringType& s) {
+	return ImmutableStringView(s.data(), s.size());
+      }
+
+      /** @brief Collect the pieces of this view's str_() a split stream
+       *         returns.  They are slices of a string with no text, so
+       *         they refer to this view's characters too.
+       */
+      template <typename SplitStream>
+      static std::vector<ImmutableStringView> split_(SplitStream&& pieces) {
+	std::vector<ImmutableStringView> tokens;
+	pieces.forEach([&tokens](const StringType& token) {
+	  tokens.push_back(viewOf_(token));
+	});
+	return tokens;
+      }
+
+      /** @brief Pass arguments other than views through unchanged, and
+       *         turn views into strings ImmutableString accepts
+       */
+      template <typename Arg,
+		typename Enabled =
+		    typename std::enable_if<
+		        !detail::IsIStringView<
+			    typename std::decay<Arg>::type
+			>::value,
+			int
+		    >::type>
+      static Arg&& arg_(Arg&& arg, Enabled = 0) {
+	return std::forward<Arg>(arg);
+      }
+
+      template <typename C, typename T>
+      static ImmutableString<C, T> arg_(const ImmutableStringView<C, T>& v) {
+	return v.str_();
+      }
+    };
+
+    template <typename C, typename T>
+    constexpr const size_t ImmutableStringView<C, T>::NPOS;
+
+    template <typename C, typename T>
+    constexpr const size_t ImmutableStringView<C, T>::MAX_SPLITS;
+
+    template <typename C, typename T, typename A>
+    bool operator==(const ImmutableString<C, T, A>& left,
+		    const ImmutableStringView<C, T>& right) {
+      return right == left;
+    }
+
+    template <typename C, typename T, typename A>
+    bool operator!=(const ImmutableString<C, T, A>& left,
+		    const ImmutableStringView<C, T>& right) {
+      return right != left;
+    }
+
+    template <typename C, typename T, typename A>
+    bool operator<(const ImmutableString<C, T, A>& left,
+		   const ImmutableStringView<C, T>& right) {
+      return right > left;
+    }
+
+    template <typename C, typename T, typename A>
+    bool operator==(const std::basic_string<C, T, A>& left,
+		    const ImmutableStringView<C, T>& right) {
+      return right == left;
+    }
+
+    template <typename C, typename T, typename A>
+    bool operator!=(const std::basic_string<C, T, A>& left,
+		    const ImmutableStringView<C, T>& right) {
+      return right != left;
+    }
+
+    template <typename C, typename T, typename A>
+    bool operator<(const std::basic_string<C, T, A>& left,
+		   const ImmutableStringView<C, T>& right) {
+      return right > left;
+    }
+
+    template <typename C, size_t N, typename T>
+    bool operator==(C (&left)[N], const ImmutableStringView<T>& right) {
+      return right == left;
+    }
+
+    template <typename C, size_t N, typename T>
+    bool operator!=(C (&left)[N], const ImmutableStringView<T>& right) {
+      return right != left;
+    }
+
+    template <typename C, size_t N, typename T>
+    bool operator<(C (&left)[N], const ImmutableStringView<T>& right) {
+      return right > left;
+    }
+
+    template <typename Char, typename CharTraits>
+    std::basic_ostream<Char>& operator<<(
+	std::basic_ostream<Char>& out,
+	const ImmutableStringView<Char, CharTraits>& s
+    ) {
+      out.write(s.data(), s.size());
+      return out;
+    }
+
+    /** @brief View the characters of v as an ImmutableString, so the
+     *         transparent functors in IStringTransparent.hpp accept views
+     */
+    template <typename Char, typename CharTraits>
+    inline ImmutableString<Char, CharTraits> asIStringKey(
+	const ImmutableStringView<Char, CharTraits>& v
+    ) {
+      return ImmutableString<Char, CharTraits>::literal(v.data(), v.size());
+    }
+
+    typedef ImmutableStringView<char> IStringView;
+    typedef ImmutableStringView<wchar_t> WIStringView;
+    typedef IStringView U8_IStringView;
+    typedef ImmutableStringView<char16_t> U16_IStringView;
+    typedef ImmutableStringView<char32_t> U32_IStringView;
+
+  }
+}
+
+namespace std {
+
+  template <typename Char, typename CharTraits>
+  struct hash< pistis::util::ImmutableStringView<Char, CharTraits> > {
+    size_t operator()(
+	const pistis::util::ImmutableStringView<Char, CharTraits>& s
+    ) const {
+      return s.hash();
+    }
+  };
+
+}
+
+#endif
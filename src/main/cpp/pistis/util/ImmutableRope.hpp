@@ -0,0 +1,538 @@
+#ifndef __PISTIS__UTIL__IMMUTABLEROPE_HPP__
+#define __PISTIS__UTIL__IMMUTABLEROPE_HPP__
+
+#include <pistis/util/IString.hpp>
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace pistis {
+  namespace util {
+
+    /** @brief An immutable string stored as a balanced tree of
+     *         ImmutableString segments
+     *
+     *  Appending to or inserting into an ImmutableString copies both
+     *  strings, so assembling a large document one piece at a time takes
+     *  quadratic time.  An ImmutableRope joins trees instead, rebalancing
+     *  them the way an AVL tree does, so append(), insert(), substr() and
+     *  operator[] take O(log n) time in the number of segments.  Segments
+     *  are slices of the strings the rope was built from and share their
+     *  text.  Adjacent segments no longer than MAX_MERGED_SEGMENT_SIZE
+     *  characters together are merged, so a rope built a few characters
+     *  at a time does not end up with one segment per append.
+     *
+     *  The rope is converted to a single ImmutableString only when str()
+     *  is called, and the result is kept in the tree so later calls on
+     *  the same rope return it immediately.  Code that only needs to write
+     *  the rope out can visit its segments with forEachSegment() or the
+     *  segment iterators instead.
+     *
+     *  Copies of a rope share its tree, and like ImmutableStrings, ropes
+     *  may be read by many threads at once.
+     */
+    template <typename Char, typename CharTraits = std::char_traits<Char>,
+	      typename Allocator = std::allocator<uint8_t> >
+    class ImmutableRope {
+    public:
+      typedef Char CharType;
+      typedef CharTraits CharTraitsType;
+      typedef Allocator AllocatorType;
+      typedef ImmutableString<Char, CharTraits, Allocator> StringType;
+
+      static constexpr const size_t NPOS = StringType::NPOS;
+
+      /** @brief Largest segment produced by merging adjacent segments */
+      static constexpr const size_t MAX_MERGED_SEGMENT_SIZE = 128;
+
+    private:
+      struct Node;
+      typedef std::shared_ptr<const Node> NodePtr;
+
+      struct Node {
+	size_t size;
+	uint32_t height;
+
+	// The text of a leaf, or for a concatenation, its text once str()
+	// has been called on it
+	mutable StringType segment;
+
+	// Set for concatenations only
+	NodePtr left;
+	NodePtr right;
+	mutable std::once_flag flattenOnce;
+
+	Node(const StringType& s):
+	    size(s.size()), height(0), segment(s), left(), right(),
+	    flattenOnce() {
+	}
+
+	Node(const NodePtr& l, const NodePtr& r, const Allocator& allocator):
+	    size(l->size + r->size),
+	    height(std::max(l->height, r->height) + 1), segment(allocator),
+	    left(l), right(r), flattenOnce() {
+	}
+
+	bool isLeaf() const { return !left; }
+      };
+
+    public:
+      /** @brief Iterates over a rope's segments from first to last
+       *
+       *  Valid only as long as the rope it came from.
+       */
+      class SegmentIterator {
+      public:
+	typedef std::forward_iterator_tag iterator_category;
+	typedef StringType value_type;
+	typedef ptrdiff_t difference_type;
+	typedef const StringType& reference;
+	typedef const StringType* pointer;
+
+      public:
+	SegmentIterator(): current_(nullptr), pending_() { }
+
+	const StringType& operator*() const { return current_->segment; }
+	const StringType* operator->() const { return &current_->segment; }
+
+	SegmentIterator& operator++() {
+	  if (pending_.empty()) {
+	    current_ = nullptr;
+	  } else {
+	    const Node* const next = pending_.back();
+	    pending_.pop_back();
+	    descend_(next);
+	  }
+	  return *this;
+	}
+
+	SegmentIterator operator++(int) {
+	  SegmentIterator tmp(*this);
+	  ++(*this);
+	  return tmp;
+	}
+
+	bool operator==(const SegmentIterator& other) const {
+	  return (current_ == other.current_) && (pending_ == other.pending_);
+	}
+
+	bool operator!=(const SegmentIterator& other) const {
+	  return !(*this == other);
+	}
+
+      private:
+	// The current leaf, and the right subtrees still to visit with the
+	// nearest one last
+	const Node* current_;
+	std::vector<const Node*> pending_;
+
+	SegmentIterator(const Node* root): current_(nullptr), pending_() {
+	  if (root) {
+	    descend_(root);
+	  }
+	}
+
+	void descend_(const Node* n) {
+	  while (!n->isLeaf()) {
+	    pending_.push_back(n->right.get());
+	    n = n->left.get();
+	  }
+	  current_ = n;
+	}
+
+	friend class ImmutableRope;
+      };
+
+    public:
+      ImmutableRope(const Allocator& allocator = Allocator()):
+	  allocator_(allocator), root_() {
+      }
+
+      explicit ImmutableRope(const StringType& s):
+	  allocator_(s.allocator()), root_(makeLeaf_(s)) {
+      }
+
+      ImmutableRope(const ImmutableRope&) = default;
+      ImmutableRope(ImmutableRope&&) = default;
+
+      const Allocator& allocator() const { return allocator_; }
+
+      size_t size() const { return root_ ? root_->size : 0; }
+
+      /** @brief Number of concatenations on the longest path from the
+       *         root of the rope's tree to a segment
+       */
+      size_t depth() const { return root_ ? root_->height : 0; }
+
+      /** @brief Return the character at position n
+       *
+       *  Takes O(log n) time.  Requires n < size().
+       */
+      Char operator[](size_t n) const {
+	const Node* p = root_.get();
+	while (!p->isLeaf()) {
+	  if (n < p->left->size) {
+	    p = p->left.get();
+	  } else {
+	    n -= p->left->size;
+	    p = p->right.get();
+	  }
+	}
+	return p->segment[n];
+      }
+
+      SegmentIterator segmentsBegin() const {
+	return SegmentIterator(root_.get());
+      }
+
+      SegmentIterator segmentsEnd() const { return SegmentIterator(); }
+
+      /** @brief Call f(segment) for each segment in order */
+      template <typename Function>
+      void forEachSegment(Function f) const {
+	for (auto i = segmentsBegin(); i != segmentsEnd(); ++i) {
+	  f(*i);
+	}
+      }
+
+      /** @brief Return the contents of the rope as an ImmutableString
+       *
+       *  Copies the rope's segments into a new string the first time it
+       *  is called on a tree and returns that string afterward.  A rope
+       *  with a single segment returns it without copying.
+       */
+      StringType str() const {
+	if (!root_) {
+	  return StringType(allocator_);
+	} else if (root_->isLeaf()) {
+	  return root_->segment;
+	}
+	std::call_once(root_->flattenOnce, [this]() {
+	  ImmutableStringBuilder<Char, CharTraits, Allocator> builder(
+	      root_->size, allocator_
+	  );
+	  forEachSegment([&builder](const StringType& s) {
+	    builder.append(s.data(), s.data() + s.size());
+	  });
+	  root_->segment = builder.done();
+	});
+	return root_->segment;
+      }
+
+      /** @brief Return the characters from start up to but not including
+       *         end
+       */
+      ImmutableRope substr(size_t start, size_t end = NPOS) const {
+	end = std::min(end, size());
+	start = std::min(start, end);
+	return ImmutableRope(allocator_, slice_(root_, start, end));
+      }
+
+      ImmutableRope append(const ImmutableRope& suffix) const {
+	return ImmutableRope(allocator_, join_(root_, suffix.root_));
+      }
+
+      ImmutableRope append(const StringType& suffix) const {
+	return ImmutableRope(allocator_, join_(root_, makeLeaf_(suffix)));
+      }
+
+      /** @brief Return a rope with text inserted before position pos
+       *
+       *  Positions past the end of the rope insert at the end.
+       */
+      ImmutableRope insert(size_t pos, const ImmutableRope& text) const {
+	return insert_(pos, text.root_);
+      }
+
+      ImmutableRope insert(size_t pos, const StringType& text) const {
+	return insert_(pos, makeLeaf_(text));
+      }
+
+      int cmp(const ImmutableRope& other) const {
+	return cmp_(other.segmentsBegin(), other.segmentsEnd());
+      }
+
+      int cmp(const StringType& other) const {
+	const StringType* const p = &other;
+	return cmp_(p, p + 1);
+      }
+
+      ImmutableRope& operator=(const ImmutableRope&) = default;
+      ImmutableRope& operator=(ImmutableRope&&) = default;
+
+      bool operator==(const ImmutableRope& other) const {
+	return (size() == other.size()) && !cmp(other);
+      }
+
+      bool operator!=(const ImmutableRope& other) const {
+	return !(*this == other);
+      }
+
+      bool operator==(const StringType& other) const {
+	return (size() == other.size()) && !cmp(other);
+      }
+
+      bool operator!=(const StringType& other) const {
+	return !(*this == other);
+      }
+
+    private:
+      Allocator allocator_;
+      NodePtr root_;
+
+      ImmutableRope(const Allocator& allocator, NodePtr&& root):
+	  allocator_(allocator), root_(std::move(root)) {
+      }
+
+      NodePtr makeLeaf_(const StringType& s) const {
+	if (!s.size()) {
+	  return NodePtr();
+	}
+	return std::allocate_shared<Node>(allocator_, s);
+      }
+
+      NodePtr makeConcat_(const NodePtr& left, const NodePtr& right) const {
+	return std::allocate_shared<Node>(allocator_, left, right, allocator_);
+      }
+
+      NodePtr mergeLeaves_(const NodePtr& left, const NodePtr& right) const {
+	return makeLeaf_(left->segment.append(right->segment));
+      }
+
+      static bool canMerge_(const NodePtr& left, const NodePtr& right) {
+	return left->isLeaf() && right->isLeaf() &&
+	       (left->size + right->size <= MAX_MERGED_SEGMENT_SIZE);
+      }
+
+      static const NodePtr& firstLeaf_(const NodePtr& n) {
+	return n->isLeaf() ? n : firstLeaf_(n->left);
+      }
+
+      static const NodePtr& lastLeaf_(const NodePtr& n) {
+	return n->isLeaf() ? n : lastLeaf_(n->right);
+      }
+
+      // Replacing a leaf with another leaf leaves the tree balanced
+
+      NodePtr replaceFirstLeaf_(const NodePtr& n, const NodePtr& leaf) const {
+	return n->isLeaf() ? leaf
+	                   : makeConcat_(replaceFirstLeaf_(n->left, leaf),
+					 n->right);
+      }
+
+      NodePtr replaceLastLeaf_(const NodePtr& n, const NodePtr& leaf) const {
+	return n->isLeaf() ? leaf
+	                   : makeConcat_(n->left,
+					 replaceLastLeaf_(n->right, leaf));
+      }
+
+      /** @brief Concatenate two trees into one balanced tree */
+      NodePtr join_(const NodePtr& left, const NodePtr& right) const {
+	if (!left) {
+	  return right;
+	} else if (!right) {
+	  return left;
+	} else if (canMerge_(left, right)) {
+	  return mergeLeaves_(left, right);
+	}
+
+	// Merge a short segment with the segment it ends up next to
+	if (right->isLeaf() && (right->size < MAX_MERGED_SEGMENT_SIZE)) {
+	  const NodePtr& last = lastLeaf_(left);
+	  if (canMerge_(last, right)) {
+	    return replaceLastLeaf_(left, mergeLeaves_(last, right));
+	  }
+	}
+	if (left->isLeaf() && (left->size < MAX_MERGED_SEGMENT_SIZE)) {
+	  const NodePtr& first = firstLeaf_(right);
+	  if (canMerge_(left, first)) {
+	    return replaceFirstLeaf_(right, mergeLeaves_(left, first));
+	  }
+	}
+
+	if (left->height > right->height + 1) {
+	  return joinRight_(left, right);
+	} else if (right->height > left->height + 1) {
+	  return joinLeft_(left, right);
+	} else {
+	  return makeConcat_(left, right);
+	}
+      }
+
+      // joinRight_() and joinLeft_() are the AVL join from Blelloch,
+      // Ferizovic and Sun, "Just Join for Parallel Ordered Sets" (2016),
+      // without the key between the two trees.  They take time
+      // proportional to the difference in the trees' heights.
+
+      // Requires left->height > right->height + 1
+      NodePtr joinRight_(const NodePtr& left, const NodePtr& right) const {
+	const NodePtr& a = left->left;
+	const NodePtr& c = left->right;
+	if (c->height <= right->height + 1) {
+	  NodePtr t = makeConcat_(c, right);
+	  if (t->height <= a->height + 1) {
+	    return makeConcat_(a, t);
+	  }
+	  return rotateLeft_(a, rotateRight_(t->left, t->right));
+	}
+	NodePtr t = joinRight_(c, right);
+	if (t->height <= a->height + 1) {
+	  return makeConcat_(a, t);
+	}
+	return rotateLeft_(a, t);
+      }
+
+      // Requires right->height > left->height + 1
+      NodePtr joinLeft_(const NodePtr& left, const NodePtr& right) const {
+	const NodePtr& a = right->right;
+	const NodePtr& c = right->left;
+	if (c->height <= left->height + 1) {
+	  NodePtr t = makeConcat_(left, c);
+	  if (t->height <= a->height + 1) {
+	    return makeConcat_(t, a);
+	  }
+	  return rotateRight_(rotateLeft_(t->left, t->right), a);
+	}
+	NodePtr t = joinLeft_(left, c);
+	if (t->height <= a->height + 1) {
+	  return makeConcat_(t, a);
+	}
+	return rotateRight_(t, a);
+      }
+
+      // (left, (x, y)) -> ((left, x), y)
+      NodePtr rotateLeft_(const NodePtr& left, const NodePtr& right) const {
+	return makeConcat_(makeConcat_(left, right->left), right->right);
+      }
+
+      // ((x, y), right) -> (x, (y, right))
+      NodePtr rotateRight_(const NodePtr& left, const NodePtr& right) const {
+	return makeConcat_(left->left, makeConcat_(left->right, right));
+      }
+
+      /** @brief Return the tree for characters [start, end) of n */
+      NodePtr slice_(const NodePtr& n, size_t start, size_t end) const {
+	if (start >= end) {
+	  return NodePtr();
+	} else if (!start && (end == n->size)) {
+	  return n;
+	} else if (n->isLeaf()) {
+	  return makeLeaf_(n->segment.substr(start, end));
+	}
+
+	const size_t leftSize = n->left->size;
+	if (end <= leftSize) {
+	  return slice_(n->left, start, end);
+	} else if (start >= leftSize) {
+	  return slice_(n->right, start - leftSize, end - leftSize);
+	} else {
+	  return join_(slice_(n->left, start, leftSize),
+		       slice_(n->right, 0, end - leftSize));
+	}
+      }
+
+      ImmutableRope insert_(size_t pos, const NodePtr& text) const {
+	pos = std::min(pos, size());
+	return ImmutableRope(
+	    allocator_,
+	    join_(join_(slice_(root_, 0, pos), text),
+		  slice_(root_, pos, size()))
+	);
+      }
+
+      template <typename Iterator>
+      int cmp_(Iterator otherSegment, const Iterator& otherEnd) const {
+	SegmentIterator segment = segmentsBegin();
+	const SegmentIterator end = segmentsEnd();
+	size_t i = 0, j = 0;
+
+	while ((segment != end) && (otherSegment != otherEnd)) {
+	  const size_t n = std::min(segment->size() - i,
+				    otherSegment->size() - j);
+	  const int c = CharTraits::compare(segment->data() + i,
+					    otherSegment->data() + j, n);
+	  if (c) {
+	    return c;
+	  }
+	  i += n;
+	  j += n;
+	  if (i == segment->size()) {
+	    ++segment;
+	    i = 0;
+	  }
+	  if (j == otherSegment->size()) {
+	    ++otherSegment;
+	    j = 0;
+	  }
+	}
+
+	if (segment != end) {
+	  return 1;
+	} else if ((otherSegment != otherEnd) && otherSegment->size()) {
+	  return -1;
+	} else {
+	  return 0;
+	}
+      }
+    };
+
+    template <typename C, typename T, typename A>
+    const size_t ImmutableRope<C, T, A>::NPOS;
+
+    template <typename C, typename T, typename A>
+    const size_t ImmutableRope<C, T, A>::MAX_MERGED_SEGMENT_SIZE;
+
+    template <typename C, typename T, typename A>
+    ImmutableRope<C, T, A> operator+(const ImmutableRope<C, T, A>& left,
+				     const ImmutableRope<C, T, A>& right) {
+      return left.append(right);
+    }
+
+    template <typename C, typename T, typename A>
+    ImmutableRope<C, T, A> operator+(const ImmutableRope<C, T, A>& left,
+				     const ImmutableString<C, T, A>& right) {
+      return left.append(right);
+    }
+
+    template <typename C, typename T, typename A>
+    ImmutableRope<C, T, A> operator+(const ImmutableString<C, T, A>& left,
+				     const ImmutableRope<C, T, A>& right) {
+      return right.insert(0, left);
+    }
+
+    template <typename C, typename T, typename A>
+    bool operator==(const ImmutableString<C, T, A>& left,
+		    const ImmutableRope<C, T, A>& right) {
+      return right == left;
+    }
+
+    template <typename C, typename T, typename A>
+    bool operator!=(const ImmutableString<C, T, A>& left,
+		    const ImmutableRope<C, T, A>& right) {
+      return right != left;
+    }
+
+    template <typename C, typename T, typename A>
+    std::basic_ostream<C>& operator<<(std::basic_ostream<C>& out,
+				      const ImmutableRope<C, T, A>& rope) {
+      rope.forEachSegment([&out](const ImmutableString<C, T, A>& s) {
+	out.write(s.data(), s.size());
+      });
+      return out;
+    }
+
+    typedef ImmutableRope<char> IRope;
+    typedef ImmutableRope<wchar_t> WIRope;
+    typedef IRope U8_IRope;
+    typedef ImmutableRope<char16_t> U16_IRope;
+    typedef ImmutableRope<char32_t> U32_IRope;
+
+  }
+}
+#endif
@@ -0,0 +1,174 @@
+#ifndef __PISTIS__UTIL__INTERNPOOL_HPP__
+#define __PISTIS__UTIL__INTERNPOOL_HPP__
+
+#include <pistis/util/detail/IStringText.hpp>
+#include <pistis/util/detail/IStringHash.hpp>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace pistis {
+  namespace util {
+
+    template <typename Char, typename CharTraits, typename Allocator>
+    class ImmutableString;
+
+    /** @brief Canonicalizes the text of ImmutableStrings
+     *
+     *  An InternPool maps each distinct sequence of characters to a
+     *  single shared IStringText.  Strings obtained from
+     *  ImmutableString::intern() with the same content therefore share
+     *  the same text, which lets equality and hashing use the text's
+     *  address instead of its content (see InternedIStringHash and
+     *  InternedIStringEqual).
+     *
+     *  The pool does not own its texts.  When the last string referring
+     *  to an interned text goes away, the text removes itself from the
+     *  pool and is freed, so the pool only ever holds texts that are in
+     *  use.  The pool is divided into NUM_SHARDS independently locked
+     *  shards selected by hash code, so threads interning different
+     *  strings rarely contend with each other.
+     *
+     *  There is one pool per character and allocator type, returned by
+     *  global().  Strings interned together share their text regardless
+     *  of which allocator instance they came from, so the allocator
+     *  instances used with a pool should compare equal.
+     */
+    template <typename Char, typename Allocator = std::allocator<uint8_t> >
+    class InternPool {
+    private:
+      typedef detail::IStringText<Char> Text;
+      typedef detail::IStringTextPtr<Char, Allocator> TextPtr;
+
+    public:
+      static constexpr const size_t NUM_SHARDS = 64;
+
+    public:
+      InternPool(const InternPool&) = delete;
+
+      /** @brief Number of distinct texts in the pool */
+      size_t size() const {
+	size_t n = 0;
+	for (const Shard& shard : shards_) {
+	  std::lock_guard<std::mutex> lock(shard.lock);
+	  n += shard.texts.size();
+	}
+	return n;
+      }
+
+      /** @brief Return the pool's text for the n characters starting at
+       *         p, adding a copy of them to the pool if necessary.
+       */
+      TextPtr intern(const Char* p, size_t n, const Allocator& allocator) {
+	const size_t h = detail::hashIStringChars(p, n);
+	Shard& shard = shardFor_(h);
+	std::lock_guard<std::mutex> lock(shard.lock);
+	auto range = shard.texts.equal_range(h);
+
+	for (auto i = range.first; i != range.second; ++i) {
+	  Text* const text = i->second;
+	  if ((text->numChars() == n) &&
+	      std::equal(p, p + n, text->chars())) {
+	    if (Text::tryAddRef(text)) {
+	      return TextPtr::adopt(text, allocator);
+	    }
+	    // The last reference to this text is being released.  Replace
+	    // it with a new text; remove_() will leave the new one alone.
+	    shard.texts.erase(i);
+	    break;
+	  }
+	}
+
+	Allocator newAllocator(allocator);
+	TextPtr text = TextPtr::create(n, p, newAllocator);
+	text->hashCode.store(h, std::memory_order_relaxed);
+	shard.texts.emplace(h, text.get());
+	// Not marked until it is in the pool, so that if emplace() throws,
+	// releasing the text does not try to remove it.
+	text->sizeAndFlags |= Text::INTERNED;
+	return text;
+      }
+
+      InternPool& operator=(const InternPool&) = delete;
+
+      /** @brief The pool used by ImmutableString::intern() */
+      static InternPool& global() {
+	// Never destroyed, so strings that outlive static destruction can
+	// still remove their text from the pool.
+	static InternPool* pool = new InternPool();
+	return *pool;
+      }
+
+    private:
+      struct Shard {
+	mutable std::mutex lock;
+	std::unordered_multimap<size_t, Text*> texts;
+
+	// Keep neighboring shards' locks off the same cache line
+	char padding[64];
+      };
+
+      Shard shards_[NUM_SHARDS];
+
+      InternPool() { }
+
+      Shard& shardFor_(size_t h) {
+	return shards_[((h * 0x9E3779B97F4A7C15ull) >> 32) % NUM_SHARDS];
+      }
+
+      void remove_(Text* t) {
+	const size_t h = t->hash();
+	Shard& shard = shardFor_(h);
+	std::lock_guard<std::mutex> lock(shard.lock);
+	auto range = shard.texts.equal_range(h);
+	for (auto i = range.first; i != range.second; ++i) {
+	  if (i->second == t) {
+	    shard.texts.erase(i);
+	    break;
+	  }
+	}
+      }
+
+      friend class detail::IStringTextPtr<Char, Allocator>;
+    };
+
+    template <typename Char, typename Allocator>
+    const size_t InternPool<Char, Allocator>::NUM_SHARDS;
+
+    /** @brief Hashes interned strings by the address of their text
+     *
+     *  Only valid for containers whose keys all come from
+     *  ImmutableString::intern().
+     */
+    struct InternedIStringHash {
+      template <typename Char, typename CharTraits, typename Allocator>
+      size_t operator()(
+	  const ImmutableString<Char, CharTraits, Allocator>& s
+      ) const {
+	return std::hash<const Char*>()(s.data());
+      }
+    };
+
+    /** @brief Compares interned strings by the address of their text
+     *
+     *  Only valid for containers whose keys all come from
+     *  ImmutableString::intern().
+     */
+    struct InternedIStringEqual {
+      template <typename Char, typename CharTraits, typename Allocator>
+      bool operator()(
+	  const ImmutableString<Char, CharTraits, Allocator>& left,
+	  const ImmutableString<Char, CharTraits, Allocator>& right
+      ) const {
+	return (left.data() == right.data()) && (left.size() == right.size());
+      }
+    };
+
+  }
+}
+#endif
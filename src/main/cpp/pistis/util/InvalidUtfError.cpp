@@ -0,0 +1,23 @@
+#include <pistis/util/InvalidUtfError.hpp>
+#include <sstream>
+
+using namespace pistis::exceptions;
+using namespace pistis::util;
+
+InvalidUtfError::InvalidUtfError(
+    const std::string& details, size_t offset,
+    const pistis::exceptions::ExceptionOrigin& origin
+): PistisException(details, origin), offset_(offset) {
+}
+
+InvalidUtfError::~InvalidUtfError() noexcept {
+}
+
+InvalidUtfError InvalidUtfError::invalidSequence(
+    const std::string& encoding, size_t offset,
+    const pistis::exceptions::ExceptionOrigin& origin
+) {
+  std::ostringstream msg;
+  msg << "Invalid " << encoding << " sequence at code unit " << offset;
+  return InvalidUtfError(msg.str(), offset, origin);
+}
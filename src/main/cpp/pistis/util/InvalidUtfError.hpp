@@ -0,0 +1,42 @@
+#ifndef __PISTIS__UTIL__INVALIDUTFERROR_HPP__
+#define __PISTIS__UTIL__INVALIDUTFERROR_HPP__
+
+#include <pistis/exceptions/PistisException.hpp>
+#include <string>
+#include <stddef.h>
+
+namespace pistis {
+  namespace util {
+
+    /** @brief Thrown when a string that should be UTF-8, UTF-16 or UTF-32
+     *         is not
+     */
+    class InvalidUtfError : public pistis::exceptions::PistisException {
+    public:
+      InvalidUtfError(const std::string& details, size_t offset,
+		      const pistis::exceptions::ExceptionOrigin& origin);
+      virtual ~InvalidUtfError() noexcept;
+
+      /** @brief Offset, in code units, of the start of the first invalid
+       *         sequence
+       */
+      size_t offset() const { return offset_; }
+
+      /** @brief Create an error for an invalid sequence
+       *
+       *  @param encoding  Name of the encoding, such as "UTF-8"
+       *  @param offset    Where the invalid sequence starts
+       *  @param origin    Where the error was detected
+       */
+      static InvalidUtfError invalidSequence(
+	  const std::string& encoding, size_t offset,
+	  const pistis::exceptions::ExceptionOrigin& origin
+      );
+
+    private:
+      size_t offset_;
+    };
+
+  }
+}
+#endif
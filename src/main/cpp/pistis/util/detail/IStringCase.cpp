@@ -0,0 +1,192 @@
+#include "IStringCase.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PISTIS_ISTRING_CASE_X86
+#include <immintrin.h>
+#endif
+
+using namespace pistis::util::detail;
+
+namespace {
+
+  // Strings shorter than a vector are processed one unit at a time
+  constexpr size_t MIN_VECTOR_SIZE = 32;
+
+#ifdef PISTIS_ISTRING_CASE_X86
+
+  // A byte c is in [low, low + span] when c - low, computed modulo 256,
+  // is no greater than span.  Returns a mask with 0xFF in the lanes that
+  // are.
+  __attribute__((target("avx2")))
+  inline __m256i avx2InRange(__m256i v, __m256i low, __m256i span) {
+    const __m256i t = _mm256_sub_epi8(v, low);
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(t, span), t);
+  }
+
+  // Returns 0xFF in the lanes where l and r are equal or are the same
+  // ASCII letter in different cases.  They are when l ^ r is zero, or
+  // when it is 0x20 and l | 0x20 is one of a-z.
+  __attribute__((target("avx2")))
+  inline __m256i avx2EqualIgnoringCase(__m256i l, __m256i r) {
+    const __m256i caseBit = _mm256_set1_epi8(0x20);
+    const __m256i letters = avx2InRange(_mm256_or_si256(l, caseBit),
+					_mm256_set1_epi8('a'),
+					_mm256_set1_epi8(25));
+    const __m256i allowed = _mm256_and_si256(letters, caseBit);
+    return _mm256_cmpeq_epi8(
+	_mm256_or_si256(_mm256_xor_si256(l, r), allowed), allowed
+    );
+  }
+
+  __attribute__((target("avx2")))
+  size_t avx2FindFirstInRange(const uint8_t* text, size_t n, uint8_t low,
+			      uint8_t high, bool inside) {
+    const __m256i vLow = _mm256_set1_epi8((char)low);
+    const __m256i vSpan = _mm256_set1_epi8((char)(high - low));
+    const uint32_t flip = inside ? 0 : 0xFFFFFFFF;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+      const __m256i v = _mm256_loadu_si256((const __m256i*)(text + i));
+      const uint32_t mask =
+	  (uint32_t)_mm256_movemask_epi8(avx2InRange(v, vLow, vSpan)) ^ flip;
+      if (mask) {
+	return i + __builtin_ctz(mask);
+      }
+    }
+    return i + (inside ? findFirstInRange<uint8_t>(text + i, n - i, low, high)
+		       : findFirstNotInRange<uint8_t>(text + i, n - i, low,
+						      high));
+  }
+
+  __attribute__((target("avx2")))
+  size_t avx2FindFirstInRange(const uint8_t* text, size_t n, uint8_t low,
+			      uint8_t high) {
+    return avx2FindFirstInRange(text, n, low, high, true);
+  }
+
+  __attribute__((target("avx2")))
+  size_t avx2FindFirstNotInRange(const uint8_t* text, size_t n, uint8_t low,
+				 uint8_t high) {
+    return avx2FindFirstInRange(text, n, low, high, false);
+  }
+
+  __attribute__((target("avx2")))
+  void avx2SwitchCase(const uint8_t* text, size_t n, uint8_t* out,
+		      uint8_t first) {
+    const __m256i vFirst = _mm256_set1_epi8((char)first);
+    const __m256i vSpan = _mm256_set1_epi8(25);
+    const __m256i vBit = _mm256_set1_epi8(0x20);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+      const __m256i v = _mm256_loadu_si256((const __m256i*)(text + i));
+      const __m256i letters = avx2InRange(v, vFirst, vSpan);
+      _mm256_storeu_si256((__m256i*)(out + i),
+			  _mm256_xor_si256(v, _mm256_and_si256(letters, vBit)));
+    }
+    switchAsciiCase<uint8_t>(text + i, n - i, out + i, first);
+  }
+
+  __attribute__((target("avx2")))
+  size_t avx2FindMismatchIgnoringCase(const uint8_t* left,
+				      const uint8_t* right, size_t n) {
+    size_t i = 0;
+    // Two vectors per iteration, with one branch for both
+    for (; i + 64 <= n; i += 64) {
+      const __m256i equal = _mm256_and_si256(
+	  avx2EqualIgnoringCase(
+	      _mm256_loadu_si256((const __m256i*)(left + i)),
+	      _mm256_loadu_si256((const __m256i*)(right + i))
+	  ),
+	  avx2EqualIgnoringCase(
+	      _mm256_loadu_si256((const __m256i*)(left + i + 32)),
+	      _mm256_loadu_si256((const __m256i*)(right + i + 32))
+	  )
+      );
+      if ((uint32_t)_mm256_movemask_epi8(equal) != 0xFFFFFFFF) {
+	break;
+      }
+    }
+    for (; i + 32 <= n; i += 32) {
+      const uint32_t equal = (uint32_t)_mm256_movemask_epi8(
+	  avx2EqualIgnoringCase(
+	      _mm256_loadu_si256((const __m256i*)(left + i)),
+	      _mm256_loadu_si256((const __m256i*)(right + i))
+	  )
+      );
+      if (equal != 0xFFFFFFFF) {
+	return i + __builtin_ctz(~equal);
+      }
+    }
+    return i + findMismatchIgnoringCase<uint8_t>(left + i, right + i, n - i);
+  }
+
+#endif
+
+  struct CaseKernels {
+    const char* name;
+    size_t (*findFirstInRange)(const uint8_t*, size_t, uint8_t, uint8_t);
+    size_t (*findFirstNotInRange)(const uint8_t*, size_t, uint8_t, uint8_t);
+    void (*switchCase)(const uint8_t*, size_t, uint8_t*, uint8_t);
+    size_t (*findMismatch)(const uint8_t*, const uint8_t*, size_t);
+  };
+
+  CaseKernels selectKernels() {
+#ifdef PISTIS_ISTRING_CASE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      return CaseKernels{ "avx2", avx2FindFirstInRange,
+			  avx2FindFirstNotInRange, avx2SwitchCase,
+			  avx2FindMismatchIgnoringCase };
+    }
+#endif
+    return CaseKernels{ "scalar", findFirstInRange<uint8_t>,
+			findFirstNotInRange<uint8_t>,
+			switchAsciiCase<uint8_t>,
+			findMismatchIgnoringCase<uint8_t> };
+  }
+
+  const CaseKernels& kernels() {
+    static const CaseKernels KERNELS = selectKernels();
+    return KERNELS;
+  }
+}
+
+namespace pistis {
+  namespace util {
+    namespace detail {
+
+      size_t findFirstInRange(const uint8_t* text, size_t n, uint8_t low,
+			      uint8_t high) {
+	return (n < MIN_VECTOR_SIZE)
+	           ? findFirstInRange<uint8_t>(text, n, low, high)
+	           : kernels().findFirstInRange(text, n, low, high);
+      }
+
+      size_t findFirstNotInRange(const uint8_t* text, size_t n, uint8_t low,
+				 uint8_t high) {
+	return (n < MIN_VECTOR_SIZE)
+	           ? findFirstNotInRange<uint8_t>(text, n, low, high)
+	           : kernels().findFirstNotInRange(text, n, low, high);
+      }
+
+      void switchAsciiCase(const uint8_t* text, size_t n, uint8_t* out,
+			   uint8_t first) {
+	if (n < MIN_VECTOR_SIZE) {
+	  switchAsciiCase<uint8_t>(text, n, out, first);
+	} else {
+	  kernels().switchCase(text, n, out, first);
+	}
+      }
+
+      size_t findMismatchIgnoringCase(const uint8_t* left,
+				      const uint8_t* right, size_t n) {
+	return (n < MIN_VECTOR_SIZE)
+	           ? findMismatchIgnoringCase<uint8_t>(left, right, n)
+	           : kernels().findMismatch(left, right, n);
+      }
+
+      const char* asciiCaseKernel() { return kernels().name; }
+
+    }
+  }
+}
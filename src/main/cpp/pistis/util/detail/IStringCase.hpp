@@ -0,0 +1,104 @@
+#ifndef __PISTIS__UTIL__DETAIL__ISTRINGCASE_HPP__
+#define __PISTIS__UTIL__DETAIL__ISTRINGCASE_HPP__
+
+/** @file IStringCase.hpp
+ *
+ *  ASCII case kernels for ImmutableString.  Only the letters A-Z and
+ *  a-z have case.  Every other code unit, including those of non-ASCII
+ *  letters and of UTF-8 sequences, is left alone, so the results do not
+ *  depend on the locale and never break a multi-byte character.
+ *
+ *  Byte strings are processed 32 bytes at a time with AVX2 when the CPU
+ *  supports it.  Wider code units, short strings and CPUs without AVX2
+ *  use scalar loops.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace pistis {
+  namespace util {
+    namespace detail {
+
+      /** @brief Fold c to lower case if it is an ASCII capital */
+      template <typename Unit>
+      constexpr Unit foldAsciiCase(Unit c) {
+	return ((c >= 'A') && (c <= 'Z')) ? (Unit)(c + ('a' - 'A')) : c;
+      }
+
+      /** @brief Return the offset of the first unit in [low, high], or n
+       *         if there is none.
+       */
+      size_t findFirstInRange(const uint8_t* text, size_t n, uint8_t low,
+			      uint8_t high);
+
+      template <typename Unit>
+      inline size_t findFirstInRange(const Unit* text, size_t n, Unit low,
+				     Unit high) {
+	size_t i = 0;
+	while ((i < n) && ((Unit)(text[i] - low) > (Unit)(high - low))) {
+	  ++i;
+	}
+	return i;
+      }
+
+      /** @brief Return the offset of the first unit outside [low, high],
+       *         or n if there is none.
+       */
+      size_t findFirstNotInRange(const uint8_t* text, size_t n, uint8_t low,
+				 uint8_t high);
+
+      template <typename Unit>
+      inline size_t findFirstNotInRange(const Unit* text, size_t n, Unit low,
+					Unit high) {
+	size_t i = 0;
+	while ((i < n) && ((Unit)(text[i] - low) <= (Unit)(high - low))) {
+	  ++i;
+	}
+	return i;
+      }
+
+      /** @brief Copy n units from text to out, switching the case of the
+       *         letters from first to first + 25
+       *
+       *  Pass 'A' to convert to lower case and 'a' to convert to upper
+       *  case.
+       */
+      void switchAsciiCase(const uint8_t* text, size_t n, uint8_t* out,
+			   uint8_t first);
+
+      template <typename Unit>
+      inline void switchAsciiCase(const Unit* text, size_t n, Unit* out,
+				  Unit first) {
+	for (size_t i = 0; i < n; ++i) {
+	  const Unit c = text[i];
+	  out[i] = ((Unit)(c - first) < 26) ? (Unit)(c ^ 0x20) : c;
+	}
+      }
+
+      /** @brief Return the first i such that left[i] and right[i] differ
+       *         other than in the case of an ASCII letter, or n if there
+       *         is no such i.
+       */
+      size_t findMismatchIgnoringCase(const uint8_t* left,
+				      const uint8_t* right, size_t n);
+
+      template <typename Unit>
+      inline size_t findMismatchIgnoringCase(const Unit* left,
+					     const Unit* right, size_t n) {
+	size_t i = 0;
+	while ((i < n) && (foldAsciiCase(left[i]) == foldAsciiCase(right[i]))) {
+	  ++i;
+	}
+	return i;
+      }
+
+      /** @brief Name of the kernels the byte versions use on this CPU:
+       *         "avx2" or "scalar"
+       */
+      const char* asciiCaseKernel();
+
+    }
+  }
+}
+#endif
@@ -0,0 +1,133 @@
+#include "IStringCompare.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PISTIS_ISTRING_COMPARE_X86
+#include <immintrin.h>
+#endif
+
+using namespace pistis::util::detail;
+
+namespace {
+
+  template <typename Narrow, typename Wide>
+  size_t scalarFindMismatch(const Narrow* narrow, const Wide* wide,
+			    size_t n) {
+    size_t i = 0;
+    while ((i < n) && ((Wide)narrow[i] == wide[i])) {
+      ++i;
+    }
+    return i;
+  }
+
+#ifdef PISTIS_ISTRING_COMPARE_X86
+
+  // Each loop widens one vector's worth of narrow units, compares them
+  // with the wide units, and stops at the first lane that differs.  The
+  // movemask has sizeof(Wide) bits per lane.
+
+  __attribute__((target("avx2")))
+  size_t avx2FindMismatch8To16(const uint8_t* narrow, const uint16_t* wide,
+			       size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      const __m256i w = _mm256_cvtepu8_epi16(
+	  _mm_loadu_si128((const __m128i*)(narrow + i))
+      );
+      const __m256i v = _mm256_loadu_si256((const __m256i*)(wide + i));
+      const uint32_t equal =
+	  (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi16(w, v));
+      if (equal != 0xFFFFFFFF) {
+	return i + __builtin_ctz(~equal) / 2;
+      }
+    }
+    return i + scalarFindMismatch(narrow + i, wide + i, n - i);
+  }
+
+  __attribute__((target("avx2")))
+  size_t avx2FindMismatch8To32(const uint8_t* narrow, const uint32_t* wide,
+			       size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+      const __m256i w = _mm256_cvtepu8_epi32(
+	  _mm_loadl_epi64((const __m128i*)(narrow + i))
+      );
+      const __m256i v = _mm256_loadu_si256((const __m256i*)(wide + i));
+      const uint32_t equal =
+	  (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi32(w, v));
+      if (equal != 0xFFFFFFFF) {
+	return i + __builtin_ctz(~equal) / 4;
+      }
+    }
+    return i + scalarFindMismatch(narrow + i, wide + i, n - i);
+  }
+
+  __attribute__((target("avx2")))
+  size_t avx2FindMismatch16To32(const uint16_t* narrow, const uint32_t* wide,
+				size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+      const __m256i w = _mm256_cvtepu16_epi32(
+	  _mm_loadu_si128((const __m128i*)(narrow + i))
+      );
+      const __m256i v = _mm256_loadu_si256((const __m256i*)(wide + i));
+      const uint32_t equal =
+	  (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi32(w, v));
+      if (equal != 0xFFFFFFFF) {
+	return i + __builtin_ctz(~equal) / 4;
+      }
+    }
+    return i + scalarFindMismatch(narrow + i, wide + i, n - i);
+  }
+
+#endif
+
+  struct CompareKernels {
+    const char* name;
+    size_t (*mismatch8To16)(const uint8_t*, const uint16_t*, size_t);
+    size_t (*mismatch8To32)(const uint8_t*, const uint32_t*, size_t);
+    size_t (*mismatch16To32)(const uint16_t*, const uint32_t*, size_t);
+  };
+
+  CompareKernels selectKernels() {
+#ifdef PISTIS_ISTRING_COMPARE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      return CompareKernels{ "avx2", avx2FindMismatch8To16,
+			     avx2FindMismatch8To32, avx2FindMismatch16To32 };
+    }
+#endif
+    return CompareKernels{ "scalar", scalarFindMismatch<uint8_t, uint16_t>,
+			   scalarFindMismatch<uint8_t, uint32_t>,
+			   scalarFindMismatch<uint16_t, uint32_t> };
+  }
+
+  const CompareKernels& kernels() {
+    static const CompareKernels KERNELS = selectKernels();
+    return KERNELS;
+  }
+}
+
+namespace pistis {
+  namespace util {
+    namespace detail {
+
+      size_t findWideningMismatch(const uint8_t* narrow, const uint16_t* wide,
+				  size_t n) {
+	return kernels().mismatch8To16(narrow, wide, n);
+      }
+
+      size_t findWideningMismatch(const uint8_t* narrow, const uint32_t* wide,
+				  size_t n) {
+	return kernels().mismatch8To32(narrow, wide, n);
+      }
+
+      size_t findWideningMismatch(const uint16_t* narrow,
+				  const uint32_t* wide, size_t n) {
+	return kernels().mismatch16To32(narrow, wide, n);
+      }
+
+      const char* wideningCompareKernel() { return kernels().name; }
+
+    }
+  }
+}
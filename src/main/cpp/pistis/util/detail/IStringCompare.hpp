@@ -0,0 +1,85 @@
+#ifndef __PISTIS__UTIL__DETAIL__ISTRINGCOMPARE_HPP__
+#define __PISTIS__UTIL__DETAIL__ISTRINGCOMPARE_HPP__
+
+/** @file IStringCompare.hpp
+ *
+ *  Kernels for comparing strings whose characters have different widths,
+ *  such as an IString and a U16_IString.  Under std::char_traits, a
+ *  narrow character equals a wide one when its code unit, zero-extended,
+ *  equals the wide code unit, so the kernels widen the narrow string 16
+ *  or 32 bytes at a time with AVX2 and compare.  CPUs without AVX2
+ *  compare one unit at a time.
+ */
+
+#include <pistis/util/detail/IStringSearch.hpp>
+#include <type_traits>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace pistis {
+  namespace util {
+    namespace detail {
+
+      /** @brief Return the first i such that narrow[i], zero-extended, is
+       *         not equal to wide[i], or n if there is no such i.
+       */
+      size_t findWideningMismatch(const uint8_t* narrow, const uint16_t* wide,
+				  size_t n);
+      size_t findWideningMismatch(const uint8_t* narrow, const uint32_t* wide,
+				  size_t n);
+      size_t findWideningMismatch(const uint16_t* narrow,
+				  const uint32_t* wide, size_t n);
+
+      /** @brief Name of the kernel findWideningMismatch() uses on this
+       *         CPU: "avx2" or "scalar"
+       */
+      const char* wideningCompareKernel();
+
+      // Shorter strings are compared inline rather than calling the kernels
+      constexpr size_t MIN_WIDENING_KERNEL_SIZE = 16;
+
+      template <typename Narrow, typename Wide>
+      inline size_t findWideningMismatch_(const Narrow* narrow,
+					  const Wide* wide, size_t n) {
+	if (n < MIN_WIDENING_KERNEL_SIZE) {
+	  size_t i = 0;
+	  while ((i < n) && ((Wide)narrow[i] == wide[i])) {
+	    ++i;
+	  }
+	  return i;
+	}
+	return findWideningMismatch(narrow, wide, n);
+      }
+
+      template <typename Narrow, typename Wide>
+      inline size_t findMismatch_(const Narrow* left, const Wide* right,
+				  size_t n, std::true_type) {
+	return findWideningMismatch_(left, right, n);
+      }
+
+      template <typename Wide, typename Narrow>
+      inline size_t findMismatch_(const Wide* left, const Narrow* right,
+				  size_t n, std::false_type) {
+	return findWideningMismatch_(right, left, n);
+      }
+
+      /** @brief Return the offset of the first character where left and
+       *         right differ, or n if they are the same.
+       *
+       *  C1 and C2 must have different sizes.
+       */
+      template <typename C1, typename C2>
+      inline size_t findMismatch(const C1* left, const C2* right, size_t n) {
+	static_assert(sizeof(C1) != sizeof(C2),
+		      "Character types must have different sizes");
+	typedef typename SearchUnitType<sizeof(C1)>::type Unit1;
+	typedef typename SearchUnitType<sizeof(C2)>::type Unit2;
+	return findMismatch_((const Unit1*)left, (const Unit2*)right, n,
+			     std::integral_constant<bool,
+			                            sizeof(C1) < sizeof(C2)>());
+      }
+
+    }
+  }
+}
+#endif
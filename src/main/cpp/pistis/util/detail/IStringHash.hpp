@@ -0,0 +1,26 @@
+#ifndef __PISTIS__UTIL__DETAIL__ISTRINGHASH_HPP__
+#define __PISTIS__UTIL__DETAIL__ISTRINGHASH_HPP__
+
+#include <pistis/util/IStringHash.hpp>
+#include <stddef.h>
+
+namespace pistis {
+  namespace util {
+    namespace detail {
+
+      /** @brief Compute the hash code for the n characters starting at p
+       *
+       *  This is the hash ImmutableString::hash() returns, and anything
+       *  that has to agree with it (such as the InternPool) should call
+       *  this function rather than computing its own.  It uses
+       *  DefaultIStringHasher.
+       */
+      template <typename Char>
+      inline size_t hashIStringChars(const Char* p, size_t n) {
+	return DefaultIStringHasher()(p, n);
+      }
+
+    }
+  }
+}
+#endif
@@ -0,0 +1,120 @@
+#ifndef __PISTIS__UTIL__DETAIL__ISTRINGPARALLEL_HPP__
+#define __PISTIS__UTIL__DETAIL__ISTRINGPARALLEL_HPP__
+
+/** @file IStringParallel.hpp
+ *
+ *  Chunked parallel search for ImmutableString::findAll(), count(),
+ *  replace() and remove().  The string is split into chunks, and each
+ *  chunk collects the matches that start inside it, reading up to
+ *  patternSize - 1 characters past its end so it sees matches that
+ *  straddle the boundary.  Each chunk starts its search at its own first
+ *  character, so its first few matches may overlap the last match of the
+ *  chunk before it.  A sequential pass over the chunks then drops those
+ *  and searches again from where the previous match ended, until the new
+ *  search lands on a match the chunk already found.  From there on both
+ *  searches find the same matches, so the result is exactly what one
+ *  search over the whole string would find.
+ */
+
+#include <algorithm>
+#include <future>
+#include <vector>
+#include <stddef.h>
+
+namespace pistis {
+  namespace util {
+    namespace detail {
+
+      /** @brief Call f(i) for every i in [0, n), calling f(0) on the
+       *         current thread and the others on threads of their own
+       *
+       *  Returns once every call has returned, and rethrows the first
+       *  exception any of them threw.
+       */
+      template <typename Function>
+      void forEachChunk(size_t n, const Function& f) {
+	std::vector< std::future<void> > others;
+	others.reserve(n ? n - 1 : 0);
+	for (size_t i = 1; i < n; ++i) {
+	  others.push_back(std::async(std::launch::async,
+				      [&f, i]() { f(i); }));
+	}
+	if (n) {
+	  f(0);
+	}
+	for (auto& other : others) {
+	  other.get();
+	}
+      }
+
+      /** @brief Split [0, n) into numChunks nearly equal chunks
+       *
+       *  Chunk i is [boundaries[i], boundaries[i + 1]).
+       */
+      inline std::vector<size_t> chunkBoundaries(size_t n, size_t numChunks) {
+	std::vector<size_t> boundaries(numChunks + 1);
+	const size_t chunkSize = n / numChunks;
+	const size_t extra = n % numChunks;
+	for (size_t i = 0; i <= numChunks; ++i) {
+	  boundaries[i] = i * chunkSize + std::min(i, extra);
+	}
+	return boundaries;
+      }
+
+      /** @brief Find the non-overlapping matches of a pattern of
+       *         patternSize characters in each chunk of a string of n
+       *         characters
+       *
+       *  find(start, end) returns the position of the first match that
+       *  lies entirely within [start, end), or a position past the end
+       *  of the string if there is none.  Returns the positions of the
+       *  matches that start in each chunk, in order.
+       */
+      template <typename Find>
+      std::vector< std::vector<size_t> > findInChunks(
+	  const std::vector<size_t>& boundaries, size_t n, size_t patternSize,
+	  const Find& find
+      ) {
+	const size_t numChunks = boundaries.size() - 1;
+	std::vector< std::vector<size_t> > matches(numChunks);
+	auto searchEnd = [&boundaries, n, patternSize](size_t i) {
+	  return std::min(boundaries[i + 1] + patternSize - 1, n);
+	};
+
+	forEachChunk(numChunks, [&](size_t i) {
+	  const size_t e = searchEnd(i);
+	  for (size_t p = find(boundaries[i], e); p < boundaries[i + 1];
+	       p = find(p + patternSize, e)) {
+	    matches[i].push_back(p);
+	  }
+	});
+
+	size_t lastEnd = 0;
+	for (size_t i = 0; i < numChunks; ++i) {
+	  std::vector<size_t>& found = matches[i];
+	  if (!found.empty() && (found.front() < lastEnd)) {
+	    const size_t e = searchEnd(i);
+	    std::vector<size_t> resynced;
+	    auto k = found.begin();
+	    for (size_t p = find(lastEnd, e); p < boundaries[i + 1];
+		 p = find(p + patternSize, e)) {
+	      k = std::lower_bound(k, found.end(), p);
+	      if ((k != found.end()) && (*k == p)) {
+		resynced.insert(resynced.end(), k, found.end());
+		break;
+	      }
+	      resynced.push_back(p);
+	    }
+	    found.swap(resynced);
+	  }
+	  if (!found.empty()) {
+	    lastEnd = found.back() + patternSize;
+	  }
+	}
+	return matches;
+      }
+
+    }
+  }
+}
+#endif
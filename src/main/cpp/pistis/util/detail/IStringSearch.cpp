@@ -0,0 +1,685 @@
+#include "IStringSearch.hpp"
+#include <algorithm>
+#include <iterator>
+#include <string.h>
+#include <sys/types.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PISTIS_ISTRING_SEARCH_X86
+#include <immintrin.h>
+#endif
+
+using namespace pistis::util::detail;
+
+namespace {
+
+  // Two-Way (Crochemore and Perrin, 1991).  Splits the pattern at a
+  // critical factorization and matches the right half left-to-right,
+  // then the left half right-to-left, which bounds the work to O(n + m)
+  // comparisons with O(1) extra space.
+
+  // Both take random-access iterators, so searching with reverse
+  // iterators finds the last occurrence instead of the first.
+
+  template <typename Iterator>
+  ssize_t maximalSuffix(Iterator x, ssize_t m, ssize_t& period,
+			bool reversed) {
+    ssize_t ms = -1, j = 0, k = 1;
+    period = 1;
+    while (j + k < m) {
+      const auto a = x[j + k];
+      const auto b = x[ms + k];
+      if (reversed ? (a > b) : (a < b)) {
+	j += k;
+	k = 1;
+	period = j - ms;
+      } else if (a == b) {
+	if (k != period) {
+	  ++k;
+	} else {
+	  j += period;
+	  k = 1;
+	}
+      } else {
+	ms = j;
+	j = ms + 1;
+	k = period = 1;
+      }
+    }
+    return ms;
+  }
+
+  template <typename Iterator>
+  size_t twoWay(Iterator y, size_t n, Iterator x, size_t m) {
+    if (m > n) {
+      return n;
+    }
+
+    ssize_t p, q;
+    const ssize_t sm = m, sn = n;
+    const ssize_t i1 = maximalSuffix(x, sm, p, false);
+    const ssize_t i2 = maximalSuffix(x, sm, q, true);
+    const ssize_t ell = (i1 > i2) ? i1 : i2;
+    ssize_t per = (i1 > i2) ? p : q;
+
+    if (std::equal(x, x + ell + 1, x + per)) {
+      // The pattern is periodic.  Remember how much of the previous
+      // window's left half is known to match.
+      ssize_t memory = -1;
+      for (ssize_t j = 0; j <= sn - sm; ) {
+	ssize_t i = std::max(ell, memory) + 1;
+	while ((i < sm) && (x[i] == y[i + j])) {
+	  ++i;
+	}
+	if (i >= sm) {
+	  i = ell;
+	  while ((i > memory) && (x[i] == y[i + j])) {
+	    --i;
+	  }
+	  if (i <= memory) {
+	    return j;
+	  }
+	  j += per;
+	  memory = sm - per - 1;
+	} else {
+	  j += i - ell;
+	  memory = -1;
+	}
+      }
+    } else {
+      per = std::max(ell + 1, sm - ell - 1) + 1;
+      for (ssize_t j = 0; j <= sn - sm; ) {
+	ssize_t i = ell + 1;
+	while ((i < sm) && (x[i] == y[i + j])) {
+	  ++i;
+	}
+	if (i >= sm) {
+	  i = ell;
+	  while ((i >= 0) && (x[i] == y[i + j])) {
+	    --i;
+	  }
+	  if (i < 0) {
+	    return j;
+	  }
+	  j += per;
+	} else {
+	  j += i - ell;
+	}
+      }
+    }
+    return n;
+  }
+
+  template <typename Unit>
+  size_t twoWaySearch(const Unit* text, size_t n, const Unit* pattern,
+		      size_t m) {
+    return twoWay(text, n, pattern, m);
+  }
+
+  template <typename Unit>
+  size_t twoWayReverseSearch(const Unit* text, size_t n, const Unit* pattern,
+			     size_t m) {
+    typedef std::reverse_iterator<const Unit*> Reversed;
+    const size_t j = twoWay(Reversed(text + n), n, Reversed(pattern + m), m);
+    return (j < n) ? (n - j - m) : n;
+  }
+
+  // Checks every position from start on.  Only used for the few
+  // positions left over after a vectorized scan.
+  template <typename Unit>
+  size_t naiveSearch(const Unit* text, size_t n, const Unit* pattern,
+		     size_t m, size_t start) {
+    for (size_t j = start; j + m <= n; ++j) {
+      if ((text[j] == pattern[0]) &&
+	  !memcmp(text + j + 1, pattern + 1, (m - 1) * sizeof(Unit))) {
+	return j;
+      }
+    }
+    return n;
+  }
+
+  // Switch to Two-Way once failed verifications have cost this many
+  // times the number of units scanned so far
+  const size_t MAX_VERIFY_RATIO = 8;
+  const size_t MIN_VERIFY_BUDGET = 1024;
+
+  // Continue a search from start with Two-Way
+  template <typename Unit>
+  size_t twoWayFrom(const Unit* text, size_t n, const Unit* pattern,
+		    size_t m, size_t start) {
+    const size_t p = twoWay(text + start, n - start, pattern, m);
+    return (p < n - start) ? start + p : n;
+  }
+
+  // Checks every position below end, last first
+  template <typename Unit>
+  size_t naiveReverseSearch(const Unit* text, size_t n, const Unit* pattern,
+			    size_t m, size_t end) {
+    for (size_t j = end; j > 0; --j) {
+      if ((text[j - 1] == pattern[0]) &&
+	  !memcmp(text + j, pattern + 1, (m - 1) * sizeof(Unit))) {
+	return j - 1;
+      }
+    }
+    return n;
+  }
+
+  template <typename Unit>
+  size_t scalarFindLastUnit(const Unit* text, size_t n, Unit c) {
+    for (size_t i = n; i > 0; --i) {
+      if (text[i - 1] == c) {
+	return i - 1;
+      }
+    }
+    return n;
+  }
+
+  size_t scalarFindFirstInSet(const uint8_t* text, size_t n,
+			      const ByteSet& set) {
+    for (size_t i = 0; i < n; ++i) {
+      if (set.contains(text[i])) {
+	return i;
+      }
+    }
+    return n;
+  }
+
+  size_t scalarFindLastInSet(const uint8_t* text, size_t n,
+			     const ByteSet& set) {
+    for (size_t i = n; i > 0; --i) {
+      if (set.contains(text[i - 1])) {
+	return i - 1;
+      }
+    }
+    return n;
+  }
+
+  // Shorter texts are not worth building the lookup tables for
+  const size_t MIN_VECTOR_SET_SCAN = 64;
+
+#ifdef PISTIS_ISTRING_SEARCH_X86
+
+  // Bits of a byte-wise movemask that mark the first byte of each unit
+  template <typename Unit> struct UnitBits { };
+  template <> struct UnitBits<uint8_t> {
+    static constexpr uint32_t MASK = 0xFFFFFFFF;
+  };
+  template <> struct UnitBits<uint16_t> {
+    static constexpr uint32_t MASK = 0x55555555;
+  };
+  template <> struct UnitBits<uint32_t> {
+    static constexpr uint32_t MASK = 0x11111111;
+  };
+
+  __attribute__((target("sse2")))
+  inline __m128i sse2Splat(uint8_t c) { return _mm_set1_epi8((char)c); }
+
+  __attribute__((target("sse2")))
+  inline __m128i sse2Splat(uint16_t c) { return _mm_set1_epi16((short)c); }
+
+  __attribute__((target("sse2")))
+  inline __m128i sse2Splat(uint32_t c) { return _mm_set1_epi32((int)c); }
+
+  __attribute__((target("sse2")))
+  inline __m128i sse2Equal(__m128i a, __m128i b, const uint8_t*) {
+    return _mm_cmpeq_epi8(a, b);
+  }
+
+  __attribute__((target("sse2")))
+  inline __m128i sse2Equal(__m128i a, __m128i b, const uint16_t*) {
+    return _mm_cmpeq_epi16(a, b);
+  }
+
+  __attribute__((target("sse2")))
+  inline __m128i sse2Equal(__m128i a, __m128i b, const uint32_t*) {
+    return _mm_cmpeq_epi32(a, b);
+  }
+
+  __attribute__((target("avx2")))
+  inline __m256i avx2Splat(uint8_t c) { return _mm256_set1_epi8((char)c); }
+
+  __attribute__((target("avx2")))
+  inline __m256i avx2Splat(uint16_t c) {
+    return _mm256_set1_epi16((short)c);
+  }
+
+  __attribute__((target("avx2")))
+  inline __m256i avx2Splat(uint32_t c) { return _mm256_set1_epi32((int)c); }
+
+  __attribute__((target("avx2")))
+  inline __m256i avx2Equal(__m256i a, __m256i b, const uint8_t*) {
+    return _mm256_cmpeq_epi8(a, b);
+  }
+
+  __attribute__((target("avx2")))
+  inline __m256i avx2Equal(__m256i a, __m256i b, const uint16_t*) {
+    return _mm256_cmpeq_epi16(a, b);
+  }
+
+  __attribute__((target("avx2")))
+  inline __m256i avx2Equal(__m256i a, __m256i b, const uint32_t*) {
+    return _mm256_cmpeq_epi32(a, b);
+  }
+
+  // Verify the candidates in mask, a movemask of the positions starting
+  // at j whose first and last units match.  Returns the first match or
+  // n, and adds the cost of failed candidates to wasted.
+  template <typename Unit>
+  inline size_t verifyCandidates(const Unit* text, size_t n,
+				 const Unit* pattern, size_t m, size_t j,
+				 uint32_t mask, size_t& wasted) {
+    mask &= UnitBits<Unit>::MASK;
+    while (mask) {
+      const size_t k = j + __builtin_ctz(mask) / sizeof(Unit);
+      if ((m == 2) ||
+	  !memcmp(text + k + 1, pattern + 1, (m - 2) * sizeof(Unit))) {
+	return k;
+      }
+      wasted += m;
+      mask &= mask - 1;
+    }
+    return n;
+  }
+
+  template <typename Unit>
+  __attribute__((target("sse2")))
+  size_t sse2Search(const Unit* text, size_t n, const Unit* pattern,
+		    size_t m) {
+    const size_t UNITS = sizeof(__m128i) / sizeof(Unit);
+    const __m128i first = sse2Splat(pattern[0]);
+    const __m128i last = sse2Splat(pattern[m - 1]);
+    size_t wasted = 0;
+    size_t j = 0;
+
+    for (; j + m - 1 + UNITS <= n; j += UNITS) {
+      const __m128i f = _mm_loadu_si128((const __m128i*)(text + j));
+      const __m128i l = _mm_loadu_si128((const __m128i*)(text + j + m - 1));
+      const __m128i eq = _mm_and_si128(sse2Equal(first, f, text),
+				       sse2Equal(last, l, text));
+      const uint32_t mask = (uint32_t)_mm_movemask_epi8(eq);
+      if (mask) {
+	const size_t k = verifyCandidates(text, n, pattern, m, j, mask,
+					  wasted);
+	if (k < n) {
+	  return k;
+	} else if (wasted > MAX_VERIFY_RATIO * j + MIN_VERIFY_BUDGET) {
+	  return twoWayFrom(text, n, pattern, m, j + UNITS);
+	}
+      }
+    }
+    return naiveSearch(text, n, pattern, m, j);
+  }
+
+  template <typename Unit>
+  __attribute__((target("avx2")))
+  size_t avx2Search(const Unit* text, size_t n, const Unit* pattern,
+		    size_t m) {
+    const size_t UNITS = sizeof(__m256i) / sizeof(Unit);
+    const __m256i first = avx2Splat(pattern[0]);
+    const __m256i last = avx2Splat(pattern[m - 1]);
+    size_t wasted = 0;
+    size_t j = 0;
+
+    for (; j + m - 1 + UNITS <= n; j += UNITS) {
+      const __m256i f = _mm256_loadu_si256((const __m256i*)(text + j));
+      const __m256i l =
+	  _mm256_loadu_si256((const __m256i*)(text + j + m - 1));
+      const __m256i eq = _mm256_and_si256(avx2Equal(first, f, text),
+					  avx2Equal(last, l, text));
+      const uint32_t mask = (uint32_t)_mm256_movemask_epi8(eq);
+      if (mask) {
+	const size_t k = verifyCandidates(text, n, pattern, m, j, mask,
+					  wasted);
+	if (k < n) {
+	  return k;
+	} else if (wasted > MAX_VERIFY_RATIO * j + MIN_VERIFY_BUDGET) {
+	  return twoWayFrom(text, n, pattern, m, j + UNITS);
+	}
+      }
+    }
+    return naiveSearch(text, n, pattern, m, j);
+  }
+
+  // Like verifyCandidates(), but tries the last candidate first
+  template <typename Unit>
+  inline size_t verifyCandidatesReverse(const Unit* text, size_t n,
+					const Unit* pattern, size_t m,
+					size_t j, uint32_t mask,
+					size_t& wasted) {
+    mask &= UnitBits<Unit>::MASK;
+    while (mask) {
+      const unsigned bit = 31 - __builtin_clz(mask);
+      const size_t k = j + bit / sizeof(Unit);
+      if ((m == 2) ||
+	  !memcmp(text + k + 1, pattern + 1, (m - 2) * sizeof(Unit))) {
+	return k;
+      }
+      wasted += m;
+      mask &= ~((uint32_t)1 << bit);
+    }
+    return n;
+  }
+
+  template <typename Unit>
+  __attribute__((target("avx2")))
+  size_t avx2ReverseSearch(const Unit* text, size_t n, const Unit* pattern,
+			   size_t m) {
+    const size_t UNITS = sizeof(__m256i) / sizeof(Unit);
+    const __m256i first = avx2Splat(pattern[0]);
+    const __m256i last = avx2Splat(pattern[m - 1]);
+    size_t wasted = 0;
+
+    // Positions below end have yet to be checked
+    size_t end = n - m + 1;
+    for (; end >= UNITS; end -= UNITS) {
+      const size_t j = end - UNITS;
+      const __m256i f = _mm256_loadu_si256((const __m256i*)(text + j));
+      const __m256i l =
+	  _mm256_loadu_si256((const __m256i*)(text + j + m - 1));
+      const __m256i eq = _mm256_and_si256(avx2Equal(first, f, text),
+					  avx2Equal(last, l, text));
+      const uint32_t mask = (uint32_t)_mm256_movemask_epi8(eq);
+      if (mask) {
+	const size_t k = verifyCandidatesReverse(text, n, pattern, m, j, mask,
+						 wasted);
+	if (k < n) {
+	  return k;
+	} else if (wasted > MAX_VERIFY_RATIO * (n - j) + MIN_VERIFY_BUDGET) {
+	  const size_t p = twoWayReverseSearch(text, j + m - 1, pattern, m);
+	  return (p < j + m - 1) ? p : n;
+	}
+      }
+    }
+    return naiveReverseSearch(text, n, pattern, m, end);
+  }
+
+  template <typename Unit>
+  __attribute__((target("avx2")))
+  size_t avx2FindLastUnit(const Unit* text, size_t n, Unit c) {
+    const size_t UNITS = sizeof(__m256i) / sizeof(Unit);
+    const __m256i target = avx2Splat(c);
+    size_t end = n;
+    for (; end >= UNITS; end -= UNITS) {
+      const __m256i v =
+	  _mm256_loadu_si256((const __m256i*)(text + end - UNITS));
+      const uint32_t mask =
+	  (uint32_t)_mm256_movemask_epi8(avx2Equal(target, v, text));
+      if (mask) {
+	return end - UNITS + (31 - __builtin_clz(mask)) / sizeof(Unit);
+      }
+    }
+    const size_t p = scalarFindLastUnit(text, end, c);
+    return (p < end) ? p : n;
+  }
+
+  // Classifies 32 bytes at a time.  Byte b is in the set if bit
+  // (b >> 4) & 7 of table[b >> 7][b & 15] is set, so one PSHUFB on the
+  // low nibble finds the candidate bits for each half of the byte values,
+  // the byte's own high bit selects the half, and a second PSHUFB on the
+  // high nibble finds the bit to test.
+  class Avx2ByteSetMatcher {
+  public:
+    __attribute__((target("avx2")))
+    Avx2ByteSetMatcher(const ByteSet& set) {
+      alignas(16) uint8_t tables[2][16] = { { 0 }, { 0 } };
+      set.forEach([&tables](uint8_t c) {
+	tables[c >> 7][c & 15] |= (uint8_t)(1 << ((c >> 4) & 7));
+      });
+      low_ = _mm256_broadcastsi128_si256(
+	  _mm_load_si128((const __m128i*)tables[0])
+      );
+      high_ = _mm256_broadcastsi128_si256(
+	  _mm_load_si128((const __m128i*)tables[1])
+      );
+    }
+
+    /** @brief Bit i is set if byte i of the 32 at p is in the set */
+    __attribute__((target("avx2")))
+    uint32_t match(const uint8_t* p) const {
+      const __m256i nibble = _mm256_set1_epi8(0x0F);
+      const __m256i bits = _mm256_setr_epi8(
+	  1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128,
+	  1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128
+      );
+      const __m256i v = _mm256_loadu_si256((const __m256i*)p);
+      const __m256i lo = _mm256_and_si256(v, nibble);
+      const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+      const __m256i candidates =
+	  _mm256_blendv_epi8(_mm256_shuffle_epi8(low_, lo),
+			     _mm256_shuffle_epi8(high_, lo), v);
+      const __m256i hits =
+	  _mm256_and_si256(candidates, _mm256_shuffle_epi8(bits, hi));
+      return ~(uint32_t)_mm256_movemask_epi8(
+	  _mm256_cmpeq_epi8(hits, _mm256_setzero_si256())
+      );
+    }
+
+  private:
+    __m256i low_;
+    __m256i high_;
+  };
+
+  __attribute__((target("avx2")))
+  size_t avx2FindFirstInSet(const uint8_t* text, size_t n,
+			    const ByteSet& set) {
+    if (n < MIN_VECTOR_SET_SCAN) {
+      return scalarFindFirstInSet(text, n, set);
+    }
+
+    const Avx2ByteSetMatcher matcher(set);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+      const uint32_t mask = matcher.match(text + i);
+      if (mask) {
+	return i + __builtin_ctz(mask);
+      }
+    }
+    const size_t p = scalarFindFirstInSet(text + i, n - i, set);
+    return (p < n - i) ? i + p : n;
+  }
+
+  __attribute__((target("avx2")))
+  size_t avx2FindLastInSet(const uint8_t* text, size_t n,
+			   const ByteSet& set) {
+    if (n < MIN_VECTOR_SET_SCAN) {
+      return scalarFindLastInSet(text, n, set);
+    }
+
+    const Avx2ByteSetMatcher matcher(set);
+    size_t i = n;
+    for (; i >= 32; i -= 32) {
+      const uint32_t mask = matcher.match(text + i - 32);
+      if (mask) {
+	return i - 1 - __builtin_clz(mask);
+      }
+    }
+    const size_t p = scalarFindLastInSet(text, i, set);
+    return (p < i) ? p : n;
+  }
+
+#endif
+
+  struct SearchKernels {
+    const char* name;
+    size_t (*search8)(const uint8_t*, size_t, const uint8_t*, size_t);
+    size_t (*search16)(const uint16_t*, size_t, const uint16_t*, size_t);
+    size_t (*search32)(const uint32_t*, size_t, const uint32_t*, size_t);
+    size_t (*reverseSearch8)(const uint8_t*, size_t, const uint8_t*, size_t);
+    size_t (*reverseSearch16)(const uint16_t*, size_t, const uint16_t*,
+			      size_t);
+    size_t (*reverseSearch32)(const uint32_t*, size_t, const uint32_t*,
+			      size_t);
+    size_t (*findLast16)(const uint16_t*, size_t, uint16_t);
+    size_t (*findLast32)(const uint32_t*, size_t, uint32_t);
+    size_t (*findFirstInSet)(const uint8_t*, size_t, const ByteSet&);
+    size_t (*findLastInSet)(const uint8_t*, size_t, const ByteSet&);
+  };
+
+  SearchKernels selectKernels() {
+#ifdef PISTIS_ISTRING_SEARCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      return SearchKernels{ "avx2", avx2Search<uint8_t>, avx2Search<uint16_t>,
+			    avx2Search<uint32_t>, avx2ReverseSearch<uint8_t>,
+			    avx2ReverseSearch<uint16_t>,
+			    avx2ReverseSearch<uint32_t>,
+			    avx2FindLastUnit<uint16_t>,
+			    avx2FindLastUnit<uint32_t>, avx2FindFirstInSet,
+			    avx2FindLastInSet };
+    } else if (__builtin_cpu_supports("sse2")) {
+      return SearchKernels{ "sse2", sse2Search<uint8_t>, sse2Search<uint16_t>,
+			    sse2Search<uint32_t>, twoWayReverseSearch<uint8_t>,
+			    twoWayReverseSearch<uint16_t>,
+			    twoWayReverseSearch<uint32_t>,
+			    scalarFindLastUnit<uint16_t>,
+			    scalarFindLastUnit<uint32_t>, scalarFindFirstInSet,
+			    scalarFindLastInSet };
+    }
+#endif
+    return SearchKernels{ "two-way", twoWaySearch<uint8_t>,
+			  twoWaySearch<uint16_t>, twoWaySearch<uint32_t>,
+			  twoWayReverseSearch<uint8_t>,
+			  twoWayReverseSearch<uint16_t>,
+			  twoWayReverseSearch<uint32_t>,
+			  scalarFindLastUnit<uint16_t>,
+			  scalarFindLastUnit<uint32_t>, scalarFindFirstInSet,
+			  scalarFindLastInSet };
+  }
+
+  const SearchKernels& kernels() {
+    static const SearchKernels KERNELS = selectKernels();
+    return KERNELS;
+  }
+
+  template <typename Unit>
+  inline size_t searchTrivial(const Unit* text, size_t n, const Unit* pattern,
+			      size_t m, bool& done) {
+    done = true;
+    if (m > n) {
+      return n;
+    } else if (m == 1) {
+      const Unit* const p = std::find(text, text + n, pattern[0]);
+      return p - text;
+    }
+    done = false;
+    return n;
+  }
+}
+
+namespace pistis {
+  namespace util {
+    namespace detail {
+
+      size_t searchUnits(const uint8_t* text, size_t n,
+			 const uint8_t* pattern, size_t m) {
+	if (m > n) {
+	  return n;
+	} else if (m == 1) {
+	  const void* const p = memchr(text, pattern[0], n);
+	  return p ? (const uint8_t*)p - text : n;
+	}
+	return kernels().search8(text, n, pattern, m);
+      }
+
+      size_t searchUnits(const uint16_t* text, size_t n,
+			 const uint16_t* pattern, size_t m) {
+	bool done;
+	const size_t p = searchTrivial(text, n, pattern, m, done);
+	return done ? p : kernels().search16(text, n, pattern, m);
+      }
+
+      size_t searchUnits(const uint32_t* text, size_t n,
+			 const uint32_t* pattern, size_t m) {
+	bool done;
+	const size_t p = searchTrivial(text, n, pattern, m, done);
+	return done ? p : kernels().search32(text, n, pattern, m);
+      }
+
+      size_t twoWaySearchUnits(const uint8_t* text, size_t n,
+			       const uint8_t* pattern, size_t m) {
+	return twoWay(text, n, pattern, m);
+      }
+
+      size_t twoWaySearchUnits(const uint16_t* text, size_t n,
+			       const uint16_t* pattern, size_t m) {
+	return twoWay(text, n, pattern, m);
+      }
+
+      size_t twoWaySearchUnits(const uint32_t* text, size_t n,
+			       const uint32_t* pattern, size_t m) {
+	return twoWay(text, n, pattern, m);
+      }
+
+      size_t reverseSearchUnits(const uint8_t* text, size_t n,
+				const uint8_t* pattern, size_t m) {
+	if (m > n) {
+	  return n;
+	} else if (m == 1) {
+	  return findLastUnit(text, n, pattern[0]);
+	}
+	return kernels().reverseSearch8(text, n, pattern, m);
+      }
+
+      size_t reverseSearchUnits(const uint16_t* text, size_t n,
+				const uint16_t* pattern, size_t m) {
+	if (m > n) {
+	  return n;
+	} else if (m == 1) {
+	  return findLastUnit(text, n, pattern[0]);
+	}
+	return kernels().reverseSearch16(text, n, pattern, m);
+      }
+
+      size_t reverseSearchUnits(const uint32_t* text, size_t n,
+				const uint32_t* pattern, size_t m) {
+	if (m > n) {
+	  return n;
+	} else if (m == 1) {
+	  return findLastUnit(text, n, pattern[0]);
+	}
+	return kernels().reverseSearch32(text, n, pattern, m);
+      }
+
+      size_t twoWayReverseSearchUnits(const uint8_t* text, size_t n,
+				      const uint8_t* pattern, size_t m) {
+	return twoWayReverseSearch(text, n, pattern, m);
+      }
+
+      size_t twoWayReverseSearchUnits(const uint16_t* text, size_t n,
+				      const uint16_t* pattern, size_t m) {
+	return twoWayReverseSearch(text, n, pattern, m);
+      }
+
+      size_t twoWayReverseSearchUnits(const uint32_t* text, size_t n,
+				      const uint32_t* pattern, size_t m) {
+	return twoWayReverseSearch(text, n, pattern, m);
+      }
+
+      size_t findLastUnit(const uint8_t* text, size_t n, uint8_t c) {
+	const void* const p = n ? memrchr(text, c, n) : nullptr;
+	return p ? (const uint8_t*)p - text : n;
+      }
+
+      size_t findLastUnit(const uint16_t* text, size_t n, uint16_t c) {
+	return kernels().findLast16(text, n, c);
+      }
+
+      size_t findLastUnit(const uint32_t* text, size_t n, uint32_t c) {
+	return kernels().findLast32(text, n, c);
+      }
+
+      const char* substringSearchKernel() { return kernels().name; }
+
+      size_t findFirstInSet(const uint8_t* text, size_t n,
+			    const ByteSet& set) {
+	return kernels().findFirstInSet(text, n, set);
+      }
+
+      size_t findLastInSet(const uint8_t* text, size_t n,
+			   const ByteSet& set) {
+	return kernels().findLastInSet(text, n, set);
+      }
+
+    }
+  }
+}
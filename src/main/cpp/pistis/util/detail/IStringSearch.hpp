@@ -0,0 +1,277 @@
+#ifndef __PISTIS__UTIL__DETAIL__ISTRINGSEARCH_HPP__
+#define __PISTIS__UTIL__DETAIL__ISTRINGSEARCH_HPP__
+
+/** @file IStringSearch.hpp
+ *
+ *  Substring search kernels for ImmutableString.  The kernels compare
+ *  code units bit-for-bit, so they only apply when both strings have
+ *  code units of the same size and neither uses custom character
+ *  traits.  ImmutableString decides when that is the case.
+ *
+ *  searchUnits() scans for the first and last units of the pattern
+ *  with SSE2 or AVX2, whichever the CPU supports, and verifies the
+ *  candidates it finds.  If verification does too much work (as it does
+ *  with patterns like "aaaab" in text full of "a"), it switches to the
+ *  Two-Way algorithm, which runs in linear time on any input.  Processors
+ *  without SSE2 use Two-Way throughout.
+ *
+ *  reverseSearchUnits() and findLastUnit() are the right-to-left
+ *  counterparts of searchUnits() and std::find.  They use AVX2 when the
+ *  CPU supports it.  Otherwise reverseSearchUnits() uses Two-Way on
+ *  the reversed strings and findLastUnit() uses memrchr() for bytes and
+ *  a plain loop for wider units.
+ *
+ *  findFirstInSet() and findLastInSet() look for any member of a set of
+ *  units.  Byte sets are matched 32 bytes at a time with a nibble lookup
+ *  table on processors with AVX2 and with a bitmap otherwise.  Sets of
+ *  wider units use a bitmap for units below 256 and a sorted list for the
+ *  rest.
+ */
+
+#include <algorithm>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace pistis {
+  namespace util {
+    namespace detail {
+
+      /** @brief Return the offset of the first occurrence of the m units
+       *         starting at pattern in the n units starting at text, or
+       *         n if it does not occur.
+       *
+       *  Requires m >= 1.
+       */
+      size_t searchUnits(const uint8_t* text, size_t n,
+			 const uint8_t* pattern, size_t m);
+      size_t searchUnits(const uint16_t* text, size_t n,
+			 const uint16_t* pattern, size_t m);
+      size_t searchUnits(const uint32_t* text, size_t n,
+			 const uint32_t* pattern, size_t m);
+
+      /** @brief Like searchUnits(), but always uses Two-Way */
+      size_t twoWaySearchUnits(const uint8_t* text, size_t n,
+			       const uint8_t* pattern, size_t m);
+      size_t twoWaySearchUnits(const uint16_t* text, size_t n,
+			       const uint16_t* pattern, size_t m);
+      size_t twoWaySearchUnits(const uint32_t* text, size_t n,
+			       const uint32_t* pattern, size_t m);
+
+      /** @brief Return the offset of the last occurrence of the m units
+       *         starting at pattern in the n units starting at text, or
+       *         n if it does not occur.
+       *
+       *  Requires m >= 1.
+       */
+      size_t reverseSearchUnits(const uint8_t* text, size_t n,
+				const uint8_t* pattern, size_t m);
+      size_t reverseSearchUnits(const uint16_t* text, size_t n,
+				const uint16_t* pattern, size_t m);
+      size_t reverseSearchUnits(const uint32_t* text, size_t n,
+				const uint32_t* pattern, size_t m);
+
+      /** @brief Like reverseSearchUnits(), but always uses Two-Way */
+      size_t twoWayReverseSearchUnits(const uint8_t* text, size_t n,
+				      const uint8_t* pattern, size_t m);
+      size_t twoWayReverseSearchUnits(const uint16_t* text, size_t n,
+				      const uint16_t* pattern, size_t m);
+      size_t twoWayReverseSearchUnits(const uint32_t* text, size_t n,
+				      const uint32_t* pattern, size_t m);
+
+      /** @brief Return the offset of the last c in the n units starting
+       *         at text, or n if c does not occur.
+       */
+      size_t findLastUnit(const uint8_t* text, size_t n, uint8_t c);
+      size_t findLastUnit(const uint16_t* text, size_t n, uint16_t c);
+      size_t findLastUnit(const uint32_t* text, size_t n, uint32_t c);
+
+      /** @brief Name of the kernel searchUnits() uses on this CPU:
+       *         "avx2", "sse2" or "two-way".
+       */
+      const char* substringSearchKernel();
+
+      /** @brief A set of byte values, stored as a bitmap */
+      class ByteSet {
+      public:
+	ByteSet(): bits_{ 0, 0, 0, 0 } { }
+
+	ByteSet(const uint8_t* units, size_t n): ByteSet() {
+	  for (size_t i = 0; i < n; ++i) {
+	    add(units[i]);
+	  }
+	}
+
+	bool contains(uint8_t c) const {
+	  return (bits_[c >> 6] >> (c & 63)) & 1;
+	}
+
+	void add(uint8_t c) { bits_[c >> 6] |= (uint64_t)1 << (c & 63); }
+
+	/** @brief Call f(c) for each member c in ascending order */
+	template <typename Function>
+	void forEach(Function f) const {
+	  for (unsigned i = 0; i < 4; ++i) {
+	    for (uint64_t w = bits_[i]; w; w &= w - 1) {
+	      f((uint8_t)((i << 6) | __builtin_ctzll(w)));
+	    }
+	  }
+	}
+
+      private:
+	uint64_t bits_[4];
+      };
+
+      /** @brief A set of units of type Unit
+       *
+       *  Units below 256 go in a bitmap.  The rest go in a sorted list,
+       *  guarded by a 64-bit filter on their low bits so that most
+       *  non-members are rejected without searching it.
+       */
+      template <typename Unit>
+      class UnitSet {
+      public:
+	UnitSet(const Unit* units, size_t n): low_(), filter_(0), high_() {
+	  for (size_t i = 0; i < n; ++i) {
+	    if (units[i] < 256) {
+	      low_.add((uint8_t)units[i]);
+	    } else {
+	      high_.push_back(units[i]);
+	      filter_ |= (uint64_t)1 << (units[i] & 63);
+	    }
+	  }
+	  std::sort(high_.begin(), high_.end());
+	}
+
+	bool contains(Unit c) const {
+	  if (c < 256) {
+	    return low_.contains((uint8_t)c);
+	  } else {
+	    return ((filter_ >> (c & 63)) & 1) &&
+	           std::binary_search(high_.begin(), high_.end(), c);
+	  }
+	}
+
+      private:
+	ByteSet low_;
+	uint64_t filter_;
+	std::vector<Unit> high_;
+      };
+
+      /** @brief Return the offset of the first unit in text that is in
+       *         set, or n if there are none.
+       */
+      size_t findFirstInSet(const uint8_t* text, size_t n, const ByteSet& set);
+
+      template <typename Unit>
+      inline size_t findFirstInSet(const Unit* text, size_t n,
+				   const UnitSet<Unit>& set) {
+	for (size_t i = 0; i < n; ++i) {
+	  if (set.contains(text[i])) {
+	    return i;
+	  }
+	}
+	return n;
+      }
+
+      /** @brief Return the offset of the last unit in text that is in
+       *         set, or n if there are none.
+       */
+      size_t findLastInSet(const uint8_t* text, size_t n, const ByteSet& set);
+
+      template <typename Unit>
+      inline size_t findLastInSet(const Unit* text, size_t n,
+				  const UnitSet<Unit>& set) {
+	for (size_t i = n; i > 0; --i) {
+	  if (set.contains(text[i - 1])) {
+	    return i - 1;
+	  }
+	}
+	return n;
+      }
+
+      template <size_t N> struct SearchUnitType { };
+      template <> struct SearchUnitType<1> { typedef uint8_t type; };
+      template <> struct SearchUnitType<2> { typedef uint16_t type; };
+      template <> struct SearchUnitType<4> { typedef uint32_t type; };
+
+      /** @brief True if the search kernels can compare characters of
+       *         type Char
+       */
+      template <typename Char>
+      struct IsSearchableChar {
+	static constexpr const bool value =
+	    (sizeof(Char) == 1) || (sizeof(Char) == 2) || (sizeof(Char) == 4);
+      };
+
+      /** @brief Return the offset of the first occurrence of pattern
+       *         in text, or n if it does not occur.
+       */
+      template <typename C1, typename C2>
+      inline size_t searchChars(const C1* text, size_t n, const C2* pattern,
+				size_t m) {
+	static_assert(sizeof(C1) == sizeof(C2),
+		      "Character types must have the same size");
+	typedef typename SearchUnitType<sizeof(C1)>::type Unit;
+	return searchUnits((const Unit*)text, n, (const Unit*)pattern, m);
+      }
+
+      /** @brief Return the offset of the last occurrence of pattern
+       *         in text, or n if it does not occur.
+       */
+      template <typename C1, typename C2>
+      inline size_t reverseSearchChars(const C1* text, size_t n,
+				       const C2* pattern, size_t m) {
+	static_assert(sizeof(C1) == sizeof(C2),
+		      "Character types must have the same size");
+	typedef typename SearchUnitType<sizeof(C1)>::type Unit;
+	return reverseSearchUnits((const Unit*)text, n, (const Unit*)pattern,
+				  m);
+      }
+
+      /** @brief Return the offset of the last c in text, or n if c does
+       *         not occur.
+       */
+      template <typename C1, typename C2>
+      inline size_t findLastChar(const C1* text, size_t n, C2 c) {
+	static_assert(sizeof(C1) == sizeof(C2),
+		      "Character types must have the same size");
+	typedef typename SearchUnitType<sizeof(C1)>::type Unit;
+	return findLastUnit((const Unit*)text, n, (Unit)c);
+      }
+
+      template <typename Unit>
+      struct SearchUnitSet { typedef UnitSet<Unit> type; };
+      template <>
+      struct SearchUnitSet<uint8_t> { typedef ByteSet type; };
+
+      /** @brief Return the offset of the first character in text that is
+       *         one of the m characters in chars, or n if there are none.
+       */
+      template <typename C1, typename C2>
+      inline size_t findFirstOfChars(const C1* text, size_t n,
+				     const C2* chars, size_t m) {
+	static_assert(sizeof(C1) == sizeof(C2),
+		      "Character types must have the same size");
+	typedef typename SearchUnitType<sizeof(C1)>::type Unit;
+	const typename SearchUnitSet<Unit>::type set((const Unit*)chars, m);
+	return findFirstInSet((const Unit*)text, n, set);
+      }
+
+      /** @brief Return the offset of the last character in text that is
+       *         one of the m characters in chars, or n if there are none.
+       */
+      template <typename C1, typename C2>
+      inline size_t findLastOfChars(const C1* text, size_t n,
+				    const C2* chars, size_t m) {
+	static_assert(sizeof(C1) == sizeof(C2),
+		      "Character types must have the same size");
+	typedef typename SearchUnitType<sizeof(C1)>::type Unit;
+	const typename SearchUnitSet<Unit>::type set((const Unit*)chars, m);
+	return findLastInSet((const Unit*)text, n, set);
+      }
+
+    }
+  }
+}
+#endif
@@ -1,62 +1,296 @@
 #ifndef __PISTIS__UTIL__DETAIL__ISTRINGTEXT_HPP__
 #define __PISTIS__UTIL__DETAIL__ISTRINGTEXT_HPP__
 
+#include <pistis/util/detail/IStringHash.hpp>
+#include <pistis/util/FileMapping.hpp>
+#include <pistis/util/IStringRefCount.hpp>
 #include <algorithm>
 #include <atomic>
 #include <cstddef>
+#include <limits>
+#include <new>
 #include <assert.h>
 #include <stdint.h>
+#include <string.h>
 
 namespace pistis {
   namespace util {
+
+    template <typename Char, typename Allocator>
+    class InternPool;
+
     namespace detail {
 
       template <typename Char>
       struct IStringText {
+	/** @brief Flag bit set on texts owned by an InternPool */
+	static constexpr const uint32_t INTERNED = 0x80000000;
+
+	/** @brief Bits that say what a text holds in place of characters,
+	 *         if anything
+	 *
+	 *  The kinds are exclusive, so they share two bits and leave the
+	 *  rest of sizeAndFlags for the size.
+	 */
+	static constexpr const uint32_t KIND = 0x60000000;
+
+	/** @brief Kind of texts that hold a reference to another text in
+	 *         place of characters (see IStringTextPtr::borrow())
+	 */
+	static constexpr const uint32_t BORROWED = 0x20000000;
+
+	/** @brief Kind of texts that hold a file mapping in place of
+	 *         characters (see IStringTextPtr::map())
+	 */
+	static constexpr const uint32_t MAPPED = 0x40000000;
+
+	/** @brief Kind of texts that hold a pointer to characters allocated
+	 *         separately, because there are more than MAX_SIZE of them
+	 *         (see IStringTextPtr::create())
+	 */
+	static constexpr const uint32_t LARGE = 0x60000000;
+
+	/** @brief All flag bits kept in sizeAndFlags */
+	static constexpr const uint32_t FLAGS = INTERNED | KIND;
+
+	/** @brief Largest number of characters an IStringText holds inline.
+	 *         Longer texts are LARGE.
+	 */
+	static constexpr const size_t MAX_SIZE = ~FLAGS;
+
+	/** @brief Where a LARGE text's characters are */
+	struct LargeChars {
+	  Char* chars;
+	  size_t size;
+
+	  /** @brief Number of characters allocated, which resize() can
+	   *         leave larger than size
+	   */
+	  size_t capacity;
+	};
+
 	std::atomic<uint32_t> refCnt;
-	uint32_t size;
+	uint32_t sizeAndFlags;
+
+	/** @brief Hash code of the full text, or zero if not computed yet */
+	mutable std::atomic<size_t> hashCode;
 	Char text[1];
 
-	IStringText(uint32_t s): refCnt(0), size(s) { }
+	IStringText(uint32_t s, uint32_t flags = 0):
+	    refCnt(0), sizeAndFlags(s | flags), hashCode(0) {
+	}
 
 	template <typename Iterator>
-	IStringText(uint32_t s, const Iterator& t): refCnt(0), size(s) {
+	IStringText(uint32_t s, const Iterator& t, uint32_t flags = 0):
+	    refCnt(0), sizeAndFlags(s | flags), hashCode(0) {
 	  std::copy_n(t, s, text);
 	}
 
-	size_t allocationSize() const { return computeAllocationSize(size); }
+	/** @brief Number of characters or payload units held inline */
+	size_t size() const { return sizeAndFlags & ~FLAGS; }
+	bool interned() const { return sizeAndFlags & INTERNED; }
+	bool borrowed() const { return (sizeAndFlags & KIND) == BORROWED; }
+	bool mapped() const { return (sizeAndFlags & KIND) == MAPPED; }
+	bool large() const { return (sizeAndFlags & KIND) == LARGE; }
+
+	/** @brief The text a borrowed text refers to */
+	IStringText* lender() const {
+	  IStringText* p;
+	  ::memcpy(&p, text, sizeof(p));
+	  return p;
+	}
+
+	/** @brief The mapping a mapped text holds */
+	FileMapping mapping() const {
+	  FileMapping m;
+	  ::memcpy(&m, text, sizeof(m));
+	  return m;
+	}
+
+	/** @brief Where the characters of a large text are */
+	LargeChars largeChars() const {
+	  LargeChars c;
+	  ::memcpy(&c, text, sizeof(c));
+	  return c;
+	}
+
+	/** @brief The text whose characters strings using this text see */
+	const IStringText* owner() const {
+	  return borrowed() ? lender() : this;
+	}
+
+	/** @brief The characters this text holds, maps or points to */
+	Char* chars() {
+	  switch (sizeAndFlags & KIND) {
+	    case MAPPED: return (Char*)mapping().address;
+	    case LARGE: return largeChars().chars;
+	    default: return text;
+	  }
+	}
+
+	const Char* chars() const {
+	  return const_cast<IStringText*>(this)->chars();
+	}
+
+	size_t numChars() const {
+	  switch (sizeAndFlags & KIND) {
+	    case MAPPED: return mapping().length / sizeof(Char);
+	    case LARGE: return largeChars().size;
+	    default: return size();
+	  }
+	}
+
+	/** @brief True if the n characters starting at p are all of the
+	 *         characters this text holds or maps
+	 */
+	bool spans(const Char* p, size_t n) const {
+	  return (p == chars()) && (n == numChars());
+	}
+
+	/** @brief Hash code of the full text, computed on first use
+	 *
+	 *  Racing threads may each compute the hash, but they all store
+	 *  the same value.  A text whose hash really is zero is simply
+	 *  rehashed every time.
+	 */
+	size_t hash() const {
+	  size_t h = hashCode.load(std::memory_order_relaxed);
+	  if (!h) {
+	    h = hashIStringChars(chars(), numChars());
+	    hashCode.store(h, std::memory_order_relaxed);
+	  }
+	  return h;
+	}
+	size_t allocationSize() const { return computeAllocationSize(size()); }
+
+	/** @brief Bytes this text keeps alive, including its mapping or
+	 *         separately allocated characters
+	 */
+	size_t footprint() const {
+	  switch (sizeAndFlags & KIND) {
+	    case MAPPED: return allocationSize() + mapping().length;
+	    case LARGE:
+	      return allocationSize() + largeChars().capacity * sizeof(Char);
+	    default: return allocationSize();
+	  }
+	}
       
 	static size_t computeAllocationSize(size_t n) {
 	  return offsetof(IStringText, text) + n * sizeof(Char);
 	}
       
+	template <typename RefCount = AtomicIStringRefCount>
 	static IStringText* addRef(IStringText* t) {
 	  if (t) {
-	    ++(t->refCnt);
+	    RefCount::addRef(t->refCnt);
 	  }
 	  return t;
 	}
+
+	/** @brief Add a reference to t unless its count has already
+	 *         dropped to zero.
+	 *
+	 *  Used by lookups that hold t without owning a reference to it,
+	 *  such as the InternPool, to avoid resurrecting a dying text.
+	 *  Returns t if a reference was added and nullptr otherwise.
+	 */
+	static IStringText* tryAddRef(IStringText* t) {
+	  uint32_t n = t->refCnt.load(std::memory_order_relaxed);
+	  while (n && !t->refCnt.compare_exchange_weak(n, n + 1)) {
+	  }
+	  return n ? t : nullptr;
+	}
       
+	template <typename RefCount = AtomicIStringRefCount>
 	static uint32_t removeRef(IStringText* t) {
-	  assert(t->refCnt > 0);
-	  return --(t->refCnt);
-	}      
+	  assert(t->refCnt.load(std::memory_order_relaxed) > 0);
+	  return RefCount::removeRef(t->refCnt);
+	}
+
+	/** @brief True if the caller holds the only reference to t
+	 *
+	 *  The acquire load makes every change to t made by a thread that
+	 *  has since released its reference visible to the caller.
+	 */
+	static bool isUnique(const IStringText* t) {
+	  return t->refCnt.load(std::memory_order_acquire) == 1;
+	}
+      };
+
+      template <typename Char>
+      constexpr const uint32_t IStringText<Char>::INTERNED;
+
+      template <typename Char>
+      constexpr const uint32_t IStringText<Char>::KIND;
+
+      template <typename Char>
+      constexpr const uint32_t IStringText<Char>::BORROWED;
+
+      template <typename Char>
+      constexpr const uint32_t IStringText<Char>::MAPPED;
+
+      template <typename Char>
+      constexpr const uint32_t IStringText<Char>::LARGE;
+
+      template <typename Char>
+      constexpr const uint32_t IStringText<Char>::FLAGS;
+
+      template <typename Char>
+      constexpr const size_t IStringText<Char>::MAX_SIZE;
+
+      /** @brief What IStringTextPtr can do with Allocator besides
+       *         allocate() and deallocate()
+       *
+       *  Specialize for allocators that can resize an allocation in place
+       *  or whose allocations are all freed together with the allocator.
+       */
+      template <typename Allocator>
+      struct IStringAllocationTraits {
+	/** @brief True if allocations do not outlive the allocator's
+	 *         backing store, so texts from it must not be shared with
+	 *         strings that use other instances of Allocator.
+	 */
+	static constexpr const bool SCOPED = false;
+
+	/** @brief Resize the allocation of oldSize bytes at p to newSize
+	 *         bytes without moving it, and return true if that is
+	 *         possible.
+	 */
+	static bool resize(Allocator&, uint8_t*, size_t, size_t) {
+	  return false;
+	}
+      };
+
+      template <typename Allocator>
+      struct IStringAllocationTraits< LocalIStringAllocator<Allocator> > {
+	static constexpr const bool SCOPED =
+	    IStringAllocationTraits<Allocator>::SCOPED;
+
+	static bool resize(LocalIStringAllocator<Allocator>& allocator,
+			   uint8_t* p, size_t oldSize, size_t newSize) {
+	  return IStringAllocationTraits<Allocator>::resize(
+	      allocator, p, oldSize, newSize
+	  );
+	}
       };
 
       template <typename Char, typename Allocator>
       class IStringTextPtr : Allocator {
       public:
+	typedef typename IStringRefCountPolicy<Allocator>::type RefCount;
+
 	IStringTextPtr(const Allocator& allocator = Allocator()):
 	    Allocator(allocator), p_(nullptr) {
 	}
       
 	IStringTextPtr(IStringText<Char>* p, const Allocator& allocator):
-	    Allocator(allocator), p_(IStringText<Char>::addRef(p)) {
+	    Allocator(allocator),
+	    p_(IStringText<Char>::template addRef<RefCount>(p)) {
 	}
       
 	IStringTextPtr(const IStringTextPtr& other):
 	    Allocator(other.allocator()),
-	    p_(IStringText<Char>::addRef(other.get())) {
+	    p_(IStringText<Char>::template addRef<RefCount>(other.get())) {
 	}
 	IStringTextPtr(IStringTextPtr&& other):
 	    Allocator(std::move(other)), p_(other.p_) {
@@ -74,14 +308,14 @@ namespace pistis {
 
 	void reset(IStringText<Char>* p = nullptr) {
 	  release_();
-	  p_ = IStringText<Char>::addRef(p);
+	  p_ = IStringText<Char>::template addRef<RefCount>(p);
 	}
 
 	IStringTextPtr& operator=(const IStringTextPtr& other) {
 	  if (this != &other) {
 	    release_();
 	    Allocator::operator=(other);
-	    p_ = IStringText<Char>::addRef(other.get());
+	    p_ = IStringText<Char>::template addRef<RefCount>(other.get());
 	  }
 	  return *this;
 	}
@@ -110,13 +344,40 @@ namespace pistis {
 	  Allocator newAllocator(allocator);
 	  return create(n, newAllocator);
 	}
+
+	/** @brief Create a text for n characters and set chars to where
+	 *         they go
+	 *
+	 *  Callers that fill in a new text should use this rather than
+	 *  chars(), which has to check what kind of text it has.
+	 */
+	static IStringTextPtr create(size_t n, const Allocator& allocator,
+				     Char*& chars) {
+	  Allocator newAllocator(allocator);
+	  if (n > IStringText<Char>::MAX_SIZE) {
+	    return createLarge_(n, newAllocator, chars);
+	  }
+	  IStringTextPtr text = create(n, newAllocator);
+	  chars = text->text;
+	  return text;
+	}
 	
-	static IStringTextPtr create(size_t n, Allocator& allocator) {
+	/** @brief Create a text for n characters
+	 *
+	 *  Texts for more than IStringText::MAX_SIZE characters are LARGE,
+	 *  with the characters in a separate allocation.
+	 */
+	static IStringTextPtr create(size_t n, Allocator& allocator,
+				     uint32_t flags = 0) {
+	  if (n > IStringText<Char>::MAX_SIZE) {
+	    Char* chars;
+	    return createLarge_(n, allocator, chars);
+	  }
 	  const size_t textSize = IStringText<Char>::computeAllocationSize(n);
 	  IStringText<Char>* newText =
 	       (IStringText<Char>*)allocator.allocate(textSize);
 	  try {
-	    new(newText) IStringText<Char>(n);
+	    new(newText) IStringText<Char>(n, flags);
 	    try {
 	      return IStringTextPtr(newText, allocator);
 	    } catch(...) {
@@ -131,12 +392,18 @@ namespace pistis {
 
 	template <typename Iterator>
 	static IStringTextPtr create(size_t n, const Iterator& t,
-				     Allocator& allocator) {
+				     Allocator& allocator, uint32_t flags = 0) {
+	  if (n > IStringText<Char>::MAX_SIZE) {
+	    Char* chars;
+	    IStringTextPtr text = createLarge_(n, allocator, chars);
+	    std::copy_n(t, n, chars);
+	    return text;
+	  }
 	  const size_t textSize = IStringText<Char>::computeAllocationSize(n);
 	  IStringText<Char>* newText =
 	       (IStringText<Char>*)allocator.allocate(textSize);
 	  try {
-	    new(newText) IStringText<Char>(n, t);
+	    new(newText) IStringText<Char>(n, t, flags);
 	    try {
 	      return IStringTextPtr(newText, allocator);
 	    } catch(...) {
@@ -149,11 +416,145 @@ namespace pistis {
 	  }
 	}
 
+	/** @brief Wrap p, which the caller has already added a reference
+	 *         to, without adding another one.
+	 */
+	static IStringTextPtr adopt(IStringText<Char>* p,
+				    const Allocator& allocator) {
+	  IStringTextPtr tmp(allocator);
+	  tmp.p_ = p;
+	  return tmp;
+	}
+
+	/** @brief Create a text that refers to lender's characters
+	 *
+	 *  The new text holds a single reference to lender, taken with
+	 *  atomic operations, and releases it when its own count drops to
+	 *  zero.  When Allocator counts references without atomics, the
+	 *  strings on one thread can then share lender through the new text
+	 *  without touching lender's count at all.  Lender must count its
+	 *  references atomically and must not be borrowed itself.
+	 */
+	static IStringTextPtr borrow(IStringText<Char>* lender,
+				     const Allocator& allocator) {
+	  const size_t n = (sizeof(lender) + sizeof(Char) - 1) / sizeof(Char);
+	  Allocator newAllocator(allocator);
+	  IStringTextPtr text =
+	      create(n, newAllocator, IStringText<Char>::BORROWED);
+	  ::memcpy(text->text, &lender, sizeof(lender));
+	  IStringText<Char>::addRef(lender);
+	  return text;
+	}
+
+	/** @brief Create a text that owns mapping
+	 *
+	 *  The mapping is unmapped when the text's count drops to zero, or
+	 *  immediately if the text cannot be created.
+	 */
+	static IStringTextPtr map(const FileMapping& mapping,
+				  const Allocator& allocator) {
+	  const size_t n = (sizeof(mapping) + sizeof(Char) - 1) / sizeof(Char);
+	  Allocator newAllocator(allocator);
+	  try {
+	    IStringTextPtr text =
+	        create(n, newAllocator, IStringText<Char>::MAPPED);
+	    ::memcpy(text->text, &mapping, sizeof(mapping));
+	    return text;
+	  } catch(...) {
+	    unmapFile(mapping);
+	    throw;
+	  }
+	}
+
+	/** @brief Change the size of this pointer's text to n characters
+	 *         without moving it, and return true if the allocator can
+	 *         do that.
+	 *
+	 *  Only plain texts that nothing else refers to can be resized.
+	 */
+	bool resize(size_t n) {
+	  if (!p_ || p_->interned() || !IStringText<Char>::isUnique(p_)) {
+	    return false;
+	  } else if (p_->large()) {
+	    return resizeLarge_(n);
+	  } else if ((p_->sizeAndFlags & IStringText<Char>::KIND) ||
+		     (n > IStringText<Char>::MAX_SIZE)) {
+	    return false;
+	  }
+	  const size_t oldSize = p_->allocationSize();
+	  const size_t newSize = IStringText<Char>::computeAllocationSize(n);
+	  if (!IStringAllocationTraits<Allocator>::resize(
+		  allocator(), (uint8_t*)p_, oldSize, newSize)) {
+	    return false;
+	  }
+	  p_->sizeAndFlags = (uint32_t)n;
+	  p_->hashCode.store(0, std::memory_order_relaxed);
+	  return true;
+	}
+
+	/** @brief Give up this pointer's reference to its text without
+	 *         releasing it, and return the text.
+	 */
+	IStringText<Char>* release() {
+	  IStringText<Char>* const p = p_;
+	  p_ = nullptr;
+	  return p;
+	}
+
       private:
 	IStringText<Char>* p_;
 
+	static IStringTextPtr createLarge_(size_t n, Allocator& allocator,
+					   Char*& chars) {
+	  typedef typename IStringText<Char>::LargeChars LargeChars;
+	  const size_t payloadSize =
+	      (sizeof(LargeChars) + sizeof(Char) - 1) / sizeof(Char);
+	  if (n > std::numeric_limits<size_t>::max() / sizeof(Char)) {
+	    throw std::bad_alloc();
+	  }
+	  const LargeChars c = { (Char*)allocator.allocate(n * sizeof(Char)),
+				 n, n };
+	  try {
+	    IStringTextPtr text =
+	        create(payloadSize, allocator, IStringText<Char>::LARGE);
+	    ::memcpy(text->text, &c, sizeof(c));
+	    chars = c.chars;
+	    return text;
+	  } catch(...) {
+	    allocator.deallocate((uint8_t*)c.chars, n * sizeof(Char));
+	    throw;
+	  }
+	}
+
+	// A large text can shrink without moving its characters, but only
+	// grows in place within its capacity
+	bool resizeLarge_(size_t n) {
+	  typename IStringText<Char>::LargeChars c = p_->largeChars();
+	  if (n > c.capacity) {
+	    return false;
+	  }
+	  c.size = n;
+	  ::memcpy(p_->text, &c, sizeof(c));
+	  p_->hashCode.store(0, std::memory_order_relaxed);
+	  return true;
+	}
+
 	void release_() {
-	  if (p_ && !IStringText<Char>::removeRef(p_)) {
+	  if (p_ && !IStringText<Char>::template removeRef<RefCount>(p_)) {
+	    if (p_->interned()) {
+	      InternPool<Char, Allocator>::global().remove_(p_);
+	    }
+	    if (p_->mapped()) {
+	      unmapFile(p_->mapping());
+	    } else if (p_->large()) {
+	      const typename IStringText<Char>::LargeChars c = p_->largeChars();
+	      this->deallocate((uint8_t*)c.chars, c.capacity * sizeof(Char));
+	    } else if (p_->borrowed()) {
+	      typedef typename SharedIStringAllocator<Allocator>::type
+		      LenderAllocator;
+	      IStringTextPtr<Char, LenderAllocator>::adopt(p_->lender(),
+							   allocator());
+	    }
 	    const size_t allocationSize = p_->allocationSize();
 	    p_->~IStringText<Char>();
 	    this->deallocate((uint8_t*)p_, allocationSize);
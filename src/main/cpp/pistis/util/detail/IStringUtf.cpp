@@ -0,0 +1,524 @@
+#include "IStringUtf.hpp"
+#include <pistis/util/InvalidUtfError.hpp>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PISTIS_ISTRING_UTF_X86
+#include <immintrin.h>
+#endif
+
+using namespace pistis::util::detail;
+
+namespace {
+
+  // Runs of ASCII shorter than this are handled one unit at a time
+  constexpr size_t MIN_KERNEL_RUN = 16;
+
+  template <typename Unit>
+  size_t scalarAsciiPrefix(const Unit* text, size_t n) {
+    size_t i = 0;
+    while ((i < n) && (text[i] < 0x80)) {
+      ++i;
+    }
+    return i;
+  }
+
+  template <typename In, typename Out>
+  size_t scalarCopyAscii(const In* text, size_t n, Out* out) {
+    size_t i = 0;
+    while ((i < n) && (text[i] < 0x80)) {
+      out[i] = (Out)text[i];
+      ++i;
+    }
+    return i;
+  }
+
+#ifdef PISTIS_ISTRING_UTF_X86
+
+  __attribute__((target("avx2")))
+  size_t avx2AsciiPrefix8(const uint8_t* text, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+      const __m256i v = _mm256_loadu_si256((const __m256i*)(text + i));
+      const uint32_t high = (uint32_t)_mm256_movemask_epi8(v);
+      if (high) {
+	return i + __builtin_ctz(high);
+      }
+    }
+    return i + scalarAsciiPrefix(text + i, n - i);
+  }
+
+  __attribute__((target("avx2")))
+  size_t avx2AsciiPrefix16(const uint16_t* text, size_t n) {
+    const __m256i nonAscii = _mm256_set1_epi16((short)0xFF80);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      const __m256i v = _mm256_loadu_si256((const __m256i*)(text + i));
+      if (!_mm256_testz_si256(v, nonAscii)) {
+	break;
+      }
+    }
+    return i + scalarAsciiPrefix(text + i, n - i);
+  }
+
+  __attribute__((target("avx2")))
+  size_t avx2AsciiPrefix32(const uint32_t* text, size_t n) {
+    const __m256i nonAscii = _mm256_set1_epi32((int)0xFFFFFF80);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+      const __m256i v = _mm256_loadu_si256((const __m256i*)(text + i));
+      if (!_mm256_testz_si256(v, nonAscii)) {
+	break;
+      }
+    }
+    return i + scalarAsciiPrefix(text + i, n - i);
+  }
+
+  __attribute__((target("avx2")))
+  size_t avx2CopyAscii8to16(const uint8_t* text, size_t n, uint16_t* out) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      const __m128i v = _mm_loadu_si128((const __m128i*)(text + i));
+      if (_mm_movemask_epi8(v)) {
+	break;
+      }
+      _mm256_storeu_si256((__m256i*)(out + i), _mm256_cvtepu8_epi16(v));
+    }
+    return i + scalarCopyAscii(text + i, n - i, out + i);
+  }
+
+  __attribute__((target("avx2")))
+  size_t avx2CopyAscii8to32(const uint8_t* text, size_t n, uint32_t* out) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      const __m128i v = _mm_loadu_si128((const __m128i*)(text + i));
+      if (_mm_movemask_epi8(v)) {
+	break;
+      }
+      _mm256_storeu_si256((__m256i*)(out + i), _mm256_cvtepu8_epi32(v));
+      _mm256_storeu_si256((__m256i*)(out + i + 8),
+			  _mm256_cvtepu8_epi32(_mm_srli_si128(v, 8)));
+    }
+    return i + scalarCopyAscii(text + i, n - i, out + i);
+  }
+
+  __attribute__((target("avx2")))
+  size_t avx2CopyAscii16to8(const uint16_t* text, size_t n, uint8_t* out) {
+    const __m256i nonAscii = _mm256_set1_epi16((short)0xFF80);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      const __m256i v = _mm256_loadu_si256((const __m256i*)(text + i));
+      if (!_mm256_testz_si256(v, nonAscii)) {
+	break;
+      }
+      // packus works within 128-bit lanes, so gather the two lanes'
+      // results into the low half before storing it
+      const __m256i packed = _mm256_permute4x64_epi64(
+	  _mm256_packus_epi16(v, v), 0x08
+      );
+      _mm_storeu_si128((__m128i*)(out + i), _mm256_castsi256_si128(packed));
+    }
+    return i + scalarCopyAscii(text + i, n - i, out + i);
+  }
+
+  __attribute__((target("avx2")))
+  size_t avx2CopyAscii32to8(const uint32_t* text, size_t n, uint8_t* out) {
+    const __m256i nonAscii = _mm256_set1_epi32((int)0xFFFFFF80);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      const __m256i a = _mm256_loadu_si256((const __m256i*)(text + i));
+      const __m256i b = _mm256_loadu_si256((const __m256i*)(text + i + 8));
+      if (!_mm256_testz_si256(_mm256_or_si256(a, b), nonAscii)) {
+	break;
+      }
+      const __m256i words = _mm256_permute4x64_epi64(
+	  _mm256_packus_epi32(a, b), 0xD8
+      );
+      const __m256i bytes = _mm256_permute4x64_epi64(
+	  _mm256_packus_epi16(words, words), 0x08
+      );
+      _mm_storeu_si128((__m128i*)(out + i), _mm256_castsi256_si128(bytes));
+    }
+    return i + scalarCopyAscii(text + i, n - i, out + i);
+  }
+
+#endif
+
+  struct UtfKernels {
+    const char* name;
+    size_t (*asciiPrefix8)(const uint8_t*, size_t);
+    size_t (*asciiPrefix16)(const uint16_t*, size_t);
+    size_t (*asciiPrefix32)(const uint32_t*, size_t);
+    size_t (*copyAscii8to16)(const uint8_t*, size_t, uint16_t*);
+    size_t (*copyAscii8to32)(const uint8_t*, size_t, uint32_t*);
+    size_t (*copyAscii16to8)(const uint16_t*, size_t, uint8_t*);
+    size_t (*copyAscii32to8)(const uint32_t*, size_t, uint8_t*);
+  };
+
+  UtfKernels selectKernels() {
+#ifdef PISTIS_ISTRING_UTF_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      return UtfKernels{ "avx2", avx2AsciiPrefix8, avx2AsciiPrefix16,
+			 avx2AsciiPrefix32, avx2CopyAscii8to16,
+			 avx2CopyAscii8to32, avx2CopyAscii16to8,
+			 avx2CopyAscii32to8 };
+    }
+#endif
+    return UtfKernels{ "scalar", scalarAsciiPrefix<uint8_t>,
+		       scalarAsciiPrefix<uint16_t>,
+		       scalarAsciiPrefix<uint32_t>,
+		       scalarCopyAscii<uint8_t, uint16_t>,
+		       scalarCopyAscii<uint8_t, uint32_t>,
+		       scalarCopyAscii<uint16_t, uint8_t>,
+		       scalarCopyAscii<uint32_t, uint8_t> };
+  }
+
+  const UtfKernels& kernels() {
+    static const UtfKernels KERNELS = selectKernels();
+    return KERNELS;
+  }
+
+  // Length of the ASCII run at text, which starts with an ASCII unit
+  inline size_t asciiRun(const uint8_t* text, size_t n) {
+    return (n < MIN_KERNEL_RUN) ? 1 : kernels().asciiPrefix8(text, n);
+  }
+
+  inline size_t asciiRun(const uint16_t* text, size_t n) {
+    return (n < MIN_KERNEL_RUN) ? 1 : kernels().asciiPrefix16(text, n);
+  }
+
+  inline size_t asciiRun(const uint32_t* text, size_t n) {
+    return (n < MIN_KERNEL_RUN) ? 1 : kernels().asciiPrefix32(text, n);
+  }
+
+  // Copy the ASCII run at text, which starts with an ASCII unit, to out
+  // and return its length
+  template <typename In, typename Out, typename Kernel>
+  inline size_t copyAsciiRun(const In* text, size_t n, Out* out,
+			     Kernel kernel) {
+    if (n < MIN_KERNEL_RUN) {
+      *out = (Out)*text;
+      return 1;
+    }
+    return kernel(text, n, out);
+  }
+
+  inline size_t utf8Length(uint32_t c) {
+    return (c < 0x80) ? 1 : (c < 0x800) ? 2 : (c < 0x10000) ? 3 : 4;
+  }
+
+  // Units needed for code point c in the encoding with units of the
+  // given size
+  inline size_t encodedLength(uint32_t c, size_t unitSize) {
+    switch (unitSize) {
+      case 1: return utf8Length(c);
+      case 2: return (c < 0x10000) ? 1 : 2;
+      default: return 1;
+    }
+  }
+
+  inline bool isSurrogate(uint32_t c) { return (c >= 0xD800) && (c < 0xE000); }
+
+  inline uint8_t* encodeUtf8(uint32_t c, uint8_t* out) {
+    if (c < 0x80) {
+      *out++ = (uint8_t)c;
+    } else if (c < 0x800) {
+      *out++ = (uint8_t)(0xC0 | (c >> 6));
+      *out++ = (uint8_t)(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+      *out++ = (uint8_t)(0xE0 | (c >> 12));
+      *out++ = (uint8_t)(0x80 | ((c >> 6) & 0x3F));
+      *out++ = (uint8_t)(0x80 | (c & 0x3F));
+    } else {
+      *out++ = (uint8_t)(0xF0 | (c >> 18));
+      *out++ = (uint8_t)(0x80 | ((c >> 12) & 0x3F));
+      *out++ = (uint8_t)(0x80 | ((c >> 6) & 0x3F));
+      *out++ = (uint8_t)(0x80 | (c & 0x3F));
+    }
+    return out;
+  }
+
+  inline uint16_t* encodeUtf16(uint32_t c, uint16_t* out) {
+    if (c < 0x10000) {
+      *out++ = (uint16_t)c;
+    } else {
+      c -= 0x10000;
+      *out++ = (uint16_t)(0xD800 | (c >> 10));
+      *out++ = (uint16_t)(0xDC00 | (c & 0x3FF));
+    }
+    return out;
+  }
+
+  inline uint16_t* storeCodePoint(uint32_t c, uint16_t* out) {
+    return encodeUtf16(c, out);
+  }
+
+  inline uint32_t* storeCodePoint(uint32_t c, uint32_t* out) {
+    *out = c;
+    return out + 1;
+  }
+
+  // Decode the multi-byte UTF-8 sequence at text, which is valid, and
+  // advance text past it
+  inline uint32_t decodeUtf8(const uint8_t*& text) {
+    const uint32_t c = *text;
+    if (c < 0xE0) {
+      const uint32_t result = ((c & 0x1F) << 6) | (text[1] & 0x3F);
+      text += 2;
+      return result;
+    } else if (c < 0xF0) {
+      const uint32_t result = ((c & 0x0F) << 12) | ((text[1] & 0x3F) << 6) |
+	                      (text[2] & 0x3F);
+      text += 3;
+      return result;
+    } else {
+      const uint32_t result = ((c & 0x07) << 18) | ((text[1] & 0x3F) << 12) |
+	                      ((text[2] & 0x3F) << 6) | (text[3] & 0x3F);
+      text += 4;
+      return result;
+    }
+  }
+
+  // Length of the valid multi-byte UTF-8 sequence at text, or zero if
+  // the sequence there is invalid.  The second byte's range depends on
+  // the first to exclude overlong forms, surrogates and code points
+  // past U+10FFFF (see table 3-7 of the Unicode standard).
+  inline size_t validUtf8SequenceLength(const uint8_t* text, size_t n) {
+    const uint8_t c = text[0];
+    size_t length;
+    uint8_t low = 0x80, high = 0xBF;
+
+    if (c < 0xC2) {
+      return 0;
+    } else if (c < 0xE0) {
+      length = 2;
+    } else if (c < 0xF0) {
+      length = 3;
+      if (c == 0xE0) {
+	low = 0xA0;
+      } else if (c == 0xED) {
+	high = 0x9F;
+      }
+    } else if (c < 0xF5) {
+      length = 4;
+      if (c == 0xF0) {
+	low = 0x90;
+      } else if (c == 0xF4) {
+	high = 0x8F;
+      }
+    } else {
+      return 0;
+    }
+
+    if ((n < length) || (text[1] < low) || (text[1] > high)) {
+      return 0;
+    }
+    for (size_t i = 2; i < length; ++i) {
+      if ((text[i] & 0xC0) != 0x80) {
+	return 0;
+      }
+    }
+    return length;
+  }
+
+  template <typename Out, typename Kernel>
+  void decodeUtf8To(const uint8_t* text, size_t n, Out* out, Kernel kernel) {
+    const uint8_t* const end = text + n;
+    while (text < end) {
+      if (*text < 0x80) {
+	const size_t k = copyAsciiRun(text, end - text, out, kernel);
+	text += k;
+	out += k;
+      } else {
+	out = storeCodePoint(decodeUtf8(text), out);
+      }
+    }
+  }
+}
+
+namespace pistis {
+  namespace util {
+    namespace detail {
+
+      UtfScan scanUtf(const uint8_t* text, size_t n, size_t outUnitSize) {
+	size_t i = 0;
+	size_t length = 0;
+	while (i < n) {
+	  if (text[i] < 0x80) {
+	    const size_t k = asciiRun(text + i, n - i);
+	    i += k;
+	    length += k;
+	  } else {
+	    const size_t k = validUtf8SequenceLength(text + i, n - i);
+	    if (!k) {
+	      return UtfScan{ length, i };
+	    }
+	    length += (outUnitSize == 1) ? k
+	                                 : ((outUnitSize == 2) && (k == 4)) ? 2
+	                                 : 1;
+	    i += k;
+	  }
+	}
+	return UtfScan{ length, n };
+      }
+
+      UtfScan scanUtf(const uint16_t* text, size_t n, size_t outUnitSize) {
+	size_t i = 0;
+	size_t length = 0;
+	while (i < n) {
+	  const uint32_t c = text[i];
+	  if (c < 0x80) {
+	    const size_t k = asciiRun(text + i, n - i);
+	    i += k;
+	    length += k;
+	  } else if (!isSurrogate(c)) {
+	    length += (outUnitSize == 1) ? utf8Length(c) : 1;
+	    ++i;
+	  } else if ((c < 0xDC00) && ((i + 1) < n) &&
+		     (text[i + 1] >= 0xDC00) && (text[i + 1] < 0xE000)) {
+	    length += (outUnitSize == 1) ? 4 : (outUnitSize == 2) ? 2 : 1;
+	    i += 2;
+	  } else {
+	    return UtfScan{ length, i };
+	  }
+	}
+	return UtfScan{ length, n };
+      }
+
+      UtfScan scanUtf(const uint32_t* text, size_t n, size_t outUnitSize) {
+	size_t i = 0;
+	size_t length = 0;
+	while (i < n) {
+	  const uint32_t c = text[i];
+	  if (c < 0x80) {
+	    const size_t k = asciiRun(text + i, n - i);
+	    i += k;
+	    length += k;
+	  } else if ((c > 0x10FFFF) || isSurrogate(c)) {
+	    return UtfScan{ length, i };
+	  } else {
+	    length += encodedLength(c, outUnitSize);
+	    ++i;
+	  }
+	}
+	return UtfScan{ length, n };
+      }
+
+      void transcodeUtf(const uint8_t* text, size_t n, uint16_t* out) {
+	decodeUtf8To(text, n, out, kernels().copyAscii8to16);
+      }
+
+      void transcodeUtf(const uint8_t* text, size_t n, uint32_t* out) {
+	decodeUtf8To(text, n, out, kernels().copyAscii8to32);
+      }
+
+      void transcodeUtf(const uint16_t* text, size_t n, uint8_t* out) {
+	const uint16_t* const end = text + n;
+	while (text < end) {
+	  const uint32_t c = *text;
+	  if (c < 0x80) {
+	    const size_t k = copyAsciiRun(text, end - text, out,
+					  kernels().copyAscii16to8);
+	    text += k;
+	    out += k;
+	  } else if (!isSurrogate(c)) {
+	    out = encodeUtf8(c, out);
+	    ++text;
+	  } else {
+	    out = encodeUtf8(0x10000 + ((c - 0xD800) << 10) + (text[1] - 0xDC00),
+			     out);
+	    text += 2;
+	  }
+	}
+      }
+
+      void transcodeUtf(const uint16_t* text, size_t n, uint32_t* out) {
+	const uint16_t* const end = text + n;
+	while (text < end) {
+	  const uint32_t c = *text++;
+	  if (!isSurrogate(c)) {
+	    *out++ = c;
+	  } else {
+	    *out++ = 0x10000 + ((c - 0xD800) << 10) + (*text++ - 0xDC00);
+	  }
+	}
+      }
+
+      void transcodeUtf(const uint32_t* text, size_t n, uint8_t* out) {
+	const uint32_t* const end = text + n;
+	while (text < end) {
+	  if (*text < 0x80) {
+	    const size_t k = copyAsciiRun(text, end - text, out,
+					  kernels().copyAscii32to8);
+	    text += k;
+	    out += k;
+	  } else {
+	    out = encodeUtf8(*text++, out);
+	  }
+	}
+      }
+
+      void transcodeUtf(const uint32_t* text, size_t n, uint16_t* out) {
+	for (const uint32_t* const end = text + n; text < end; ++text) {
+	  out = encodeUtf16(*text, out);
+	}
+      }
+
+      size_t indexUtf8(const uint8_t* text, size_t n, size_t stride,
+		       std::vector<size_t>& offsets) {
+	static constexpr const uint64_t HIGH_BITS = 0x8080808080808080ull;
+	if (!n) {
+	  return 0;
+	}
+
+	// The first byte always starts a code point, even if it is a
+	// continuation byte
+	offsets.push_back(0);
+	size_t count = 1;       // Code points that start before text + i
+	size_t next = stride;   // The next code point to record
+	size_t i = 1;
+	while (i < n) {
+	  if ((i + 8) <= n) {
+	    // Continuation bytes have their top bit set and the next
+	    // bit clear.  Skip words that do not start the next code
+	    // point to record.
+	    uint64_t word;
+	    ::memcpy(&word, text + i, sizeof(word));
+	    const size_t starts =
+		8 - __builtin_popcountll(word & ~(word << 1) & HIGH_BITS);
+	    if ((count + starts) <= next) {
+	      count += starts;
+	      i += 8;
+	      continue;
+	    }
+	  }
+	  if ((text[i] & 0xC0) != 0x80) {
+	    if (count == next) {
+	      offsets.push_back(i);
+	      next += stride;
+	    }
+	    ++count;
+	  }
+	  ++i;
+	}
+	return count;
+      }
+
+      const char* utfName(size_t unitSize) {
+	switch (unitSize) {
+	  case 1: return "UTF-8";
+	  case 2: return "UTF-16";
+	  default: return "UTF-32";
+	}
+      }
+
+      void throwInvalidUtf(size_t unitSize, size_t offset) {
+	throw InvalidUtfError::invalidSequence(utfName(unitSize), offset,
+					       PISTIS_EX_HERE);
+      }
+
+      const char* utfKernel() { return kernels().name; }
+
+    }
+  }
+}
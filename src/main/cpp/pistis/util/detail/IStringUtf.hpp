@@ -0,0 +1,98 @@
+#ifndef __PISTIS__UTIL__DETAIL__ISTRINGUTF_HPP__
+#define __PISTIS__UTIL__DETAIL__ISTRINGUTF_HPP__
+
+/** @file IStringUtf.hpp
+ *
+ *  Validation and transcoding between UTF-8, UTF-16 and UTF-32, used by
+ *  ImmutableString::toUtf8(), toUtf16() and toUtf32().  The encoding of
+ *  a string follows from the width of its code units: one byte for
+ *  UTF-8, two for UTF-16 and four for UTF-32.
+ *
+ *  Transcoding takes two passes.  scanUtf() validates the input and
+ *  computes the length of the output, so the caller can allocate it
+ *  exactly, then transcodeUtf() fills it in.  Both passes handle runs
+ *  of ASCII 16 or 32 units at a time with AVX2 when the CPU supports it;
+ *  everything else is decoded one code point at a time.
+ */
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace pistis {
+  namespace util {
+    namespace detail {
+
+      /** @brief What scanUtf() learned about its input */
+      struct UtfScan {
+	/** @brief Number of code units in the transcoded string */
+	size_t length;
+
+	/** @brief Offset of the first code unit of the first invalid
+	 *         sequence, or the input's length if it is valid
+	 */
+	size_t invalidAt;
+      };
+
+      /** @brief Validate n code units of UTF-8, UTF-16 or UTF-32 and
+       *         count the units they need in the encoding whose units
+       *         are outUnitSize bytes wide.
+       *
+       *  Rejects overlong UTF-8 sequences, surrogates encoded in UTF-8 or
+       *  UTF-32, unpaired UTF-16 surrogates, code points past U+10FFFF
+       *  and truncated sequences.  When the input is invalid, length
+       *  counts the units needed for the valid input before invalidAt.
+       */
+      UtfScan scanUtf(const uint8_t* text, size_t n, size_t outUnitSize);
+      UtfScan scanUtf(const uint16_t* text, size_t n, size_t outUnitSize);
+      UtfScan scanUtf(const uint32_t* text, size_t n, size_t outUnitSize);
+
+      /** @brief Transcode n units of valid input into out, which must
+       *         have room for the length scanUtf() computed.
+       */
+      void transcodeUtf(const uint8_t* text, size_t n, uint16_t* out);
+      void transcodeUtf(const uint8_t* text, size_t n, uint32_t* out);
+      void transcodeUtf(const uint16_t* text, size_t n, uint8_t* out);
+      void transcodeUtf(const uint16_t* text, size_t n, uint32_t* out);
+      void transcodeUtf(const uint32_t* text, size_t n, uint8_t* out);
+      void transcodeUtf(const uint32_t* text, size_t n, uint16_t* out);
+
+      template <typename Unit>
+      inline void transcodeUtf(const Unit* text, size_t n, Unit* out) {
+	if (n) {
+	  ::memcpy(out, text, n * sizeof(Unit));
+	}
+      }
+
+      /** @brief Count the code points in n bytes of UTF-8, appending the
+       *         byte offset of every stride-th one, starting with the
+       *         first, to offsets.
+       *
+       *  Every byte that is not a continuation byte starts a code point,
+       *  and so does the first byte, so invalid input still gets a
+       *  consistent count and a leading run of continuation bytes is a
+       *  code point of its own.
+       */
+      size_t indexUtf8(const uint8_t* text, size_t n, size_t stride,
+		       std::vector<size_t>& offsets);
+
+      /** @brief Name of the encoding whose code units are unitSize bytes
+       *         wide: "UTF-8", "UTF-16" or "UTF-32"
+       */
+      const char* utfName(size_t unitSize);
+
+      /** @brief Throw an InvalidUtfError for the invalid sequence at
+       *         offset in a string whose units are unitSize bytes wide
+       */
+      [[noreturn]] void throwInvalidUtf(size_t unitSize, size_t offset);
+
+      /** @brief Name of the ASCII kernels used on this CPU: "avx2" or
+       *         "scalar"
+       */
+      const char* utfKernel();
+
+    }
+  }
+}
+#endif
@@ -0,0 +1,65 @@
+#include <pistis/util/FileMapping.hpp>
+#include <pistis/util/FileMappingError.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace pistis::util;
+
+namespace {
+  class TemporaryFile {
+  public:
+    TemporaryFile(const std::string& content) {
+      char name[] = "/tmp/pistis_util_FileMappingTests_XXXXXX";
+      const int fd = ::mkstemp(name);
+      EXPECT_LE(0, fd);
+      EXPECT_EQ((ssize_t)content.size(),
+		::write(fd, content.data(), content.size()));
+      ::close(fd);
+      path_ = name;
+    }
+    ~TemporaryFile() { ::unlink(path_.c_str()); }
+
+    const std::string& path() const { return path_; }
+
+  private:
+    std::string path_;
+  };
+}
+
+TEST(FileMappingTests, MapFile) {
+  const std::string CONTENT(10000, 'x');
+  TemporaryFile file(CONTENT);
+  const detail::FileMapping mapping =
+      detail::mapFile(file.path(), FileAccessPattern::SEQUENTIAL);
+
+  ASSERT_TRUE(mapping.address != nullptr);
+  EXPECT_EQ(CONTENT.size(), mapping.length);
+  EXPECT_EQ(0, ::memcmp(CONTENT.data(), mapping.address, CONTENT.size()));
+
+  detail::adviseFileAccess((const char*)mapping.address + 5000, 100,
+			   FileAccessPattern::RANDOM);
+  detail::unmapFile(mapping);
+}
+
+TEST(FileMappingTests, MapEmptyFile) {
+  TemporaryFile file("");
+  const detail::FileMapping mapping =
+      detail::mapFile(file.path(), FileAccessPattern::NORMAL);
+  EXPECT_TRUE(mapping.address == nullptr);
+  EXPECT_EQ(0, mapping.length);
+  detail::unmapFile(mapping);
+}
+
+TEST(FileMappingTests, MapMissingFile) {
+  const std::string PATH("/tmp/pistis_util_FileMappingTests_missing");
+  try {
+    detail::mapFile(PATH, FileAccessPattern::NORMAL);
+    FAIL() << "mapFile() did not throw";
+  } catch(const FileMappingError& e) {
+    EXPECT_NE(std::string::npos, std::string(e.what()).find(PATH));
+  }
+}
@@ -0,0 +1,146 @@
+#include <pistis/util/IStringArena.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace pistis::util;
+
+namespace {
+  size_t textSize(size_t n) {
+    const size_t bytes = detail::IStringText<char>::computeAllocationSize(n);
+    return (bytes + IStringArena::ALIGNMENT - 1) &
+           ~(IStringArena::ALIGNMENT - 1);
+  }
+}
+
+TEST(IStringArenaTests, Allocate) {
+  IStringArena arena(1024);
+
+  EXPECT_EQ(1024, arena.blockSize());
+  EXPECT_EQ(0, arena.numBlocks());
+  EXPECT_EQ(0, arena.bytesAllocated());
+  EXPECT_EQ(0, arena.bytesReserved());
+
+  uint8_t* p1 = arena.allocate(10);
+  uint8_t* p2 = arena.allocate(24);
+  EXPECT_EQ(p1 + 16, p2);
+  EXPECT_EQ(0, (uintptr_t)p2 % IStringArena::ALIGNMENT);
+  EXPECT_EQ(1, arena.numBlocks());
+  EXPECT_EQ(40, arena.bytesAllocated());
+  EXPECT_EQ(1024, arena.bytesReserved());
+
+  // Large requests get their own block and leave the current one alone
+  uint8_t* big = arena.allocate(4000);
+  EXPECT_NE(p2 + 24, big);
+  EXPECT_EQ(p2 + 24, arena.allocate(8));
+  EXPECT_EQ(2, arena.numBlocks());
+  EXPECT_EQ(4048, arena.bytesAllocated());
+  EXPECT_EQ(5024, arena.bytesReserved());
+
+  // Running out of room starts a new block
+  for (size_t i = 0; i < 20; ++i) {
+    arena.allocate(64);
+  }
+  EXPECT_EQ(3, arena.numBlocks());
+
+  arena.release();
+  EXPECT_EQ(0, arena.numBlocks());
+  EXPECT_EQ(0, arena.bytesAllocated());
+  EXPECT_EQ(0, arena.bytesReserved());
+}
+
+TEST(IStringArenaTests, Resize) {
+  IStringArena arena(1024);
+  uint8_t* p1 = arena.allocate(32);
+  uint8_t* p2 = arena.allocate(32);
+
+  EXPECT_TRUE(arena.resize(p2, 32, 100));
+  EXPECT_EQ(136, arena.bytesAllocated());
+  EXPECT_EQ(p2 + 104, arena.allocate(8));
+
+  // Only the most recent allocation can grow, but any can shrink
+  EXPECT_FALSE(arena.resize(p1, 32, 40));
+  EXPECT_TRUE(arena.resize(p1, 32, 16));
+
+  uint8_t* p3 = arena.allocate(64);
+  EXPECT_TRUE(arena.resize(p3, 64, 8));
+  EXPECT_EQ(p3 + 8, arena.allocate(8));
+  EXPECT_FALSE(arena.resize(p3 + 8, 8, 2000));
+}
+
+TEST(IStringArenaTests, MoveArena) {
+  IStringArena arena(1024);
+  uint8_t* p = arena.allocate(32);
+
+  IStringArena moved(std::move(arena));
+  EXPECT_EQ(0, arena.numBlocks());
+  EXPECT_EQ(1, moved.numBlocks());
+  EXPECT_EQ(32, moved.bytesAllocated());
+  EXPECT_EQ(p + 32, moved.allocate(8));
+
+  arena = std::move(moved);
+  EXPECT_EQ(0, moved.numBlocks());
+  EXPECT_EQ(1, arena.numBlocks());
+  EXPECT_EQ(40, arena.bytesAllocated());
+}
+
+TEST(IStringArenaTests, CreateStrings) {
+  const std::string text("The quick brown fox jumps over the lazy dog");
+  IStringArena arena(1024);
+  IStringArenaAllocator allocator(arena);
+  {
+    ArenaIString s(text, allocator);
+    EXPECT_TRUE(s == text);
+    EXPECT_EQ(&arena, s.allocator().arena());
+    EXPECT_EQ(textSize(text.size()), arena.bytesAllocated());
+
+    ArenaIString fox = s.substr(16, 19);
+    EXPECT_TRUE(fox == "fox");
+    ArenaIString copy(s);
+    EXPECT_EQ(s.data(), copy.data());
+    EXPECT_EQ(textSize(text.size()), arena.bytesAllocated());
+
+    ArenaIString lazy = s + ArenaIString(" and the cat", allocator);
+    EXPECT_TRUE(lazy == text + " and the cat");
+    EXPECT_EQ(&arena, lazy.allocator().arena());
+    EXPECT_EQ(1, arena.numBlocks());
+  }
+  arena.release();
+
+  // Arena strings stay on the arena's thread
+  EXPECT_TRUE((std::is_same<
+		   LocalIStringRefCount,
+		   IStringRefCountPolicy<ArenaIString::AllocatorType>::type
+	       >::value));
+
+  // Strings without an arena use the heap
+  ArenaIString s(text);
+  EXPECT_EQ(nullptr, s.allocator().arena());
+  EXPECT_TRUE(s == text);
+  EXPECT_EQ(0, arena.bytesAllocated());
+}
+
+TEST(IStringArenaTests, BuildStrings) {
+  IStringArena arena(4096);
+  IStringArenaAllocator allocator(arena);
+  std::string truth;
+
+  ArenaIStringBuilder builder(allocator);
+  for (size_t i = 0; i < 100; ++i) {
+    builder << "item " << i << ", ";
+    truth += "item " + std::to_string(i) + ", ";
+  }
+  ArenaIString s = builder.done();
+
+  // The builder grew its buffer in place and gave the unused part back,
+  // so the arena holds exactly one text, the string's.
+  EXPECT_TRUE(s == truth);
+  EXPECT_EQ(1, arena.numBlocks());
+  EXPECT_EQ(textSize(truth.size()), arena.bytesAllocated());
+
+  ArenaIStringBuilder another(allocator);
+  another << "abc" << 123 << "def" << 456 << "ghi";
+  EXPECT_TRUE(another.done() == "abc123def456ghi");
+}
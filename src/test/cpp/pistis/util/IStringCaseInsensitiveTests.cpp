@@ -0,0 +1,44 @@
+#include <pistis/util/IStringCaseInsensitive.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace pistis::util;
+
+TEST(IStringCaseInsensitiveTests, HashAgreesWithEquality) {
+  const CaseInsensitiveIStringHash hash;
+  const CaseInsensitiveIStringEqual equal;
+  const IString a("Content-Type");
+  const IString b("CONTENT-type");
+
+  EXPECT_TRUE(equal(a, b));
+  EXPECT_EQ(hash(a), hash(b));
+  EXPECT_EQ(a.hashIgnoreCase(), hash(a));
+  EXPECT_FALSE(equal(a, IString("Content-Types")));
+  EXPECT_NE(hash(a), CaseInsensitiveIStringHash(1)(a));
+}
+
+TEST(IStringCaseInsensitiveTests, UnorderedMap) {
+  std::unordered_map<IString, int, CaseInsensitiveIStringHash,
+		     CaseInsensitiveIStringEqual> headers;
+  headers[IString("Content-Length")] = 42;
+  headers[IString("Host")] = 1;
+  headers[IString("CONTENT-LENGTH")] = 43;
+
+  EXPECT_EQ((size_t)2, headers.size());
+  EXPECT_EQ(43, headers.at(IString("content-length")));
+  EXPECT_EQ(1, headers.at(IString("hOST")));
+  EXPECT_EQ((size_t)0, headers.count(IString("Hosts")));
+}
+
+TEST(IStringCaseInsensitiveTests, UnorderedSetOfWideStrings) {
+  std::unordered_set<WIString, CaseInsensitiveIStringHash,
+		     CaseInsensitiveIStringEqual> keys;
+  keys.insert(WIString(std::wstring(L"Accept-Encoding")));
+  keys.insert(WIString(std::wstring(L"accept-encoding")));
+  keys.insert(WIString(std::wstring(L"Accept-Language")));
+
+  EXPECT_EQ((size_t)2, keys.size());
+  EXPECT_EQ((size_t)1, keys.count(WIString(std::wstring(L"ACCEPT-ENCODING"))));
+}
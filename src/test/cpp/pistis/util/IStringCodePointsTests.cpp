@@ -0,0 +1,129 @@
+#include <pistis/util/IStringCodePoints.hpp>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace pistis::util;
+
+namespace {
+  // Code points of one, two, three and four bytes
+  const std::string PHRASE(
+      "\xC3\x87" "a co\xC3\xBB" "te 5 \xE2\x82\xAC \xF0\x9F\x98\x80 "
+  );
+  const size_t PHRASE_LENGTH = 15;
+
+  std::string repeat(const std::string& s, size_t n) {
+    std::string result;
+    for (size_t i = 0; i < n; ++i) {
+      result += s;
+    }
+    return result;
+  }
+
+  void verifyAgainstUtf32(const IString& text, size_t stride) {
+    const U32_IString expected = text.toUtf32();
+    const IStringCodePoints codePoints(text, stride);
+
+    ASSERT_EQ(expected.size(), codePoints.length());
+    size_t offset = 0;
+    for (size_t i = 0; i < expected.size(); ++i) {
+      ASSERT_EQ(offset, codePoints.offsetOf(i)) << "i = " << i;
+      ASSERT_EQ(expected[i], codePoints[i]) << "i = " << i;
+      const U32_IString c(expected.data() + i, expected.data() + i + 1);
+      const size_t next = offset + c.toUtf8().size();
+      for (size_t p = offset; p < next; ++p) {
+	ASSERT_EQ(i, codePoints.indexOf(p)) << "p = " << p;
+      }
+      offset = next;
+    }
+    EXPECT_EQ(text.size(), codePoints.offsetOf(expected.size()));
+    EXPECT_EQ(expected.size(), codePoints.indexOf(text.size()));
+  }
+}
+
+TEST(IStringCodePointsTests, Length) {
+  EXPECT_EQ((size_t)0, IStringCodePoints(IString()).length());
+  EXPECT_EQ(PHRASE_LENGTH, IStringCodePoints(IString(PHRASE)).length());
+  EXPECT_EQ(PHRASE_LENGTH * 100,
+	    IStringCodePoints(IString(repeat(PHRASE, 100))).length());
+  EXPECT_EQ(PHRASE_LENGTH * 100,
+	    IStringCodePoints(IString(repeat(PHRASE, 100)), 1).length());
+}
+
+TEST(IStringCodePointsTests, AccessMatchesUtf32) {
+  const IString text(repeat(PHRASE, 40));
+  for (size_t stride : { 1, 3, 64, 1000 }) {
+    SCOPED_TRACE("stride = " + std::to_string(stride));
+    verifyAgainstUtf32(text, stride);
+  }
+  verifyAgainstUtf32(IString(std::string(300, 'a') + PHRASE), 64);
+  verifyAgainstUtf32(IString("short"), 64);
+}
+
+TEST(IStringCodePointsTests, Substr) {
+  const IString text(repeat(PHRASE, 40));
+  const IStringCodePoints codePoints(text);
+  const size_t start = PHRASE_LENGTH * 20;
+
+  const IString window = codePoints.substr(start, start + PHRASE_LENGTH);
+  EXPECT_EQ(IString(PHRASE), window);
+  EXPECT_EQ(text.data() + PHRASE.size() * 20, window.data());
+
+  EXPECT_EQ(IString("\xF0\x9F\x98\x80 \xC3\x87"),
+	    codePoints.substr(start - 2, start + 1));
+  EXPECT_EQ(text, codePoints.substr(0));
+  EXPECT_EQ(IString(), codePoints.substr(start, start - 1));
+  EXPECT_EQ(IString(), codePoints.substr(codePoints.length() + 5));
+}
+
+TEST(IStringCodePointsTests, CopiesShareIndex) {
+  const IString text(repeat(PHRASE, 1000));
+  const IStringCodePoints codePoints(text);
+  std::vector<std::thread> threads;
+  std::vector<size_t> lengths(4);
+
+  for (size_t i = 0; i < lengths.size(); ++i) {
+    threads.emplace_back([codePoints, &lengths, i]() {
+      lengths[i] = codePoints.length();
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (size_t n : lengths) {
+    EXPECT_EQ(PHRASE_LENGTH * 1000, n);
+  }
+}
+
+TEST(IStringCodePointsTests, LeadingContinuationBytes) {
+  for (size_t stride : { 1, 64 }) {
+    SCOPED_TRACE("stride = " + std::to_string(stride));
+    const IStringCodePoints codePoints(IString("\x80\xBF" "a\xC3\x87"),
+				       stride);
+
+    EXPECT_EQ((size_t)3, codePoints.length());
+    EXPECT_EQ((size_t)0, codePoints.offsetOf(0));
+    EXPECT_EQ((size_t)2, codePoints.offsetOf(1));
+    EXPECT_EQ((size_t)3, codePoints.offsetOf(2));
+    EXPECT_EQ((size_t)0, codePoints.indexOf(0));
+    EXPECT_EQ((size_t)0, codePoints.indexOf(1));
+    EXPECT_EQ((size_t)1, codePoints.indexOf(2));
+    EXPECT_EQ((size_t)2, codePoints.indexOf(4));
+    EXPECT_EQ((size_t)3, codePoints.indexOf(5));
+    EXPECT_EQ(IString("\x80\xBF"), codePoints.substr(0, 1));
+    EXPECT_EQ(IString("\x80\xBF" "a"), codePoints.substr(0, 2));
+  }
+
+  const IStringCodePoints onlyContinuations(IString("\x80\x80"));
+  EXPECT_EQ((size_t)1, onlyContinuations.length());
+  EXPECT_EQ((size_t)0, onlyContinuations.offsetOf(0));
+  EXPECT_EQ((size_t)0, onlyContinuations.indexOf(1));
+  EXPECT_EQ(IString("\x80\x80"), onlyContinuations.substr(0, 1));
+}
+
+TEST(IStringCodePointsTests, ZeroStrideIsIllegal) {
+  EXPECT_THROW(IStringCodePoints(IString("abc"), 0),
+	       pistis::exceptions::IllegalValueError);
+}
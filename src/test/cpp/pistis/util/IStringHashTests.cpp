@@ -0,0 +1,112 @@
+#include <pistis/util/IStringHash.hpp>
+#include <pistis/util/CStringUtil.hpp>
+#include <pistis/util/IString.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace pistis::util;
+
+namespace {
+  template <typename Char>
+  std::basic_string<Char> makeText(size_t n) {
+    std::basic_string<Char> text;
+    for (size_t i = 0; i < n; ++i) {
+      text.push_back((Char)(0x20 + ((i * 37) % 0xE0)));
+    }
+    return text;
+  }
+
+  template <typename Char>
+  void verifyComputeMatchesRuntime() {
+    const WyHasher hasher(12345);
+    const std::basic_string<Char> text = makeText<Char>(200);
+
+    for (size_t n = 0; n <= text.size(); ++n) {
+      EXPECT_EQ(hasher.compute(text.data(), n), hasher(text.data(), n))
+	  << "n = " << n;
+    }
+  }
+}
+
+TEST(IStringHashTests, Djb2) {
+  EXPECT_EQ((size_t)210706217108, Djb2Hasher()("abcde", 5));
+  EXPECT_EQ((size_t)5381, Djb2Hasher()("", 0));
+}
+
+TEST(IStringHashTests, ComputeMatchesRuntimeHash) {
+  verifyComputeMatchesRuntime<char>();
+  verifyComputeMatchesRuntime<char16_t>();
+  verifyComputeMatchesRuntime<char32_t>();
+}
+
+TEST(IStringHashTests, ComputeAtCompileTime) {
+  constexpr size_t H = WyHasher().compute("compile time", 12);
+  EXPECT_EQ(WyHasher()("compile time", 12), H);
+}
+
+TEST(IStringHashTests, SeedChangesHash) {
+  const std::string text("seeded hash");
+
+  EXPECT_NE(WyHasher(1)(text.data(), text.size()),
+	    WyHasher(2)(text.data(), text.size()));
+  EXPECT_EQ(processHashSeed(), SeededWyHasher().seed());
+  EXPECT_EQ(WyHasher(processHashSeed())(text.data(), text.size()),
+	    SeededWyHasher()(text.data(), text.size()));
+}
+
+TEST(IStringHashTests, LowBitsAreWellDistributed) {
+  const size_t NUM_BUCKETS = 4096;
+  std::vector<size_t> counts(NUM_BUCKETS, 0);
+
+  for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+    const std::string key = "key" + std::to_string(i);
+    ++counts[WyHasher()(key.data(), key.size()) & (NUM_BUCKETS - 1)];
+  }
+  EXPECT_LE(*std::max_element(counts.begin(), counts.end()), 10);
+}
+
+TEST(IStringHashTests, CStringHashers) {
+  EXPECT_EQ(Djb2Hasher()("abcde", 5), CStringHasher()("abcde"));
+  EXPECT_EQ(IString("abcde").hash(), FastCStringHasher()("abcde"));
+  EXPECT_EQ(computeHashCode("abcde"), CStringHasher()("abcde"));
+}
+
+TEST(IStringHashTests, CaseInsensitiveHashFoldsAsciiLetters) {
+  const CaseInsensitiveWyHasher hasher(99);
+  const WyHasher plain(99);
+
+  // Every length exercises a different mix of the reads wyhash makes
+  for (size_t n = 0; n <= 120; ++n) {
+    std::string mixed, lower;
+    for (size_t i = 0; i < n; ++i) {
+      const char c = "aBcDeFgHiJkLmNoPqRsTuVwXyZ@[`{\x80\xC1\xDA"[i % 33];
+      mixed.push_back(c);
+      lower.push_back(((c >= 'A') && (c <= 'Z')) ? (char)(c + 32) : c);
+    }
+    ASSERT_EQ(plain(lower.data(), n), hasher(mixed.data(), n)) << "n = " << n;
+    ASSERT_EQ(hasher.compute(mixed.data(), n), hasher(mixed.data(), n))
+	<< "n = " << n;
+
+    const std::u16string wideMixed(mixed.begin(), mixed.end());
+    const std::u16string wideLower(lower.begin(), lower.end());
+    ASSERT_EQ(plain(wideLower.data(), n), hasher(wideMixed.data(), n))
+	<< "n = " << n;
+
+    const std::u32string widerMixed(mixed.begin(), mixed.end());
+    const std::u32string widerLower(lower.begin(), lower.end());
+    ASSERT_EQ(plain(widerLower.data(), n), hasher(widerMixed.data(), n))
+	<< "n = " << n;
+    ASSERT_EQ(hasher.compute(widerMixed.data(), n),
+	      hasher(widerMixed.data(), n)) << "n = " << n;
+  }
+}
+
+TEST(IStringHashTests, CaseInsensitiveHashLeavesWideUnitsAlone) {
+  // U+0141 and U+0161 have the low byte of 'A' and 'a'
+  const char16_t upper[] = { 0x0141, 0x0142 };
+  const char16_t lower[] = { 0x0161, 0x0162 };
+  EXPECT_NE(CaseInsensitiveWyHasher()(upper, 2),
+	    CaseInsensitiveWyHasher()(lower, 2));
+}
@@ -0,0 +1,211 @@
+#include <pistis/util/IStringPatternSet.hpp>
+#include <pistis/util/IString.hpp>
+#include <pistis/exceptions/IllegalValueError.hpp>
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace pistis::util;
+
+namespace {
+  typedef IStringPatternSet::Match Match;
+
+  std::vector<Match> allMatches(const IStringPatternSet& patterns,
+				const std::string& text) {
+    std::vector<Match> matches;
+    patterns.forEachMatch(text.data(), text.size(),
+			  [&matches](const Match& m) { matches.push_back(m); });
+    return matches;
+  }
+
+  // Leftmost-longest, non-overlapping matches found the slow way
+  std::vector<Match> naiveMatches(const std::vector<std::string>& patterns,
+				  const std::string& text) {
+    std::vector<Match> matches;
+    size_t i = 0;
+    while (i < text.size()) {
+      Match best{ 0, 0, 0 };
+      for (size_t j = 0; j < patterns.size(); ++j) {
+	const std::string& p = patterns[j];
+	if ((p.size() > best.length) && !text.compare(i, p.size(), p)) {
+	  best = Match{ i, p.size(), j };
+	}
+      }
+      if (best.length) {
+	matches.push_back(best);
+	i += best.length;
+      } else {
+	++i;
+      }
+    }
+    return matches;
+  }
+
+  ::testing::AssertionResult sameMatches(const std::vector<Match>& truth,
+					 const std::vector<Match>& matches) {
+    if (truth.size() != matches.size()) {
+      return ::testing::AssertionFailure()
+	  << "Expected " << truth.size() << " matches, but found "
+	  << matches.size();
+    }
+    for (size_t i = 0; i < truth.size(); ++i) {
+      if ((truth[i].position != matches[i].position) ||
+	  (truth[i].length != matches[i].length) ||
+	  (truth[i].pattern != matches[i].pattern)) {
+	return ::testing::AssertionFailure()
+	    << "Match " << i << " should be (" << truth[i].position << ", "
+	    << truth[i].length << ", " << truth[i].pattern << "), but it is ("
+	    << matches[i].position << ", " << matches[i].length << ", "
+	    << matches[i].pattern << ")";
+      }
+    }
+    return ::testing::AssertionSuccess();
+  }
+}
+
+TEST(IStringPatternSetTests, CreateFromPatterns) {
+  const IStringPatternSet patterns{ "he", "she", "his", "hers" };
+  EXPECT_EQ(4, patterns.size());
+  EXPECT_EQ("she", patterns.pattern(1));
+  EXPECT_EQ("", patterns.replacement(1));
+  // Root, h, he, her, hers, hi, his, s, sh, she
+  EXPECT_EQ(10, patterns.numStates());
+  EXPECT_TRUE(patterns.prefiltered());
+}
+
+TEST(IStringPatternSetTests, CreateFromMapping) {
+  const std::map<IString, std::string> mapping{
+    { IString("cow"), "moo" }, { IString("sheep"), "baa" }
+  };
+  const IStringPatternSet patterns(mapping);
+  ASSERT_EQ(2, patterns.size());
+  EXPECT_EQ("cow", patterns.pattern(0));
+  EXPECT_EQ("moo", patterns.replacement(0));
+  EXPECT_EQ("sheep", patterns.pattern(1));
+  EXPECT_EQ("baa", patterns.replacement(1));
+
+  const std::vector<std::string> words{ "cow", "sheep" };
+  const IStringPatternSet fromIterators(words.begin(), words.end());
+  EXPECT_EQ(2, fromIterators.size());
+  EXPECT_EQ("", fromIterators.replacement(0));
+}
+
+TEST(IStringPatternSetTests, CreateWithEmptyPattern) {
+  EXPECT_THROW(IStringPatternSet({ "cow", "" }),
+	       pistis::exceptions::IllegalValueError);
+}
+
+TEST(IStringPatternSetTests, Find) {
+  const IStringPatternSet patterns{ "he", "she", "his", "hers" };
+  const std::string text("ushers");
+  Match match;
+
+  // "she" and "he" both end at offset 3, but "she" starts first
+  ASSERT_TRUE(patterns.find(text.data(), text.size(), match));
+  EXPECT_EQ(1, match.position);
+  EXPECT_EQ(3, match.length);
+  EXPECT_EQ(1, match.pattern);
+
+  EXPECT_TRUE(patterns.find(text.data() + 2, 4, match));
+  EXPECT_EQ(0, match.position);
+  EXPECT_EQ(4, match.length);
+  EXPECT_EQ(3, match.pattern);
+
+  EXPECT_FALSE(patterns.find(text.data(), 2, match));
+  EXPECT_FALSE(patterns.find(text.data(), 0, match));
+}
+
+TEST(IStringPatternSetTests, LeftmostLongest) {
+  const std::vector<std::string> words{ "bcd", "abcde", "b", "cd", "ab" };
+  const IStringPatternSet patterns(words);
+
+  // "abcde" is longer than "ab", though "bcd" ends first
+  EXPECT_TRUE(sameMatches(std::vector<Match>{ { 0, 5, 1 } },
+			  allMatches(patterns, "abcde")));
+
+  // Without the "e", "ab" is the longest match at 0, and "cd" follows
+  EXPECT_TRUE(sameMatches(std::vector<Match>{ { 0, 2, 4 }, { 2, 2, 3 } },
+			  allMatches(patterns, "abcdx")));
+
+  // Matches at the very end of the text
+  EXPECT_TRUE(sameMatches(std::vector<Match>{ { 1, 3, 0 } },
+			  allMatches(patterns, "xbcd")));
+}
+
+TEST(IStringPatternSetTests, DuplicatePatterns) {
+  const IStringPatternSet patterns{ { "cow", "moo" }, { "cow", "baa" } };
+  EXPECT_TRUE(sameMatches(std::vector<Match>{ { 2, 3, 0 } },
+			  allMatches(patterns, "a cow")));
+}
+
+TEST(IStringPatternSetTests, MatchRandomText) {
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<int> letter('a', 'd');
+  auto randomString = [&rng, &letter](size_t n) {
+    std::string s;
+    for (size_t i = 0; i < n; ++i) {
+      s.push_back((char)letter(rng));
+    }
+    return s;
+  };
+
+  for (size_t trial = 0; trial < 50; ++trial) {
+    std::vector<std::string> words;
+    for (size_t i = 0; i < 1 + trial % 7; ++i) {
+      words.push_back(randomString(1 + (rng() % 5)));
+    }
+    const IStringPatternSet patterns(words);
+    const std::string text = randomString(500);
+    ASSERT_TRUE(sameMatches(naiveMatches(words, text),
+			    allMatches(patterns, text)))
+	<< "on trial " << trial;
+  }
+}
+
+TEST(IStringPatternSetTests, MatchNearRareCharacters) {
+  // 'Q' is the rarest character in both patterns, but it comes later in
+  // one of them
+  const std::vector<std::string> words{ "Quit", "eeeeQ", "ee" };
+  const IStringPatternSet patterns(words);
+  EXPECT_TRUE(patterns.prefiltered());
+
+  const std::string text(std::string(100, 'e') + "Q" +
+			 std::string(100, '-') + "eeeQuit eeeeQ");
+  EXPECT_TRUE(sameMatches(naiveMatches(words, text),
+			  allMatches(patterns, text)));
+}
+
+TEST(IStringPatternSetTests, WithoutPrefilter) {
+  std::vector<std::string> words;
+  for (char c = 'a'; c <= 'z'; ++c) {
+    words.push_back(std::string(1, c) + std::string(1, c - 'a' + 'A'));
+  }
+  const IStringPatternSet patterns(words);
+  EXPECT_FALSE(patterns.prefiltered());
+
+  const std::string text("the qQ rRy zZ xxX");
+  EXPECT_TRUE(sameMatches(naiveMatches(words, text),
+			  allMatches(patterns, text)));
+}
+
+TEST(IStringPatternSetTests, MatchWideCharacters) {
+  const U16_IStringPatternSet patterns{ u"\u4e2d\u6587", u"\u6587\u5b57",
+					u"x\u00e9" };
+  const std::u16string text(
+      u"ax\u00e9 \u4e2d\u6587\u5b57 \u6587\u5b57");
+  std::vector<U16_IStringPatternSet::Match> matches;
+  patterns.forEachMatch(
+      text.data(), text.size(),
+      [&matches](const U16_IStringPatternSet::Match& m) {
+	matches.push_back(m);
+      });
+  ASSERT_EQ(3, matches.size());
+  EXPECT_EQ(1, matches[0].position);
+  EXPECT_EQ(2, matches[0].pattern);
+  EXPECT_EQ(4, matches[1].position);
+  EXPECT_EQ(0, matches[1].pattern);
+  EXPECT_EQ(8, matches[2].position);
+  EXPECT_EQ(1, matches[2].pattern);
+}
@@ -0,0 +1,120 @@
+#include <pistis/util/IStringPool.hpp>
+#include <gtest/gtest.h>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace pistis::util;
+
+TEST(IStringPoolTests, SizeClasses) {
+  EXPECT_EQ(0, IStringPool::sizeClass(1));
+  EXPECT_EQ(32, IStringPool::sizeOfClass(0));
+  EXPECT_EQ(IStringPool::NUM_SIZE_CLASSES - 1,
+	    IStringPool::sizeClass(IStringPool::MAX_POOLED_SIZE));
+  EXPECT_EQ(IStringPool::MAX_POOLED_SIZE,
+	    IStringPool::sizeOfClass(IStringPool::NUM_SIZE_CLASSES - 1));
+
+  // Each request gets the smallest class that holds it
+  for (size_t n = 1; n <= IStringPool::MAX_POOLED_SIZE; ++n) {
+    const size_t c = IStringPool::sizeClass(n);
+    ASSERT_GE(IStringPool::sizeOfClass(c), n) << "n = " << n;
+    if (c) {
+      ASSERT_LT(IStringPool::sizeOfClass(c - 1), n) << "n = " << n;
+    }
+    ASSERT_EQ(0, IStringPool::sizeOfClass(c) % 16) << "n = " << n;
+  }
+}
+
+TEST(IStringPoolTests, AllocateAndFree) {
+  uint8_t* p = IStringPool::allocate(40);
+  uint8_t* q = IStringPool::allocate(40);
+  EXPECT_NE(p, q);
+  EXPECT_EQ(0, (uintptr_t)p % 16);
+
+  IStringPool::deallocate(p, 40);
+  EXPECT_EQ(p, IStringPool::allocate(48));
+  IStringPool::deallocate(q, 40);
+  IStringPool::deallocate(p, 48);
+
+  uint8_t* big = IStringPool::allocate(IStringPool::MAX_POOLED_SIZE + 1);
+  big[IStringPool::MAX_POOLED_SIZE] = 1;
+  IStringPool::deallocate(big, IStringPool::MAX_POOLED_SIZE + 1);
+}
+
+TEST(IStringPoolTests, FreeOnAnotherThread) {
+  const size_t n = IStringPool::REMOTE_BATCH_SIZE * 2 + 5;
+  std::vector<uint8_t*> blocks;
+  for (size_t i = 0; i < n; ++i) {
+    blocks.push_back(IStringPool::allocate(100));
+  }
+
+  std::thread other([&blocks]() {
+    for (uint8_t* p : blocks) {
+      IStringPool::deallocate(p, 100);
+    }
+    IStringPool::flushRemoteFrees();
+  });
+  other.join();
+
+  // The freed blocks come back to this thread
+  std::set<uint8_t*> freed(blocks.begin(), blocks.end());
+  for (size_t i = 0; i < n; ++i) {
+    uint8_t* p = IStringPool::allocate(100);
+    EXPECT_EQ(1, freed.erase(p));
+  }
+  EXPECT_TRUE(freed.empty());
+
+  for (uint8_t* p : blocks) {
+    IStringPool::deallocate(p, 100);
+  }
+}
+
+TEST(IStringPoolTests, ExitedThreadHandsOverCache) {
+  uint8_t* freed = nullptr;
+  std::thread first([&freed]() {
+    freed = IStringPool::allocate(200);
+    IStringPool::deallocate(freed, 200);
+  });
+  first.join();
+
+  uint8_t* reused = nullptr;
+  std::thread second([&reused]() {
+    reused = IStringPool::allocate(200);
+    IStringPool::deallocate(reused, 200);
+  });
+  second.join();
+
+  EXPECT_EQ(freed, reused);
+}
+
+TEST(IStringPoolTests, PooledStrings) {
+  const std::string text("The quick brown fox jumps over the lazy dog");
+  std::vector<PooledIString> words;
+  {
+    PooledIString s(text);
+    EXPECT_TRUE(s == text);
+
+    auto tokens = s.split(PooledIString(" "));
+    while (tokens) {
+      words.push_back(tokens.next());
+    }
+  }
+  ASSERT_EQ(9, words.size());
+  EXPECT_TRUE(words[3] == "fox");
+
+  // Strings released on another thread go back to this one
+  std::thread other([&words]() {
+    PooledIString last = words.back() + PooledIString(" and the cat");
+    EXPECT_TRUE(last == "dog and the cat");
+    words.clear();
+  });
+  other.join();
+
+  PooledIStringBuilder builder;
+  for (size_t i = 0; i < 20; ++i) {
+    builder << i << ' ';
+  }
+  EXPECT_TRUE(builder.done() ==
+	      "0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 ");
+}
@@ -0,0 +1,72 @@
+#include <pistis/util/IStringRefCount.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace pistis::util;
+
+namespace {
+  template <typename RefCount>
+  void verifyCounts() {
+    std::atomic<uint32_t> n(0);
+    RefCount::addRef(n);
+    RefCount::addRef(n);
+    EXPECT_EQ(2, n.load());
+    EXPECT_EQ(1, RefCount::removeRef(n));
+    RefCount::addRef(n);
+    EXPECT_EQ(1, RefCount::removeRef(n));
+    EXPECT_EQ(0, RefCount::removeRef(n));
+  }
+}
+
+TEST(IStringRefCountTests, AtomicRefCount) {
+  verifyCounts<AtomicIStringRefCount>();
+
+  std::atomic<uint32_t> n(1);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 4; ++i) {
+    threads.emplace_back([&n]() {
+      for (size_t j = 0; j < 10000; ++j) {
+	AtomicIStringRefCount::addRef(n);
+	AtomicIStringRefCount::removeRef(n);
+      }
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(1, n.load());
+}
+
+TEST(IStringRefCountTests, LocalRefCount) {
+  verifyCounts<LocalIStringRefCount>();
+}
+
+TEST(IStringRefCountTests, PolicyForAllocator) {
+  typedef std::allocator<uint8_t> SharedAllocator;
+  typedef LocalIStringAllocator<SharedAllocator> LocalAllocator;
+
+  EXPECT_TRUE((std::is_same<
+		   AtomicIStringRefCount,
+		   IStringRefCountPolicy<SharedAllocator>::type
+	       >::value));
+  EXPECT_TRUE((std::is_same<
+		   LocalIStringRefCount,
+		   IStringRefCountPolicy<LocalAllocator>::type
+	       >::value));
+  EXPECT_TRUE((detail::CanTransferIStringText<SharedAllocator,
+		                              LocalAllocator>::value));
+  EXPECT_TRUE((detail::CanTransferIStringText<LocalAllocator,
+		                              SharedAllocator>::value));
+  EXPECT_FALSE((detail::CanTransferIStringText<SharedAllocator,
+		                               SharedAllocator>::value));
+  EXPECT_TRUE((std::is_same<
+		   SharedAllocator,
+		   detail::SharedIStringAllocator<LocalAllocator>::type
+	       >::value));
+  EXPECT_TRUE((std::is_same<
+		   SharedAllocator,
+		   detail::SharedIStringAllocator<SharedAllocator>::type
+	       >::value));
+}
@@ -0,0 +1,48 @@
+#include <pistis/util/IStringRetentionAudit.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using namespace pistis::util;
+
+TEST(IStringRetentionAuditTests, AuditStrings) {
+  const IString document(std::string(10000, 'a') + "needle" +
+			 std::string(10000, 'b'));
+  const IString other(std::string(100, 'c'));
+  std::vector<IString> cache{
+    document.substr(0, 20),
+    document.substr(9990, 10016),
+    other,
+    IString("short"),
+  };
+
+  IStringRetentionAudit audit = IStringRetentionAudit::of(cache);
+  EXPECT_EQ(4, audit.numStrings());
+  EXPECT_EQ(2, audit.numTexts());
+  EXPECT_EQ(20 + 26 + 100 + 5, audit.referencedBytes());
+  EXPECT_EQ(document.bytesPinned() + other.bytesPinned(),
+	    audit.pinnedBytes());
+  EXPECT_GT(audit.pinnedBytes(), 20000);
+
+  // Shrinking the substrings leaves only small texts pinned
+  const IStringCompactionPolicy policy(1024, 0.5);
+  for (IString& s : cache) {
+    s.shrink(policy);
+  }
+  audit = IStringRetentionAudit::of(cache);
+  EXPECT_EQ(4, audit.numStrings());
+  EXPECT_EQ(3, audit.numTexts());
+  EXPECT_EQ(20 + 26 + 100 + 5, audit.referencedBytes());
+  EXPECT_LT(audit.pinnedBytes(), 300);
+}
+
+TEST(IStringRetentionAuditTests, AuditWideStrings) {
+  const U32_IString s(std::u32string(100, U'x'));
+  IStringRetentionAudit audit;
+  audit.add(s).add(s.substr(10, 50)).add(s);
+  EXPECT_EQ(3, audit.numStrings());
+  EXPECT_EQ(1, audit.numTexts());
+  EXPECT_EQ((100 + 40 + 100) * 4, audit.referencedBytes());
+  EXPECT_EQ(s.bytesPinned(), audit.pinnedBytes());
+  EXPECT_GE(audit.pinnedBytes(), 400);
+}
@@ -101,6 +101,93 @@ TEST(IStringSplitStreamTests, SplitByStringWithLimit) {
   EXPECT_EQ(TRUTH, result);
 }
 
+TEST(IStringSplitStreamTests, ReverseSplitByString) {
+  const std::vector<IString> TRUTH{ "hijkl"_is, "g"_is, "de"_is, "abc"_is };
+  IString source("abc||de||g||hijkl");
+  IString target("||");
+  ReverseIStringSplitStream<
+      char, std::char_traits<char>, std::allocator<uint8_t>,
+      char, std::char_traits<char>, std::allocator<uint8_t> >
+      splitStream(source, target);
+
+  std::vector<IString> result = splitStream.toVector();
+  EXPECT_EQ(TRUTH, result);
+}
+
+TEST(IStringSplitStreamTests, ReverseSplitEmptyStringByString) {
+  const std::vector<IString> TRUTH{ };
+  IString source("");
+  IString target("||");
+  ReverseIStringSplitStream<
+      char, std::char_traits<char>, std::allocator<uint8_t>,
+      char, std::char_traits<char>, std::allocator<uint8_t> >
+      splitStream(source, target);
+
+  std::vector<IString> result = splitStream.toVector();
+  EXPECT_EQ(TRUTH, result);
+}
+
+TEST(IStringSplitStreamTests, ReverseSplitByStringSeparatorsAtEnds) {
+  const std::vector<IString> TRUTH{ ""_is, "three"_is, "one"_is, ""_is };
+  IString source("::one::three::");
+  IString target("::");
+  ReverseIStringSplitStream<
+      char, std::char_traits<char>, std::allocator<uint8_t>,
+      char, std::char_traits<char>, std::allocator<uint8_t> >
+      splitStream(source, target);
+
+  std::vector<IString> result = splitStream.toVector();
+  EXPECT_EQ(TRUTH, result);
+}
+
+TEST(IStringSplitStreamTests, ReverseSplitByStringWithConsecutiveSeparators) {
+  const std::vector<IString> TRUTH{ ""_is, "c"_is, "b"_is, ""_is, "a"_is,
+                                    ""_is };
+  IString source(":a::b:c:");
+  IString target(":");
+  ReverseIStringSplitStream<
+      char, std::char_traits<char>, std::allocator<uint8_t>,
+      char, std::char_traits<char>, std::allocator<uint8_t> >
+      splitStream(source, target);
+
+  std::vector<IString> result = splitStream.toVector();
+  EXPECT_EQ(TRUTH, result);
+}
+
+TEST(IStringSplitStreamTests, ReverseSplitByEmptyString) {
+  const std::vector<IString> TRUTH{ "p"_is, "h"_is, "d"_is, "b"_is, "a"_is };
+  IString source("abdhp");
+  IString target("");
+  ReverseIStringSplitStream<
+      char, std::char_traits<char>, std::allocator<uint8_t>,
+      char, std::char_traits<char>, std::allocator<uint8_t> >
+      splitStream(source, target);
+
+  std::vector<IString> result = splitStream.toVector();
+  EXPECT_EQ(TRUTH, result);
+}
+
+TEST(IStringSplitStreamTests, ReverseSplitByStringWithLimit) {
+  const std::vector<IString> TRUTH{ "hijkl"_is, "g"_is, "abc||de"_is };
+  IString source("abc||de||g||hijkl");
+  IString target("||");
+  ReverseIStringSplitStream<
+      char, std::char_traits<char>, std::allocator<uint8_t>,
+      char, std::char_traits<char>, std::allocator<uint8_t> >
+      splitStream(source, target, 2);
+
+  std::vector<IString> result = splitStream.toVector();
+  EXPECT_EQ(TRUTH, result);
+}
+
+TEST(IStringSplitStreamTests, RSplit) {
+  IString path("/var/log/app/server.log.1");
+
+  EXPECT_EQ("server.log.1"_is, path.rsplit(IString("/"), 1).next());
+  EXPECT_EQ((std::vector<IString>{ "1"_is, "/var/log/app/server.log"_is }),
+	    path.rsplit(IString("."), 1).toVector());
+}
+
 TEST(IStringSplitStreamTests, SplitByRegex) {
   const std::vector<IString> TRUTH{
       "apples"_is, "oranges"_is, "bananas"_is, "grapes"_is
@@ -1,12 +1,18 @@
 #include <pistis/util/IString.hpp>
+#include <pistis/util/FileMappingError.hpp>
 #include <pistis/testing/Allocator.hpp>
 #include <gtest/gtest.h>
 #include <algorithm>
 #include <iostream>
 #include <iterator>
+#include <memory>
 #include <regex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
+#include <stdlib.h>
+#include <unistd.h>
 
 using namespace pistis::util;
 namespace pt = pistis::testing;
@@ -203,7 +209,64 @@ TEST(IStringTests, Hash) {
   std::hash<IString> h;
   IString s("abcde");
 
-  EXPECT_EQ((size_t)210706217108, h(s));
+  EXPECT_EQ(WyHasher()("abcde", 5), h(s));
+  EXPECT_EQ((size_t)210706217108, s.hash(Djb2Hasher()));
+}
+
+TEST(IStringTests, HashIgnoreCase) {
+  const IString s("Transfer-Encoding");
+
+  EXPECT_EQ(s.hashIgnoreCase(), IString("transfer-encoding").hashIgnoreCase());
+  EXPECT_EQ(s.hashIgnoreCase(), IString("TRANSFER-ENCODING").hashIgnoreCase());
+  EXPECT_EQ(s.toLower().hash(), s.hashIgnoreCase());
+  EXPECT_NE(s.hashIgnoreCase(), IString("Transfer-Encodings").hashIgnoreCase());
+}
+
+TEST(IStringTests, HashIsCachedConsistently) {
+  const std::string TEXT("a string long enough to live in an IStringText");
+  IString s(TEXT);
+  IString copy(s);
+  IString sub = s.substr(2, 40);
+
+  EXPECT_EQ(s.hash(), s.hash());
+  EXPECT_EQ(s.hash(), copy.hash());
+  EXPECT_EQ(IString(TEXT.data(), TEXT.data() + TEXT.size()).hash(), s.hash());
+  EXPECT_EQ(IString(TEXT.substr(2, 38)).hash(), sub.hash());
+  EXPECT_NE(s.hash(), sub.hash());
+}
+
+TEST(IStringTests, LiteralsCarryTheirHash) {
+  static_assert(detail::HashedIStringLiteral<char, 'c', 'o', 'w'>::HASH ==
+		    WyHasher().compute("cow", 3),
+		"Literal hash is not computed at compile time");
+
+  const std::string TEXT("content-type: text/plain; charset=utf-8");
+  const IString literal = "content-type: text/plain; charset=utf-8"_is;
+  EXPECT_EQ(IString(TEXT).hash(), literal.hash());
+  EXPECT_EQ(std::hash<IString>()(IString(TEXT)),
+	    std::hash<IString>()(literal));
+  EXPECT_EQ(WIString(L"moo").hash(), L"moo"_wis.hash());
+  EXPECT_EQ(IString().hash(), ""_is.hash());
+
+  // hash() trusts the code a literal was made with
+  const IString fake = IString::hashedLiteral("cows", 4, 12345);
+  EXPECT_EQ((size_t)12345, fake.hash());
+  EXPECT_EQ((size_t)12345, IString(fake).hash());
+  IString assigned;
+  assigned = fake;
+  EXPECT_EQ((size_t)12345, assigned.hash());
+  IString moved(std::move(assigned));
+  EXPECT_EQ((size_t)12345, moved.hash());
+  EXPECT_EQ((size_t)12345, LocalIString(fake).hash());
+
+  // But substrings and plain literals hash their characters
+  EXPECT_EQ(IString("cow").hash(), fake.substr(0, 3).hash());
+  EXPECT_EQ(IString(std::string("cows")).hash(),
+	    IString::literal("cows", 4).hash());
+  EXPECT_EQ(IString(TEXT.substr(14)).hash(), literal.substr(14).hash());
+
+  std::unordered_map<IString, int> table{ { IString(TEXT), 1 } };
+  EXPECT_EQ(1, table.at("content-type: text/plain; charset=utf-8"_is));
 }
 
 TEST(IStringTests, Compare) {
@@ -263,6 +326,55 @@ TEST(IStringTests, CompareWithCString) {
   EXPECT_LT(0, s2.cmp(t1));
 }
 
+TEST(IStringTests, CompareDifferentWidths) {
+  const std::string TEXT("content-type: application/json; charset=utf-8");
+  IString s(TEXT);
+  std::u16string wide16(TEXT.begin(), TEXT.end());
+  std::u32string wide32(TEXT.begin(), TEXT.end());
+  const U16_IString u16(wide16);
+  const U32_IString u32(wide32);
+
+  EXPECT_EQ(0, s.cmp(u16));
+  EXPECT_EQ(0, s.cmp(u32));
+  EXPECT_EQ(0, u16.cmp(u32));
+  EXPECT_EQ(0, u32.cmp(s));
+  EXPECT_TRUE(s == u16);
+  EXPECT_TRUE(u32 == s);
+  EXPECT_FALSE(s != wide16);
+
+  for (size_t i : { (size_t)0, (size_t)15, (size_t)16, (size_t)31,
+                    TEXT.size() - 1 }) {
+    std::u16string higher(wide16);
+    higher[i] = u'\u00e9';
+    std::u32string lower(wide32);
+    lower[i] = U'\t';
+
+    EXPECT_GT(0, s.cmp(higher)) << "i = " << i;
+    EXPECT_LT(0, s.cmp(lower)) << "i = " << i;
+    EXPECT_LT(0, U16_IString(higher).cmp(s)) << "i = " << i;
+    EXPECT_TRUE(s != U32_IString(lower)) << "i = " << i;
+  }
+
+  EXPECT_FALSE(s == U16_IString(wide16.substr(1)));
+  EXPECT_TRUE(u16.startsWith(IString("content-type")));
+  EXPECT_TRUE(u32.endsWith(IString("charset=utf-8")));
+  EXPECT_FALSE(s.startsWith(U32_IString(U"content-typo")));
+}
+
+TEST(IStringTests, FindDifferentWidths) {
+  const std::string TEXT("GET /index.html HTTP/1.1\r\nHost: example.com\r\n");
+  IString s(TEXT);
+  std::u16string wideText(TEXT.begin(), TEXT.end());
+  U16_IString ws(wideText);
+
+  EXPECT_EQ(TEXT.find("Host:"), ws.find("Host:"));
+  EXPECT_EQ(TEXT.find("Host:"), s.find(u"Host:"));
+  EXPECT_EQ(TEXT.find("\r\n", 30), s.find(U"\r\n", 30));
+  EXPECT_EQ(IString::NPOS, s.find(u"Host\u0100"));
+  EXPECT_EQ(IString::NPOS, ws.find("Hosts"));
+  EXPECT_EQ(TEXT.find("/index"), ws.find(std::string("/index")));
+}
+
 TEST(IStringTests, Substr) {
   IString s("cows are cool and penguins are cute");
   EXPECT_EQ("cool and penguins", s.substr(9, 26));
@@ -280,6 +392,110 @@ TEST(IStringTests, Shrink) {
   EXPECT_NE(s.data() + 9, ss.data());
 }
 
+TEST(IStringTests, ShrinkWithPolicy) {
+  const std::string text(1000, 'x');
+  const IString s(text + "a token worth keeping" + text);
+  const IStringCompactionPolicy policy(64, 0.05);
+
+  // Copied, because it is short and a tiny part of its text
+  IString token = s.substr(1000, 1021);
+  EXPECT_EQ(s.data() + 1000, token.data());
+  EXPECT_EQ(s.bytesPinned(), token.bytesPinned());
+  token.shrink(policy);
+  EXPECT_EQ("a token worth keeping", token);
+  EXPECT_NE(s.data() + 1000, token.data());
+  EXPECT_LT(token.bytesPinned(), 64);
+
+  // Too long to copy
+  IString big = s.substr(0, 100);
+  EXPECT_EQ(s.data(), big.shrink(policy).data());
+
+  // Too large a part of its text
+  const IString small(std::string(40, 'y'));
+  IString most = small.substr(0, 38);
+  EXPECT_EQ(small.data(), most.shrink(policy).data());
+
+  // The default policy never copies
+  token = s.substr(1000, 1021);
+  EXPECT_EQ(s.data() + 1000, token.shrink(IStringCompactionPolicy()).data());
+
+  token = s.substr(1000, 1021, policy);
+  EXPECT_EQ("a token worth keeping", token);
+  EXPECT_NE(s.data() + 1000, token.data());
+  EXPECT_EQ(0, IString("short").bytesPinned());
+}
+
+TEST(IStringTests, ShortStringsAreInline) {
+  const std::string TEXT("short text");
+  IString s(TEXT);
+  auto isInline = [](const IString& x) {
+    return ((const void*)x.data() >= (const void*)&x) &&
+           ((const void*)x.data() < (const void*)(&x + 1));
+  };
+
+  ASSERT_LE(TEXT.size(), IString::MAX_INLINE_SIZE);
+  EXPECT_TRUE(isInline(s));
+  EXPECT_EQ(TEXT, s);
+
+  IString copy(s);
+  EXPECT_TRUE(isInline(copy));
+  EXPECT_NE(s.data(), copy.data());
+  EXPECT_EQ(TEXT, copy);
+
+  IString moved(std::move(copy));
+  EXPECT_TRUE(isInline(moved));
+  EXPECT_EQ(TEXT, moved);
+  EXPECT_EQ(0, copy.size());
+
+  IString assigned("a much longer string that is not inline"_is);
+  assigned = s;
+  EXPECT_TRUE(isInline(assigned));
+  EXPECT_EQ(TEXT, assigned);
+
+  IString sub = s.substr(6);
+  EXPECT_TRUE(isInline(sub));
+  EXPECT_EQ("text", sub);
+  EXPECT_EQ("text", IString(std::string("  text  ")).strip());
+  EXPECT_GT(0, s.cmp(std::string("shorter")));
+  EXPECT_EQ(6, s.find("text"));
+}
+
+TEST(IStringTests, InlineStringsFitInThreePointers) {
+  auto isInline = [](const auto& x) {
+    return ((const void*)x.data() >= (const void*)&x) &&
+           ((const void*)x.data() < (const void*)(&x + 1));
+  };
+
+  EXPECT_EQ(3 * sizeof(void*), sizeof(IString));
+  EXPECT_EQ(3 * sizeof(void*), sizeof(U16_IString));
+  EXPECT_LE((size_t)15, IString::MAX_INLINE_SIZE);
+
+  const std::string full(IString::MAX_INLINE_SIZE, 'x');
+  const IString longest(full);
+  const IString tooLong(full + "x");
+  EXPECT_EQ(full.size(), longest.size());
+  EXPECT_EQ(full, longest);
+  EXPECT_TRUE(isInline(longest));
+  EXPECT_EQ(full + "x", tooLong);
+  EXPECT_FALSE(isInline(tooLong));
+
+  const U16_IString wide(std::u16string(u"ça va"));
+  EXPECT_TRUE(isInline(wide));
+  EXPECT_EQ((size_t)5, wide.size());
+  EXPECT_EQ(U16_IString(u"va"), wide.substr(3));
+}
+
+TEST(IStringTests, ShortSubstrOfLongStringIsInline) {
+  IString s(std::string("cows are cool and penguins are cute"));
+  IString sub = s.substr(9, 13);
+  IString longSub = s.substr(9, 26);
+
+  EXPECT_EQ("cool", sub);
+  EXPECT_NE(s.data() + 9, sub.data());
+  EXPECT_EQ("cool and penguins", longSub);
+  EXPECT_EQ(s.data() + 9, longSub.data());
+}
+
 TEST(IStringTests, FindChar) {
   IString s("adcbedcba");
 
@@ -317,6 +533,30 @@ TEST(IStringTests, FindImmutableString) {
   EXPECT_EQ(IString::NPOS, s.find(target, 35, 10));
 }
 
+TEST(IStringTests, FindPastEnd) {
+  IString s("I love love cows, oh yes I do! I so love cows!");
+
+  EXPECT_EQ(IString::NPOS, s.find("cows", 100));
+  EXPECT_EQ(IString::NPOS, IString("cow").find("cows"));
+  EXPECT_EQ(IString::NPOS, s.find("cows", s.size() - 3));
+}
+
+TEST(IStringTests, FindInLongText) {
+  std::string text;
+  for (size_t i = 0; i < 100; ++i) {
+    text += "Header-" + std::to_string(i) + ": value\r\n";
+  }
+  IString s(text + "\r\nbody");
+  std::basic_string<char16_t> wideText(text.begin(), text.end());
+  U16_IString ws(wideText + u"\r\nbody");
+
+  EXPECT_EQ(text.size() - 2, s.find("\r\n\r\n"));
+  EXPECT_EQ(text.find("Header-42:"), s.find("Header-42:"));
+  EXPECT_EQ(text.find("\r\n", 500), s.find("\r\n", 500));
+  EXPECT_EQ(text.size() - 2, ws.find(u"\r\n\r\n"));
+  EXPECT_EQ(text.find("Header-42:"), ws.find(u"Header-42:"));
+}
+
 TEST(IStringTests, FindStdString) {
   IString s("I love love cows, oh yes I do! I so love cows!");
   std::string target("love cows");
@@ -407,6 +647,16 @@ TEST(IStringTests, FindLastCharArray) {
   EXPECT_EQ(IString::NPOS, s.findLast("moo"));
 }
 
+TEST(IStringTests, FindLastOtherCharType) {
+  IString s("I love love cows, oh yes I do! I so love cows!");
+
+  EXPECT_EQ(36, s.findLast(U16_IString(u"love cows")));
+  EXPECT_EQ( 7, s.findLast(U16_IString(u"love cows"), 0, 16));
+  EXPECT_EQ(IString::NPOS, s.findLast(U16_IString(u"love cats")));
+  EXPECT_EQ(IString::NPOS, IString("acz").findLast(U16_IString(u"ab")));
+  EXPECT_EQ(IString::NPOS, IString("abab").findLast(U32_IString(U"abc")));
+}
+
 TEST(IStringTests, FindLastCString) {
   IString s("I love love cows, oh yes I do! I so love cows!");
   const char* target = "love cows";
@@ -419,6 +669,26 @@ TEST(IStringTests, FindLastCString) {
   EXPECT_EQ(IString::NPOS, s.findLast(missing));
 }
 
+TEST(IStringTests, FindLastInLongText) {
+  std::string text;
+  for (size_t i = 0; i < 100; ++i) {
+    text += "/segment" + std::to_string(i);
+  }
+  IString s(text);
+  std::u16string wideText(text.begin(), text.end());
+  U16_IString ws(wideText);
+
+  EXPECT_EQ(text.rfind('/'), s.findLast('/'));
+  EXPECT_EQ(text.rfind('/', 499), s.findLast('/', 0, 500));
+  EXPECT_EQ(text.rfind("/segment4"), s.findLast("/segment4"));
+  EXPECT_EQ(text.rfind("/segment4", 600), s.findLast("/segment4", 0, 609));
+  EXPECT_EQ(IString::NPOS, s.findLast("/segment4", 900, 905));
+  EXPECT_EQ(IString::NPOS, s.findLast("/segment4", 2000));
+  EXPECT_EQ(IString::NPOS, IString("seg").findLast("segment"));
+  EXPECT_EQ(text.rfind('/'), ws.findLast(u'/'));
+  EXPECT_EQ(text.rfind("/segment4"), ws.findLast(u"/segment4"));
+}
+
 TEST(IStringTests, FindFirstOf) {
   IString s("I love love cows, oh yes I do! I so love cows!");
   IString target("lco");
@@ -471,6 +741,34 @@ TEST(IStringTests, FindLastOf) {
   EXPECT_EQ( 7, s.findLastOf(ctarget, 1, 9));
 }
 
+TEST(IStringTests, FindFirstAndLastOfInLongText) {
+  std::string text;
+  for (size_t i = 0; i < 200; ++i) {
+    text += "field" + std::to_string(i) + " ";
+  }
+  text[150] = ';';
+  text[900] = '\xE9';
+  IString s(text);
+  const std::string DELIMITERS(";\xE9|");
+  std::u32string wideText(text.begin(), text.end());
+  wideText[400] = U'\u2028';
+  U32_IString ws(wideText);
+
+  EXPECT_EQ(150, s.findFirstOf(DELIMITERS));
+  EXPECT_EQ(900, s.findFirstOf(DELIMITERS, 151));
+  EXPECT_EQ(IString::NPOS, s.findFirstOf(DELIMITERS, 901));
+  EXPECT_EQ(900, s.findLastOf(DELIMITERS));
+  EXPECT_EQ(150, s.findLastOf(DELIMITERS, 0, 900));
+  EXPECT_EQ(IString::NPOS, s.findLastOf(DELIMITERS, 151, 900));
+  EXPECT_EQ(text.find_first_of(" 7", 333), s.findFirstOf(" 7", 333));
+  EXPECT_EQ(text.find_last_of(" 7"), s.findLastOf(" 7"));
+
+  EXPECT_EQ(150, ws.findFirstOf(U";\u2028"));
+  EXPECT_EQ(400, ws.findFirstOf(U";\u2028", 151));
+  EXPECT_EQ(400, ws.findLastOf(U";\u2028"));
+  EXPECT_EQ(IString::NPOS, s.findFirstOf(DELIMITERS, 2000));
+}
+
 TEST(IStringTests, Insert) {
   IString s("abcdef");
   EXPECT_EQ(IString("abcZdef"), s.insert(3, 'Z'));
@@ -640,6 +938,51 @@ TEST(IStringTests, ReplaceWithCString) {
 	    s.replace("cows", wide_penguins));
 }
 
+TEST(IStringTests, FindAny) {
+  const IStringPatternSet patterns{ "cows", "penguins", "best" };
+  IString s("i love cows.  cows are the bestbest.  penguins");
+  EXPECT_EQ(7, s.findAny(patterns));
+  EXPECT_EQ(14, s.findAny(patterns, 8));
+  EXPECT_EQ(27, s.findAny(patterns, 15, 31));
+  EXPECT_EQ(IString::NPOS, s.findAny(patterns, 15, 30));
+  EXPECT_EQ(IString::NPOS, s.findAny(patterns, 100));
+
+  const U32_IStringPatternSet widePatterns{ U"\u2028", U"\u00e9t\u00e9" };
+  EXPECT_EQ(3, U32_IString(U"un \u00e9t\u00e9\u2028").findAny(widePatterns));
+}
+
+TEST(IStringTests, ReplaceAll) {
+  const IStringPatternSet patterns{ { "cows", "penguins" },
+				    { "penguins", "cows" },
+				    { "best", "" } };
+  IString s("i love cows.  cows are the bestbest.  penguins");
+  EXPECT_EQ(IString("i love penguins.  penguins are the .  cows"),
+	    s.replaceAll(patterns));
+  EXPECT_EQ(IString("i love cows.  penguins are the bestbest.  penguins"),
+	    s.replaceAll(patterns, 8, 30));
+
+  // Replacements are not rescanned
+  EXPECT_EQ(IString("penguinscows"),
+	    IString("cowspenguins").replaceAll(patterns));
+
+  // Nothing to replace
+  IString unchanged("no animals here");
+  IString result = unchanged.replaceAll(patterns);
+  EXPECT_EQ(unchanged, result);
+  EXPECT_EQ(unchanged.data(), result.data());
+
+  // A set without replacements removes its patterns
+  const IStringPatternSet removals{ "\r", "\t", "\x1b" };
+  EXPECT_EQ(IString("abcdef"),
+	    IString("a\rb\tc\x1b\rdef").replaceAll(removals));
+
+  const WIStringPatternSet widePatterns{ { L"&", L"&amp;" },
+					 { L"<", L"&lt;" },
+					 { L">", L"&gt;" } };
+  EXPECT_EQ(WIString(L"a &lt;b&gt; &amp;&amp; c"),
+	    WIString(L"a <b> && c").replaceAll(widePatterns));
+}
+
 TEST(IStringTests, RemoveChar) {
   IString s("i love cows.  i love penguins.");
   checkSameType<IString, decltype(s.remove(' '))>();
@@ -667,6 +1010,101 @@ TEST(IStringTests, RemoveString) {
   EXPECT_EQ(IString("i  cows.  i  penguins."), s.remove(love));
 }
 
+TEST(IStringTests, ReplaceAndRemoveAllocateExactly) {
+  typedef detail::IStringText<char> Text;
+  std::string text;
+  for (size_t i = 0; i < 100; ++i) {
+    text += "cows " + std::to_string(i) + ", ";
+  }
+  const IString s(text);
+
+  // More matches than replace() remembers from its first pass
+  const IString longer = s.replace("cows", "penguins");
+  EXPECT_EQ(text.size() + 400, longer.size());
+  EXPECT_EQ(Text::computeAllocationSize(longer.size()),
+	    longer.bytesPinned());
+  EXPECT_EQ(IString::NPOS, longer.find("cows"));
+  EXPECT_EQ(IString("penguins 99, "), longer.substr(longer.size() - 13));
+
+  const IString shorter = s.remove("cows ");
+  EXPECT_EQ(text.size() - 500, shorter.size());
+  EXPECT_EQ(Text::computeAllocationSize(shorter.size()),
+	    shorter.bytesPinned());
+
+  const IString noCommas = s.remove(',');
+  EXPECT_EQ(text.size() - 100, noCommas.size());
+  EXPECT_EQ(Text::computeAllocationSize(noCommas.size()),
+	    noCommas.bytesPinned());
+
+  // Nothing to replace or remove shares this string's text
+  EXPECT_EQ(s.data(), s.replace("sheep", "goats").data());
+  EXPECT_EQ(s.data(), s.remove("sheep").data());
+  EXPECT_EQ(s.data(), s.remove('!').data());
+  EXPECT_EQ(s.data(), s.replace("cows", "penguins", 5, 10).data());
+  EXPECT_EQ(WIString(std::wstring(text.begin(), text.end())),
+	    s.replace("sheep", L"goats"));
+}
+
+TEST(IStringTests, FindAllAndCount) {
+  const IString s("aaa cows aaaa cows aa");
+  const std::vector<size_t> truth{ 0, 9, 11, 19 };
+  const IStringParallelism oneThread(1);
+
+  const ImmutableList<size_t> found = s.findAll("aa", oneThread);
+  EXPECT_EQ(truth, std::vector<size_t>(found.begin(), found.end()));
+  EXPECT_EQ(truth.size(), s.count("aa", oneThread));
+  EXPECT_EQ((size_t)2, s.count(IString("cows")));
+  EXPECT_EQ((size_t)2, s.count(std::string("cows")));
+  EXPECT_EQ((size_t)2, s.count(WIString("cows")));
+  EXPECT_EQ((size_t)0, s.count("penguins"));
+  EXPECT_EQ((size_t)0, s.count(""));
+  EXPECT_TRUE(s.findAll("penguins").empty());
+
+  // Chunks of one character each, so matches straddle every boundary
+  const IStringParallelism tinyChunks(8, 1);
+  for (size_t n = 1; n < 8; ++n) {
+    const std::string pattern(n, 'a');
+    std::vector<size_t> expected;
+    for (size_t p = s.find(pattern); p != IString::NPOS;
+	 p = s.find(pattern, p + n)) {
+      expected.push_back(p);
+    }
+    const ImmutableList<size_t> parallel = s.findAll(pattern, tinyChunks);
+    EXPECT_EQ(expected,
+	      std::vector<size_t>(parallel.begin(), parallel.end()))
+        << "pattern = " << pattern;
+    EXPECT_EQ(expected.size(), s.count(pattern, tinyChunks));
+  }
+}
+
+TEST(IStringTests, ParallelReplaceAndRemove) {
+  std::string text;
+  for (size_t i = 0; i < 1000; ++i) {
+    text += "moo" + std::string(i % 5, 'o') + " cows " + std::to_string(i);
+  }
+  const IString s(text);
+  const IStringParallelism parallelism(4, 64);
+
+  for (const char* target : { "oo", "ooo", "cows", "moooo" }) {
+    for (const char* replacement : { "", "x", "penguins" }) {
+      EXPECT_EQ(s.replace(target, replacement),
+		s.replace(std::string(target), std::string(replacement),
+			  parallelism))
+	  << target << " -> " << replacement;
+    }
+    EXPECT_EQ(s.remove(target), s.remove(std::string(target), parallelism))
+        << target;
+  }
+
+  EXPECT_EQ(IString("i love penguins. i love penguins."),
+	    IString("i love cows. i love cows.")
+	        .replace("cows", "penguins", IStringParallelism(2, 4)));
+  EXPECT_EQ(IString("i  cows."),
+	    IString("i love cows.").remove(IString("love"), parallelism));
+  EXPECT_EQ(s.data(), s.replace("sheep", "goats", parallelism).data());
+  EXPECT_EQ(s.data(), s.remove(IString("sheep"), parallelism).data());
+}
+
 TEST(IStringTests, Strip) {
   EXPECT_EQ(IString("i love cows."), IString("i love cows.").strip());
   EXPECT_EQ(IString("i love cows."), IString("  i love cows.   ").strip());  
@@ -709,6 +1147,122 @@ TEST(IStringTests, IsCase) {
   EXPECT_FALSE(IString("ABCDeF").isUpperCase());
   EXPECT_TRUE(IString("abcdef").isLowerCase());
   EXPECT_FALSE(IString("abcdeF").isLowerCase());
+  EXPECT_FALSE(IString("abc def").isLowerCase());
+  EXPECT_TRUE(IString("THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG")
+	          .remove(' ').isUpperCase());
+  EXPECT_FALSE(IString("THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG")
+	           .isUpperCase());
+  EXPECT_TRUE(WIString(L"abcdefghijklmnopqrstuvwxyz").isLowerCase());
+  EXPECT_FALSE(WIString(L"abcdefghijklmnopqrstuvwxyZ").isLowerCase());
+}
+
+TEST(IStringTests, ToLowerAndToUpper) {
+  const IString mixed("Content-Type: Text/HTML; charset=UTF-8 \xC3\x89t\xC3\xA9");
+
+  EXPECT_EQ("content-type: text/html; charset=utf-8 \xC3\x89t\xC3\xA9",
+	    mixed.toLower());
+  EXPECT_EQ("CONTENT-TYPE: TEXT/HTML; CHARSET=UTF-8 \xC3\x89T\xC3\xA9",
+	    mixed.toUpper());
+  EXPECT_EQ("x-id", IString("X-Id").toLower());
+  EXPECT_EQ("X-ID", IString("X-Id").toUpper());
+  EXPECT_EQ("@[`{", IString("@[`{").toUpper());
+  EXPECT_EQ(WIString(L"\u00C9T\u00E9 SHOUTING"),
+	    WIString(L"\u00C9t\u00E9 shouting").toUpper());
+
+  // Strings without letters to convert are returned as they are
+  const IString lower("already lower case, and long enough for a text");
+  EXPECT_EQ(lower.data(), lower.toLower().data());
+  EXPECT_EQ(IString().data(), IString().toUpper().data());
+}
+
+TEST(IStringTests, CmpIgnoreCase) {
+  const IString s("Content-Length");
+
+  EXPECT_EQ(0, s.cmpIgnoreCase(IString("content-length")));
+  EXPECT_EQ(0, s.cmpIgnoreCase(std::string("CONTENT-LENGTH")));
+  EXPECT_EQ(0, s.cmpIgnoreCase("content-LENGTH"));
+  EXPECT_LT(s.cmpIgnoreCase("content-type"), 0);
+  EXPECT_GT(s.cmpIgnoreCase("CONTENT-ENCODING"), 0);
+  EXPECT_LT(s.cmpIgnoreCase("content-lengths"), 0);
+  EXPECT_GT(s.cmpIgnoreCase("content"), 0);
+
+  // Letters sort as lower case, after '[' and before '{'
+  EXPECT_LT(IString("[").cmpIgnoreCase("A"), 0);
+  EXPECT_GT(IString("{").cmpIgnoreCase("Z"), 0);
+
+  const std::string longer(100, 'a');
+  std::string shouting(100, 'A');
+  EXPECT_EQ(0, IString(longer).cmpIgnoreCase(shouting));
+  shouting[70] = 'B';
+  EXPECT_LT(IString(longer).cmpIgnoreCase(shouting), 0);
+}
+
+TEST(IStringTests, EqualsIgnoreCase) {
+  EXPECT_TRUE(IString("Accept").equalsIgnoreCase(IString("aCCEPT")));
+  EXPECT_TRUE(IString("Accept").equalsIgnoreCase(std::string("ACCEPT")));
+  EXPECT_TRUE(IString("Accept").equalsIgnoreCase("accept"));
+  EXPECT_FALSE(IString("Accept").equalsIgnoreCase("accepts"));
+  EXPECT_FALSE(IString("Accept").equalsIgnoreCase("Except"));
+  EXPECT_FALSE(IString("@").equalsIgnoreCase("`"));
+  EXPECT_TRUE(U32_IString(U"X-Forwarded-For")
+	          .equalsIgnoreCase(U"x-forwarded-for"));
+}
+
+TEST(IStringTests, TranscodeUtf) {
+  const IString utf8("Caf\xC3\xA9 \xE4\xB8\xAD\xE6\x96\x87 \xF0\x9F\x98\x80 and "
+		     "enough ASCII to need a text of its own");
+  const U16_IString utf16(std::u16string(
+      u"Caf\u00E9 \u4E2D\u6587 \U0001F600 and "
+      u"enough ASCII to need a text of its own"
+  ));
+  const U32_IString utf32(std::u32string(
+      U"Caf\u00E9 \u4E2D\u6587 \U0001F600 and "
+      U"enough ASCII to need a text of its own"
+  ));
+
+  EXPECT_EQ(utf16, utf8.toUtf16());
+  EXPECT_EQ(utf32, utf8.toUtf32());
+  EXPECT_EQ(utf8, utf16.toUtf8());
+  EXPECT_EQ(utf32, utf16.toUtf32());
+  EXPECT_EQ(utf8, utf32.toUtf8());
+  EXPECT_EQ(utf16, utf32.toUtf16());
+  EXPECT_EQ(utf32, WIString(L"Caf\u00E9 \u4E2D\u6587 \U0001F600 and "
+			    L"enough ASCII to need a text of its own")
+	               .toUtf32());
+
+  // Converting to the same type only validates
+  EXPECT_EQ(utf8.data(), utf8.toUtf8().data());
+  EXPECT_EQ(utf16.data(), utf16.toUtf16().data());
+
+  // Exactly one allocation, of exactly the right size
+  const U16_IString converted = utf8.toUtf16();
+  EXPECT_EQ(detail::IStringText<char16_t>::computeAllocationSize(
+		converted.size()
+	    ),
+	    converted.bytesPinned());
+
+  EXPECT_EQ(U16_IString(std::u16string(u"\u00E9t\u00E9")),
+	    IString("\xC3\xA9t\xC3\xA9").toUtf16());
+  EXPECT_EQ(U16_IString(), IString().toUtf16());
+}
+
+TEST(IStringTests, TranscodeInvalidUtf) {
+  EXPECT_TRUE(IString("Caf\xC3\xA9").isValidUtf());
+  EXPECT_FALSE(IString("Caf\xC3").isValidUtf());
+  EXPECT_TRUE(U16_IString(std::u16string(u"\U0001F600")).isValidUtf());
+  EXPECT_FALSE(U16_IString(std::u16string(1, (char16_t)0xD83D)).isValidUtf());
+
+  EXPECT_THROW(IString("Caf\xC3").toUtf16(), InvalidUtfError);
+  EXPECT_THROW(IString("Caf\xC3").toUtf8(), InvalidUtfError);
+  try {
+    U32_IString(std::u32string(U"ok \U0010FFFF")).toUtf8();
+    U32_IString(std::u32string{ 'b', 'a', 'd', 0x110000 }).toUtf16();
+    FAIL() << "Expected InvalidUtfError";
+  } catch(const InvalidUtfError& e) {
+    EXPECT_EQ((size_t)3, e.offset());
+    EXPECT_NE(std::string::npos,
+	      std::string(e.what()).find("Invalid UTF-32 sequence"));
+  }
 }
 
 TEST(IStringTests, All) {
@@ -1153,6 +1707,224 @@ TEST(IStringTests, SplitByRegex) {
   EXPECT_EQ(truth, "one two   three  four"_is.split(sep, 1).toVector());
 }
 
+TEST(IStringTests, SplitWithCompaction) {
+  const std::vector<IString> words{
+    IString("the first long word"), IString("the second long word"),
+    IString("the third long word"), IString(std::string(2000, '-'))
+  };
+  const IString s(words[0] + "|" + words[1] + "|" + words[2] + "|" +
+		  words[3]);
+  const IStringCompactionPolicy policy(32, 0.1);
+
+  std::vector<IString> pieces =
+      s.split(IString("|"), IString::MAX_SPLITS, policy).toVector();
+  ASSERT_EQ(words, pieces);
+  for (size_t i = 0; i < 3; ++i) {
+    EXPECT_LT(pieces[i].bytesPinned(), 64);
+  }
+  EXPECT_EQ(s.bytesPinned(), pieces[3].bytesPinned());
+
+  pieces = s.rsplit(IString("|"), IString::MAX_SPLITS, policy).toVector();
+  std::reverse(pieces.begin(), pieces.end());
+  ASSERT_EQ(words, pieces);
+  EXPECT_LT(pieces[0].bytesPinned(), 64);
+
+  pieces = s.split(std::regex("\\|"), IString::MAX_SPLITS, policy).toVector();
+  ASSERT_EQ(words, pieces);
+  EXPECT_LT(pieces[1].bytesPinned(), 64);
+
+  // Without a policy, every piece pins the whole text
+  pieces = s.split(IString("|")).toVector();
+  EXPECT_EQ(s.bytesPinned(), pieces[0].bytesPinned());
+}
+
+TEST(IStringTests, LocalIString) {
+  const std::string TEXT("a string too long to be stored inline");
+  LocalIString s(TEXT);
+  LocalIString copy(s);
+  LocalIString sub = s.substr(2, 22);
+
+  EXPECT_TRUE(s == TEXT);
+  EXPECT_EQ(s.data(), copy.data());
+  EXPECT_TRUE(s == copy);
+  EXPECT_TRUE(s == IString(TEXT));
+  EXPECT_TRUE(sub == TEXT.substr(2, 20));
+  EXPECT_EQ(IString(TEXT).hash(), s.hash());
+
+  s = LocalIString();
+  EXPECT_TRUE(copy == TEXT);
+  EXPECT_TRUE(sub == TEXT.substr(2, 20));
+}
+
+TEST(IStringTests, ConvertLocalIStringToIString) {
+  const std::string TEXT("a string too long to be stored inline");
+
+  // The only reference moves with the string
+  LocalIString local(TEXT);
+  const char* const text = local.data();
+  IString shared(std::move(local));
+  EXPECT_EQ(text, shared.data());
+  EXPECT_TRUE(shared == TEXT);
+  EXPECT_EQ(0, local.size());
+
+  // Shared texts are copied
+  LocalIString other(TEXT);
+  LocalIString otherCopy(other);
+  IString sharedCopy(std::move(other));
+  EXPECT_NE(otherCopy.data(), sharedCopy.data());
+  EXPECT_TRUE(sharedCopy == TEXT);
+  EXPECT_TRUE(otherCopy == TEXT);
+  EXPECT_EQ(0, other.size());
+
+  // So are inline strings
+  LocalIString shortString("short");
+  EXPECT_TRUE(IString(std::move(shortString)) == "short");
+}
+
+TEST(IStringTests, BorrowIString) {
+  const std::string TEXT("a string too long to be stored inline");
+  std::unique_ptr<IString> shared(new IString(TEXT));
+  LocalIString local(*shared);
+  LocalIString copy(local);
+  LocalIString sub = copy.substr(2, 30);
+
+  EXPECT_EQ(shared->data(), local.data());
+  EXPECT_EQ(shared->data(), copy.data());
+  EXPECT_EQ(shared->data() + 2, sub.data());
+  EXPECT_EQ(shared->hash(), local.hash());
+
+  // The borrowed text outlives the string it came from
+  shared.reset();
+  EXPECT_TRUE(local == TEXT);
+  EXPECT_TRUE(sub == TEXT.substr(2, 28));
+
+  // Converting back shares the original text
+  IString again(local);
+  EXPECT_EQ(local.data(), again.data());
+  IString fromSub(std::move(sub));
+  EXPECT_EQ(local.data() + 2, fromSub.data());
+  EXPECT_EQ(0, sub.size());
+
+  // shrink() makes a text of its own
+  LocalIString shrunk = local.substr(1, local.size());
+  shrunk.shrink();
+  EXPECT_NE(local.data() + 1, shrunk.data());
+  EXPECT_TRUE(shrunk == TEXT.substr(1));
+
+  // Interned strings stay interned when borrowed
+  IString interned = IString(TEXT).intern();
+  LocalIString localInterned(interned);
+  EXPECT_EQ(interned.data(), localInterned.data());
+  EXPECT_TRUE(localInterned.isInterned());
+  EXPECT_TRUE(IString(localInterned).isInterned());
+}
+
+TEST(IStringTests, PassLocalIStringToAnotherThread) {
+  LocalIString local("a string too long to be stored inline");
+  IString shared(std::move(local));
+  std::vector<std::thread> threads;
+  std::vector<size_t> sizes(4, 0);
+
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    threads.emplace_back([&shared, i, &sizes]() {
+      LocalIString mine(shared);
+      for (size_t j = 0; j < 1000; ++j) {
+	LocalIString copy(mine);
+	sizes[i] += copy.size();
+      }
+      EXPECT_EQ(shared.data(), mine.data());
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+  for (size_t n : sizes) {
+    EXPECT_EQ(1000 * shared.size(), n);
+  }
+}
+
+TEST(IStringTests, MapFile) {
+  std::string content;
+  for (size_t i = 0; i < 1000; ++i) {
+    content += "line " + std::to_string(i) + "\n";
+  }
+  char path[] = "/tmp/pistis_util_IStringTests_XXXXXX";
+  const int fd = ::mkstemp(path);
+  ASSERT_LE(0, fd);
+  ASSERT_EQ((ssize_t)content.size(),
+	    ::write(fd, content.data(), content.size()));
+  ::close(fd);
+
+  std::unique_ptr<IString> s(
+      new IString(IString::mapFile(path, FileAccessPattern::SEQUENTIAL))
+  );
+  ::unlink(path);
+  EXPECT_TRUE(*s == content);
+  EXPECT_EQ(IString(content).hash(), s->hash());
+  s->advise(FileAccessPattern::RANDOM);
+
+  // Substrings and split tokens keep the mapping alive
+  IString middle = s->substr(100, 200);
+  auto lines = s->rsplit(IString("\n"), 2);
+  lines.next();
+  IString lastLine = lines.next();
+  const char* const start = s->data();
+  s.reset();
+  EXPECT_TRUE(middle == content.substr(100, 100));
+  EXPECT_EQ(start + 100, middle.data());
+  EXPECT_TRUE(lastLine == "line 999");
+
+  // shrink() copies a substring out of the mapping
+  middle.shrink();
+  EXPECT_NE(start + 100, middle.data());
+  EXPECT_TRUE(middle == content.substr(100, 100));
+}
+
+TEST(IStringTests, MapFileLargerThan4GiB) {
+  // A sparse file, so it takes no space on disk or in memory except
+  // for the pages the test reads
+  const size_t SIZE = ((size_t)5 << 30) + 7;
+  const std::string tail("|the end");
+  char path[] = "/tmp/pistis_util_IStringTests_XXXXXX";
+  const int fd = ::mkstemp(path);
+  ASSERT_LE(0, fd);
+  ASSERT_EQ(0, ::ftruncate(fd, SIZE));
+  ASSERT_EQ((ssize_t)tail.size(),
+	    ::pwrite(fd, tail.data(), tail.size(), SIZE - tail.size()));
+  ::close(fd);
+
+  IString s = IString::mapFile(path, FileAccessPattern::RANDOM);
+  ::unlink(path);
+  ASSERT_EQ(SIZE, s.size());
+  EXPECT_GE(s.bytesPinned(), SIZE);
+
+  EXPECT_EQ(SIZE - tail.size(), s.findLast('|'));
+  EXPECT_TRUE(s.substr(SIZE - 7) == "the end");
+  auto pieces = s.rsplit(IString("|"), 1);
+  EXPECT_TRUE(pieces.next() == "the end");
+  EXPECT_EQ(SIZE - tail.size(), pieces.next().size());
+
+  IString end = s.substr(SIZE - 100);
+  EXPECT_EQ(100, end.size());
+  EXPECT_EQ(92, end.find('|'));
+}
+
+TEST(IStringTests, MapSmallAndMissingFiles) {
+  char path[] = "/tmp/pistis_util_IStringTests_XXXXXX";
+  const int fd = ::mkstemp(path);
+  ASSERT_LE(0, fd);
+  ASSERT_EQ(5, ::write(fd, "short", 5));
+  ::close(fd);
+
+  IString s = IString::mapFile(path);
+  EXPECT_TRUE(s == "short");
+  ::truncate(path, 0);
+  EXPECT_EQ(0, IString::mapFile(path).size());
+  ::unlink(path);
+
+  EXPECT_THROW(IString::mapFile(path), FileMappingError);
+}
+
 TEST(IStringTests, Format) {
   IString pattern("%s %8.6f %+10d");
 
@@ -0,0 +1,84 @@
+#include <pistis/util/IStringTransparent.hpp>
+#include <gtest/gtest.h>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <string>
+
+using namespace pistis::util;
+
+TEST(IStringTransparentTests, AsIStringKeyCopiesNothing) {
+  const std::string text("a string long enough to need an IStringText");
+  const IString key = asIStringKey(text);
+
+  EXPECT_EQ(text.data(), key.data());
+  EXPECT_EQ(text.size(), key.size());
+  EXPECT_EQ((size_t)0, key.bytesPinned());
+  EXPECT_EQ(text.c_str(), asIStringKey(text.c_str()).data());
+
+  const IString s(text);
+  EXPECT_EQ(&s, &asIStringKey(s));
+}
+
+TEST(IStringTransparentTests, HashAgreesWithIString) {
+  const TransparentIStringHash hash;
+  const std::string text("content-type");
+  const IString s(text);
+  char buffer[] = "content-type";
+
+  EXPECT_EQ(s.hash(), hash(s));
+  EXPECT_EQ(s.hash(), hash(text));
+  EXPECT_EQ(s.hash(), hash(text.c_str()));
+  EXPECT_EQ(s.hash(), hash(buffer));
+  EXPECT_EQ(s.hash(), hash("content-type"));
+  EXPECT_EQ(WIString(L"moo").hash(), hash(std::wstring(L"moo")));
+  EXPECT_NE(s.hash(), hash("content-types"));
+}
+
+TEST(IStringTransparentTests, EqualAndLessAgreeWithIString) {
+  const TransparentIStringEqual equal;
+  const TransparentIStringLess less;
+  const IString cow("cow");
+  const std::string cows("cows");
+
+  EXPECT_TRUE(equal(cow, "cow"));
+  EXPECT_TRUE(equal(std::string("cow"), cow));
+  EXPECT_FALSE(equal(cow, cows));
+  EXPECT_FALSE(equal("cows", cow));
+
+  EXPECT_EQ(cow < IString(cows), less(cow, cows));
+  EXPECT_EQ(IString(cows) < cow, less(cows, cow));
+  EXPECT_FALSE(less(cow, "cow"));
+  EXPECT_TRUE(less("cat", cow));
+  EXPECT_EQ(IString("\xE9") < IString("e"), less("\xE9", std::string("e")));
+}
+
+TEST(IStringTransparentTests, MapLookup) {
+  std::map<IString, int, TransparentIStringLess> handlers{
+    { IString("/cows"), 1 }, { IString("/penguins"), 2 }
+  };
+  const std::string path("/penguins");
+  const char buffer[] = "/cows/moo";
+
+  EXPECT_EQ(2, handlers.find(path)->second);
+  EXPECT_EQ(1, handlers.find("/cows")->second);
+  EXPECT_EQ(1, handlers.find(IString::literal(buffer, 5))->second);
+  EXPECT_TRUE(handlers.find("/sheep") == handlers.end());
+  EXPECT_EQ((size_t)1, handlers.count(path));
+
+  std::set<IString, TransparentIStringLess> words{ IString("a"),
+						   IString("b") };
+  EXPECT_TRUE(words.find(std::string("b")) != words.end());
+}
+
+TEST(IStringTransparentTests, UnorderedLookupWithKeyView) {
+  std::unordered_map<IString, int, TransparentIStringHash,
+		     TransparentIStringEqual> table{
+    { IString("content-length"), 1 }, { IString("content-type"), 2 }
+  };
+  const std::string header("content-type");
+
+  EXPECT_EQ(2, table.at(asIStringKey(header)));
+  EXPECT_EQ(1, table.at(asIStringKey("content-length")));
+  EXPECT_EQ((size_t)0, table.count(asIStringKey("host")));
+}
@@ -0,0 +1,190 @@
+#include <pistis/util/IStringView.hpp>
+#include <pistis/exceptions/IllegalValueError.hpp>
+#include <gtest/gtest.h>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace pistis::util;
+
+namespace {
+  const IString& text() {
+    static const IString TEXT(
+	"  GET /api/v1/resource HTTP/1.1 host=example.com  "
+    );
+    return TEXT;
+  }
+}
+
+TEST(IStringViewTests, Create) {
+  const IString& s = text();
+  const IStringView v(s);
+  EXPECT_EQ(s.data(), v.data());
+  EXPECT_EQ(s.size(), v.size());
+  EXPECT_EQ(v.data(), v.begin());
+  EXPECT_EQ(v.data() + v.size(), v.end());
+  EXPECT_EQ('G', v[2]);
+
+  const std::string text("a std::string");
+  const IStringView fromStd(text);
+  EXPECT_EQ(text.data(), fromStd.data());
+  EXPECT_EQ(text.size(), fromStd.size());
+
+  const IStringView fromChars("cow");
+  EXPECT_EQ((size_t)3, fromChars.size());
+  EXPECT_EQ((size_t)2, IStringView(text.data(), 2).size());
+
+  const IStringView empty;
+  EXPECT_EQ((size_t)0, empty.size());
+  EXPECT_EQ(empty.begin(), empty.end());
+}
+
+TEST(IStringViewTests, SubstrAndStripShareCharacters) {
+  const IString& s = text();
+  const IStringView v(s);
+  const IStringView stripped = v.strip();
+
+  EXPECT_EQ(s.strip(), stripped);
+  EXPECT_EQ(s.data() + 2, stripped.data());
+
+  const IStringView sub = stripped.substr(4, 20);
+  EXPECT_EQ(s.strip().substr(4, 20), sub);
+  EXPECT_EQ(stripped.data() + 4, sub.data());
+  EXPECT_EQ(s.strip().substr(4), stripped.substr(4));
+  EXPECT_EQ(sub, sub.substr(0, 1000));
+  EXPECT_EQ((size_t)0, v.substr(1000).size());
+  EXPECT_EQ((size_t)0, v.substr(10, 5).size());
+  EXPECT_EQ(IStringView("  ").strip().size(), (size_t)0);
+}
+
+TEST(IStringViewTests, Split) {
+  const IString& s = text();
+  const std::vector<IStringView> tokens = IStringView(s).strip().split(" ");
+  const std::vector<IString> truth = s.strip().split(IString(" ")).toVector();
+
+  ASSERT_EQ(truth.size(), tokens.size());
+  for (size_t i = 0; i < truth.size(); ++i) {
+    EXPECT_EQ(truth[i], tokens[i]);
+    EXPECT_GE(tokens[i].data(), s.data());
+    EXPECT_LE(tokens[i].end(), s.data() + s.size());
+  }
+
+  const std::vector<IStringView> limited =
+      IStringView(s).strip().split(IStringView(" "), 1);
+  ASSERT_EQ((size_t)2, limited.size());
+  EXPECT_EQ("GET", limited[0]);
+  EXPECT_EQ("/api/v1/resource HTTP/1.1 host=example.com", limited[1]);
+}
+
+TEST(IStringViewTests, SearchesAgreeWithIString) {
+  const IString s("the cow jumped over the moon");
+  const IStringView v(s);
+  const IStringView the(s.data(), 3);
+
+  EXPECT_EQ(s.find("the"), v.find("the"));
+  EXPECT_EQ(s.find("the", 1), v.find(the, 1));
+  EXPECT_EQ(s.find(IString("moo")), v.find(IString("moo")));
+  EXPECT_EQ(s.findLast("the"), v.findLast(the));
+  EXPECT_EQ(s.findFirstOf("jmp"), v.findFirstOf("jmp"));
+  EXPECT_EQ(s.findLastOf("jmp"), v.findLastOf(IStringView("jmp")));
+  EXPECT_EQ(s.findAny({ "w", "v" }), v.findAny({ "w", "v" }));
+  EXPECT_EQ(s.count("o"), v.count("o"));
+  EXPECT_EQ((size_t)2, v.count(the));
+  EXPECT_EQ(IString::NPOS, v.find("cat"));
+
+  EXPECT_TRUE(v.startsWith(the));
+  EXPECT_TRUE(v.startsWith("the cow"));
+  EXPECT_TRUE(v.endsWith("moon"));
+  EXPECT_FALSE(v.endsWith(the));
+
+  const IStringView cow = v.substr(4, 7);
+  EXPECT_EQ((size_t)0, cow.find("cow"));
+  EXPECT_EQ(IString::NPOS, cow.find("the"));
+  EXPECT_TRUE(cow.all([](char c) { return (c >= 'a') && (c <= 'z'); }));
+  EXPECT_FALSE(v.all([](char c) { return (c >= 'a') && (c <= 'z'); }));
+  EXPECT_TRUE(v.any([](char c) { return c == ' '; }));
+  EXPECT_TRUE(v.isValidUtf());
+}
+
+TEST(IStringViewTests, CompareAndHash) {
+  const IString cow("cow");
+  const std::string cowStd("cow");
+  const IStringView v(cow);
+
+  EXPECT_TRUE(v == cow);
+  EXPECT_TRUE(cow == v);
+  EXPECT_TRUE(v == cowStd);
+  EXPECT_TRUE(cowStd == v);
+  EXPECT_TRUE(v == "cow");
+  EXPECT_TRUE(v == IStringView("cow"));
+  EXPECT_FALSE(v != "cow");
+  EXPECT_TRUE(v != "cows");
+  EXPECT_TRUE(IString("cows") != v);
+
+  EXPECT_TRUE(v < "cows");
+  EXPECT_TRUE(v <= "cow");
+  EXPECT_TRUE(v > "cat");
+  EXPECT_TRUE(v >= IStringView("cat"));
+  EXPECT_TRUE(IString("cat") < v);
+  EXPECT_TRUE(std::string("cat") < v);
+  EXPECT_EQ(cow.cmp("cat"), v.cmp("cat"));
+  EXPECT_EQ(0, v.cmpIgnoreCase("COW"));
+  EXPECT_TRUE(v.equalsIgnoreCase(IStringView("Cow")));
+
+  EXPECT_EQ(cow.hash(), v.hash());
+  EXPECT_EQ(cow.hashIgnoreCase(), IStringView("COW").hashIgnoreCase());
+  EXPECT_EQ(std::hash<IString>()(cow), std::hash<IStringView>()(v));
+}
+
+TEST(IStringViewTests, ToIString) {
+  const IString& s = text();
+  const IStringView v = IStringView(s).strip().substr(0, 25);
+
+  const IString shared = v.toIString(s);
+  EXPECT_EQ(v, shared);
+  EXPECT_EQ(v.data(), shared.data());
+
+  const IString copy = v.toIString();
+  EXPECT_EQ(v, copy);
+  EXPECT_NE(v.data(), copy.data());
+
+  EXPECT_EQ((size_t)0, IStringView().toIString(s).size());
+  EXPECT_THROW(IStringView("elsewhere").toIString(s),
+	       pistis::exceptions::IllegalValueError);
+
+  EXPECT_EQ(std::string("GET /api/v1/resource HTTP"), v.toStdString());
+}
+
+TEST(IStringViewTests, TransparentLookup) {
+  const IString& s = text();
+  std::map<IString, int, TransparentIStringLess> handlers{
+    { IString("/api/v1/resource"), 1 }, { IString("GET"), 2 }
+  };
+  const std::vector<IStringView> tokens = IStringView(s).strip().split(" ");
+
+  ASSERT_NE(handlers.end(), handlers.find(tokens[0]));
+  EXPECT_EQ(2, handlers.find(tokens[0])->second);
+  EXPECT_EQ(1, handlers.find(tokens[1])->second);
+  EXPECT_EQ(handlers.end(), handlers.find(tokens[2]));
+
+  const TransparentIStringHash hash;
+  const TransparentIStringEqual equal;
+  EXPECT_EQ(IString("GET").hash(), hash(tokens[0]));
+  EXPECT_TRUE(equal(tokens[0], "GET"));
+
+  std::unordered_set<IStringView> seen(tokens.begin(), tokens.end());
+  EXPECT_EQ(tokens.size(), seen.size());
+  EXPECT_EQ((size_t)1, seen.count(IStringView("HTTP/1.1")));
+}
+
+TEST(IStringViewTests, WriteToStream) {
+  std::ostringstream out;
+  out << IStringView(text()).strip().substr(0, 3);
+  EXPECT_EQ("GET", out.str());
+
+  std::wostringstream wout;
+  wout << WIStringView(L"moo");
+  EXPECT_EQ(L"moo", wout.str());
+}
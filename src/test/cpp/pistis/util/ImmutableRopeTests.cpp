@@ -0,0 +1,198 @@
+#include <pistis/util/ImmutableRope.hpp>
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace pistis::util;
+
+namespace {
+  std::string makeText(size_t n, size_t seed = 0) {
+    std::string text;
+    for (size_t i = 0; i < n; ++i) {
+      text.push_back((char)('a' + (i * 7 + seed) % 26));
+    }
+    return text;
+  }
+
+  std::string toStdString(const IRope& rope) {
+    std::string s;
+    rope.forEachSegment([&s](const IString& segment) {
+      s.append(segment.data(), segment.size());
+    });
+    return s;
+  }
+
+  // An AVL tree with n leaves is at most about 1.44 log2(n) deep
+  void verifyBalanced(const IRope& rope) {
+    size_t segments = 0;
+    rope.forEachSegment([&segments](const IString&) { ++segments; });
+    EXPECT_LE((double)rope.depth(),
+	      1.45 * std::log2((double)segments + 2) + 1)
+	<< "with " << segments << " segments";
+  }
+}
+
+TEST(ImmutableRopeTests, CreateEmpty) {
+  IRope rope;
+  EXPECT_EQ(0, rope.size());
+  EXPECT_EQ(0, rope.depth());
+  EXPECT_TRUE(rope.segmentsBegin() == rope.segmentsEnd());
+  EXPECT_EQ(0, rope.str().size());
+  EXPECT_TRUE(rope == IString(""));
+}
+
+TEST(ImmutableRopeTests, CreateFromIString) {
+  const IString s(makeText(200));
+  IRope rope(s);
+  EXPECT_EQ(s.size(), rope.size());
+  EXPECT_EQ(s.data(), rope.str().data());
+  EXPECT_TRUE(rope == s);
+
+  auto i = rope.segmentsBegin();
+  ASSERT_TRUE(i != rope.segmentsEnd());
+  EXPECT_EQ(s.data(), i->data());
+  EXPECT_TRUE(++i == rope.segmentsEnd());
+}
+
+TEST(ImmutableRopeTests, Append) {
+  const std::string a = makeText(200, 1), b = makeText(300, 2);
+  const IString sa(a), sb(b);
+  IRope rope = IRope(sa).append(sb);
+
+  EXPECT_EQ(a.size() + b.size(), rope.size());
+  EXPECT_EQ(a + b, toStdString(rope));
+  EXPECT_TRUE(rope.str() == a + b);
+
+  // The segments share the text of the original strings
+  std::vector<const char*> segments;
+  rope.forEachSegment([&segments](const IString& s) {
+    segments.push_back(s.data());
+  });
+  EXPECT_EQ((std::vector<const char*>{ sa.data(), sb.data() }), segments);
+
+  IRope twice = rope + rope;
+  EXPECT_EQ(a + b + a + b, toStdString(twice));
+  EXPECT_EQ(a + b + a, toStdString(rope + sa));
+  EXPECT_EQ(b + a + b, toStdString(sb + rope));
+}
+
+TEST(ImmutableRopeTests, AppendShortPieces) {
+  IRope rope;
+  std::string expected;
+  for (size_t i = 0; i < 10000; ++i) {
+    const std::string piece = makeText(1 + i % 13, i);
+    rope = rope.append(IString(piece));
+    expected += piece;
+  }
+  EXPECT_EQ(expected, toStdString(rope));
+  EXPECT_TRUE(rope.str() == expected);
+  verifyBalanced(rope);
+
+  // Short pieces are merged into longer segments
+  size_t segments = 0;
+  rope.forEachSegment([&segments](const IString&) { ++segments; });
+  EXPECT_LT(segments, expected.size() / 64);
+}
+
+TEST(ImmutableRopeTests, Index) {
+  IRope rope;
+  std::string expected;
+  for (size_t i = 0; i < 100; ++i) {
+    const std::string piece = makeText(100 + i, i);
+    rope = rope.append(IString(piece));
+    expected += piece;
+  }
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(expected[i], rope[i]) << "i = " << i;
+  }
+}
+
+TEST(ImmutableRopeTests, Substr) {
+  IRope rope;
+  std::string expected;
+  for (size_t i = 0; i < 50; ++i) {
+    const std::string piece = makeText(150 + i, i);
+    rope = rope.append(IString(piece));
+    expected += piece;
+  }
+
+  std::mt19937 rng(11);
+  for (size_t trial = 0; trial < 200; ++trial) {
+    size_t start = rng() % (expected.size() + 10);
+    size_t end = rng() % (expected.size() + 10);
+    const IRope sub = rope.substr(start, end);
+    end = std::min(end, expected.size());
+    start = std::min(start, end);
+    ASSERT_EQ(expected.substr(start, end - start), toStdString(sub))
+	<< "start = " << start << ", end = " << end;
+    verifyBalanced(sub);
+  }
+
+  EXPECT_EQ(expected.substr(100), toStdString(rope.substr(100)));
+  EXPECT_EQ(0, rope.substr(100, 50).size());
+}
+
+TEST(ImmutableRopeTests, Insert) {
+  const std::string base = makeText(1000);
+  IRope rope{ IString(base) };
+  std::string expected = base;
+
+  std::mt19937 rng(5);
+  for (size_t i = 0; i < 500; ++i) {
+    const std::string piece = makeText(1 + rng() % 300, i);
+    const size_t pos = rng() % (expected.size() + 1);
+    if (i % 2) {
+      rope = rope.insert(pos, IString(piece));
+    } else {
+      rope = rope.insert(pos, IRope(IString(piece)));
+    }
+    expected.insert(pos, piece);
+  }
+  EXPECT_EQ(expected, toStdString(rope));
+  verifyBalanced(rope);
+
+  EXPECT_EQ(expected + "tail", toStdString(rope.insert(expected.size() + 5,
+							IString("tail"))));
+}
+
+TEST(ImmutableRopeTests, StrIsCached) {
+  const IRope rope = IRope(IString(makeText(200, 1)))
+                         .append(IString(makeText(200, 2)));
+  const IString s = rope.str();
+  EXPECT_EQ(s.data(), rope.str().data());
+  EXPECT_EQ(s.data(), IRope(rope).str().data());
+}
+
+TEST(ImmutableRopeTests, Compare) {
+  const std::string text = makeText(1000);
+  IRope a = IRope(IString(text.substr(0, 300)))
+                .append(IString(text.substr(300)));
+  IRope b = IRope(IString(text.substr(0, 700)))
+                .append(IString(text.substr(700)));
+
+  EXPECT_EQ(0, a.cmp(b));
+  EXPECT_TRUE(a == b);
+  EXPECT_TRUE(a == IString(text));
+  EXPECT_TRUE(IString(text) == a);
+  EXPECT_FALSE(a != b);
+
+  EXPECT_GT(0, a.substr(0, 999).cmp(b));
+  EXPECT_LT(0, a.cmp(b.substr(0, 999)));
+  EXPECT_TRUE(a != b.substr(0, 999));
+
+  IRope c = a.substr(0, 500).append(IString("~")).append(a.substr(501));
+  EXPECT_LT(0, c.cmp(a));
+  EXPECT_GT(0, a.cmp(c));
+  EXPECT_TRUE(c != IString(text));
+}
+
+TEST(ImmutableRopeTests, WriteToOstream) {
+  const IRope rope = IRope(IString(makeText(200, 1)))
+                         .append(IString(makeText(200, 2)));
+  std::ostringstream out;
+  out << rope;
+  EXPECT_EQ(makeText(200, 1) + makeText(200, 2), out.str());
+}
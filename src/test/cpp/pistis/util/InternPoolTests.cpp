@@ -0,0 +1,104 @@
+#include <pistis/util/InternPool.hpp>
+#include <pistis/util/IString.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using namespace pistis::util;
+
+TEST(InternPoolTests, InternSharesText) {
+  const std::string TEXT("interned strings share their text");
+  IString s1(TEXT);
+  IString s2(TEXT);
+
+  ASSERT_NE(s1.data(), s2.data());
+  EXPECT_FALSE(s1.isInterned());
+
+  IString i1 = s1.intern();
+  IString i2 = s2.intern();
+
+  EXPECT_TRUE(i1.isInterned());
+  EXPECT_TRUE(i2.isInterned());
+  EXPECT_EQ(i1.data(), i2.data());
+  EXPECT_EQ(TEXT, i1);
+  EXPECT_EQ(i1, s1);
+  EXPECT_EQ(i1.data(), i1.intern().data());
+}
+
+TEST(InternPoolTests, InternShortString) {
+  IString s1(std::string("short"));
+  IString s2(std::string("short"));
+  IString i1 = s1.intern();
+  IString i2 = s2.intern();
+
+  EXPECT_TRUE(i1.isInterned());
+  EXPECT_EQ(i1.data(), i2.data());
+  EXPECT_EQ("short", i1);
+  EXPECT_FALSE(i1.substr(1).isInterned());
+}
+
+TEST(InternPoolTests, InternedStringsCompareByIdentity) {
+  IString i1 = IString(std::string("first interned string")).intern();
+  IString i2 = IString(std::string("other interned string")).intern();
+  IString i3 = IString(std::string("first interned string")).intern();
+
+  EXPECT_TRUE(i1 == i3);
+  EXPECT_FALSE(i1 != i3);
+  EXPECT_FALSE(i1 == i2);
+  EXPECT_TRUE(i1 != i2);
+}
+
+TEST(InternPoolTests, UnusedTextsAreReclaimed) {
+  InternPool<char>& pool = InternPool<char>::global();
+  const size_t initialSize = pool.size();
+  {
+    IString i1 = IString(std::string("reclaimed when unused")).intern();
+    IString i2 = IString(std::string("also reclaimed when unused")).intern();
+    IString i3 = IString(std::string("reclaimed when unused")).intern();
+    EXPECT_EQ(initialSize + 2, pool.size());
+  }
+  EXPECT_EQ(initialSize, pool.size());
+
+  IString i = IString(std::string("reclaimed when unused")).intern();
+  EXPECT_EQ(initialSize + 1, pool.size());
+  EXPECT_EQ("reclaimed when unused", i);
+}
+
+TEST(InternPoolTests, InternFromManyThreads) {
+  const size_t NUM_THREADS = 8;
+  const size_t NUM_STRINGS = 200;
+  std::vector< std::vector<IString> > results(NUM_THREADS);
+  std::vector<std::thread> threads;
+
+  for (size_t t = 0; t < NUM_THREADS; ++t) {
+    threads.emplace_back([t, &results]() {
+      for (size_t i = 0; i < NUM_STRINGS; ++i) {
+	IString s(std::string("concurrently interned #") + std::to_string(i));
+	results[t].push_back(s.intern());
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (size_t t = 1; t < NUM_THREADS; ++t) {
+    for (size_t i = 0; i < NUM_STRINGS; ++i) {
+      EXPECT_EQ(results[0][i].data(), results[t][i].data());
+    }
+  }
+}
+
+TEST(InternPoolTests, IdentityHashAndEquality) {
+  std::unordered_set<IString, InternedIStringHash, InternedIStringEqual> keys;
+
+  keys.insert(IString(std::string("content-type")).intern());
+  keys.insert(IString(std::string("content-length")).intern());
+  keys.insert(IString(std::string("content-type")).intern());
+
+  EXPECT_EQ(2, keys.size());
+  EXPECT_EQ(1, keys.count(IString(std::string("content-length")).intern()));
+  EXPECT_EQ(0, keys.count(IString(std::string("accept")).intern()));
+}
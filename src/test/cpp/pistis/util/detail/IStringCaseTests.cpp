@@ -0,0 +1,87 @@
+#include <pistis/util/detail/IStringCase.hpp>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace pistis::util::detail;
+
+namespace {
+  // Mostly letters, with some punctuation and bytes just outside A-Z
+  // and a-z to catch off-by-one errors in the range tests
+  std::vector<uint8_t> randomText(std::mt19937& rng, size_t n) {
+    static const char ALPHABET[] = "AZaz@[`{ 09MmQq\x80\xC1\xE1\xFF";
+    std::vector<uint8_t> text(n);
+    for (auto& c : text) {
+      c = (uint8_t)ALPHABET[rng() % (sizeof(ALPHABET) - 1)];
+    }
+    return text;
+  }
+}
+
+TEST(IStringCaseTests, KernelIsKnown) {
+  const std::string kernel = asciiCaseKernel();
+  EXPECT_TRUE((kernel == "avx2") || (kernel == "scalar")) << kernel;
+}
+
+TEST(IStringCaseTests, FoldAsciiCase) {
+  EXPECT_EQ('a', foldAsciiCase('A'));
+  EXPECT_EQ('z', foldAsciiCase('Z'));
+  EXPECT_EQ('a', foldAsciiCase('a'));
+  EXPECT_EQ('@', foldAsciiCase('@'));
+  EXPECT_EQ('[', foldAsciiCase('['));
+  EXPECT_EQ((char16_t)0xC1, foldAsciiCase((char16_t)0xC1));
+}
+
+TEST(IStringCaseTests, ByteKernelsMatchScalar) {
+  std::mt19937 rng(17);
+  for (size_t trial = 0; trial < 1000; ++trial) {
+    const size_t n = rng() % 150;
+    const std::vector<uint8_t> text = randomText(rng, n);
+    const uint8_t* p = text.data();
+
+    ASSERT_EQ(findFirstInRange<uint8_t>(p, n, 'A', 'Z'),
+	      findFirstInRange(p, n, (uint8_t)'A', (uint8_t)'Z'))
+	<< "trial " << trial;
+    ASSERT_EQ(findFirstNotInRange<uint8_t>(p, n, 'a', 'z'),
+	      findFirstNotInRange(p, n, (uint8_t)'a', (uint8_t)'z'))
+	<< "trial " << trial;
+
+    std::vector<uint8_t> expected(n), actual(n);
+    switchAsciiCase<uint8_t>(p, n, expected.data(), 'a');
+    switchAsciiCase(p, n, actual.data(), (uint8_t)'a');
+    ASSERT_EQ(expected, actual) << "trial " << trial;
+
+    // Differs from text only in case, except perhaps at one position
+    std::vector<uint8_t> other(n);
+    switchAsciiCase<uint8_t>(p, n, other.data(), 'A');
+    if (n && (trial % 3)) {
+      other[rng() % n] ^= (uint8_t)(1 << (rng() % 8));
+    }
+    ASSERT_EQ(findMismatchIgnoringCase<uint8_t>(p, other.data(), n),
+	      findMismatchIgnoringCase(p, other.data(), n))
+	<< "trial " << trial;
+  }
+}
+
+TEST(IStringCaseTests, SwitchCase) {
+  const char16_t text[] = u"Hello, World! \u00C9t\u00E9";
+  const size_t n = sizeof(text) / sizeof(char16_t) - 1;
+  char16_t upper[n + 1] = { 0 };
+  char16_t lower[n + 1] = { 0 };
+
+  switchAsciiCase(text, n, upper, (char16_t)'a');
+  switchAsciiCase(text, n, lower, (char16_t)'A');
+  EXPECT_EQ(std::u16string(u"HELLO, WORLD! \u00C9T\u00E9"), upper);
+  EXPECT_EQ(std::u16string(u"hello, world! \u00C9t\u00E9"), lower);
+}
+
+TEST(IStringCaseTests, FindMismatchIgnoringCase) {
+  const char32_t left[] = U"Content-Length";
+  const char32_t right[] = U"content-lenGTH";
+  const char32_t other[] = U"content-lenGTX";
+
+  EXPECT_EQ((size_t)14, findMismatchIgnoringCase(left, right, 14));
+  EXPECT_EQ((size_t)13, findMismatchIgnoringCase(left, other, 14));
+  EXPECT_EQ((size_t)0, findMismatchIgnoringCase(U"@", U"`", 1));
+}
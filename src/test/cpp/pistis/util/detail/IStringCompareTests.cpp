@@ -0,0 +1,55 @@
+#include <pistis/util/detail/IStringCompare.hpp>
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+using namespace pistis::util::detail;
+
+namespace {
+  template <typename Narrow, typename Wide>
+  void verifyMismatch() {
+    std::mt19937 rng(31);
+    for (size_t trial = 0; trial < 1000; ++trial) {
+      const size_t n = rng() % 100;
+      std::vector<Narrow> narrow(n);
+      for (auto& c : narrow) {
+	c = (Narrow)rng();
+      }
+      std::vector<Wide> wide(narrow.begin(), narrow.end());
+      size_t expected = n;
+      if (n && (trial % 4)) {
+	expected = rng() % n;
+	// Differs only in a bit the narrow type does not have
+	wide[expected] += (Wide)((Wide)1 << (8 * sizeof(Narrow)));
+      }
+
+      ASSERT_EQ(expected, findWideningMismatch(narrow.data(), wide.data(), n))
+	  << "trial " << trial;
+      ASSERT_EQ(expected, findMismatch(narrow.data(), wide.data(), n))
+	  << "trial " << trial;
+      ASSERT_EQ(expected, findMismatch(wide.data(), narrow.data(), n))
+	  << "trial " << trial;
+    }
+  }
+}
+
+TEST(IStringCompareTests, KernelIsKnown) {
+  const std::string kernel = wideningCompareKernel();
+  EXPECT_TRUE((kernel == "avx2") || (kernel == "scalar")) << kernel;
+}
+
+TEST(IStringCompareTests, FindWideningMismatch) {
+  verifyMismatch<uint8_t, uint16_t>();
+  verifyMismatch<uint8_t, uint32_t>();
+  verifyMismatch<uint16_t, uint32_t>();
+}
+
+TEST(IStringCompareTests, FindMismatchBetweenCharTypes) {
+  const char TEXT[] = "a string longer than sixteen characters";
+  const char16_t WIDE[] = u"a string longer than sixteen character!";
+
+  EXPECT_EQ(sizeof(TEXT) - 2,
+	    findMismatch(TEXT, WIDE, sizeof(TEXT) - 1));
+  EXPECT_EQ(sizeof(TEXT) - 2,
+	    findMismatch(WIDE, TEXT, sizeof(TEXT) - 1));
+}
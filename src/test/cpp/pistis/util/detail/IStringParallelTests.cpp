@@ -0,0 +1,75 @@
+#include <pistis/util/detail/IStringParallel.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace pistis::util::detail;
+
+namespace {
+  std::vector<size_t> findSequentially(const std::string& text,
+				       const std::string& pattern) {
+    std::vector<size_t> found;
+    for (size_t p = text.find(pattern); p != std::string::npos;
+	 p = text.find(pattern, p + pattern.size())) {
+      found.push_back(p);
+    }
+    return found;
+  }
+
+  std::vector<size_t> findInParallel(const std::string& text,
+				     const std::string& pattern,
+				     size_t numChunks) {
+    const std::vector<size_t> boundaries =
+        chunkBoundaries(text.size(), numChunks);
+    auto find = [&text, &pattern](size_t start, size_t end) {
+      const size_t p = text.substr(0, end).find(pattern, start);
+      return (p == std::string::npos) ? std::numeric_limits<size_t>::max()
+	                              : p;
+    };
+    std::vector<size_t> found;
+    for (const auto& chunk : findInChunks(boundaries, text.size(),
+					  pattern.size(), find)) {
+      found.insert(found.end(), chunk.begin(), chunk.end());
+    }
+    return found;
+  }
+}
+
+TEST(IStringParallelTests, ChunkBoundaries) {
+  EXPECT_EQ(std::vector<size_t>({ 0, 4, 7, 10 }), chunkBoundaries(10, 3));
+  EXPECT_EQ(std::vector<size_t>({ 0, 10 }), chunkBoundaries(10, 1));
+  EXPECT_EQ(std::vector<size_t>({ 0, 1, 2 }), chunkBoundaries(2, 2));
+}
+
+TEST(IStringParallelTests, ForEachChunk) {
+  std::vector<std::atomic<int> > calls(5);
+  forEachChunk(calls.size(), [&calls](size_t i) { ++calls[i]; });
+  for (const auto& c : calls) {
+    EXPECT_EQ(1, c.load());
+  }
+
+  EXPECT_THROW(forEachChunk(3, [](size_t i) {
+		 if (i == 2) {
+		   throw std::runtime_error("chunk 2 failed");
+		 }
+	       }),
+	       std::runtime_error);
+}
+
+TEST(IStringParallelTests, MatchesAcrossChunkBoundaries) {
+  // Runs of a self-overlapping pattern make the matches each chunk
+  // finds on its own disagree with a search over the whole text.
+  const std::string text = "aaaaaaa b aaa abab ababab aaaaaaaaaaa ab";
+  for (const std::string pattern : { "a", "aa", "aaa", "aba", "abab", "b a",
+				      "zz" }) {
+    const std::vector<size_t> truth = findSequentially(text, pattern);
+    for (size_t numChunks = 1; numChunks <= text.size() / pattern.size();
+	 ++numChunks) {
+      EXPECT_EQ(truth, findInParallel(text, pattern, numChunks))
+	  << "pattern = \"" << pattern << "\", numChunks = " << numChunks;
+    }
+  }
+}
@@ -0,0 +1,180 @@
+#include <pistis/util/detail/IStringSearch.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <string.h>
+#include <vector>
+
+using namespace pistis::util::detail;
+
+namespace {
+  template <typename Unit>
+  size_t expectedPosition(const std::vector<Unit>& text,
+			  const std::vector<Unit>& pattern) {
+    return std::search(text.begin(), text.end(), pattern.begin(),
+		       pattern.end()) - text.begin();
+  }
+
+  template <typename Unit>
+  size_t expectedLast(const std::vector<Unit>& text, Unit c) {
+    const auto i = std::find(text.rbegin(), text.rend(), c);
+    return (i == text.rend()) ? text.size() : (text.rend() - i - 1);
+  }
+
+  // Small alphabets produce lots of partial matches
+  template <typename Unit>
+  std::vector<Unit> randomUnits(std::mt19937& rng, size_t n, Unit alphabet) {
+    std::vector<Unit> units(n);
+    for (auto& u : units) {
+      u = (Unit)((0x101 * (rng() % alphabet)) & (Unit)~0);
+    }
+    return units;
+  }
+
+  template <typename Unit>
+  void verifySearchMatchesStdSearch() {
+    std::mt19937 rng(17);
+    for (size_t trial = 0; trial < 2000; ++trial) {
+      const Unit alphabet = 2 + trial % 3;
+      const std::vector<Unit> text = randomUnits(rng, rng() % 300, alphabet);
+      const std::vector<Unit> pattern =
+	  randomUnits(rng, 1 + rng() % 12, alphabet);
+      const size_t expected = expectedPosition(text, pattern);
+
+      ASSERT_EQ(expected, searchUnits(text.data(), text.size(),
+				      pattern.data(), pattern.size()))
+	  << "trial " << trial;
+      ASSERT_EQ(expected, twoWaySearchUnits(text.data(), text.size(),
+					    pattern.data(), pattern.size()))
+	  << "trial " << trial;
+    }
+  }
+}
+
+TEST(IStringSearchTests, KernelIsKnown) {
+  const std::string kernel = substringSearchKernel();
+  EXPECT_TRUE((kernel == "avx2") || (kernel == "sse2") ||
+	      (kernel == "two-way")) << kernel;
+}
+
+TEST(IStringSearchTests, SearchBytes) {
+  verifySearchMatchesStdSearch<uint8_t>();
+}
+
+TEST(IStringSearchTests, SearchWideUnits) {
+  verifySearchMatchesStdSearch<uint16_t>();
+  verifySearchMatchesStdSearch<uint32_t>();
+}
+
+TEST(IStringSearchTests, AdversarialInput) {
+  // Every position matches the first and last units of the pattern, so
+  // the vectorized search has to fall back to Two-Way
+  std::vector<uint8_t> text(100000, 'a');
+  std::vector<uint8_t> pattern(500, 'a');
+  pattern[250] = 'b';
+
+  EXPECT_EQ(text.size(), searchUnits(text.data(), text.size(),
+				     pattern.data(), pattern.size()));
+
+  std::copy(pattern.begin(), pattern.end(), text.end() - 600);
+  EXPECT_EQ(text.size() - 600,
+	    searchUnits(text.data(), text.size(), pattern.data(),
+			pattern.size()));
+}
+
+TEST(IStringSearchTests, MatchAtBoundaries) {
+  std::vector<uint8_t> text(200, 'x');
+  const uint8_t PATTERN[] = { 'a', 'b', 'c' };
+
+  for (size_t i = 0; i + 3 <= text.size(); ++i) {
+    std::copy(PATTERN, PATTERN + 3, text.begin() + i);
+    ASSERT_EQ(i, searchUnits(text.data(), text.size(), PATTERN, 3));
+    std::fill(text.begin() + i, text.begin() + i + 3, 'x');
+  }
+}
+
+TEST(IStringSearchTests, FindInByteSet) {
+  std::mt19937 rng(23);
+  for (size_t trial = 0; trial < 500; ++trial) {
+    std::vector<uint8_t> text(rng() % 400);
+    for (auto& c : text) {
+      c = (uint8_t)rng();
+    }
+    std::vector<uint8_t> chars(1 + rng() % 3);
+    for (auto& c : chars) {
+      c = (uint8_t)rng();
+    }
+    const ByteSet set(chars.data(), chars.size());
+    const size_t first = std::find_first_of(text.begin(), text.end(),
+					    chars.begin(), chars.end())
+                         - text.begin();
+    const auto last = std::find_first_of(text.rbegin(), text.rend(),
+					 chars.begin(), chars.end());
+    const size_t lastIndex =
+        (last == text.rend()) ? text.size() : text.rend() - last - 1;
+
+    ASSERT_EQ(first, findFirstInSet(text.data(), text.size(), set))
+        << "trial " << trial;
+    ASSERT_EQ(lastIndex, findLastInSet(text.data(), text.size(), set))
+        << "trial " << trial;
+  }
+}
+
+TEST(IStringSearchTests, UnitSet) {
+  const uint32_t UNITS[] = { 'a', 0x2028, 0x10000, 0xFF };
+  const UnitSet<uint32_t> set(UNITS, 4);
+
+  EXPECT_TRUE(set.contains('a'));
+  EXPECT_TRUE(set.contains(0xFF));
+  EXPECT_TRUE(set.contains(0x2028));
+  EXPECT_TRUE(set.contains(0x10000));
+  EXPECT_FALSE(set.contains('b'));
+  EXPECT_FALSE(set.contains(0x2029));
+  EXPECT_FALSE(set.contains(0x10000 + 64));
+}
+
+namespace {
+  template <typename Unit>
+  void verifyReverseSearchMatchesFindEnd() {
+    std::mt19937 rng(29);
+    for (size_t trial = 0; trial < 2000; ++trial) {
+      const Unit alphabet = 2 + trial % 3;
+      const std::vector<Unit> text = randomUnits(rng, rng() % 300, alphabet);
+      const std::vector<Unit> pattern =
+	  randomUnits(rng, 1 + rng() % 12, alphabet);
+      const size_t expected = std::find_end(text.begin(), text.end(),
+					    pattern.begin(), pattern.end())
+                              - text.begin();
+
+      ASSERT_EQ(expected, reverseSearchUnits(text.data(), text.size(),
+					     pattern.data(), pattern.size()))
+	  << "trial " << trial;
+      ASSERT_EQ(expected,
+		twoWayReverseSearchUnits(text.data(), text.size(),
+					 pattern.data(), pattern.size()))
+	  << "trial " << trial;
+      ASSERT_EQ(expectedLast(text, pattern[0]),
+		findLastUnit(text.data(), text.size(), pattern[0]))
+	  << "trial " << trial;
+    }
+  }
+}
+
+TEST(IStringSearchTests, ReverseSearch) {
+  verifyReverseSearchMatchesFindEnd<uint8_t>();
+  verifyReverseSearchMatchesFindEnd<uint16_t>();
+  verifyReverseSearchMatchesFindEnd<uint32_t>();
+}
+
+TEST(IStringSearchTests, ReverseAdversarialInput) {
+  std::vector<uint8_t> text(100000, 'a');
+  std::vector<uint8_t> pattern(500, 'a');
+  pattern[250] = 'b';
+
+  EXPECT_EQ(text.size(), reverseSearchUnits(text.data(), text.size(),
+					    pattern.data(), pattern.size()));
+
+  std::copy(pattern.begin(), pattern.end(), text.begin() + 600);
+  EXPECT_EQ(600, reverseSearchUnits(text.data(), text.size(), pattern.data(),
+				    pattern.size()));
+}
@@ -0,0 +1,129 @@
+#include <pistis/util/detail/IStringText.hpp>
+#include <pistis/util/InternPool.hpp>
+#include <gtest/gtest.h>
+#include <new>
+#include <stddef.h>
+#include <sys/mman.h>
+
+using namespace pistis::util;
+using namespace pistis::util::detail;
+
+namespace {
+  // Maps large requests without reserving memory for them, so a text
+  // past IStringText::MAX_SIZE costs only the pages a test touches.
+  // Counts outstanding bytes to check that everything is freed.
+  class LazyAllocator {
+  public:
+    typedef uint8_t value_type;
+
+    static constexpr const size_t LAZY_SIZE = 1024 * 1024;
+
+    LazyAllocator(size_t& outstanding): outstanding_(&outstanding) { }
+
+    uint8_t* allocate(size_t n) {
+      void* p;
+      if (n < LAZY_SIZE) {
+	p = ::operator new(n);
+      } else {
+	p = ::mmap(nullptr, n, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (p == MAP_FAILED) {
+	  throw std::bad_alloc();
+	}
+      }
+      *outstanding_ += n;
+      return (uint8_t*)p;
+    }
+
+    void deallocate(uint8_t* p, size_t n) {
+      if (n < LAZY_SIZE) {
+	::operator delete(p);
+      } else {
+	::munmap(p, n);
+      }
+      *outstanding_ -= n;
+    }
+
+  private:
+    size_t* outstanding_;
+  };
+
+  typedef IStringText<char> Text;
+  typedef IStringTextPtr<char, LazyAllocator> TextPtr;
+}
+
+TEST(IStringTextTests, SmallTextLayout) {
+  EXPECT_EQ(16, offsetof(Text, text));
+  EXPECT_EQ(17, Text::computeAllocationSize(1));
+  EXPECT_EQ(((size_t)1 << 29) - 1, Text::MAX_SIZE);
+
+  size_t outstanding = 0;
+  LazyAllocator allocator(outstanding);
+  TextPtr text = TextPtr::create(100, allocator);
+  EXPECT_FALSE(text->large());
+  EXPECT_FALSE(text->mapped());
+  EXPECT_FALSE(text->borrowed());
+  EXPECT_EQ(100, text->size());
+  EXPECT_EQ(100, text->numChars());
+  EXPECT_EQ(text->text, text->chars());
+  EXPECT_EQ(Text::computeAllocationSize(100), text->footprint());
+
+  TextPtr borrowed = TextPtr::borrow(text.get(), allocator);
+  EXPECT_TRUE(borrowed->borrowed());
+  EXPECT_FALSE(borrowed->mapped());
+  EXPECT_FALSE(borrowed->large());
+  EXPECT_EQ(text.get(), borrowed->owner());
+
+  borrowed.reset();
+  text.reset();
+  EXPECT_EQ(0, outstanding);
+}
+
+TEST(IStringTextTests, CreateLargeText) {
+  const size_t n = Text::MAX_SIZE + 100;
+  size_t outstanding = 0;
+  {
+    LazyAllocator allocator(outstanding);
+    TextPtr text = TextPtr::create(n, allocator);
+    ASSERT_TRUE(text->large());
+    EXPECT_FALSE(text->mapped());
+    EXPECT_FALSE(text->borrowed());
+    EXPECT_EQ(n, text->numChars());
+    EXPECT_NE(text->text, text->chars());
+    EXPECT_EQ(text->allocationSize() + n, text->footprint());
+    EXPECT_EQ(outstanding, text->footprint());
+
+    char* const chars = text->chars();
+    chars[0] = 'a';
+    chars[n - 1] = 'z';
+    EXPECT_TRUE(text->spans(chars, n));
+    EXPECT_FALSE(text->spans(chars, n - 1));
+  }
+  EXPECT_EQ(0, outstanding);
+}
+
+TEST(IStringTextTests, ResizeLargeText) {
+  const size_t n = Text::MAX_SIZE + 100;
+  size_t outstanding = 0;
+  {
+    LazyAllocator allocator(outstanding);
+    TextPtr text = TextPtr::create(n, allocator);
+    char* const chars = text->chars();
+
+    // Shrinks and grows within its capacity without moving
+    EXPECT_TRUE(text.resize(10));
+    EXPECT_TRUE(text->large());
+    EXPECT_EQ(10, text->numChars());
+    EXPECT_EQ(chars, text->chars());
+    EXPECT_EQ(text->allocationSize() + n, text->footprint());
+
+    EXPECT_TRUE(text.resize(n));
+    EXPECT_EQ(n, text->numChars());
+    EXPECT_FALSE(text.resize(n + 1));
+
+    // Not while shared
+    TextPtr copy(text);
+    EXPECT_FALSE(text.resize(10));
+  }
+  EXPECT_EQ(0, outstanding);
+}
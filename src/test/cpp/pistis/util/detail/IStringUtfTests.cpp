@@ -0,0 +1,153 @@
+#include <pistis/util/detail/IStringUtf.hpp>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace pistis::util::detail;
+
+namespace {
+  // Straightforward reference encoders for checking the kernels
+  std::vector<uint8_t> referenceUtf8(const std::vector<uint32_t>& text) {
+    std::vector<uint8_t> out;
+    for (uint32_t c : text) {
+      if (c < 0x80) {
+	out.push_back((uint8_t)c);
+      } else if (c < 0x800) {
+	out.push_back((uint8_t)(0xC0 | (c >> 6)));
+	out.push_back((uint8_t)(0x80 | (c & 0x3F)));
+      } else if (c < 0x10000) {
+	out.push_back((uint8_t)(0xE0 | (c >> 12)));
+	out.push_back((uint8_t)(0x80 | ((c >> 6) & 0x3F)));
+	out.push_back((uint8_t)(0x80 | (c & 0x3F)));
+      } else {
+	out.push_back((uint8_t)(0xF0 | (c >> 18)));
+	out.push_back((uint8_t)(0x80 | ((c >> 12) & 0x3F)));
+	out.push_back((uint8_t)(0x80 | ((c >> 6) & 0x3F)));
+	out.push_back((uint8_t)(0x80 | (c & 0x3F)));
+      }
+    }
+    return out;
+  }
+
+  std::vector<uint16_t> referenceUtf16(const std::vector<uint32_t>& text) {
+    std::vector<uint16_t> out;
+    for (uint32_t c : text) {
+      if (c < 0x10000) {
+	out.push_back((uint16_t)c);
+      } else {
+	out.push_back((uint16_t)(0xD800 + ((c - 0x10000) >> 10)));
+	out.push_back((uint16_t)(0xDC00 + ((c - 0x10000) & 0x3FF)));
+      }
+    }
+    return out;
+  }
+
+  // Runs of ASCII of random length, some long enough for the kernels,
+  // between code points from every other UTF-8 length
+  std::vector<uint32_t> randomText(std::mt19937& rng) {
+    static const uint32_t NON_ASCII[] = {
+      0x80, 0xE9, 0x7FF, 0x800, 0x4E2D, 0xD7FF, 0xE000, 0xFFFD, 0xFFFF,
+      0x10000, 0x1F600, 0x10FFFF
+    };
+    std::vector<uint32_t> text;
+    const size_t numRuns = rng() % 8;
+    for (size_t r = 0; r < numRuns; ++r) {
+      const size_t runLength = (rng() % 2) ? rng() % 5 : rng() % 80;
+      for (size_t i = 0; i < runLength; ++i) {
+	text.push_back(0x20 + rng() % 0x5F);
+      }
+      text.push_back(NON_ASCII[rng() % (sizeof(NON_ASCII) / sizeof(uint32_t))]);
+    }
+    return text;
+  }
+
+  template <typename In, typename Out>
+  void verifyTranscode(const std::vector<In>& in,
+		       const std::vector<Out>& expected) {
+    const UtfScan scan = scanUtf(in.data(), in.size(), sizeof(Out));
+    ASSERT_EQ(in.size(), scan.invalidAt);
+    ASSERT_EQ(expected.size(), scan.length);
+
+    std::vector<Out> out(scan.length);
+    transcodeUtf(in.data(), in.size(), out.data());
+    ASSERT_EQ(expected, out);
+  }
+
+  size_t invalidUtf8At(const std::string& text) {
+    return scanUtf((const uint8_t*)text.data(), text.size(), 2).invalidAt;
+  }
+}
+
+TEST(IStringUtfTests, KernelIsKnown) {
+  const std::string kernel = utfKernel();
+  EXPECT_TRUE((kernel == "avx2") || (kernel == "scalar")) << kernel;
+}
+
+TEST(IStringUtfTests, TranscodeMatchesReference) {
+  std::mt19937 rng(23);
+  for (size_t trial = 0; trial < 500; ++trial) {
+    const std::vector<uint32_t> utf32 = randomText(rng);
+    const std::vector<uint16_t> utf16 = referenceUtf16(utf32);
+    const std::vector<uint8_t> utf8 = referenceUtf8(utf32);
+    SCOPED_TRACE("trial " + std::to_string(trial));
+
+    verifyTranscode(utf8, utf16);
+    verifyTranscode(utf8, utf32);
+    verifyTranscode(utf8, utf8);
+    verifyTranscode(utf16, utf8);
+    verifyTranscode(utf16, utf32);
+    verifyTranscode(utf32, utf8);
+    verifyTranscode(utf32, utf16);
+  }
+}
+
+TEST(IStringUtfTests, RejectInvalidUtf8) {
+  EXPECT_EQ((size_t)5, invalidUtf8At("ascii"));
+  EXPECT_EQ((size_t)2, invalidUtf8At("ab\x80"));             // Continuation
+  EXPECT_EQ((size_t)1, invalidUtf8At("a\xC0\xAF"));          // Overlong
+  EXPECT_EQ((size_t)0, invalidUtf8At("\xC1\xBF"));           // Overlong
+  EXPECT_EQ((size_t)0, invalidUtf8At("\xE0\x9F\xBF"));       // Overlong
+  EXPECT_EQ((size_t)0, invalidUtf8At("\xF0\x8F\xBF\xBF"));   // Overlong
+  EXPECT_EQ((size_t)0, invalidUtf8At("\xED\xA0\x80"));       // Surrogate
+  EXPECT_EQ((size_t)0, invalidUtf8At("\xF4\x90\x80\x80"));   // > U+10FFFF
+  EXPECT_EQ((size_t)0, invalidUtf8At("\xF5\x80\x80\x80"));
+  EXPECT_EQ((size_t)3, invalidUtf8At("abc\xE2\x82"));        // Truncated
+  EXPECT_EQ((size_t)0, invalidUtf8At("\xE2\x28\xA1"));
+  EXPECT_EQ((size_t)4, invalidUtf8At("\xED\x9F\xBF" "a\xFF"));
+
+  // An error after a run long enough for the kernels
+  const std::string longRun(100, 'x');
+  EXPECT_EQ((size_t)100, invalidUtf8At(longRun + "\xC3"));
+  EXPECT_EQ((size_t)102, invalidUtf8At(longRun + "\xC3\xA9\xC3"));
+}
+
+TEST(IStringUtfTests, RejectInvalidUtf16) {
+  const uint16_t lone[] = { 'a', 0xD800, 'b' };
+  const uint16_t reversed[] = { 0xDC00, 0xD800 };
+  const uint16_t truncated[] = { 'a', 'b', 0xDBFF };
+  const uint16_t paired[] = { 0xDBFF, 0xDFFF };
+
+  EXPECT_EQ((size_t)1, scanUtf(lone, 3, 1).invalidAt);
+  EXPECT_EQ((size_t)1, scanUtf(lone, 3, 1).length);
+  EXPECT_EQ((size_t)0, scanUtf(reversed, 2, 4).invalidAt);
+  EXPECT_EQ((size_t)2, scanUtf(truncated, 3, 1).invalidAt);
+  EXPECT_EQ((size_t)2, scanUtf(paired, 2, 4).invalidAt);
+  EXPECT_EQ((size_t)1, scanUtf(paired, 2, 4).length);
+  EXPECT_EQ((size_t)4, scanUtf(paired, 2, 1).length);
+}
+
+TEST(IStringUtfTests, RejectInvalidUtf32) {
+  const uint32_t surrogate[] = { 'a', 0xDFFF };
+  const uint32_t tooLarge[] = { 0x10FFFF, 0x110000 };
+
+  EXPECT_EQ((size_t)1, scanUtf(surrogate, 2, 1).invalidAt);
+  EXPECT_EQ((size_t)1, scanUtf(tooLarge, 2, 2).invalidAt);
+  EXPECT_EQ((size_t)2, scanUtf(tooLarge, 2, 2).length);
+}
+
+TEST(IStringUtfTests, UtfName) {
+  EXPECT_EQ(std::string("UTF-8"), utfName(1));
+  EXPECT_EQ(std::string("UTF-16"), utfName(2));
+  EXPECT_EQ(std::string("UTF-32"), utfName(4));
+}